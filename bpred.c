@@ -50,6 +50,8 @@
 
 #include"bpred.h"
 
+#include<iostream>
+
 bpred_t::bpred_t()
 : retstack(0)
 {
@@ -128,3 +130,67 @@ void bpred_t::reset()
 	retstack.reset();
 }
 
+void bpred_t::save_state(std::ostream & out) const
+{
+	out << name << " " << retstack;
+}
+
+void bpred_t::load_state(std::istream & in)
+{
+	std::string saved_name;
+	in >> saved_name;
+	if(saved_name != name)
+	{
+		fatal("checkpoint holds a `%s' predictor, this one is `%s'", saved_name.c_str(), name.c_str());
+	}
+	in >> retstack;
+}
+
+void bpred_t::save_table(std::ostream & out, const std::vector<unsigned char> & table)
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string buf(2 * table.size(), '0');
+	for(size_t i=0;i<table.size();i++)
+	{
+		buf[2*i] = digits[table[i] >> 4];
+		buf[2*i+1] = digits[table[i] & 0xf];
+	}
+	out << " " << std::dec << table.size() << " " << buf;
+}
+
+void bpred_t::load_table(std::istream & in, std::vector<unsigned char> & table)
+{
+	size_t size;
+	std::string buf;
+	in >> std::dec >> size >> buf;
+	if((size != table.size()) || (buf.size() != 2 * size))
+	{
+		fatal("checkpoint predictor table has %d entries, this one has %d", (int)size, (int)table.size());
+	}
+	for(size_t i=0;i<table.size();i++)
+	{
+		char t[3] = { buf[2*i], buf[2*i+1], 0 };
+		table[i] = static_cast<unsigned char>(strtol(t, NULL, 16));
+	}
+}
+
+std::ostream & operator<<(std::ostream & out, const bpred_t & source)
+{
+	out << "(";
+	source.save_state(out);
+	out << ")";
+	return out;
+}
+
+std::istream & operator>>(std::istream & in, bpred_t & target)
+{
+	char c_buf;
+	in >> c_buf;
+	target.load_state(in);
+	in >> c_buf;
+	if(c_buf != ')')
+	{
+		fatal("bad `%s' predictor in checkpoint", target.name.c_str());
+	}
+	return in;
+}
@@ -56,6 +56,10 @@
 #include"stats.h"
 #include"retstack.h"
 
+#include<iosfwd>
+#include<string>
+#include<vector>
+
 //branch predictor update information
 class bpred_update_t
 {
@@ -139,6 +143,19 @@ class bpred_t
 
 		//register branch predictor stats with sdb (stat database) using name as an identifier
 		void bpred_reg_stats(stat_sdb_t *sdb, const char * name);
+
+		//checkpoint the predictor state (tables, BTB and return address stack, the stats are not saved),
+		//predictors with tables extend these, loading checks the predictor type and geometry match
+		virtual void save_state(std::ostream & out) const;
+		virtual void load_state(std::istream & in);
+
+	protected:
+		//a prediction state table, as hex digits
+		static void save_table(std::ostream & out, const std::vector<unsigned char> & table);
+		static void load_table(std::istream & in, std::vector<unsigned char> & table);
 };
 
+std::ostream & operator<<(std::ostream & out, const bpred_t & source);
+std::istream & operator>>(std::istream & in, bpred_t & target);
+
 #endif
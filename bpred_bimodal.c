@@ -1,5 +1,7 @@
 #include"bpred_bimodal.h"
 
+#include<iostream>
+
 //turn this on to enable the SimpleScalar 2.0 RAS bug
 //#define RAS_BUG_COMPATIBLE
 
@@ -178,3 +180,17 @@ void bpred_bpred_2bit::bpred_config(FILE *stream)
 	fprintf(stream, "btb: %ld sets x %ld associativity",  btb.sets, btb.assoc);
 	fprintf(stream, "ret_stack: %ld entries", retstack.stack.size());
 }
+
+void bpred_bpred_2bit::save_state(std::ostream & out) const
+{
+	bpred_t::save_state(out);
+	save_table(out, table);
+	out << " " << btb;
+}
+
+void bpred_bpred_2bit::load_state(std::istream & in)
+{
+	bpred_t::load_state(in);
+	load_table(in, table);
+	in >> btb;
+}
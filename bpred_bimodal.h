@@ -42,6 +42,9 @@ class bpred_bpred_2bit : public bpred_t
 
 		//Update a predictor entry - pointer to the entry (NULL if none)
 		void update_state(char *p, bool taken);
+
+		void save_state(std::ostream & out) const;
+		void load_state(std::istream & in);
 };
 
 
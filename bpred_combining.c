@@ -1,5 +1,7 @@
 #include"bpred_combining.h"
 
+#include<iostream>
+
 //turn this on to enable the SimpleScalar 2.0 RAS bug
 //#define RAS_BUG_COMPATIBLE
 
@@ -234,3 +236,14 @@ void bpred_bpred_comb::bpred_config(FILE *stream)
 	fprintf(stream, "ret_stack: %ld entries", retstack.stack.size());
 }
 
+void bpred_bpred_comb::save_state(std::ostream & out) const
+{
+	bpred_t::save_state(out);
+	out << " " << btb << " " << bimod << " " << meta << " " << twolev;
+}
+
+void bpred_bpred_comb::load_state(std::istream & in)
+{
+	bpred_t::load_state(in);
+	in >> btb >> bimod >> meta >> twolev;
+}
@@ -50,6 +50,9 @@ class bpred_bpred_comb : public bpred_t
 
 		void bpred_reg_stats(stat_sdb_t *sdb, const char *name);
 		void reset();
+
+		void save_state(std::ostream & out) const;
+		void load_state(std::istream & in);
 };
 
 #endif
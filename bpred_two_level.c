@@ -1,5 +1,7 @@
 #include"bpred_two_level.h"
 
+#include<iostream>
+
 //turn this on to enable the SimpleScalar 2.0 RAS bug
 //#define RAS_BUG_COMPATIBLE
 
@@ -219,3 +221,34 @@ void bpred_bpred_2Level::bpred_config(FILE *stream)
 	fprintf(stream, "ret_stack: %ld entries", retstack.stack.size());
 }
 
+void bpred_bpred_2Level::save_state(std::ostream & out) const
+{
+	bpred_t::save_state(out);
+	out << " " << std::dec << shiftregs.size() << std::hex;
+	for(size_t i=0;i<shiftregs.size();i++)
+	{
+		out << " " << shiftregs[i];
+	}
+	out << std::dec;
+	save_table(out, l2table);
+	out << " " << btb;
+}
+
+void bpred_bpred_2Level::load_state(std::istream & in)
+{
+	bpred_t::load_state(in);
+	size_t size;
+	in >> std::dec >> size;
+	if(size != shiftregs.size())
+	{
+		fatal("checkpoint 2-level predictor has %d history registers, this one has %d", (int)size, (int)shiftregs.size());
+	}
+	in >> std::hex;
+	for(size_t i=0;i<shiftregs.size();i++)
+	{
+		in >> shiftregs[i];
+	}
+	in >> std::dec;
+	load_table(in, l2table);
+	in >> btb;
+}
@@ -1,5 +1,6 @@
 #include"btb.h"
 #include<cassert>
+#include<iostream>
 
 #ifdef NEW_BTB
 #include<algorithm>
@@ -256,3 +257,103 @@ void btb_t::update(bpred_btb_ent_t * pbtb, bool taken, md_addr_t baddr, bool cor
 	}
 #endif
 }
+
+#ifdef NEW_BTB
+std::ostream & operator<<(std::ostream & out, const btb_t & source)
+{
+	out << "(" << std::dec << source.btb_data.size() << std::hex;
+	for(size_t i=0;i<source.btb_data.size();i++)
+	{
+		//MRU first
+		out << " " << std::dec << source.btb_data[i].size() << std::hex;
+		for(std::list<bpred_btb_ent_t>::const_iterator it = source.btb_data[i].begin(); it != source.btb_data[i].end(); ++it)
+		{
+			out << " " << it->addr << " " << it->target;
+		}
+	}
+	out << std::dec << ")";
+	return out;
+}
+
+std::istream & operator>>(std::istream & in, btb_t & target)
+{
+	char c_buf;
+	size_t sets;
+	in >> c_buf >> std::dec >> sets;
+	if(sets != target.btb_data.size())
+	{
+		fatal("checkpoint BTB has %d sets, this one has %d", (int)sets, (int)target.btb_data.size());
+	}
+	for(size_t i=0;i<target.btb_data.size();i++)
+	{
+		size_t entries;
+		in >> std::dec >> entries >> std::hex;
+		if(entries != target.btb_data[i].size())
+		{
+			fatal("checkpoint BTB set %d has %d entries, this one has %d", (int)i, (int)entries, (int)target.btb_data[i].size());
+		}
+		for(std::list<bpred_btb_ent_t>::iterator it = target.btb_data[i].begin(); it != target.btb_data[i].end(); ++it)
+		{
+			in >> it->addr >> it->target;
+		}
+	}
+	in >> std::dec >> c_buf;
+	if(c_buf != ')')
+	{
+		fatal("bad BTB in checkpoint");
+	}
+	return in;
+}
+#else
+//each entry is written with the index of the next (less recently used) entry of its set, -1 ends the LRU list
+std::ostream & operator<<(std::ostream & out, const btb_t & source)
+{
+	out << "(" << std::dec << source.sets << " " << source.assoc;
+	for(size_t i=0;i<source.btb_data.size();i++)
+	{
+		const bpred_btb_ent_t & ent = source.btb_data[i];
+		long long next = ent.next ? (ent.next - &source.btb_data[0]) : -1;
+		out << " " << std::hex << ent.addr << " " << ent.target << " " << std::dec << next;
+	}
+	out << ")";
+	return out;
+}
+
+std::istream & operator>>(std::istream & in, btb_t & target)
+{
+	char c_buf;
+	size_t sets, assoc;
+	in >> c_buf >> std::dec >> sets >> assoc;
+	if((sets != target.sets) || (assoc != target.assoc))
+	{
+		fatal("checkpoint BTB is %d x %d, this one is %d x %d", (int)sets, (int)assoc, (int)target.sets, (int)target.assoc);
+	}
+	for(size_t i=0;i<target.btb_data.size();i++)
+	{
+		target.btb_data[i].prev = NULL;
+	}
+	for(size_t i=0;i<target.btb_data.size();i++)
+	{
+		long long next;
+		in >> std::hex >> target.btb_data[i].addr >> target.btb_data[i].target >> std::dec >> next;
+		if((next < -1) || (next >= (long long)target.btb_data.size()) || ((next >= 0) && ((size_t)next / assoc != i / assoc)))
+		{
+			fatal("bad BTB LRU order in checkpoint");
+		}
+		target.btb_data[i].next = (next < 0) ? NULL : &target.btb_data[next];
+	}
+	for(size_t i=0;i<target.btb_data.size();i++)
+	{
+		if(target.btb_data[i].next)
+		{
+			target.btb_data[i].next->prev = &target.btb_data[i];
+		}
+	}
+	in >> c_buf;
+	if(c_buf != ')')
+	{
+		fatal("bad BTB in checkpoint");
+	}
+	return in;
+}
+#endif
@@ -6,6 +6,7 @@
 #include"misc.h"
 #include<vector>
 #include<list>
+#include<iosfwd>
 
 //#define NEW_BTB
 
@@ -43,4 +44,8 @@ class btb_t
 };
 
 
+//checkpoint the BTB entries and their LRU order, reading checks the geometry matches
+std::ostream & operator<<(std::ostream & out, const btb_t & source);
+std::istream & operator>>(std::istream & in, btb_t & target);
+
 #endif
@@ -50,9 +50,18 @@
 
 #include<cstdio>
 #include<cstdlib>
+#include<cstring>
 #include<cassert>
+#include<algorithm>
 
 #include "cache.h"
+#include<iostream>
+
+#ifndef CACHE_WAY_LIST
+#if defined(__AVX2__) || defined(__SSE2__)
+	#include<immintrin.h>
+#endif
+#endif
 
 //cache access macros
 #define CACHE_TAG(cp, addr)			((addr) >> (cp)->tag_shift)
@@ -64,10 +73,19 @@
 #define CACHE_BADDR(cp, addr)			((addr) & ~(cp)->blk_mask)
 #define CACHE_MK_BADDR(cp, tag, set)		(((tag) << (cp)->tag_shift)|((set) << (cp)->set_shift))
 
+//size of a block with its data and user data, rounded so that the next block stays aligned
+#define CACHE_BLK_SIZE(cp)			((sizeof(cache_blk_t)							\
+						+ ((cp)->balloc	? (cp)->bsize*sizeof(byte_t) : 0)			\
+						+ (cp)->usize + sizeof(md_addr_t) - 1) & ~(sizeof(md_addr_t) - 1))
+
+//words of tags and ages per set, the tags and ages of a set share cache lines
+#define CACHE_SET_WORDS(cp)			((cp)->assoc + ((cp)->assoc*sizeof(unsigned short) + sizeof(md_addr_t) - 1) / sizeof(md_addr_t))
+
 //index an array of cache blocks, non-trivial due to variable length blocks
-#define CACHE_BINDEX(cp, blks, i)		((cache_blk_t *)(((char *)(blks))			\
-						+ (i)*(sizeof(cache_blk_t)				\
-						+ ((cp)->balloc	? (cp)->bsize*sizeof(byte_t) : 0))))
+#define CACHE_BINDEX(cp, blks, i)		((cache_blk_t *)(((char *)(blks)) + (i)*(cp)->blk_size))
+
+//slot of block address BADDR among the blocks replaced by prefetches
+#define CACHE_PF_INDEX(cp, baddr)		(((baddr) >> (cp)->set_shift) & ((cp)->pf_replaced.size() - 1))
 
 //cache data block accessor, type parameterized
 #define __CACHE_ACCESS(type, data, bofs)	(*((type *)(((char *)data) + (bofs))))
@@ -90,17 +108,17 @@
 							switch (nbytes)									\
 							{										\
 							case 1:										\
-								*((byte_t *)p) = CACHE_BYTE(&blk->data[0], bofs); break;		\
+								*((byte_t *)p) = CACHE_BYTE(blk->data, bofs); break;		\
 							case 2:										\
-								*((half_t *)p) = CACHE_HALF(&blk->data[0], bofs); break;		\
+								*((half_t *)p) = CACHE_HALF(blk->data, bofs); break;		\
 							case 4:										\
-								*((word_t *)p) = CACHE_WORD(&blk->data[0], bofs); break;		\
+								*((word_t *)p) = CACHE_WORD(blk->data, bofs); break;		\
 							default:									\
 								{ /* >= 8, power of two, fits in block */				\
 									int words = nbytes >> 2;					\
 									while (words-- > 0)						\
 									{								\
-										*((word_t *)p) = CACHE_WORD(&blk->data[0], bofs);	\
+										*((word_t *)p) = CACHE_WORD(blk->data, bofs);	\
 										p += 4; bofs += 4;					\
 									}								\
 								}									\
@@ -111,17 +129,17 @@
 							switch (nbytes)									\
 							{										\
 							case 1:										\
-								CACHE_BYTE(&blk->data[0], bofs) = *((byte_t *)p); break;		\
+								CACHE_BYTE(blk->data, bofs) = *((byte_t *)p); break;		\
 							case 2:										\
-								CACHE_HALF(&blk->data[0], bofs) = *((half_t *)p); break;		\
+								CACHE_HALF(blk->data, bofs) = *((half_t *)p); break;		\
 							case 4:										\
-								CACHE_WORD(&blk->data[0], bofs) = *((word_t *)p); break;		\
+								CACHE_WORD(blk->data, bofs) = *((word_t *)p); break;		\
 							default:									\
 								{ /* >= 8, power of two, fits in block */				\
 									int words = nbytes >> 2;					\
 									while (words-- > 0)						\
 									{								\
-										CACHE_WORD(&blk->data[0], bofs) = *((word_t *)p);	\
+										CACHE_WORD(blk->data, bofs) = *((word_t *)p);	\
 										p += 4; bofs += 4;					\
 									}								\
 								}									\
@@ -179,6 +197,7 @@ enum list_loc_t
 	Tail
 };
 
+#ifdef CACHE_WAY_LIST
 //insert BLK into the order way chain in SET at location WHERE
 void update_way_list(cache_set_t *set,			//set contained way chain
 	cache_blk_t *blk,				//block to insert
@@ -243,8 +262,195 @@ void update_way_list(cache_set_t *set,			//set contained way chain
 		panic("bogus WHERE designator");
 	}
 }
+#else
+//The set operations below are instantiated for the common associativities (ASSOC), so that their loops have
+//a constant trip count, ASSOC 0 is the general case that takes the associativity at run time
+
+//move block WAY of SET to location WHERE of the replacement order, the blocks it passes move up or down by one
+template<unsigned int ASSOC>
+static inline void update_way_ages_n(cache_set_t *set,	//set containing the block
+	unsigned int assoc,				//associativity of the set
+	unsigned int way,				//block to move
+	list_loc_t where)				//insert location
+{
+	const unsigned int n = ASSOC ? ASSOC : assoc;
+	unsigned short *ages = set->ages;
+	unsigned short age = ages[way];
+	if(where == Head)
+	{
+		for(unsigned int i=0; i<n; i++)
+		{
+			ages[i] += (ages[i] < age);
+		}
+		ages[way] = 0;
+	}
+	else if(where == Tail)
+	{
+		for(unsigned int i=0; i<n; i++)
+		{
+			ages[i] -= (ages[i] > age);
+		}
+		ages[way] = n - 1;
+	}
+	else
+	{
+		panic("bogus WHERE designator");
+	}
+}
+
+//returns the block at the tail of the replacement order of SET (the oldest block)
+template<unsigned int ASSOC>
+static inline unsigned int tail_way_n(cache_set_t *set,	//set to search
+	unsigned int assoc)				//associativity of the set
+{
+	const unsigned int n = ASSOC ? ASSOC : assoc;
+	unsigned int way = 0;
+	for(unsigned int i=0; i<n; i++)
+	{
+		//arithmetic rather than a branch, the oldest block is unpredictable
+		way |= i * (set->ages[i] == n - 1);
+	}
+	return way;
+}
+
+//returns a mask of the ways among TAGS[0..N) (N <= 32) holding TAG
+static inline unsigned int cache_match(const md_addr_t *tags,	//tags to search
+	unsigned int n,						//number of tags to search
+	md_addr_t tag)						//tag to look for
+{
+	unsigned int mask = 0, i = 0;
+#if defined(__AVX2__)
+	__m256i key = _mm256_set1_epi64x(tag);
+	for(; i+4<=n; i+=4)
+	{
+		__m256i eq = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(tags + i)), key);
+		mask |= (unsigned int)_mm256_movemask_pd(_mm256_castsi256_pd(eq)) << i;
+	}
+#elif defined(__SSE2__)
+	__m128i key = _mm_set1_epi64x(tag);
+	for(; i+2<=n; i+=2)
+	{
+		//64 bit equality is the AND of both 32 bit halves
+		__m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(tags + i)), key);
+		eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+		mask |= (unsigned int)_mm_movemask_pd(_mm_castsi128_pd(eq)) << i;
+	}
+#endif
+	for(; i<n; i++)
+	{
+		mask |= (unsigned int)(tags[i] == tag) << i;
+	}
+	return mask;
+}
+
+//find the valid block of SET holding TAG for CONTEXT_ID (or for any context if ANY_CONTEXT, the one
+//nearest to the head of the replacement order, as a walk of the way list would), NULL if none
+template<unsigned int ASSOC>
+static inline cache_blk_t * find_blk_n(cache_t *cp,	//cache to search
+	cache_set_t *set,				//set to search
+	md_addr_t tag,					//tag to look for
+	int context_id,					//owner of the block
+	bool any_context,				//match blocks of any owner?
+	unsigned int *way_out)				//for return of the way of the block
+{
+	const unsigned int n = ASSOC ? ASSOC : cp->assoc;
+	cache_blk_t *found = NULL;
+	unsigned int found_way = 0;
+	for(unsigned int base=0; base<n; base+=32)
+	{
+		unsigned int mask = cache_match(set->tags + base, MIN(n - base, 32), tag);
+		while(mask)
+		{
+			unsigned int way = base + __builtin_ctz(mask);
+			mask &= mask - 1;
+			cache_blk_t *blk = CACHE_BINDEX(cp, set->blks, way);
+			if(!(blk->status & CACHE_BLK_VALID))
+				continue;
+			if(!any_context)
+			{
+				//tag and owner are unique among valid blocks
+				if(blk->context_id != context_id)
+					continue;
+				*way_out = way;
+				return blk;
+			}
+			if(!found || (set->ages[way] < set->ages[found_way]))
+			{
+				found = blk;
+				found_way = way;
+			}
+		}
+	}
+	*way_out = found_way;
+	return found;
+}
+
+//look up TAG for CONTEXT_ID in SET, returns the block on a hit (moved to the head of the replacement order if
+//the policy is LRU), otherwise returns NULL and places the block to replace in *WAY_OUT (moved to the head if
+//the policy is LRU or FIFO)
+template<unsigned int ASSOC>
+static inline cache_blk_t * cache_lookup_n(cache_t *cp,	//cache to search
+	cache_set_t *set,				//set to search
+	md_addr_t tag,					//tag to look for
+	int context_id,					//owner of the block
+	unsigned int *way_out)				//for return of the way of the block
+{
+	cache_blk_t *blk = find_blk_n<ASSOC>(cp, set, tag, context_id, false, way_out);
+	if(blk)
+	{
+		if((cp->policy == LRU) && set->ages[*way_out])
+		{
+			update_way_ages_n<ASSOC>(set, cp->assoc, *way_out, Head);
+		}
+		return blk;
+	}
+	switch(cp->policy)
+	{
+	case LRU:
+	case FIFO:
+		*way_out = tail_way_n<ASSOC>(set, cp->assoc);
+		update_way_ages_n<ASSOC>(set, cp->assoc, *way_out, Head);
+		break;
+	case Random:
+		*way_out = myrand() & (cp->assoc - 1);
+		break;
+	default:
+		panic("bogus replacement policy");
+	}
+	return NULL;
+}
+
+//run set operation OP (a template above) for the associativity of cache CP
+#define CACHE_SET_OP(cp, op, args)				\
+	switch((cp)->assoc)					\
+	{							\
+	case 1:		return op<1> args;			\
+	case 2:		return op<2> args;			\
+	case 4:		return op<4> args;			\
+	case 8:		return op<8> args;			\
+	case 16:	return op<16> args;			\
+	default:	return op<0> args;			\
+	}
+
+static cache_blk_t * cache_lookup(cache_t *cp, cache_set_t *set, md_addr_t tag, int context_id, unsigned int *way_out)
+{
+	CACHE_SET_OP(cp, cache_lookup_n, (cp, set, tag, context_id, way_out));
+}
+
+//the other set operations are rare (flushes and probes), so they are not specialized
+static void update_way_ages(cache_set_t *set, unsigned int assoc, unsigned int way, list_loc_t where)
+{
+	update_way_ages_n<0>(set, assoc, way, where);
+}
+
+static cache_blk_t * cache_find_blk(cache_t *cp, cache_set_t *set, md_addr_t tag, unsigned int *way_out)
+{
+	return find_blk_n<0>(cp, set, tag, -1, true, way_out);
+}
+#endif
 
 cache_t::cache_t()
+: partition(PART_NONE), partitioned(false), prefetcher(NULL), ucp_interval(0), ucp_next(0), ucp_stride(1)
 {}
 
 //create and initialize a general cache structure
@@ -262,11 +468,12 @@ cache_t::cache_t(std::string name,		//name of the cache
 		cache_blk_t *blk,
 		tick_t now,
 		int context_id),
-		unsigned int hit_latency)
+		unsigned int hit_latency,
+		unsigned int mshr_entries)
 : 
 //initialize user parameters
 	name(name), nsets(nsets), bsize(bsize), balloc(balloc), usize(usize), assoc(assoc), policy(policy), 
-	hit_latency(hit_latency),
+	hit_latency(hit_latency), mshr_entries(mshr_entries), partition(PART_NONE), partitioned(false),
 //miss/replacement functions
 	blk_access_fn(blk_access_fn), 
 //compute derived parameters
@@ -275,16 +482,21 @@ cache_t::cache_t(std::string name,		//name of the cache
 #endif
 	blk_mask(bsize-1), set_shift(log_base2(bsize)), 
 	set_mask(nsets-1), tag_shift(set_shift + log_base2(nsets)), tag_mask((1 << (32 - tag_shift))-1), 
-	tagset_mask(~blk_mask), 
+	tagset_mask(~blk_mask), blk_size(CACHE_BLK_SIZE(this)), 
 #ifndef BUS_CONTENTION
 	bus_free(0),
 #endif
 //initialize cache stats
 	hits(0), misses(0), replacements(0), writebacks(0), invalidations(0),
+	mshr_merges(0), mshr_allocs(0), mshr_occupancy(0), mshr_full(0), mshr_full_cycles(0),
+	pf_issued(0), pf_useful(0), pf_late(0), pf_useless(0), pf_polluting(0), pf_dropped(0), pf_mshr_allocs(0), pf_mshr_occupancy(0), repartitions(0),
 //allocate data blocks
-	data((nsets*assoc) * (sizeof(cache_blk_t) + (balloc ? (bsize*sizeof(byte_t)) : 0))),
+	data((nsets*assoc) * blk_size),
+#ifndef CACHE_WAY_LIST
+	tags(nsets * CACHE_SET_WORDS(this)),
+#endif
 //allocate the cache structure
-	sets(nsets)
+	sets(nsets), prefetcher(NULL), ucp_interval(0), ucp_next(0), ucp_stride(1)
 #ifdef BUS_CONTENTION
 	, contention_time(bsize/8), next_cache(NULL)
 #endif
@@ -305,9 +517,16 @@ cache_t::cache_t(std::string name,		//name of the cache
 		fatal("cache associativity `%d' must be non-zero and positive", assoc);
 	if((assoc & (assoc-1)) != 0)
 		fatal("cache associativity `%d' must be a power of two", assoc);
+#ifndef CACHE_WAY_LIST
+	if(assoc > 65536)
+		fatal("cache associativity `%d' must be 65536 or less", assoc);
+#endif
 	if(!blk_access_fn)
 		fatal("must specify miss/replacement functions");
 
+	//entries are taken by index, but keep them in place anyway
+	mshrs.reserve(mshr_entries);
+
 	//print derived parameters during debug
 #ifdef USE_HASH
 	debug("%s: cp->hsize     = %d", name.c_str(), hsize);
@@ -321,8 +540,13 @@ cache_t::cache_t(std::string name,		//name of the cache
 	//slice up the data blocks
 	for(unsigned int bindex=0,i=0; i<nsets; i++)
 	{
+#ifdef CACHE_WAY_LIST
 		sets[i].way_head = NULL;
 		sets[i].way_tail = NULL;
+#else
+		sets[i].tags = &tags[i * CACHE_SET_WORDS(this)];
+		sets[i].ages = (unsigned short *)(sets[i].tags + assoc);
+#endif
 
 #ifdef USE_HASH
 		//get a hash table, if needed
@@ -346,7 +570,8 @@ cache_t::cache_t(std::string name,		//name of the cache
 			blk->status = 0;
 			blk->tag = 0;
 			blk->ready = 0;
-			blk->user_data = (usize != static_cast<unsigned int>(0) ? new byte_t[usize] : NULL);
+			blk->data = (balloc ? (byte_t *)(blk + 1) : NULL);
+			blk->user_data = (usize ? (byte_t *)(blk + 1) + (balloc ? bsize : 0) : NULL);
 			blk->context_id = -1;
 
 #ifdef USE_HASH
@@ -355,6 +580,7 @@ cache_t::cache_t(std::string name,		//name of the cache
 				link_htab_ent(&sets[i], blk);
 #endif
 
+#ifdef CACHE_WAY_LIST
 			//insert into head of way list, order is arbitrary at this point
 			blk->way_next = sets[i].way_head;
 			blk->way_prev = NULL;
@@ -363,20 +589,286 @@ cache_t::cache_t(std::string name,		//name of the cache
 			sets[i].way_head = blk;
 			if(!sets[i].way_tail)
 				sets[i].way_tail = blk;
+#else
+			//same order as the way list: the last block is the head
+			sets[i].tags[j] = 0;
+			sets[i].ages[j] = assoc - 1 - j;
+#endif
 		}
 	}
 }
 
 cache_t::~cache_t()
 {
-	for(unsigned int bindex=0,i=0; i<nsets; i++)
+	delete prefetcher;
+}
+
+//attach PREFETCHER to the cache, which deletes it, NULL for none
+void cache_t::set_prefetcher(prefetcher_t *prefetcher)
+{
+	delete this->prefetcher;
+	this->prefetcher = prefetcher;
+	//remember as many replaced blocks as the cache holds, no block address is all ones
+	pf_replaced.assign(prefetcher ? nsets * assoc : 0, ~(md_addr_t)0);
+}
+
+//share the cache among NUM_CONTEXTS contexts, see cache_partition
+void cache_t::set_partition(int num_contexts, const char *config, const int *caps, int caps_nelt)
+{
+	partition = PART_NONE;
+	part_ways.assign(num_contexts, assoc);
+	occ_cap.assign(num_contexts, 0);
+	set_owned.assign(num_contexts, 0);
+	set_order.assign(assoc, 0);
+	ctx_blocks.assign(num_contexts, 0);
+	ctx_accesses.assign(num_contexts, 0);
+	ctx_misses.assign(num_contexts, 0);
+	ctx_occupancy.assign(num_contexts, 0);
+	ctx_capped.assign(num_contexts, 0);
+	count_owners();
+
+	int interval;
+	if(!mystricmp(config, "none"))
 	{
-		for(unsigned int j=0; j<assoc; j++)
+		//every context may use every way
+	}
+	else if(!strncmp(config, "static:", 7))
+	{
+		//ways per context, the last value repeats
+		partition = PART_STATIC;
+		const char *p = config + 7;
+		int n = 0;
+		while(n < num_contexts)
 		{
-			delete [] CACHE_BINDEX(this, &data[0], bindex)->user_data;
-			bindex++;
+			char *end;
+			long ways = strtol(p, &end, 10);
+			if((end == p) || ((*end != ',') && (*end != '\0')))
+				fatal("bad static partitioning `%s': static:<ways>[,<ways>...]", config);
+			if((ways < 0) || (ways > (long)assoc))
+				fatal("cache `%s' cannot give a context `%ld' of its %d ways", name.c_str(), ways, assoc);
+			part_ways[n++] = ways;
+			if(*end == '\0')
+				break;
+			p = end + 1;
+		}
+		for(;n<num_contexts;n++)
+		{
+			part_ways[n] = part_ways[n-1];
+		}
+	}
+	else if(sscanf(config, "ucp:%d", &interval) == 1)
+	{
+		if(interval < 1)
+			fatal("UCP interval `%d' must be positive", interval);
+		partition = PART_UCP;
+		ucp_interval = interval;
+		ucp_next = interval;
+
+		//shadow tags for 32 sets, or all of a smaller cache
+		ucp_stride = MAX(1, nsets / 32);
+		ucp_tags.assign(num_contexts * (nsets / ucp_stride) * assoc, ~(md_addr_t)0);
+		ucp_hits.assign(num_contexts * assoc, 0);
+		ucp_accesses.assign(num_contexts, 0);
+
+		//until the first interval is over the ways are split evenly
+		part_ways.assign(num_contexts, MAX(1, assoc / num_contexts));
+	}
+	else
+	{
+		fatal("bad cache partitioning `%s': {none|static:<ways>[,<ways>...]|ucp:<interval>}", config);
+	}
+
+	partitioned = (partition != PART_NONE);
+	for(int i=0;i<num_contexts;i++)
+	{
+		int percent = caps[MIN(i, caps_nelt - 1)];
+		if((percent < 1) || (percent > 100))
+			fatal("cache occupancy cap `%d' must be in 1..100 percent", percent);
+		if(percent < 100)
+		{
+			occ_cap[i] = MAX(1, (counter_t)nsets * assoc * percent / 100);
+			partitioned = true;
+		}
+	}
+}
+
+//recount the blocks each context holds
+void cache_t::count_owners()
+{
+	std::fill(ctx_blocks.begin(), ctx_blocks.end(), 0);
+	for(unsigned int i=0;i<nsets;i++)
+	{
+		for(unsigned int j=0;j<assoc;j++)
+		{
+			cache_blk_t *blk = CACHE_BINDEX(this, sets[i].blks, j);
+			if(blk->status & CACHE_BLK_VALID)
+				change_owner(-1, blk->context_id);
+		}
+	}
+}
+
+//a block of OLD_OWNER (-1 if invalid) now holds a block of NEW_OWNER (-1 if invalidated)
+void cache_t::change_owner(int old_owner, int new_owner)
+{
+	if((unsigned int)old_owner < ctx_blocks.size())
+		ctx_blocks[old_owner]--;
+	if((unsigned int)new_owner < ctx_blocks.size())
+		ctx_blocks[new_owner]++;
+}
+
+//returns the way of SET a miss of CONTEXT_ID replaces: the first, from the tail of the replacement order (from a
+//random way under Random), of an invalid block, a block of the context itself if it holds its share of the set or
+//has reached its occupancy cap, a block of a context over its share of the set, or any block
+unsigned int cache_t::partition_victim(md_addr_t set, int context_id, bool *capped)
+{
+	cache_set_t *s = &sets[set];
+	unsigned int n = set_owned.size();
+
+	std::fill(set_owned.begin(), set_owned.end(), 0);
+	for(unsigned int i=0;i<assoc;i++)
+	{
+		cache_blk_t *blk = CACHE_BINDEX(this, s->blks, i);
+		if((blk->status & CACHE_BLK_VALID) && ((unsigned int)blk->context_id < n))
+			set_owned[blk->context_id]++;
+	}
+
+	if(policy == Random)
+	{
+		unsigned int start = myrand();
+		for(unsigned int i=0;i<assoc;i++)
+		{
+			set_order[i] = (start + i) & (assoc - 1);
+		}
+	}
+	else
+	{
+#ifdef CACHE_WAY_LIST
+		unsigned int i = 0;
+		for(cache_blk_t *blk=s->way_tail;blk;blk=blk->way_prev)
+		{
+			set_order[i++] = ((char *)blk - (char *)s->blks) / blk_size;
+		}
+#else
+		for(unsigned int i=0;i<assoc;i++)
+		{
+			set_order[assoc - 1 - s->ages[i]] = i;
+		}
+#endif
+	}
+
+	bool at_cap(false), at_share(false);
+	if((unsigned int)context_id < n)
+	{
+		at_cap = occ_cap[context_id] && (ctx_blocks[context_id] >= occ_cap[context_id]);
+		at_share = (partition != PART_NONE) && (set_owned[context_id] >= part_ways[context_id]);
+	}
+
+	unsigned int victim = set_order[0];
+	int victim_class = 3;
+	for(unsigned int i=0;(i<assoc) && victim_class;i++)
+	{
+		cache_blk_t *blk = CACHE_BINDEX(this, s->blks, set_order[i]);
+		int blk_class;
+		if(!(blk->status & CACHE_BLK_VALID))
+			blk_class = 0;
+		else if(blk->context_id == context_id)
+			blk_class = (at_cap || at_share) ? 1 : 3;
+		else if((partition != PART_NONE) && ((unsigned int)blk->context_id < n)
+			&& (set_owned[blk->context_id] > part_ways[blk->context_id]))
+			blk_class = 2;
+		else
+			blk_class = 3;
+
+		if(blk_class < victim_class)
+		{
+			victim = set_order[i];
+			victim_class = blk_class;
+		}
+	}
+
+	//the cap only matters if the share of the set would not have chosen the same block
+	*capped = at_cap && !at_share && (victim_class == 1);
+	return victim;
+}
+
+//update the shadow tags of CONTEXT_ID with an access to TAG in SET at NOW, repartitioning first if an interval is over
+void cache_t::ucp_access(md_addr_t set, md_addr_t tag, int context_id, tick_t now)
+{
+	if(now >= ucp_next)
+	{
+		ucp_repartition();
+		ucp_next = now + ucp_interval;
+	}
+	if((set & (ucp_stride - 1)) || ((unsigned int)context_id >= part_ways.size()))
+		return;
+
+	//the shadow tags are kept in recency order, a hit at position i would have hit with i+1 ways
+	md_addr_t *shadow = &ucp_tags[(context_id * (nsets / ucp_stride) + set / ucp_stride) * assoc];
+	ucp_accesses[context_id]++;
+	unsigned int pos = 0;
+	while((pos < assoc - 1) && (shadow[pos] != tag))
+		pos++;
+	if(shadow[pos] == tag)
+		ucp_hits[context_id * assoc + pos]++;
+	for(;pos>0;pos--)
+	{
+		shadow[pos] = shadow[pos-1];
+	}
+	shadow[0] = tag;
+}
+
+//give the ways of each set to the contexts by the hits their shadow tags saw: every context that used the cache
+//gets a way, then the rest go, a few at a time, to the context that gains the most hits per way from them
+void cache_t::ucp_repartition()
+{
+	unsigned int n = part_ways.size();
+	std::vector<unsigned int> ways(n, 0);
+	unsigned int balance = assoc;
+	for(unsigned int i=0;(i<n) && balance;i++)
+	{
+		if(ucp_accesses[i])
+		{
+			ways[i] = 1;
+			balance--;
+		}
+	}
+
+	//nobody used the cache, keep the last partition
+	if(balance == assoc)
+		return;
+
+	while(balance)
+	{
+		double best_utility = -1.0;
+		unsigned int best = 0, best_ways = 0;
+		for(unsigned int i=0;i<n;i++)
+		{
+			if(!ucp_accesses[i])
+				continue;
+			counter_t gain = 0;
+			for(unsigned int k=1;k<=balance;k++)
+			{
+				gain += ucp_hits[i * assoc + ways[i] + k - 1];
+				if((double)gain / k > best_utility)
+				{
+					best_utility = (double)gain / k;
+					best = i;
+					best_ways = k;
+				}
+			}
 		}
+		ways[best] += best_ways;
+		balance -= best_ways;
 	}
+	part_ways = ways;
+	repartitions++;
+
+	//older intervals count for less
+	for(unsigned int i=0;i<ucp_hits.size();i++)
+	{
+		ucp_hits[i] /= 2;
+	}
+	std::fill(ucp_accesses.begin(), ucp_accesses.end(), 0);
 }
 
 //parse policy, returns replacement policy enumerated value
@@ -396,6 +888,14 @@ void cache_t::reset_cache_stats()
 {
 	//initialize cache stats
 	hits = misses = replacements = writebacks = invalidations = 0;
+	mshr_merges = mshr_allocs = mshr_occupancy = mshr_full = mshr_full_cycles = 0;
+	pf_issued = pf_useful = pf_late = pf_useless = pf_polluting = pf_dropped = pf_mshr_allocs = pf_mshr_occupancy = 0;
+	repartitions = 0;
+	std::fill(ctx_accesses.begin(), ctx_accesses.end(), 0);
+	std::fill(ctx_misses.begin(), ctx_misses.end(), 0);
+	std::fill(ctx_occupancy.begin(), ctx_occupancy.end(), 0);
+	std::fill(ctx_capped.begin(), ctx_capped.end(), 0);
+	mshrs.clear();
 
 #ifndef BUS_CONTENTION
 	bus_free = 0;
@@ -423,6 +923,26 @@ void cache_t::cache_config(FILE *stream)
 	fprintf(stream, "cache: %s: %d-way, `%s' replacement policy, write-back\n",
 		name.c_str(), assoc, policy == LRU ? "LRU"
 		: policy == Random ? "Random" : policy == FIFO ? "FIFO" : (abort(), ""));
+	if(mshr_entries)
+		fprintf(stream, "cache: %s: %d MSHRs\n", name.c_str(), mshr_entries);
+	if(prefetcher)
+		fprintf(stream, "cache: %s: `%s' prefetcher\n", name.c_str(), prefetcher->config.c_str());
+	if(partition == PART_STATIC)
+	{
+		fprintf(stream, "cache: %s: ways statically partitioned", name.c_str());
+		for(unsigned int i=0;i<part_ways.size();i++)
+			fprintf(stream, " %d", part_ways[i]);
+		fprintf(stream, "\n");
+	}
+	else if(partition == PART_UCP)
+	{
+		fprintf(stream, "cache: %s: utility-based partitioning every %lld cycles\n", name.c_str(), (long long)ucp_interval);
+	}
+	for(unsigned int i=0;i<occ_cap.size();i++)
+	{
+		if(occ_cap[i])
+			fprintf(stream, "cache: %s: context %d holds at most %lld blocks\n", name.c_str(), i, (long long)occ_cap[i]);
+	}
 }
 
 //print cache stats to the file descriptor stream
@@ -443,6 +963,62 @@ void cache_t::print_stats(FILE *stream)
 	fprintf(stream,"%s.replacements         %lld # total number of replacements\n",            name.c_str(), replacements);
 	fprintf(stream,"%s.writebacks           %lld # total number of writebacks\n",              name.c_str(), writebacks);
 	fprintf(stream,"%s.invalidations        %lld # total number of invalidations\n",           name.c_str(), invalidations);
+	fprintf(stream,"%s.mshr_merges          %lld # total number of secondary misses merged with an outstanding miss\n", name.c_str(), mshr_merges);
+	if(mshr_entries)
+	{
+		fprintf(stream,"%s.mshr_allocs          %lld # total number of misses that took an MSHR\n", name.c_str(), mshr_allocs);
+		fprintf(stream,"%s.mshr_full            %lld # total number of misses that waited for an MSHR\n", name.c_str(), mshr_full);
+		fprintf(stream,"%s.mshr_full_cycles     %lld # total cycles misses waited for an MSHR\n",     name.c_str(), mshr_full_cycles);
+		if(mshr_allocs)
+		{
+			fprintf(stream,"%s.mshr_occupancy       %f # average MSHRs in use when a miss takes one\n", name.c_str(), (double)mshr_occupancy/(double)mshr_allocs);
+		}
+	}
+
+	if(prefetcher)
+	{
+		fprintf(stream,"%s.pf_issued            %lld # total number of prefetches issued\n",           name.c_str(), pf_issued);
+		fprintf(stream,"%s.pf_useful            %lld # total number of prefetched blocks used\n",     name.c_str(), pf_useful);
+		fprintf(stream,"%s.pf_late              %lld # total number of prefetched blocks used before they were filled\n", name.c_str(), pf_late);
+		fprintf(stream,"%s.pf_useless           %lld # total number of prefetched blocks replaced unused\n", name.c_str(), pf_useless);
+		fprintf(stream,"%s.pf_polluting         %lld # total number of misses on blocks replaced by prefetches\n", name.c_str(), pf_polluting);
+		fprintf(stream,"%s.pf_dropped           %lld # total number of prefetches dropped for want of an MSHR or a free block\n", name.c_str(), pf_dropped);
+		if(pf_issued)
+		{
+			fprintf(stream,"%s.pf_accuracy          %f # prefetch accuracy (useful/issued)\n",       name.c_str(), (double)pf_useful/(double)pf_issued);
+		}
+		if(pf_useful + misses)
+		{
+			fprintf(stream,"%s.pf_coverage          %f # prefetch coverage (useful/(useful+misses))\n", name.c_str(), (double)pf_useful/(double)(pf_useful + misses));
+		}
+		if(pf_mshr_allocs)
+		{
+			fprintf(stream,"%s.pf_mshr_allocs       %lld # total number of prefetches that took an MSHR\n", name.c_str(), pf_mshr_allocs);
+			fprintf(stream,"%s.pf_mshr_occupancy    %f # average MSHRs in use when a prefetch takes one\n", name.c_str(), (double)pf_mshr_occupancy/(double)pf_mshr_allocs);
+		}
+	}
+
+	//per context, the occupancy is averaged over the accesses to the cache
+	counter_t ctx_samples = 0;
+	for(unsigned int i=0;i<ctx_accesses.size();i++)
+	{
+		ctx_samples += ctx_accesses[i];
+	}
+	for(unsigned int i=0;i<ctx_accesses.size();i++)
+	{
+		if(!ctx_accesses[i])
+			continue;
+		fprintf(stream,"%s.accesses_%d           %lld # accesses of the context\n",               name.c_str(), i, ctx_accesses[i]);
+		fprintf(stream,"%s.misses_%d             %lld # misses of the context\n",                 name.c_str(), i, ctx_misses[i]);
+		fprintf(stream,"%s.miss_rate_%d          %f # miss rate of the context (misses/ref)\n",   name.c_str(), i, (double)ctx_misses[i]/(double)ctx_accesses[i]);
+		fprintf(stream,"%s.occupancy_%d          %f # average blocks held by the context\n",      name.c_str(), i, (double)ctx_occupancy[i]/(double)ctx_samples);
+		if(partition != PART_NONE)
+			fprintf(stream,"%s.ways_%d               %d # ways of each set given to the context\n", name.c_str(), i, part_ways[i]);
+		if(occ_cap[i])
+			fprintf(stream,"%s.capped_%d             %lld # misses that replaced a block of the context for its occupancy cap\n", name.c_str(), i, ctx_capped[i]);
+	}
+	if(partition == PART_UCP)
+		fprintf(stream,"%s.repartitions         %lld # total number of UCP repartitions\n",      name.c_str(), repartitions);
 
 	if(accesses)
 	{
@@ -450,9 +1026,68 @@ void cache_t::print_stats(FILE *stream)
 		fprintf(stream,"%s.repl_rate            %f # replacement rate (repls/ref)\n",            name.c_str(), (double)replacements/(double)accesses);
 		fprintf(stream,"%s.wb_rate              %f # writeback rate (wrbks/ref)\n",              name.c_str(), (double)writebacks/(double)accesses);
 		fprintf(stream,"%s.inv_rate             %f # invalidation rate (invs/ref)\n",            name.c_str(), (double)invalidations/(double)accesses);
+		fprintf(stream,"%s.mshr_merge_rate      %f # secondary miss rate (merges/ref)\n",       name.c_str(), (double)mshr_merges/(double)accesses);
 	}
 }
 
+//write back the dirty block BLK of SET, after the LAT cycles from NOW the replacement already waits,
+//returns the latency until the block is written
+long long cache_t::write_back(cache_blk_t *blk, md_addr_t set, tick_t now, long long lat, int context_id)
+{
+#ifdef BUS_CONTENTION
+	if(next_cache)
+	{
+		lat = next_cache->make_next_request(lat) - now;
+		lat = MAX(lat,0);
+		assert(lat>=0);
+	}
+#else
+//FIXME: Bus_free implementation allows bad overlapping of requests
+//The bus communication only takes 1 cycle. However, we can tie up the bus
+//based on the service time of this request.
+//We need to:
+//	Keep track of all bus usage for cycle now and after
+//	find the earliest usage slot for this request
+//	Tie up the bus usage and apply the latency for this block, but not others
+//	This can result in out-of-order communications. Is this a problem?
+	//Stall until we can send to the next level of memory
+	lat = MAX(lat, bus_free - now);
+
+	//The communication takes 1 cycle, however, if the block isn't serviced right away
+	//due to pending misses, it stalls the bus too long.
+	bus_free = 1 + MAX(bus_free, (tick_t)(now + lat));
+//End FIXME
+#endif
+	//Add latency needed to write back
+	lat += blk_access_fn(Write, CACHE_MK_BADDR(this, blk->tag, set), bsize, blk, now+lat, context_id);
+	return lat;
+}
+
+//read block BADDR into BLK, after the LAT cycles from NOW the replacement already waits, returns the
+//latency until the block is filled
+long long cache_t::fetch_blk(cache_blk_t *blk, md_addr_t baddr, tick_t now, long long lat, int context_id)
+{
+#ifdef BUS_CONTENTION
+	if(next_cache)
+	{
+		lat = next_cache->make_next_request(lat) - now;
+		lat = MAX(lat,0);
+		assert(lat>=0);
+	}
+	lat += blk_access_fn(Read, baddr, bsize, blk, now+lat, context_id);
+#else
+	//Trying to incorporate bus_free here
+	long long new_bus_free = bus_free;
+	long long new_lat = MAX(MAX(0,blk->ready - now), new_bus_free - now);
+	new_bus_free = 1 + MAX(new_bus_free, (tick_t)(now + new_lat));
+	assert(new_bus_free >= bus_free);
+	bus_free = new_bus_free;
+	new_lat += blk_access_fn(Read, baddr, bsize, blk, now+new_lat, context_id);
+	lat = MAX(lat,new_lat);
+#endif
+	return lat;
+}
+
 //access a cache, perform a CMD operation the cache at address ADDR, places NBYTES of 
 //	data at *P, returns latency of operation if initiated at NOW (in cycles), places pointer 
 //	to block user data in *UDATA, *P is untouched if cache blocks are not allocated
@@ -464,7 +1099,8 @@ unsigned long long cache_t::cache_access(mem_cmd cmd,	//access type, Read or Wri
 	unsigned int nbytes,				//number of bytes to access
 	tick_t now,					//time of access
 	byte_t **udata,					//for return of user data ptr
-	md_addr_t *repl_addr)				//for address of replaced block
+	md_addr_t *repl_addr,				//for address of replaced block
+	md_addr_t pc)					//PC of the instruction accessing, 0 if unknown
 {
 	byte_t *p = (byte_t *)vp;
 	md_addr_t tag = CACHE_TAG(this, addr);
@@ -486,9 +1122,24 @@ unsigned long long cache_t::cache_access(mem_cmd cmd,	//access type, Read or Wri
 
 	//permissions are checked on cache misses
 
+	if(!ctx_accesses.empty() && ((unsigned int)context_id < ctx_accesses.size()))
+	{
+		ctx_accesses[context_id]++;
+		for(unsigned int i=0;i<ctx_occupancy.size();i++)
+		{
+			ctx_occupancy[i] += ctx_blocks[i];
+		}
+		if(partition == PART_UCP)
+			ucp_access(set, tag, context_id, now);
+	}
+
 	cache_blk_t *blk(NULL);
 	cache_blk_t * repl(NULL);
+	int mshr(-1);			//MSHR of the miss
+	bool merged(false);		//the miss merged with an outstanding one
+	tick_t mshr_wait(0);		//cycles the miss waited for its MSHR
 
+#ifdef CACHE_WAY_LIST
 #ifdef USE_HASH
 	if(hsize)
 	{
@@ -511,27 +1162,99 @@ unsigned long long cache_t::cache_access(mem_cmd cmd,	//access type, Read or Wri
 				goto cache_hit;
 		}
 	}
+#else
+	//match the tags of the whole set at once, on a miss this also selects the block to replace
+	unsigned int way;
+	if(partitioned)
+	{
+		//the block to replace is selected with the owners in mind below
+		blk = find_blk_n<0>(this, &sets[set], tag, context_id, false, &way);
+		if(blk)
+		{
+			if((policy == LRU) && sets[set].ages[way])
+				update_way_ages(&sets[set], assoc, way, Head);
+			goto cache_hit;
+		}
+	}
+	else
+	{
+		blk = cache_lookup(this, &sets[set], tag, context_id, &way);
+		if(blk)
+			goto cache_hit;
+	}
+#endif
 
 	//Cache block not found, MISS
 	misses++;
+	if((unsigned int)context_id < ctx_misses.size())
+		ctx_misses[context_id]++;
+
+	//the block was replaced by a prefetch
+	if(prefetcher && (pf_replaced[CACHE_PF_INDEX(this, CACHE_BADDR(this, addr))] == CACHE_BADDR(this, addr)))
+	{
+		pf_polluting++;
+		pf_replaced[CACHE_PF_INDEX(this, CACHE_BADDR(this, addr))] = ~(md_addr_t)0;
+	}
+
+	//with MSHRs, a miss to a block that is still being fetched (the block was replaced before its fill) is
+	//merged with that fetch, any other miss takes an MSHR, first waiting for one to free if all are in use
+	if(mshr_entries)
+	{
+		mshr = mshr_match(CACHE_BADDR(this, addr), context_id, now);
+		if(mshr >= 0)
+		{
+			mshr_merges++;
+			merged = true;
+		}
+		else
+		{
+			mshr = mshr_allocate(CACHE_BADDR(this, addr), context_id, now, &mshr_wait);
+			//the miss starts once it has the MSHR
+			now += mshr_wait;
+		}
+	}
 
 	//select the appropriate block to replace, and re-link this entry to
 	//	the appropriate place in the way list
-	switch(policy)
+	if(partitioned)
 	{
-	case LRU:
-	case FIFO:
-		repl = sets[set].way_tail;
-		update_way_list(&sets[set], repl, Head);
-		break;
-	case Random:
+		bool capped;
+#ifdef CACHE_WAY_LIST
+		repl = CACHE_BINDEX(this, sets[set].blks, partition_victim(set, context_id, &capped));
+		if(policy != Random)
+			update_way_list(&sets[set], repl, Head);
+#else
+		way = partition_victim(set, context_id, &capped);
+		repl = CACHE_BINDEX(this, sets[set].blks, way);
+		if(policy != Random)
+			update_way_ages(&sets[set], assoc, way, Head);
+#endif
+		if(capped)
+			ctx_capped[context_id]++;
+	}
+	else
+	{
+#ifdef CACHE_WAY_LIST
+		switch(policy)
 		{
-			int bindex = myrand() & (assoc - 1);
-			repl = CACHE_BINDEX(this, sets[set].blks, bindex);
+		case LRU:
+		case FIFO:
+			repl = sets[set].way_tail;
+			update_way_list(&sets[set], repl, Head);
+			break;
+		case Random:
+			{
+				int bindex = myrand() & (assoc - 1);
+				repl = CACHE_BINDEX(this, sets[set].blks, bindex);
+			}
+			break;
+		default:
+			panic("bogus replacement policy");
 		}
-		break;
-	default:
-		panic("bogus replacement policy");
+#else
+		//already selected (and re-ordered) by the lookup
+		repl = CACHE_BINDEX(this, sets[set].blks, way);
+#endif
 	}
 
 #ifdef USE_HASH
@@ -554,66 +1277,44 @@ unsigned long long cache_t::cache_access(mem_cmd cmd,	//access type, Read or Wri
 		lat = MAX(0, repl->ready - now);
 //		lat += MAX(0, repl->ready - now);
  
+		if(repl->status & CACHE_BLK_PREFETCHED)
+			pf_useless++;
+
 		if(repl->status & CACHE_BLK_DIRTY)
 		{
 			//The replaced block is dirty, write it back
 			writebacks++;
 
-#ifdef BUS_CONTENTION
-			if(next_cache)
-			{
-				lat = next_cache->make_next_request(lat) - now;
-				lat = MAX(lat,0);
-				assert(lat>=0);
-			}
-				
-#else
-//FIXME: Bus_free implementation allows bad overlapping of requests
-//The bus communication only takes 1 cycle. However, we can tie up the bus
-//based on the service time of this request.
-//We need to:
-//	Keep track of all bus usage for cycle now and after
-//	find the earliest usage slot for this request
-//	Tie up the bus usage and apply the latency for this block, but not others
-//	This can result in out-of-order communications. Is this a problem?
-			//Stall until we can send to the next level of memory
-			lat = MAX(lat, bus_free - now);
-
-			//The communication takes 1 cycle, however, if the block isn't serviced right away
-			//due to pending misses, it stalls the bus too long.
-			bus_free = 1 + MAX(bus_free, (tick_t)(now + lat));
-//End FIXME
-#endif
-			//Add latency needed to write back
-			lat += blk_access_fn(Write, CACHE_MK_BADDR(this, repl->tag, set), bsize, repl, now+lat, context_id);
+			lat = write_back(repl, set, now, lat, context_id);
 		}
 	}
 
+	if(!ctx_blocks.empty())
+		change_owner((repl->status & CACHE_BLK_VALID) ? repl->context_id : -1, context_id);
+
 	//update block tags
 	repl->tag = tag;
 	repl->context_id = context_id;
 	repl->status = CACHE_BLK_VALID;
+#ifndef CACHE_WAY_LIST
+	sets[set].tags[way] = tag;
+#endif
 
-#ifdef BUS_CONTENTION
-	if(next_cache)
+	if(merged)
 	{
-		lat = next_cache->make_next_request(lat) - now;
-		lat = MAX(lat,0);
-		assert(lat>=0);
-	}
-	lat += blk_access_fn(Read, CACHE_BADDR(this, addr), bsize, repl, now+lat, context_id);
+		//the data arrives with the outstanding miss, nothing goes to the next level
+#ifdef BUS_CONTENTION
+		lat = MAX(lat, (long long)(mshrs[mshr].ready - now));
 #else
-	//Trying to incorporate bus_free here
+		lat = MAX(lat, MAX(MAX(0,repl->ready - now), (long long)(mshrs[mshr].ready - now)));
+#endif
+	}
+	else
 	{
-		long long new_bus_free = bus_free;
-		long long new_lat = MAX(MAX(0,repl->ready - now), new_bus_free - now);
-		new_bus_free = 1 + MAX(new_bus_free, (tick_t)(now + new_lat));
-		assert(new_bus_free >= bus_free);
-		bus_free = new_bus_free;
-		new_lat += blk_access_fn(Read, CACHE_BADDR(this, addr), bsize, repl, now+new_lat, context_id);
-		lat = MAX(lat,new_lat);
+		lat = fetch_blk(repl, CACHE_BADDR(this, addr), now, lat, context_id);
 	}
 
+#ifndef BUS_CONTENTION
 	//Read the data block (required on all misses, load or store. Writes only occur on write back.
 //	lat += blk_access_fn(Read, CACHE_BADDR(this, addr), bsize, repl, now+lat, context_id);
 #endif
@@ -637,12 +1338,26 @@ unsigned long long cache_t::cache_access(mem_cmd cmd,	//access type, Read or Wri
 	//update block status
 	repl->ready = now+lat;
 
+	//the MSHR is held until the block is filled, the wait for it is part of the latency
+	if(mshr_entries)
+	{
+		if(!merged)
+		{
+			mshrs[mshr].ready = repl->ready;
+		}
+		lat += mshr_wait;
+	}
+
 #ifdef USE_HASH
 	//link this entry back into the hash table
 	if(hsize)
 		link_htab_ent(&sets[set], repl);
 #endif
 
+	//prefetchers learn from demand reads only, writes are committed stores or write backs
+	if(prefetcher && (cmd == Read))
+		train_prefetcher(pc, addr, context_id, PF_MISS, now);
+
 	//return latency of the operation
 	return lat;
 
@@ -650,6 +1365,10 @@ cache_hit:
 	//HIT
 	hits++;
 
+	//the block is still being filled, a secondary miss served by the outstanding one
+	if(blk->ready > now)
+		mshr_merges++;
+
 	//copy data out of cache block, if block exists
 	if(balloc)
 	{
@@ -661,10 +1380,14 @@ cache_hit:
 		blk->status |= CACHE_BLK_DIRTY;
 
 	//if this is not the first element of the list and we are using LRU, move the block to the head of the MRU list
+#ifdef CACHE_WAY_LIST
 	if(blk->way_prev && (policy == LRU))
 	{
 		update_way_list(&sets[set], blk, Head);
 	}
+#else
+	//already moved by the lookup
+#endif
 
 #ifdef USE_HASH
 	//tag is unchanged, so hash links (if they exist) are still valid
@@ -676,10 +1399,258 @@ cache_hit:
 		*udata = blk->user_data;
 	}
 
+	//first use of a prefetched block
+	if(blk->status & CACHE_BLK_PREFETCHED)
+	{
+		blk->status &= ~CACHE_BLK_PREFETCHED;
+		pf_useful++;
+		if(blk->ready > now)
+			pf_late++;
+		if(prefetcher && (cmd == Read))
+			train_prefetcher(pc, addr, context_id, PF_PREFETCH_HIT, now);
+	}
+	else if(prefetcher && (cmd == Read))
+	{
+		train_prefetcher(pc, addr, context_id, PF_HIT, now);
+	}
+
 	//return first cycle data is available to access
 	return MAX(hit_latency, (blk->ready - now));
 }
 
+//report a demand read to the prefetcher and issue the prefetches it asks for
+void cache_t::train_prefetcher(md_addr_t pc, md_addr_t addr, int context_id, prefetch_event event, tick_t now)
+{
+	prefetches.clear();
+	prefetcher->access(pc, addr, context_id, event, prefetches);
+	for(unsigned int i=0;i<prefetches.size();i++)
+	{
+		prefetch(prefetches[i], context_id, now);
+	}
+}
+
+//bring block BADDR into the cache for CONTEXT_ID at NOW, unless it is there or on its way already, dropped
+//if no MSHR is free or the block to replace is still being filled. The block takes the place a miss would,
+//its fill uses the bus like a miss
+void cache_t::prefetch(md_addr_t baddr, int context_id, tick_t now)
+{
+	md_addr_t tag = CACHE_TAG(this, baddr);
+	md_addr_t set = CACHE_SET(this, baddr);
+	cache_blk_t *repl(NULL);
+
+	//already cached?
+#ifdef CACHE_WAY_LIST
+#ifdef USE_HASH
+	if(hsize)
+	{
+		for(cache_blk_t *blk=sets[set].hash[CACHE_HASH(this, tag)];blk;blk=blk->hash_next)
+		{
+			if(blk->tag == tag && (blk->status & CACHE_BLK_VALID) && (blk->context_id == context_id))
+				return;
+		}
+	}
+	else
+#endif
+	{
+		for(cache_blk_t *blk=sets[set].way_head;blk;blk=blk->way_next)
+		{
+			if(blk->tag == tag && (blk->status & CACHE_BLK_VALID) && (blk->context_id == context_id))
+				return;
+		}
+	}
+#else
+	unsigned int way;
+	if(find_blk_n<0>(this, &sets[set], tag, context_id, false, &way))
+		return;
+#endif
+
+	if(mshr_entries)
+	{
+		//already on its way?
+		if(mshr_match(baddr, context_id, now) >= 0)
+			return;
+		if(mshr_busy(now) >= mshr_entries)
+		{
+			pf_dropped++;
+			return;
+		}
+	}
+
+	//select the block to replace, as a miss would
+#ifdef CACHE_WAY_LIST
+	if(partitioned)
+	{
+		bool capped;
+		repl = CACHE_BINDEX(this, sets[set].blks, partition_victim(set, context_id, &capped));
+	}
+	else
+	{
+		repl = (policy == Random) ? CACHE_BINDEX(this, sets[set].blks, myrand() & (assoc - 1)) : sets[set].way_tail;
+	}
+#else
+	if(partitioned)
+	{
+		bool capped;
+		way = partition_victim(set, context_id, &capped);
+	}
+	else
+	{
+		way = (policy == Random) ? (myrand() & (assoc - 1)) : tail_way_n<0>(&sets[set], assoc);
+	}
+	repl = CACHE_BINDEX(this, sets[set].blks, way);
+#endif
+
+	//a block still being filled stays, replacing it would hold the prefetch (and the bus) until it arrives
+	if(repl->ready > now)
+	{
+		pf_dropped++;
+		return;
+	}
+
+	if(policy != Random)
+	{
+#ifdef CACHE_WAY_LIST
+		update_way_list(&sets[set], repl, Head);
+#else
+		update_way_ages(&sets[set], assoc, way, Head);
+#endif
+	}
+
+#ifdef USE_HASH
+	if(hsize)
+	{
+		unlink_htab_ent(&sets[set], repl);
+	}
+#endif
+
+	long long lat = 0;
+	if(repl->status & CACHE_BLK_VALID)
+	{
+		if(repl->status & CACHE_BLK_PREFETCHED)
+		{
+			pf_useless++;
+		}
+		else
+		{
+			//remember the block, a later miss on it is caused by this prefetch
+			pf_replaced[CACHE_PF_INDEX(this, CACHE_MK_BADDR(this, repl->tag, set))] = CACHE_MK_BADDR(this, repl->tag, set);
+		}
+
+		if(repl->status & CACHE_BLK_DIRTY)
+		{
+			writebacks++;
+			lat = write_back(repl, set, now, lat, context_id);
+		}
+	}
+
+	if(!ctx_blocks.empty())
+		change_owner((repl->status & CACHE_BLK_VALID) ? repl->context_id : -1, context_id);
+
+	repl->tag = tag;
+	repl->context_id = context_id;
+	repl->status = CACHE_BLK_VALID | CACHE_BLK_PREFETCHED;
+#ifndef CACHE_WAY_LIST
+	sets[set].tags[way] = tag;
+#endif
+
+	lat = fetch_blk(repl, baddr, now, lat, context_id);
+	repl->ready = now + lat;
+	pf_issued++;
+
+	//the prefetch holds an MSHR until its block is filled
+	if(mshr_entries)
+	{
+		tick_t wait;
+		mshrs[mshr_allocate(baddr, context_id, now, &wait, true)].ready = repl->ready;
+	}
+
+#ifdef USE_HASH
+	if(hsize)
+		link_htab_ent(&sets[set], repl);
+#endif
+}
+
+//returns the MSHR of an outstanding miss to block BADDR at NOW, -1 if there is none
+int cache_t::mshr_match(md_addr_t baddr, int context_id, tick_t now)
+{
+	for(unsigned int i=0;i<mshrs.size();i++)
+	{
+		if((mshrs[i].ready > now) && (mshrs[i].baddr == baddr) && (mshrs[i].context_id == context_id))
+			return i;
+	}
+	return -1;
+}
+
+//returns the number of MSHRs in use at NOW
+unsigned int cache_t::mshr_busy(tick_t now)
+{
+	unsigned int busy = 0;
+	for(unsigned int i=0;i<mshrs.size();i++)
+	{
+		busy += (mshrs[i].ready > now);
+	}
+	return busy;
+}
+
+//takes an MSHR for a miss to block BADDR at NOW, returns it and places in *WAIT how long the miss has to
+//wait for it to free (the entry that frees first if all are in use). PREFETCH allocations are kept out of the
+//demand miss counters
+int cache_t::mshr_allocate(md_addr_t baddr, int context_id, tick_t now, tick_t *wait, bool prefetch)
+{
+	int entry = -1;
+	unsigned int busy = 0;
+	for(unsigned int i=0;i<mshrs.size();i++)
+	{
+		if(mshrs[i].ready > now)
+		{
+			busy++;
+			if((entry < 0) || ((mshrs[entry].ready > now) && (mshrs[i].ready < mshrs[entry].ready)))
+				entry = i;
+		}
+		else if((entry < 0) || (mshrs[entry].ready > now))
+		{
+			entry = i;
+		}
+	}
+	if(busy < mshrs.size())
+	{
+		//a free entry, found above
+		*wait = 0;
+	}
+	else if(mshrs.size() < mshr_entries)
+	{
+		entry = mshrs.size();
+		mshrs.push_back(cache_mshr_t());
+		*wait = 0;
+	}
+	else
+	{
+		//all in use, wait for the first to free
+		*wait = mshrs[entry].ready - now;
+		if(!prefetch)
+		{
+			mshr_full++;
+			mshr_full_cycles += *wait;
+		}
+		busy--;
+	}
+	if(prefetch)
+	{
+		pf_mshr_allocs++;
+		pf_mshr_occupancy += busy + 1;
+	}
+	else
+	{
+		mshr_allocs++;
+		mshr_occupancy += busy + 1;
+	}
+
+	mshrs[entry].baddr = baddr;
+	mshrs[entry].context_id = context_id;
+	mshrs[entry].ready = now + *wait;
+	return entry;
+}
+
 //return non-zero if block containing address ADDR is contained the cache (cache hit)
 //	this interface is used primarily for debugging and asserting cache invariants
 bool cache_t::cache_probe(md_addr_t addr)		//address of block to probe
@@ -701,12 +1672,18 @@ bool cache_t::cache_probe(md_addr_t addr)		//address of block to probe
 	else
 #endif
 	{
+#ifdef CACHE_WAY_LIST
 		//low-associativity cache, linear search the way list
 		for(cache_blk_t *blk=sets[set].way_head;blk;blk=blk->way_next)
 		{
 			if(blk->tag == tag && (blk->status & CACHE_BLK_VALID))
 				return TRUE;
 		}
+#else
+		unsigned int way;
+		if(cache_find_blk(this, &sets[set], tag, &way))
+			return TRUE;
+#endif
 	}
 	//cache block not found
 	return FALSE;
@@ -718,14 +1695,29 @@ unsigned long long cache_t::cache_flush(tick_t now)			//time of cache flush
 	unsigned long long lat = hit_latency; 			//min latency to probe cache
 
 	//no way list updates required because all blocks are being invalidated
+#ifndef CACHE_WAY_LIST
+	std::vector<cache_blk_t *> order(assoc);
+#endif
 	for(unsigned int i=0; i<nsets; i++)
 	{
+#ifdef CACHE_WAY_LIST
 		for(cache_blk_t *blk=sets[i].way_head; blk; blk=blk->way_next)
 		{
+#else
+		//blocks are written back in replacement order, as in the way list
+		for(unsigned int j=0; j<assoc; j++)
+		{
+			order[sets[i].ages[j]] = CACHE_BINDEX(this, sets[i].blks, j);
+		}
+		for(unsigned int j=0; j<assoc; j++)
+		{
+			cache_blk_t *blk = order[j];
+#endif
 			if(blk->status & CACHE_BLK_VALID)
 			{
 				invalidations++;
 				blk->status &= ~CACHE_BLK_VALID;
+				change_owner(blk->context_id, -1);
 				if(blk->status & CACHE_BLK_DIRTY)
 				{
 					//write back the invalidated block
@@ -749,6 +1741,9 @@ unsigned long long cache_t::cache_flush_addr(md_addr_t addr,		//address of block
 	md_addr_t set = CACHE_SET(this, addr);
 
 	cache_blk_t *blk(NULL);
+#ifndef CACHE_WAY_LIST
+	unsigned int way;
+#endif
 #ifdef USE_HASH
 	if(hsize)
 	{
@@ -763,18 +1758,23 @@ unsigned long long cache_t::cache_flush_addr(md_addr_t addr,		//address of block
 	else
 #endif
 	{
+#ifdef CACHE_WAY_LIST
 		//low-associativity cache, linear search the way list
 		for(blk=sets[set].way_head;blk;blk=blk->way_next)
 		{
 			if(blk->tag == tag && (blk->status & CACHE_BLK_VALID))
 				break;
 		}
+#else
+		blk = cache_find_blk(this, &sets[set], tag, &way);
+#endif
 	}
 
 	if(blk)
 	{
 		invalidations++;
 		blk->status &= ~CACHE_BLK_VALID;
+		change_owner(blk->context_id, -1);
 
 		if(blk->status & CACHE_BLK_DIRTY)
 		{
@@ -783,12 +1783,102 @@ unsigned long long cache_t::cache_flush_addr(md_addr_t addr,		//address of block
 			lat += blk_access_fn(Write, CACHE_MK_BADDR(this, blk->tag, set), bsize, blk, now+lat, blk->context_id);
 		}
 		//move this block to tail of the way (LRU) list
+#ifdef CACHE_WAY_LIST
 		update_way_list(&sets[set], blk, Tail);
+#else
+		update_way_ages(&sets[set], assoc, way, Tail);
+#endif
 	}
 	//return latency of the operation
 	return lat;
 }
 
+std::ostream & operator<<(std::ostream & out, const cache_t & source)
+{
+	out << "(" << source.name << " " << std::dec << source.nsets << " " << source.assoc << " " << source.bsize << std::hex;
+#ifndef CACHE_WAY_LIST
+	std::vector<cache_blk_t *> order(source.assoc);
+#endif
+	for(unsigned int i=0;i<source.nsets;i++)
+	{
+		//most recently used first
+#ifdef CACHE_WAY_LIST
+		for(cache_blk_t *blk=source.sets[i].way_head;blk;blk=blk->way_next)
+		{
+#else
+		for(unsigned int j=0;j<source.assoc;j++)
+		{
+			order[source.sets[i].ages[j]] = CACHE_BINDEX(&source, source.sets[i].blks, j);
+		}
+		for(unsigned int j=0;j<source.assoc;j++)
+		{
+			cache_blk_t *blk = order[j];
+#endif
+			out << " " << blk->tag << " " << blk->status << " " << std::dec << blk->context_id << std::hex;
+		}
+	}
+	out << std::dec << ")";
+	return out;
+}
+
+std::istream & operator>>(std::istream & in, cache_t & target)
+{
+	char c_buf;
+	std::string name;
+	unsigned int nsets, assoc, bsize;
+	in >> c_buf >> name >> std::dec >> nsets >> assoc >> bsize;
+	if((nsets != target.nsets) || (assoc != target.assoc) || (bsize != target.bsize))
+	{
+		fatal("checkpoint cache `%s' is %d:%d:%d, `%s' is %d:%d:%d", name.c_str(), nsets, bsize, assoc,
+			target.name.c_str(), target.nsets, target.bsize, target.assoc);
+	}
+	//every block is ready, so no miss is outstanding
+	target.mshrs.clear();
+	for(unsigned int i=0;i<target.nsets;i++)
+	{
+		cache_set_t *set = &target.sets[i];
+#ifdef CACHE_WAY_LIST
+		set->way_head = set->way_tail = NULL;
+#endif
+#ifdef USE_HASH
+		if(target.hsize)
+		{
+			set->hash.assign(target.hsize, NULL);
+		}
+#endif
+		//the blocks of the set take the saved replacement order in allocation order
+		for(unsigned int j=0;j<target.assoc;j++)
+		{
+			cache_blk_t *blk = CACHE_BINDEX(&target, set->blks, j);
+			in >> std::hex >> blk->tag >> blk->status >> std::dec >> blk->context_id;
+			blk->ready = 0;
+#ifdef USE_HASH
+			if(target.hsize)
+				target.link_htab_ent(set, blk);
+#endif
+#ifdef CACHE_WAY_LIST
+			blk->way_next = NULL;
+			blk->way_prev = set->way_tail;
+			if(set->way_tail)
+				set->way_tail->way_next = blk;
+			else
+				set->way_head = blk;
+			set->way_tail = blk;
+#else
+			set->tags[j] = blk->tag;
+			set->ages[j] = j;
+#endif
+		}
+	}
+	in >> c_buf;
+	if(c_buf != ')')
+	{
+		fatal("bad cache `%s' in checkpoint", target.name.c_str());
+	}
+	target.count_owners();
+	return in;
+}
+
 #ifdef BUS_CONTENTION
 void cache_t::clear_contention(unsigned long long sim_cycle)
 {
@@ -56,10 +56,12 @@
 #include<cstdio>
 #include<vector>
 #include<string>
+#include<iosfwd>
 
 #include "host.h"
 #include "memory.h"
 #include "stats.h"
+#include "prefetch.h"
 
 /*
  * This module contains code to implement various cache-like structures.  The
@@ -86,15 +88,33 @@
  * This module also tracks latency of accessing the data cache, each cache has
  * a hit latency defined when instantiated, miss latency is returned by the
  * cache's block access function, the caches may service any number of hits
- * under any number of misses, the calling simulator should limit the number
- * of outstanding misses or the number of hits under misses as per the
- * limitations of the particular microarchitecture being simulated.
+ * under any number of misses, unless the cache is given a number of miss
+ * status holding registers (MSHRs). Each outstanding miss then holds an MSHR
+ * until its block is filled, a miss that finds them all busy waits for the
+ * first one to free, and a miss to a block that is already being fetched is
+ * merged with that fetch instead of going to the next level.
+ *
+ * A cache shared among threads may also divide its blocks among them: the
+ * ways of each set can be partitioned among the contexts (statically, or by
+ * utility measured with per-context shadow tags), and each context can be
+ * capped at a share of the blocks. A miss then replaces a block chosen with
+ * the owners in mind, see cache_partition.
  *
  * Due to the organization of this cache implementation, the latency of a
  * request cannot be affected by a later request to this module.  As a result,
  * reordering of requests in the memory hierarchy is not possible.
  */
 
+//The tags of each set are kept in a contiguous array and matched several ways at a time (with SSE2/AVX2
+//when the host has them), replacement order is kept as a per-way age. Define CACHE_WAY_LIST to build the
+//original linked way lists instead (and, optionally, USE_HASH). Both make the same replacement decisions.
+//#define CACHE_WAY_LIST
+
+#ifndef CACHE_WAY_LIST
+	//packed sets do not use the hash tables
+	#undef USE_HASH
+#endif
+
 //highly associative caches are implemented using a hash table lookup to
 //speed block access, this macro decides if a cache is "highly associative"
 #ifdef USE_HASH
@@ -109,21 +129,30 @@ enum cache_policy
 	FIFO		//replace the oldest block in the set
 };
 
+//thread-aware replacement, how the blocks of each set are divided among the contexts sharing the cache. Under
+//any of them a context that holds its share of the set (or of the cache, if it has an occupancy cap) replaces
+//one of its own blocks, otherwise a block of a context over its share
+enum cache_partition
+{
+	PART_NONE,	//no partitioning, the replacement policy picks the block whoever owns it
+	PART_STATIC,	//each context is given a fixed number of ways of every set
+	PART_UCP	//utility-based, every interval the ways are given to the contexts whose shadow tags
+			//(tags of sampled sets as if the context had the cache to itself) saw the most hits in them
+};
+
 //block status values
 #define CACHE_BLK_VALID		0x00000001	//block is valid, in use
 #define CACHE_BLK_DIRTY		0x00000002	//dirty block, must be written back before eviction
+#define CACHE_BLK_PREFETCHED	0x00000004	//block brought in by a prefetch, not used by a demand access yet
 
 //cache block (or line) definition
 class cache_blk_t
 {
 	public:
-	 	~cache_blk_t()
-		{
-			delete user_data;
-		};
-
+#ifdef CACHE_WAY_LIST
 		cache_blk_t *way_next;		//next block in the ordered way chain, used to order blocks for replacement
 		cache_blk_t *way_prev;		//previous block in the order way chain
+#endif
 #ifdef USE_HASH
 		cache_blk_t *hash_next;		//next block in the hash bucket chain, only used in highly-associative caches
 		//hash table lists are typically small, so no previous pointer, deletion requires a trip through the hash table bucket list
@@ -131,13 +160,19 @@ class cache_blk_t
 
 		md_addr_t tag;			//tag value for the cache block
 		unsigned int status;		//block status, see CACHE_BLK_* defs above
+		int context_id;			//context_id of the owner of the data in the block
 		tick_t ready;			//time when block will be accessible. Set when a miss fetch is initiated
-		byte_t *user_data;		//pointer to user defined data, e.g., pre-decode data or physical page address
+		byte_t *user_data;		//pointer to user defined data, e.g., pre-decode data or physical page address, NULL if none
+		byte_t *data;			//actual data block, NULL if data space is not allocated (!BALLOC)
+};
 
-		//The following comment may not be relevant anymore. 
-		//DATA should be pointer-aligned due to preceeding field
-		std::vector<byte_t> data;	//actual data block starts here, block size should probably be a multiple of 8
-		int context_id;			//context_id of the owner of the data in the block
+//miss status holding register, an outstanding miss to a block
+class cache_mshr_t
+{
+	public:
+		md_addr_t baddr;		//address of the block being fetched
+		int context_id;			//context_id of the owner of the block
+		tick_t ready;			//time when the block is filled, the entry is free from then on
 };
 
 //cache set definition (one or more blocks sharing the same set index)
@@ -147,8 +182,13 @@ class cache_set_t
 #ifdef USE_HASH
 		std::vector<cache_blk_t *> hash;	//hash table: for fast access w/assoc, NULL for low-assoc caches
 #endif
+#ifdef CACHE_WAY_LIST
 		cache_blk_t *way_head;			//head of way list
 		cache_blk_t *way_tail;			//tail of way list
+#else
+		md_addr_t *tags;			//copy of the tag of each block, contiguous for matching
+		unsigned short *ages;			//replacement order of each block, 0 is the head (most recently used or filled)
+#endif
 		cache_blk_t *blks;			//cache blocks, allocated sequentially, so this pointer can also be used for random access to cache blocks
 };
 
@@ -172,7 +212,8 @@ class cache_t
 				cache_blk_t *blk,
 				tick_t now,
 				int context_id),
-			unsigned int hit_latency); 	//latency in cycles for a hit
+			unsigned int hit_latency, 	//latency in cycles for a hit
+			unsigned int mshr_entries);	//number of MSHRs, 0 for unlimited outstanding misses
 
 		//resets cache stats after fast forwarding
 		void reset_cache_stats();
@@ -196,7 +237,16 @@ class cache_t
 			unsigned int nbytes,		//number of bytes to access
 			tick_t now,			//time of access
 			byte_t **udata,			//for return of user data ptr
-			md_addr_t *repl_addr);		//for address of replaced block
+			md_addr_t *repl_addr,		//for address of replaced block
+			md_addr_t pc = 0);		//PC of the instruction accessing, 0 if unknown (trains the prefetcher)
+
+		//attach PREFETCHER (see prefetch.h) to the cache, which deletes it, NULL for none
+		void set_prefetcher(prefetcher_t *prefetcher);
+
+		//share the cache among NUM_CONTEXTS contexts, partitioned by CONFIG, i.e., {none|static:<ways>[,<ways>...]|ucp:<interval>},
+		//with context i holding at most CAPS[i] percent of the blocks (the last of the CAPS_NELT values repeats, 100 for no cap),
+		//also keeps per-context occupancy and miss stats
+		void set_partition(int num_contexts, const char *config, const int *caps, int caps_nelt);
 
 		//return true if block containing address ADDR is contained in cache	
 		//this interface is used primarily for debugging and asserting cache invariants
@@ -210,6 +260,8 @@ class cache_t
 			tick_t now);					//time of cache flush
 
 	private:
+		friend std::istream & operator>>(std::istream & in, cache_t & target);
+
 #ifdef USE_HASH
 		//insert BLK onto the head of the hash table bucket chain in SET
 		void link_htab_ent(cache_set_t *set,	//set containing bkt chain
@@ -219,6 +271,47 @@ class cache_t
 		void unlink_htab_ent(cache_set_t *set,	//set containing bkt chain
 			cache_blk_t *blk);		//block to unlink
 #endif
+
+		//write back the dirty block BLK of SET, after the LAT cycles from NOW the replacement already
+		//waits, returns the latency until the block is written
+		long long write_back(cache_blk_t *blk, md_addr_t set, tick_t now, long long lat, int context_id);
+
+		//read block BADDR into BLK, after the LAT cycles from NOW the replacement already waits,
+		//returns the latency until the block is filled
+		long long fetch_blk(cache_blk_t *blk, md_addr_t baddr, tick_t now, long long lat, int context_id);
+
+		//report a demand read to the prefetcher and issue the prefetches it asks for
+		void train_prefetcher(md_addr_t pc, md_addr_t addr, int context_id, prefetch_event event, tick_t now);
+
+		//bring block BADDR into the cache for CONTEXT_ID at NOW, unless it is there or on its way already,
+		//dropped if no MSHR is free or the block to replace is still being filled
+		void prefetch(md_addr_t baddr, int context_id, tick_t now);
+
+		//returns the number of MSHRs in use at NOW
+		unsigned int mshr_busy(tick_t now);
+
+		//returns the way of SET a miss of CONTEXT_ID replaces under the partitioning and the occupancy caps,
+		//places in *CAPPED whether the occupancy cap of the context chose it
+		unsigned int partition_victim(md_addr_t set, int context_id, bool *capped);
+
+		//a block of OLD_OWNER (-1 if invalid) now holds a block of NEW_OWNER (-1 if invalidated)
+		void change_owner(int old_owner, int new_owner);
+
+		//recount the blocks each context holds
+		void count_owners();
+
+		//update the shadow tags of CONTEXT_ID with an access to TAG in SET at NOW, repartitioning first if an interval is over
+		void ucp_access(md_addr_t set, md_addr_t tag, int context_id, tick_t now);
+
+		//give the ways of each set to the contexts by the hits their shadow tags saw (the lookahead allocation of UCP)
+		void ucp_repartition();
+
+		//returns the MSHR of an outstanding miss to block BADDR at NOW, -1 if there is none
+		int mshr_match(md_addr_t baddr, int context_id, tick_t now);
+
+		//takes an MSHR for a miss to block BADDR at NOW, returns it and places in *WAIT
+		//how long the miss has to wait for it to free. Prefetches are counted apart from demand misses
+		int mshr_allocate(md_addr_t baddr, int context_id, tick_t now, tick_t *wait, bool prefetch = false);
 	public:
 		//parameters
 		std::string name;		//cache name
@@ -229,6 +322,9 @@ class cache_t
 		unsigned int assoc;		//cache associativity
 		cache_policy policy;		//cache replacement policy
 		unsigned int hit_latency;	//cache hit latency
+		unsigned int mshr_entries;	//number of MSHRs, 0 if unlimited
+		cache_partition partition;	//division of the sets among the contexts
+		bool partitioned;		//misses replace blocks with their owners in mind (partitioning or occupancy caps)
 
 		//miss/replacement handler, read/write BSIZE bytes starting at BADDR from/into cache block
 		//BLK, returns the latency of the operation if initiated at NOW, returned latencies
@@ -255,6 +351,7 @@ class cache_t
 		int tag_shift;
 		md_addr_t tag_mask;		//use *after* shift
 		md_addr_t tagset_mask;		//used for fast hit detection
+		unsigned int blk_size;		//size of a block with its data and user data, see CACHE_BINDEX
 
 #ifndef BUS_CONTENTION
 		//bus resource
@@ -272,12 +369,56 @@ class cache_t
 		counter_t replacements;		//total number of replacements at misses
 		counter_t writebacks;		//total number of writebacks at misses
 		counter_t invalidations;	//total number of external invalidations
-
-		//data blocks
+		counter_t mshr_merges;		//secondary misses, accesses merged with an outstanding miss to their block
+		counter_t mshr_allocs;		//misses that took an MSHR
+		counter_t mshr_occupancy;	//MSHRs in use when each of them was taken
+		counter_t mshr_full;		//misses that found every MSHR in use
+		counter_t mshr_full_cycles;	//cycles those misses waited for an MSHR
+		counter_t pf_issued;		//prefetches sent to the next level
+		counter_t pf_useful;		//prefetched blocks later used by a demand access
+		counter_t pf_late;		//useful prefetches whose block was still being filled when used
+		counter_t pf_useless;		//prefetched blocks replaced before being used
+		counter_t pf_polluting;		//demand misses on blocks a prefetch replaced
+		counter_t pf_dropped;		//prefetches dropped because every MSHR, or the block to replace, was busy
+		counter_t pf_mshr_allocs;	//prefetches that took an MSHR
+		counter_t pf_mshr_occupancy;	//MSHRs in use when each of those was taken
+		counter_t repartitions;		//UCP intervals that redistributed the ways
+
+		//per-context stats, sized by set_partition (empty otherwise)
+		std::vector<counter_t> ctx_blocks;	//blocks each context holds now
+		std::vector<counter_t> ctx_accesses;	//accesses of each context
+		std::vector<counter_t> ctx_misses;	//misses of each context
+		std::vector<counter_t> ctx_occupancy;	//blocks each context held, summed over every access to the cache
+		std::vector<counter_t> ctx_capped;	//misses that replaced a block of their own context for its occupancy cap
+
+		//data blocks, each block is followed by its data (if BALLOC) and user data
 		std::vector<byte_t> data;	//pointer to data blocks allocation
+#ifndef CACHE_WAY_LIST
+		std::vector<md_addr_t> tags;	//per set: the tags of its blocks followed by their ages, see CACHE_SET_WORDS
+#endif
 
 		std::vector<cache_set_t> sets;	//each entry is a set
 
+		//outstanding misses, at most mshr_entries. Requests are taken in time order (the latency of a
+		//request cannot be affected by a later one), so an entry whose block is ready by NOW is free
+		std::vector<cache_mshr_t> mshrs;
+
+		prefetcher_t *prefetcher;		//attached prefetcher, NULL if none
+		std::vector<md_addr_t> prefetches;	//blocks the prefetcher asked for on the current access
+		std::vector<md_addr_t> pf_replaced;	//blocks replaced by prefetches, by block address, see CACHE_PF_INDEX
+
+		//thread-aware replacement, see cache_partition
+		std::vector<unsigned int> part_ways;	//ways of each set given to each context (static, UCP)
+		std::vector<counter_t> occ_cap;		//most blocks each context may hold, 0 for no cap
+		std::vector<unsigned int> set_owned;	//blocks each context holds in the set being replaced
+		std::vector<unsigned int> set_order;	//ways of the set being replaced, oldest first
+		tick_t ucp_interval;			//cycles between repartitions
+		tick_t ucp_next;			//time of the next repartition
+		unsigned int ucp_stride;		//every ucp_stride-th set has shadow tags
+		std::vector<md_addr_t> ucp_tags;	//per context and sampled set, assoc shadow tags, most recently used first
+		std::vector<counter_t> ucp_hits;	//per context, shadow tag hits at each position of the recency order
+		std::vector<counter_t> ucp_accesses;	//per context, shadow tag accesses in the current interval
+
 #ifdef BUS_CONTENTION
 		int contention_time;
 		std::vector<unsigned long long> bus_usages;
@@ -292,6 +433,11 @@ class cache_t
 //parse policy, returns the replacement policy enum, takes a char that represents the replacement policy
 cache_policy cache_char2policy(char c);
 
+//checkpoint the tags of a cache (tag, status and owner of each block, in replacement order), not the data
+//or the stats; reading checks the geometry matches and leaves every block ready
+std::ostream & operator<<(std::ostream & out, const cache_t & source);
+std::istream & operator>>(std::istream & in, cache_t & target);
+
 //These don't seem to be used anywhere. They could be replaced with a templated cache_access
 //cache access functions, these are safe, they check alignment and permissions
 #define cache_double(cp, cmd, addr, p, now, udata)	cache_access(cp, cmd, addr, p, sizeof(double), now, udata)
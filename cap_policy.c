@@ -0,0 +1,354 @@
+// Rename Register Cap Policy Definitions
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ *
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ *
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ *
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ *
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ *
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ *
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ *
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ *
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ *
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#ifndef CAP_POLICY_C
+#define CAP_POLICY_C
+
+#include<cstdio>
+#include<cstring>
+#include<cassert>
+
+#include"cap_policy.h"
+
+//returns the cap_policy_kind for the name of a policy, fatal if it is unknown
+cap_policy_kind cap_str2policy(const char *name)
+{
+	if(!strcmp(name, "none"))
+		return CAP_NONE;
+	if(!strcmp(name, "static"))
+		return CAP_STATIC;
+	if(!strcmp(name, "split"))
+		return CAP_SPLIT;
+	if(!strcmp(name, "proportional"))
+		return CAP_PROPORTIONAL;
+	if(!strcmp(name, "adaptive"))
+		return CAP_ADAPTIVE;
+	fatal("bogus rename cap policy, `%s'", name);
+	return CAP_NONE;
+}
+
+cap_policy_t::cap_policy_t(int max_contexts)
+: kind(CAP_STATIC), policy_opt(NULL),
+regs_config(max_contexts,0), regs_nelt(1), int_config(max_contexts,0), int_nelt(1),
+fp_config(max_contexts,0), fp_nelt(1), percent_config(max_contexts,0), percent_nelt(1), adapt_nelt(4),
+cap(max_contexts,0), int_cap(max_contexts,0), fp_cap(max_contexts,0),
+stalls(max_contexts,0), int_stalls(max_contexts,0), fp_stalls(max_contexts,0),
+occupancy(max_contexts,0), int_occupancy(max_contexts,0), fp_occupancy(max_contexts,0),
+raises(max_contexts,0), lowers(max_contexts,0), last_committed(max_contexts,0)
+{
+	//defaults, the static cap of 10 matches the previous hard-coded limit
+	regs_config[0] = 10;
+	int_config[0] = 10;
+	fp_config[0] = 10;
+	percent_config[0] = 25;
+
+	//<interval> <step> <min> <max>
+	adapt_config[0] = 10000;
+	adapt_config[1] = 2;
+	adapt_config[2] = 4;
+	adapt_config[3] = 64;
+}
+
+int cap_policy_t::list_value(const std::vector<int> & config, int nelt, int i)
+{
+	assert(nelt>0);
+	return config[(i < nelt) ? i : (nelt - 1)];
+}
+
+std::string cap_policy_t::name() const
+{
+	switch(kind)
+	{
+	case CAP_NONE: return "none";
+	case CAP_STATIC: return "static";
+	case CAP_SPLIT: return "split";
+	case CAP_PROPORTIONAL: return "proportional";
+	case CAP_ADAPTIVE: return "adaptive";
+	}
+	return "none";
+}
+
+void cap_policy_t::reg_options(opt_odb_t *odb)
+{
+	opt_reg_note(odb,
+		"  Rename register caps limit the number of in-flight (renamed, not yet committed) physical registers\n"
+		"  each thread may hold. Per-thread lists are indexed by context id, the last value repeats for the\n"
+		"  remaining threads. The policies are:\n"
+		"\n"
+		"    none         - no per-thread cap\n"
+		"    static       - cap on int+fp registers (-cap:regs)\n"
+		"    split        - separate caps for the int and fp register files (-cap:int, -cap:fp)\n"
+		"    proportional - cap on int+fp registers as a percentage of the core's rename registers,\n"
+		"                   -rf:size less the architected registers of both files (-cap:percent)\n"
+		"    adaptive     - starts at -cap:regs, every <interval> cycles threads that commit faster than\n"
+		"                   the average of their core gain <step> registers, slower threads lose <step>,\n"
+		"                   bounded by [<min>,<max>] (-cap:adapt)\n"
+		);
+
+	opt_reg_string(odb, "-cap:policy","",
+		"rename register cap policy {none|static|split|proportional|adaptive}",
+		&policy_opt, "static",
+		/* print */TRUE, NULL);
+
+	std::vector<int> def(regs_config.begin(),regs_config.begin()+regs_nelt);
+	opt_reg_int_list(odb, "-cap:regs","",
+		"per-thread cap on in-flight rename registers (static, initial adaptive cap)",
+		&regs_config[0], regs_config.size(), &regs_nelt, &def[0],
+		/* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+	def.assign(int_config.begin(),int_config.begin()+int_nelt);
+	opt_reg_int_list(odb, "-cap:int","",
+		"per-thread cap on in-flight integer rename registers (split)",
+		&int_config[0], int_config.size(), &int_nelt, &def[0],
+		/* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+	def.assign(fp_config.begin(),fp_config.begin()+fp_nelt);
+	opt_reg_int_list(odb, "-cap:fp","",
+		"per-thread cap on in-flight floating point rename registers (split)",
+		&fp_config[0], fp_config.size(), &fp_nelt, &def[0],
+		/* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+	def.assign(percent_config.begin(),percent_config.begin()+percent_nelt);
+	opt_reg_int_list(odb, "-cap:percent","",
+		"per-thread cap in percent of the core's rename registers (proportional)",
+		&percent_config[0], percent_config.size(), &percent_nelt, &def[0],
+		/* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+	int adapt_def[4] = {adapt_config[0], adapt_config[1], adapt_config[2], adapt_config[3]};
+	opt_reg_int_list(odb, "-cap:adapt","",
+		"adaptive cap config (<interval> <step> <min> <max>)",
+		adapt_config, 4, &adapt_nelt, adapt_def,
+		/* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+}
+
+void cap_policy_t::check_options()
+{
+	kind = cap_str2policy(policy_opt);
+
+	if(regs_nelt < 1 || int_nelt < 1 || fp_nelt < 1 || percent_nelt < 1)
+		fatal("rename cap lists need at least one value");
+
+	for(int i=0;i<regs_nelt;i++)
+		if(regs_config[i] < 1)
+			fatal("rename cap (-cap:regs) `%d' must be positive", regs_config[i]);
+	for(int i=0;i<int_nelt;i++)
+		if(int_config[i] < 1)
+			fatal("integer rename cap (-cap:int) `%d' must be positive", int_config[i]);
+	for(int i=0;i<fp_nelt;i++)
+		if(fp_config[i] < 1)
+			fatal("floating point rename cap (-cap:fp) `%d' must be positive", fp_config[i]);
+	for(int i=0;i<percent_nelt;i++)
+		if(percent_config[i] < 1 || percent_config[i] > 100)
+			fatal("rename cap percentage (-cap:percent) `%d' must be in 1..100", percent_config[i]);
+
+	if(adapt_nelt != 4)
+		fatal("bad adaptive cap config: <interval> <step> <min> <max>");
+	if(adapt_config[0] < 1 || adapt_config[1] < 1)
+		fatal("adaptive cap interval and step must be positive");
+	if(adapt_config[2] < 1 || adapt_config[3] < adapt_config[2])
+		fatal("adaptive cap bounds must satisfy 0 < <min> <= <max>");
+}
+
+void cap_policy_t::reg_stats(stat_sdb_t *sdb, int num_contexts)
+{
+	if(num_contexts > static_cast<int>(cap.size()))
+		fatal("rename cap policy supports at most %d contexts", static_cast<int>(cap.size()));
+
+	if(kind == CAP_NONE)
+		return;
+
+	std::string prefix = "cap_" + name() + ".";
+	for(int i=0;i<num_contexts;i++)
+	{
+		char buf[16];
+		sprintf(buf, "_%d", i);
+		std::string id = buf;
+
+		if(kind == CAP_SPLIT)
+		{
+			stat_reg_int(sdb, prefix + "int_limit" + id, "integer rename register cap", &int_cap[i], 0, NULL);
+			stat_reg_int(sdb, prefix + "fp_limit" + id, "floating point rename register cap", &fp_cap[i], 0, NULL);
+			stat_reg_counter(sdb, prefix + "int_stalls" + id, "rename stalls due to the integer cap", &int_stalls[i], 0, NULL);
+			stat_reg_counter(sdb, prefix + "fp_stalls" + id, "rename stalls due to the floating point cap", &fp_stalls[i], 0, NULL);
+			stat_reg_counter(sdb, prefix + "int_occupancy" + id, "cumulative in-flight integer rename registers", &int_occupancy[i], 0, NULL);
+			stat_reg_counter(sdb, prefix + "fp_occupancy" + id, "cumulative in-flight floating point rename registers", &fp_occupancy[i], 0, NULL);
+			stat_reg_formula(sdb, prefix + "int_avg_occupancy" + id, "average in-flight integer rename registers",
+				prefix + "int_occupancy" + id + " / sim_cycle", "%9.4f");
+			stat_reg_formula(sdb, prefix + "fp_avg_occupancy" + id, "average in-flight floating point rename registers",
+				prefix + "fp_occupancy" + id + " / sim_cycle", "%9.4f");
+		}
+		else
+		{
+			stat_reg_int(sdb, prefix + "limit" + id, (kind == CAP_ADAPTIVE) ? "rename register cap (at end of simulation)" : "rename register cap",
+				&cap[i], 0, NULL);
+			stat_reg_counter(sdb, prefix + "stalls" + id, "rename stalls due to the cap", &stalls[i], 0, NULL);
+			stat_reg_counter(sdb, prefix + "occupancy" + id, "cumulative in-flight rename registers", &occupancy[i], 0, NULL);
+			stat_reg_formula(sdb, prefix + "avg_occupancy" + id, "average in-flight rename registers",
+				prefix + "occupancy" + id + " / sim_cycle", "%9.4f");
+			if(kind == CAP_ADAPTIVE)
+			{
+				stat_reg_counter(sdb, prefix + "raises" + id, "adaptive cap increases", &raises[i], 0, NULL);
+				stat_reg_counter(sdb, prefix + "lowers" + id, "adaptive cap decreases", &lowers[i], 0, NULL);
+			}
+		}
+	}
+}
+
+void cap_policy_t::init(const std::vector<int> & rename_regs)
+{
+	assert(rename_regs.size() <= cap.size());
+	for(size_t i=0;i<rename_regs.size();i++)
+	{
+		switch(kind)
+		{
+		case CAP_NONE:
+			break;
+		case CAP_STATIC:
+		case CAP_ADAPTIVE:
+			cap[i] = list_value(regs_config, regs_nelt, i);
+			break;
+		case CAP_SPLIT:
+			int_cap[i] = list_value(int_config, int_nelt, i);
+			fp_cap[i] = list_value(fp_config, fp_nelt, i);
+			break;
+		case CAP_PROPORTIONAL:
+			cap[i] = (rename_regs[i] * list_value(percent_config, percent_nelt, i)) / 100;
+			if(cap[i] < 1)
+				cap[i] = 1;
+			break;
+		}
+		if(kind == CAP_ADAPTIVE)
+		{
+			cap[i] = MAX(adapt_config[2], MIN(adapt_config[3], cap[i]));
+		}
+		last_committed[i] = 0;
+	}
+}
+
+bool cap_policy_t::allow(int context_id, reg_type type, const cap_usage_t & usage)
+{
+	switch(kind)
+	{
+	case CAP_NONE:
+		return true;
+	case CAP_SPLIT:
+		if(type == REG_INT && usage.int_regs >= int_cap[context_id])
+		{
+			int_stalls[context_id]++;
+			return false;
+		}
+		if(type == REG_FP && usage.fp_regs >= fp_cap[context_id])
+		{
+			fp_stalls[context_id]++;
+			return false;
+		}
+		return true;
+	default:
+		if(usage.total >= cap[context_id])
+		{
+			stalls[context_id]++;
+			return false;
+		}
+		return true;
+	}
+}
+
+void cap_policy_t::sample(int context_id, const cap_usage_t & usage)
+{
+	occupancy[context_id] += usage.total;
+	int_occupancy[context_id] += usage.int_regs;
+	fp_occupancy[context_id] += usage.fp_regs;
+}
+
+bool cap_policy_t::interval_done(tick_t now) const
+{
+	return (kind == CAP_ADAPTIVE) && now && ((now % adapt_config[0]) == 0);
+}
+
+void cap_policy_t::adapt(const std::vector<int> & context_ids, const std::vector<long long> & committed)
+{
+	if(context_ids.size() < 2)
+	{
+		//nothing to balance against, still track the commit count
+		for(size_t i=0;i<context_ids.size();i++)
+			last_committed[context_ids[i]] = committed[context_ids[i]];
+		return;
+	}
+
+	//commits of each thread in the last interval and the core average
+	std::vector<long long> delta(context_ids.size());
+	long long sum = 0;
+	for(size_t i=0;i<context_ids.size();i++)
+	{
+		int id = context_ids[i];
+		delta[i] = committed[id] - last_committed[id];
+		last_committed[id] = committed[id];
+		sum += delta[i];
+	}
+
+	//compare delta * n against sum to avoid rounding the average
+	long long n = context_ids.size();
+	for(size_t i=0;i<context_ids.size();i++)
+	{
+		int id = context_ids[i];
+		if((delta[i] * n > sum) && (cap[id] < adapt_config[3]))
+		{
+			cap[id] = MIN(adapt_config[3], cap[id] + adapt_config[1]);
+			raises[id]++;
+		}
+		else if((delta[i] * n < sum) && (cap[id] > adapt_config[2]))
+		{
+			cap[id] = MAX(adapt_config[2], cap[id] - adapt_config[1]);
+			lowers[id]++;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,162 @@
+// Rename Register Cap Policy Prototypes
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ *
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ *
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ *
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ *
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ *
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ *
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ *
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ *
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ *
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#ifndef CAP_POLICY_H
+#define CAP_POLICY_H
+
+#include<string>
+#include<vector>
+
+#include"host.h"
+#include"misc.h"
+#include"machine.h"
+#include"options.h"
+#include"stats.h"
+#include"regs.h"
+
+//Rename register cap policies
+//A cap limits the number of in-flight (renamed, not yet committed) physical registers a thread may hold.
+//Register rename stalls the thread once it reaches its cap.
+enum cap_policy_kind
+{
+	CAP_NONE = 0,			//no per-thread cap, only the free list limits rename
+	CAP_STATIC,			//fixed per-thread cap on int+fp registers (-cap:regs)
+	CAP_SPLIT,			//separate per-thread caps for the int and fp files (-cap:int, -cap:fp)
+	CAP_PROPORTIONAL,		//per-thread cap as a percentage of the core's rename registers (-cap:percent)
+	CAP_ADAPTIVE			//per-thread cap adjusted each interval by relative commit rate (-cap:adapt)
+};
+
+//Registers held by a thread, as seen by the cap policy
+class cap_usage_t
+{
+	public:
+		cap_usage_t(int total, int int_regs, int fp_regs)
+		: total(total), int_regs(int_regs), fp_regs(fp_regs)
+		{}
+
+		int total;			//in-flight registers of either class
+		int int_regs;			//in-flight integer registers
+		int fp_regs;			//in-flight floating point registers
+};
+
+class cap_policy_t
+{
+	public:
+		cap_policy_t(int max_contexts);
+
+		//register the -cap:* options
+		void reg_options(opt_odb_t *odb);
+
+		//parse the policy name and validate the -cap:* options
+		void check_options();
+
+		//register the statistics of the selected policy, call after the contexts are loaded
+		void reg_stats(stat_sdb_t *sdb, int num_contexts);
+
+		//resolve the per-thread caps, rename_regs[i] is the number of non-architectural
+		//registers (of the int and fp files together) on the core context i runs on
+		void init(const std::vector<int> & rename_regs);
+
+		//returns true if context_id may rename another destination of type type
+		//counts a stall for the context otherwise
+		bool allow(int context_id, reg_type type, const cap_usage_t & usage);
+
+		//accumulate per-cycle occupancy for context_id
+		void sample(int context_id, const cap_usage_t & usage);
+
+		//returns true when the adaptive policy should re-evaluate its caps at cycle now
+		bool interval_done(tick_t now) const;
+
+		//adaptive policy: redistribute the caps among the contexts of one core,
+		//committed[i] is the total number of instructions committed by context i
+		void adapt(const std::vector<int> & context_ids, const std::vector<long long> & committed);
+
+		cap_policy_kind kind;		//the selected policy
+		char *policy_opt;		//-cap:policy
+
+		std::vector<int> regs_config;	//-cap:regs, per-thread cap (last value repeats)
+		int regs_nelt;
+		std::vector<int> int_config;	//-cap:int, per-thread int cap (last value repeats)
+		int int_nelt;
+		std::vector<int> fp_config;	//-cap:fp, per-thread fp cap (last value repeats)
+		int fp_nelt;
+		std::vector<int> percent_config;//-cap:percent, per-thread share of the rename registers (last value repeats)
+		int percent_nelt;
+		int adapt_config[4];		//-cap:adapt <interval> <step> <min> <max>
+		int adapt_nelt;
+
+		//current per-thread caps
+		std::vector<int> cap;		//cap on int+fp registers (static, proportional, adaptive)
+		std::vector<int> int_cap;	//cap on int registers (split)
+		std::vector<int> fp_cap;	//cap on fp registers (split)
+
+		//statistics
+		std::vector<counter_t> stalls;		//rename stalls caused by the cap
+		std::vector<counter_t> int_stalls;	//rename stalls caused by the int cap (split)
+		std::vector<counter_t> fp_stalls;	//rename stalls caused by the fp cap (split)
+		std::vector<counter_t> occupancy;	//cumulative in-flight registers (sampled every cycle)
+		std::vector<counter_t> int_occupancy;	//cumulative in-flight int registers (sampled every cycle)
+		std::vector<counter_t> fp_occupancy;	//cumulative in-flight fp registers (sampled every cycle)
+		std::vector<counter_t> raises;		//adaptive cap increases
+		std::vector<counter_t> lowers;		//adaptive cap decreases
+
+	private:
+		//returns entry i of an option list, the last value is repeated for the remaining threads
+		static int list_value(const std::vector<int> & config, int nelt, int i);
+
+		std::string name() const;
+
+		std::vector<long long> last_committed;	//committed instructions at the last adaptive interval
+};
+
+//returns the cap_policy_kind for the name of a policy, fatal if it is unknown
+cap_policy_kind cap_str2policy(const char *name);
+
+#endif
@@ -0,0 +1,391 @@
+// Checkpoints of every context, optionally with warmed caches and predictors
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ *
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ *
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ *
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ *
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ *
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ *
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ *
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ *
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ *
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#ifndef CHECKPOINT_C
+#define CHECKPOINT_C
+
+#include<algorithm>
+#include<fstream>
+#include<iostream>
+#include<vector>
+
+#include"checkpoint.h"
+#include"sim-outorder.h"
+
+#define CHKPT_HEADER	"/* m-sim checkpoint */"
+#define CHKPT_VERSION	2
+
+//the distinct caches and TLBs of core core_num in a fixed order, unified levels are listed once
+static std::vector<cache_t *> core_caches(unsigned int core_num)
+{
+	std::vector<core_t> & cores = current_sim->cores;
+	cache_t *levels[] = { cores[core_num].cache_il1, cores[core_num].cache_dl1, cores[core_num].cache_il2, cores[core_num].cache_dl2,
+		cores[core_num].itlb, cores[core_num].dtlb };
+	std::vector<cache_t *> caches;
+	for(size_t i=0;i<sizeof(levels)/sizeof(levels[0]);i++)
+	{
+		if(levels[i] && (std::find(caches.begin(), caches.end(), levels[i]) == caches.end()))
+		{
+			caches.push_back(levels[i]);
+		}
+	}
+	return caches;
+}
+
+//the shared L3 caches
+static std::vector<cache_t *> shared_caches(cache_t *cache_il3, cache_t *cache_dl3)
+{
+	std::vector<cache_t *> caches;
+	if(cache_il3)
+	{
+		caches.push_back(cache_il3);
+	}
+	if(cache_dl3 && (cache_dl3 != cache_il3))
+	{
+		caches.push_back(cache_dl3);
+	}
+	return caches;
+}
+
+static void write_caches(std::ostream & out, const std::vector<cache_t *> & caches)
+{
+	out << caches.size();
+	for(size_t i=0;i<caches.size();i++)
+	{
+		out << " " << *caches[i];
+	}
+	out << std::endl;
+}
+
+static void read_caches(std::istream & in, const std::vector<cache_t *> & caches, const std::string & where)
+{
+	size_t count;
+	in >> std::dec >> count;
+	if(count != caches.size())
+	{
+		fatal("checkpoint has %d caches for %s, the configuration has %d", (int)count, where.c_str(), (int)caches.size());
+	}
+	for(size_t i=0;i<caches.size();i++)
+	{
+		in >> *caches[i];
+	}
+}
+
+//a predictor slot, perfect prediction has no predictor
+static void write_pred(std::ostream & out, const bpred_t *pred)
+{
+	out << (pred ? 1 : 0);
+	if(pred)
+	{
+		out << " " << *pred;
+	}
+	out << std::endl;
+}
+
+static void read_pred(std::istream & in, bpred_t *pred, int context_id)
+{
+	int present;
+	in >> std::dec >> present;
+	if(present != (pred ? 1 : 0))
+	{
+		fatal("checkpoint predictor of context %d does not match the configured predictor", context_id);
+	}
+	if(pred)
+	{
+		in >> *pred;
+	}
+}
+
+//the binary memory image written next to checkpoint fname
+static std::string chkpt_pages_name(const std::string & fname)
+{
+	return fname + ".pages";
+}
+
+//creates a context for a process forked before the checkpoint, it is placed on a core like OSF_SYS_fork places it
+static void add_forked_context()
+{
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
+	int & num_contexts = current_sim->num_contexts;
+	context * new_context = new context(contexts[0]);
+	new_context->id = num_contexts;
+	new_context->regs.context_id = num_contexts;
+	new_context->core_id = -1;
+	new_context->sim_num_insn = 0;
+
+	for(unsigned int i=0;(i<cores.size() && (new_context->core_id==-1));i++)
+	{
+		cores[i].addcontext(*new_context);
+	}
+	if(new_context->core_id == -1)
+	{
+		fatal("checkpoint: no core has room for forked context %d (see -max_contexts_per_core)", num_contexts);
+	}
+	contexts.push_back(*new_context);
+	delete new_context;
+
+	contexts.back().id = num_contexts;
+	num_contexts++;
+
+	contexts.back().mem->name = std::string("Thread_Forked");
+	contexts.back().mem->context_id = contexts.back().id;
+}
+
+void chkpt_write(const std::string & fname, bool warm, bool text, cache_t *cache_il3, cache_t *cache_dl3)
+{
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
+	int & num_contexts = current_sim->num_contexts;
+	std::ofstream out(fname.c_str());
+	if(!out.is_open())
+	{
+		fatal("could not create checkpoint `%s'", fname.c_str());
+	}
+
+	std::ofstream pages;
+	if(!text)
+	{
+		pages.open(chkpt_pages_name(fname).c_str(), std::ios::out | std::ios::binary);
+		if(!pages.is_open())
+		{
+			fatal("could not create memory image `%s'", chkpt_pages_name(fname).c_str());
+		}
+		mem_image_t::write_header(pages);
+	}
+
+	out << CHKPT_HEADER << std::endl;
+	out << "(" << CHKPT_VERSION << ", " << num_contexts << ", " << (warm ? 1 : 0) << ", " << (text ? 1 : 0) << ")" << std::endl;
+	out << current_sim->pid_handler << std::endl;
+
+	for(int i=0;i<num_contexts;i++)
+	{
+		context & c = contexts[i];
+		out << c.filename << std::endl;
+		out << "(" << std::dec << c.pid << ", " << c.gpid << ", " << c.gid << ", " << c.fastfwd_cnt << ", " << c.fastfwd_left << ", "
+			<< c.sim_num_insn << ", " << c.interrupts << ", 0x" << std::hex << c.entry_point << ", " << std::dec
+			<< c.waiting_for << ", " << c.sleep << ", " << c.next_check << ")" << std::endl;
+		out << c.file_table;
+
+		out << "(" << c.mem->memory_map.size();
+		for(size_t j=0;j<c.mem->memory_map.size();j++)
+		{
+			out << ", " << c.mem->memory_map[j];
+		}
+		out << ")" << std::endl << "(" << c.mem->internal_map.size();
+		for(size_t j=0;j<c.mem->internal_map.size();j++)
+		{
+			out << ", " << c.mem->internal_map[j];
+		}
+		out << ")" << std::endl;
+
+		out << c.regs;
+		if(text)
+		{
+			out << *c.mem;
+		}
+		else
+		{
+			c.mem->write_layout(out);
+			out << "(0x" << std::hex << c.mem->write_pages(pages) << ")" << std::dec << std::endl;
+		}
+	}
+
+	if(warm)
+	{
+		for(unsigned int i=0;i<cores.size();i++)
+		{
+			write_caches(out, core_caches(i));
+		}
+		write_caches(out, shared_caches(cache_il3, cache_dl3));
+		for(int i=0;i<num_contexts;i++)
+		{
+			write_pred(out, contexts[i].pred);
+			write_pred(out, contexts[i].load_lat_pred);
+		}
+	}
+
+	if(!out)
+	{
+		fatal("could not write checkpoint `%s'", fname.c_str());
+	}
+	if(!text && !pages)
+	{
+		fatal("could not write memory image `%s'", chkpt_pages_name(fname).c_str());
+	}
+}
+
+void chkpt_read(const std::string & fname, cache_t *cache_il3, cache_t *cache_dl3)
+{
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
+	int & num_contexts = current_sim->num_contexts;
+	std::ifstream in(fname.c_str());
+	if(!in.is_open())
+	{
+		fatal("could not open checkpoint `%s'", fname.c_str());
+	}
+
+	std::string buf;
+	char c_buf;
+	int version, count, warm, text(1);
+	getline(in, buf);
+	if(buf != CHKPT_HEADER)
+	{
+		fatal("`%s' is not a checkpoint", fname.c_str());
+	}
+	in >> c_buf >> version >> c_buf >> count >> c_buf >> warm;
+	if(version > 1)
+	{
+		//version 1 always has the text memory image
+		in >> c_buf >> text;
+	}
+	in >> c_buf;
+	if((version < 1) || (version > CHKPT_VERSION))
+	{
+		fatal("checkpoint `%s' is version %d, expected version %d", fname.c_str(), version, CHKPT_VERSION);
+	}
+	if(count < num_contexts)
+	{
+		fatal("checkpoint `%s' has %d contexts, the command line loads %d", fname.c_str(), count, num_contexts);
+	}
+	in >> current_sim->pid_handler;
+
+	mem_image_t *image = text ? NULL : new mem_image_t(chkpt_pages_name(fname));
+	for(int i=0;i<count;i++)
+	{
+		std::string filename;
+		in >> std::ws;
+		getline(in, filename);
+		if(i == num_contexts)
+		{
+			add_forked_context();
+		}
+		else if(filename != contexts[i].filename)
+		{
+			fatal("checkpoint context %d is `%s', the command line loads `%s'", i, filename.c_str(), contexts[i].filename.c_str());
+		}
+		context & c = contexts[i];
+		c.filename = filename;
+
+		in >> c_buf >> std::dec >> c.pid >> c_buf >> c.gpid >> c_buf >> c.gid >> c_buf >> c.fastfwd_cnt >> c_buf >> c.fastfwd_left >> c_buf
+			>> c.sim_num_insn >> c_buf >> c.interrupts >> c_buf >> std::hex >> c.entry_point >> c_buf >> std::dec
+			>> c.waiting_for >> c_buf >> c.sleep >> c_buf >> c.next_check >> c_buf;
+		in >> c.file_table;
+
+		size_t maps;
+		in >> c_buf >> maps;
+		c.mem->memory_map.resize(maps);
+		for(size_t j=0;j<maps;j++)
+		{
+			in >> c_buf >> c.mem->memory_map[j];
+		}
+		//older checkpoints list mappings in creation order
+		std::sort(c.mem->memory_map.begin(), c.mem->memory_map.end());
+		in >> c_buf >> c_buf >> maps;
+		c.mem->internal_map.resize(maps);
+		for(size_t j=0;j<maps;j++)
+		{
+			in >> c_buf >> c.mem->internal_map[j];
+		}
+		in >> c_buf >> std::ws;
+
+		in >> c.regs;
+		if(text)
+		{
+			in >> *c.mem;
+		}
+		else
+		{
+			unsigned long long offset;
+			c.mem->read_layout(in);
+			counter_t page_count = c.mem->page_count;
+			in >> c_buf >> std::hex >> offset >> c_buf >> std::dec;
+			c.mem->map_pages(image, offset);
+			if(c.mem->page_count != page_count)
+			{
+				fatal("memory image `%s' does not match checkpoint context %d", image->fname.c_str(), i);
+			}
+		}
+		if(!in)
+		{
+			fatal("checkpoint `%s' is truncated in context %d", fname.c_str(), i);
+		}
+	}
+
+	if(image)
+	{
+		//the pages now hold the image
+		image->release();
+	}
+
+	if(warm)
+	{
+		for(unsigned int i=0;i<cores.size();i++)
+		{
+			std::stringstream where;
+			where << "core " << i;
+			read_caches(in, core_caches(i), where.str());
+		}
+		read_caches(in, shared_caches(cache_il3, cache_dl3), "the L3");
+		for(int i=0;i<num_contexts;i++)
+		{
+			read_pred(in, contexts[i].pred, i);
+			read_pred(in, contexts[i].load_lat_pred, i);
+		}
+		if(!in)
+		{
+			fatal("checkpoint `%s' is truncated in the warm state", fname.c_str());
+		}
+	}
+	std::cerr << "sim: restored " << count << " contexts from " << fname << (warm ? " (with warm caches and predictors)" : "") << std::endl;
+}
+
+#endif
@@ -0,0 +1,78 @@
+// Checkpoint Prototypes (every context, optionally with warmed caches and predictors)
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ *
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ *
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ *
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ *
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ *
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ *
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ *
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ *
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ *
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include<string>
+
+#include"cache.h"
+
+//A checkpoint holds what fast-forwarding produces for every context: the architected registers, memory image
+//and mappings, file table and process ids, plus the process list of pid_handler. A warm checkpoint also holds
+//the tags of every cache and TLB (per core and the shared L3s) and the branch and load-latency predictor of every
+//context, so a restored run warms up exactly like the run the checkpoint was written from.
+//
+//Checkpoints are restored into the contexts loaded from the command line, which must name the same programs in
+//the same order (contexts forked before the checkpoint are created again). Warm state is checked against the
+//configured cache and predictor geometry. Open files are reopened and seeked to their saved offsets.
+
+//The memory images go to a binary page file next to the checkpoint (fname.pages, see mem_image_t) that is mapped
+//when the checkpoint is read, so restoring only reads the pages a run touches. Text memory images (as -makeeio
+//writes them) are kept for debugging, they are slow to read.
+
+//writes the checkpoint of every context to fname, warm adds the cache and predictor state, text writes the memory
+//images into the checkpoint as text instead of the page file
+void chkpt_write(const std::string & fname, bool warm, bool text, cache_t *cache_il3, cache_t *cache_dl3);
+
+//restores every context (and the warm state, if the checkpoint has it) from fname
+void chkpt_read(const std::string & fname, cache_t *cache_il3, cache_t *cache_dl3);
+
+#endif
@@ -0,0 +1,361 @@
+// Core Pool (runs the cores of a cycle on host threads)
+
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ *
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ *
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ *
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ *
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ *
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ *
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ *
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ *
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ *
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#ifndef CORE_POOL_C
+#define CORE_POOL_C
+
+#include"core_pool.h"
+#include"misc.h"
+#include<cassert>
+
+//the core the calling thread is running, -1 outside of a parallel run()
+static __thread int pool_core = -1;
+
+//the pool the calling thread is running a core for
+static __thread core_pool_t * active_pool = NULL;
+
+core_pool_t::core_pool_t()
+: threads(1), quantum(1), core_fn(NULL), core_arg(NULL), generation(0), stopping(false), cores(0), next_core(0), done_upto(0), finished(0), exclusive(-1),
+quanta(0)
+{
+	pthread_mutex_init(&lock, NULL);
+	pthread_cond_init(&start_cond, NULL);
+	pthread_cond_init(&cond, NULL);
+}
+
+core_pool_t::~core_pool_t()
+{
+	stop();
+	pthread_cond_destroy(&cond);
+	pthread_cond_destroy(&start_cond);
+	pthread_mutex_destroy(&lock);
+}
+
+void core_pool_t::reg_options(opt_odb_t *odb)
+{
+	opt_reg_int(odb, "-sim:threads", "", "host threads to simulate the cores on (at most one per core, results match 1 thread)",
+		&threads, /* default */1,
+		/* print */TRUE, /* format */NULL);
+
+	opt_reg_int(odb, "-sim:quantum", "", "cycles each core runs ahead on its own clock before the cores synchronize",
+		&quantum, /* default */1,
+		/* print */TRUE, /* format */NULL);
+
+	opt_reg_note(odb,
+		"  With -sim:quantum 1 the cores synchronize every cycle and shared state (L3, main memory, syscalls)\n"
+		"  is updated in core order, so -sim:threads does not change the results. A longer quantum lets each core\n"
+		"  run that many cycles without waiting for the others. Its accesses to the shared L3 and main memory are\n"
+		"  given a latency estimated from their state at the start of the quantum and are made in time order at\n"
+		"  its end. The cores keep the estimated latencies; sim_quantum_estimate_* report how far they were from\n"
+		"  the replayed ones, not how far the run is from a -sim:quantum 1 run. To pick a quantum, compare\n"
+		"  sim_cycle and the IPCs of a mix against a -sim:quantum 1 run.\n"
+		"  Syscalls still run in the order the host threads reach them, so with -sim:threads above 1 and a\n"
+		"  quantum above 1 runs of programs that make syscalls are not repeatable; with -sim:threads 1 they are.\n"
+		);
+}
+
+void core_pool_t::check_options()
+{
+	if(threads < 1)
+		fatal("-sim:threads must be at least 1");
+	if(quantum < 1)
+		fatal("-sim:quantum must be at least 1 cycle");
+}
+
+void core_pool_t::reg_stats(stat_sdb_t *sdb)
+{
+	if(quantum == 1)
+		return;
+
+	stat_reg_counter(sdb, "sim_quantum_count", "number of quanta the cores synchronized at", &quanta, 0, NULL);
+}
+
+void core_pool_t::start(unsigned int threads)
+{
+	assert(!parallel());
+	stopping = false;
+	for(unsigned int i=1;i<threads;i++)
+	{
+		pthread_t worker;
+		if(pthread_create(&worker, NULL, worker_main, this))
+		{
+			fatal("could not create simulation thread %d", i);
+		}
+		workers.push_back(worker);
+	}
+}
+
+void core_pool_t::stop()
+{
+	if(!parallel())
+	{
+		return;
+	}
+	pthread_mutex_lock(&lock);
+	stopping = true;
+	pthread_cond_broadcast(&start_cond);
+	pthread_mutex_unlock(&lock);
+	for(size_t i=0;i<workers.size();i++)
+	{
+		pthread_join(workers[i], NULL);
+	}
+	workers.clear();
+}
+
+void * core_pool_t::worker_main(void * arg)
+{
+	core_pool_t * pool = static_cast<core_pool_t *>(arg);
+	unsigned long long seen = 0;
+	for(;;)
+	{
+		pthread_mutex_lock(&pool->lock);
+		while(!pool->stopping && (pool->generation == seen))
+		{
+			pthread_cond_wait(&pool->start_cond, &pool->lock);
+		}
+		if(pool->stopping)
+		{
+			pthread_mutex_unlock(&pool->lock);
+			return NULL;
+		}
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		pool->work();
+	}
+}
+
+core_pool_t * core_pool_t::active()
+{
+	return active_pool;
+}
+
+void core_pool_t::run(unsigned int num_cores, void (*fn)(void *, unsigned int), void * arg)
+{
+	quanta++;
+	core_pool_t * outer = active_pool;
+	active_pool = this;
+	if(!parallel())
+	{
+		for(unsigned int i=0;i<num_cores;i++)
+		{
+			fn(arg, i);
+		}
+		active_pool = outer;
+		return;
+	}
+
+	pthread_mutex_lock(&lock);
+	core_fn = fn;
+	core_arg = arg;
+	cores = num_cores;
+	next_core = 0;
+	done_upto = 0;
+	finished = 0;
+	exclusive = -1;
+	done.assign(cores, 0);
+	turn.assign(cores, 0);
+	parked.assign(cores, 0);
+	generation++;
+	pthread_cond_broadcast(&start_cond);
+	pthread_mutex_unlock(&lock);
+
+	work();
+
+	pthread_mutex_lock(&lock);
+	while(finished < cores)
+	{
+		pthread_cond_wait(&cond, &lock);
+	}
+	pthread_mutex_unlock(&lock);
+	active_pool = outer;
+}
+
+//Cores are claimed in increasing order and (with a quantum of 1) only ever wait for lower numbered cores,
+//so the lowest unfinished core is always running and the cycle cannot deadlock.
+void core_pool_t::work()
+{
+	unsigned int core;
+	core_pool_t * outer = active_pool;
+	active_pool = this;
+	while(claim(core))
+	{
+		pool_core = core;
+		core_fn(core_arg, core);
+		pool_core = -1;
+		finish(core);
+	}
+	active_pool = outer;
+}
+
+bool core_pool_t::claim(unsigned int & core)
+{
+	pthread_mutex_lock(&lock);
+	while((exclusive >= 0) && (next_core < cores))
+	{
+		pthread_cond_wait(&cond, &lock);
+	}
+	if(next_core >= cores)
+	{
+		pthread_mutex_unlock(&lock);
+		return false;
+	}
+	core = next_core++;
+	pthread_mutex_unlock(&lock);
+	return true;
+}
+
+void core_pool_t::finish(unsigned int core)
+{
+	pthread_mutex_lock(&lock);
+	done[core] = 1;
+	if(exclusive == static_cast<int>(core))
+	{
+		exclusive = -1;
+	}
+	while((done_upto < cores) && done[done_upto])
+	{
+		done_upto++;
+	}
+	finished++;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&lock);
+}
+
+bool core_pool_t::others_parked(unsigned int core)
+{
+	for(unsigned int i=0;i<next_core;i++)
+	{
+		if((i != core) && !done[i] && !parked[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void core_pool_t::ordered_enter()
+{
+	//turn[] of a core is only written by the thread running it (and by run() between cycles)
+	if((pool_core < 0) || (quantum > 1) || turn[pool_core])
+	{
+		return;
+	}
+	unsigned int core = pool_core;
+	pthread_mutex_lock(&lock);
+	parked[core] = 1;
+	pthread_cond_broadcast(&cond);
+	while(done_upto < core)
+	{
+		pthread_cond_wait(&cond, &lock);
+	}
+	parked[core] = 0;
+	turn[core] = 1;
+	pthread_mutex_unlock(&lock);
+}
+
+void core_pool_t::exclusive_enter()
+{
+	//with a quantum of 1, the lower numbered cores are done once the core has its turn
+	ordered_enter();
+	if(pool_core < 0)
+	{
+		return;
+	}
+	unsigned int core = pool_core;
+	pthread_mutex_lock(&lock);
+	while((exclusive >= 0) && (exclusive != static_cast<int>(core)))
+	{
+		//another core is exclusive, it may be waiting for this one
+		parked[core] = 1;
+		pthread_cond_broadcast(&cond);
+		pthread_cond_wait(&cond, &lock);
+	}
+	parked[core] = 0;
+	exclusive = core;
+	while(!others_parked(core))
+	{
+		pthread_cond_wait(&cond, &lock);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+void core_pool_t::safe_point()
+{
+	if((pool_core < 0) || (quantum == 1) || (__atomic_load_n(&exclusive, __ATOMIC_ACQUIRE) < 0))
+	{
+		return;
+	}
+	unsigned int core = pool_core;
+	pthread_mutex_lock(&lock);
+	while((exclusive >= 0) && (exclusive != static_cast<int>(core)))
+	{
+		parked[core] = 1;
+		pthread_cond_broadcast(&cond);
+		pthread_cond_wait(&cond, &lock);
+	}
+	parked[core] = 0;
+	pthread_mutex_unlock(&lock);
+}
+
+void core_pool_t::end_cycle()
+{
+	if((pool_core < 0) || (quantum == 1) || (__atomic_load_n(&exclusive, __ATOMIC_ACQUIRE) != pool_core))
+	{
+		return;
+	}
+	pthread_mutex_lock(&lock);
+	exclusive = -1;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&lock);
+}
+
+#endif
@@ -0,0 +1,166 @@
+// Core Pool Prototypes (runs the cores of a cycle on host threads)
+
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ *
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ *
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ *
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ *
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ *
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ *
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ *
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ *
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ *
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#ifndef CORE_POOL_H
+#define CORE_POOL_H
+
+#include<vector>
+#include<pthread.h>
+
+#include"host.h"
+#include"options.h"
+#include"stats.h"
+
+//Runs the pipeline stages of the cores on host threads, one thread per core at most
+//run() hands the cores out in order (core 0 first) to the calling thread and threads-1 helper threads
+//and returns once every core has finished, the caller runs run() once per quantum.
+//
+//With a quantum of 1 cycle (the default), cores only touch their own contexts until they reach state shared
+//among the cores (the L3 caches, main memory, syscalls, inst_seq, sim_num_insn, ...), where they call
+//ordered_enter() first. That waits for every lower numbered core to finish the cycle, so shared state is
+//updated in the same order as the serial loop and the results match it.
+//
+//With a longer quantum each core runs up to quantum cycles on its own clock (bounded skew). The shared levels are
+//not changed during a quantum: the cores queue their accesses and are given an estimated latency, and the queued
+//accesses are made in time order once all clocks meet again at the end of the quantum (see
+//simulator_t::shared_access). Syscalls still run in host order, so results may depend on the thread interleaving
+//(with 1 thread they are repeatable).
+class core_pool_t
+{
+	public:
+		core_pool_t();
+		~core_pool_t();
+
+		//register the -sim:threads and -sim:quantum options
+		void reg_options(opt_odb_t *odb);
+
+		//validate the options
+		void check_options();
+
+		//register the quantum statistics
+		void reg_stats(stat_sdb_t *sdb);
+
+		//starts threads-1 helper threads
+		void start(unsigned int threads);
+
+		//stops the helper threads, run() runs the cores one at a time again
+		void stop();
+
+		//true while helper threads are running
+		inline bool parallel() const
+		{
+			return !workers.empty();
+		}
+
+		//runs fn(arg, core) for every core (in order if there are no helper threads)
+		void run(unsigned int num_cores, void (*fn)(void *, unsigned int), void * arg);
+
+		//the pool running the calling thread's core, NULL outside of run()
+		static core_pool_t * active();
+
+		//returns once every lower numbered core has finished the cycle, the calling core keeps
+		//its turn until it finishes. No-op outside of a parallel run() and with a quantum above 1.
+		void ordered_enter();
+
+		//waits until no other core is running and keeps them from running until the calling core ends its cycle.
+		//Needed before changing another core (placing a forked context, ejecting another core's context)
+		//or anything the cores read without ordered_enter().
+		//With a quantum of 1 this is ordered_enter() plus waiting for the higher numbered cores to reach theirs.
+		void exclusive_enter();
+
+		//called by a core at the start of each cycle, where it waits while another core is exclusive
+		void safe_point();
+
+		//called by a core at the end of each cycle
+		void end_cycle();
+
+		int threads;				//-sim:threads
+		int quantum;				//-sim:quantum
+
+	private:
+		static void * worker_main(void * arg);
+
+		//runs cores until none are left
+		void work();
+
+		//takes the next core to run, false if none are left
+		bool claim(unsigned int & core);
+
+		void finish(unsigned int core);
+
+		//true if every claimed core other than core has finished or is parked
+		bool others_parked(unsigned int core);
+
+		void (*core_fn)(void *, unsigned int);
+		void * core_arg;
+		std::vector<pthread_t> workers;
+
+		pthread_mutex_t lock;
+		pthread_cond_t start_cond;		//helper threads wait here for the next run
+		pthread_cond_t cond;			//a core finished, parked or released exclusive access
+
+		unsigned long long generation;		//runs started
+		bool stopping;
+
+		unsigned int cores;
+		unsigned int next_core;			//next core to claim
+		unsigned int done_upto;			//every core below this one has finished
+		unsigned int finished;			//cores finished
+		int exclusive;				//core with exclusive access, -1 if none
+		std::vector<char> done;			//core finished
+		std::vector<char> turn;			//core passed ordered_enter() (quantum of 1)
+		std::vector<char> parked;		//core is waiting in ordered_enter(), safe_point() or exclusive_enter()
+
+		//quantum statistics
+		counter_t quanta;			//calls to run()
+};
+
+#endif
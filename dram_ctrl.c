@@ -0,0 +1,376 @@
+// Banked DRAM Controller
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ *
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ *
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ *
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ *
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ *
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ *
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ *
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ *
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ *
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#ifndef DRAM_CTRL_C
+#define DRAM_CTRL_C
+
+#include<cstdio>
+#include<cstring>
+#include<cassert>
+#include<algorithm>
+
+#include"dram_ctrl.h"
+
+dram_ctrl_t::dram_ctrl_t(std::string config, unsigned int width, unsigned int channels, unsigned int ranks, unsigned int banks,
+	unsigned int row_size, bool closed_page, tick_t t_rcd, tick_t t_cas, tick_t t_rp, tick_t t_bus, unsigned int queue_size,
+	int max_contexts)
+: config(config), width(width), channels(channels), ranks(ranks), banks(banks), row_size(row_size), closed_page(closed_page),
+t_rcd(t_rcd), t_cas(t_cas), t_rp(t_rp), t_bus(t_bus), queue_size(queue_size),
+reads(max_contexts, 0), writes(max_contexts, 0), row_hits(max_contexts, 0), row_empty(max_contexts, 0), row_conflicts(max_contexts, 0),
+forwarded(max_contexts, 0), bytes(max_contexts, 0), read_latency(max_contexts, 0), queue_wait(max_contexts, 0),
+channel_state(channels), bank_slots(channels * ranks * banks)
+{}
+
+//the channel, bank (an index into bank_slots) and row of BADDR
+void dram_ctrl_t::decode(md_addr_t baddr, unsigned int *channel, unsigned int *bank, md_addr_t *row)
+{
+	md_addr_t rest = baddr / row_size;
+	*channel = rest & (channels - 1);
+	rest /= channels;
+	unsigned int b = rest & (banks - 1);
+	rest /= banks;
+	unsigned int r = rest & (ranks - 1);
+	*row = rest / ranks;
+	*bank = (*channel * ranks + r) * banks + b;
+}
+
+//returns the earliest time from FROM that the data bus of C is free for LEN cycles
+tick_t dram_ctrl_t::bus_free(channel_t & c, tick_t from, tick_t len)
+{
+	for(std::list<transfer_t>::iterator it = c.bus.begin(); it != c.bus.end(); it++)
+	{
+		if(it->end <= from)
+			continue;
+		if(it->start >= from + len)
+			break;
+		from = it->end;
+	}
+	return from;
+}
+
+//schedule an access of BSIZE bytes to ROW of BANK on CHANNEL, arriving at NOW, returns when its data transfer ends
+tick_t dram_ctrl_t::schedule(unsigned int channel, unsigned int bank, md_addr_t row, int bsize, tick_t now, row_result *result)
+{
+	channel_t & c = channel_state[channel];
+	std::list<slot_t> & slots = bank_slots[bank];
+	tick_t burst = ((bsize + width - 1) / width) * t_bus;
+
+	//forget what is long over, the last slot of a bank is kept for its open row
+	while((slots.size() > 1) && (slots.front().end + HISTORY < now))
+		slots.pop_front();
+	while(!c.bus.empty() && (c.bus.front().end + HISTORY < now))
+		c.bus.pop_front();
+
+	//try the gap before each slot of the bank in turn, then the end of the bank's schedule
+	std::list<slot_t>::iterator next = slots.begin();
+	const slot_t *prev = NULL;
+	while(true)
+	{
+		row_result r = (!prev || closed_page) ? ROW_EMPTY : ((prev->row == row) ? ROW_HIT : ROW_CONFLICT);
+		tick_t access = t_cas + burst + ((r != ROW_HIT) ? t_rcd : 0) + ((r == ROW_CONFLICT) ? t_rp : 0);
+		tick_t start = prev ? MAX(now, prev->end) : now;
+
+		//the data comes at the end of the access, when the bus is free for it, and column accesses are pipelined so the
+		//bank takes the next command t_cas before the data is done (a closed page is precharged after that)
+		tick_t data = bus_free(c, start + access - burst, burst);
+		start = data + burst - access;
+		tick_t end = data + burst - t_cas + (closed_page ? t_rp : 0);
+
+		//an access placed in a gap must fit, and leave the next access the row it expects (or one it closes anyway,
+		//as long as it is not the row that access opens, which would turn its conflict into a hit)
+		if((next == slots.end()) || ((end <= next->start) && (closed_page || (r == ROW_HIT) || ((next->result == ROW_CONFLICT) && (next->row != row)))))
+		{
+			slot_t s;
+			s.start = start;
+			s.end = end;
+			s.row = row;
+			s.result = r;
+			slots.insert(next, s);
+
+			transfer_t t;
+			t.start = data;
+			t.end = data + burst;
+			std::list<transfer_t>::iterator pos = c.bus.begin();
+			while((pos != c.bus.end()) && (pos->start <= data))
+				pos++;
+			c.bus.insert(pos, t);
+
+			*result = r;
+			return data + burst;
+		}
+		prev = &*next;
+		next++;
+	}
+}
+
+//count an access of BSIZE bytes for CONTEXT_ID that found RESULT
+void dram_ctrl_t::count(int context_id, int bsize, row_result result)
+{
+	bytes[context_id] += bsize;
+	switch(result)
+	{
+	case ROW_HIT:
+		row_hits[context_id]++;
+		break;
+	case ROW_EMPTY:
+		row_empty[context_id]++;
+		break;
+	case ROW_CONFLICT:
+		row_conflicts[context_id]++;
+		break;
+	}
+}
+
+//returns the latency of a read of the BSIZE byte block at BADDR for CONTEXT_ID arriving at NOW
+tick_t dram_ctrl_t::mem_access_latency(md_addr_t baddr, int bsize, tick_t now, int context_id)
+{
+	unsigned int channel, bank;
+	md_addr_t row;
+	decode(baddr, &channel, &bank, &row);
+	channel_t & c = channel_state[channel];
+	reads[context_id]++;
+
+	//the block is still in the write queue
+	for(unsigned int i=0;i<c.writes.size();i++)
+	{
+		if(c.writes[i].baddr == baddr)
+		{
+			forwarded[context_id]++;
+			bytes[context_id] += bsize;
+			tick_t lat = ((bsize + width - 1) / width) * t_bus;
+			read_latency[context_id] += lat;
+			return lat;
+		}
+	}
+
+	//take a read queue entry, waiting for the first read to finish if they are all in use
+	tick_t start = now;
+	for(unsigned int i=0;i<c.reads.size();)
+	{
+		if(c.reads[i] <= now)
+		{
+			c.reads[i] = c.reads.back();
+			c.reads.pop_back();
+		}
+		else
+		{
+			i++;
+		}
+	}
+	if(c.reads.size() >= queue_size)
+	{
+		std::vector<tick_t>::iterator first = std::min_element(c.reads.begin(), c.reads.end());
+		start = *first;
+		c.reads.erase(first);
+		queue_wait[context_id] += start - now;
+	}
+
+	row_result result;
+	tick_t done = schedule(channel, bank, row, bsize, start, &result);
+	c.reads.push_back(done);
+	count(context_id, bsize, result);
+	read_latency[context_id] += done - now;
+	return done - now;
+}
+
+//post a write of the BSIZE byte block at BADDR for CONTEXT_ID at NOW
+void dram_ctrl_t::mem_write(md_addr_t baddr, int bsize, tick_t now, int context_id)
+{
+	unsigned int channel, bank;
+	md_addr_t row;
+	decode(baddr, &channel, &bank, &row);
+	channel_t & c = channel_state[channel];
+
+	//a newer write of a queued block replaces it
+	for(unsigned int i=0;i<c.writes.size();i++)
+	{
+		if(c.writes[i].baddr == baddr)
+		{
+			c.writes[i].context_id = context_id;
+			return;
+		}
+	}
+
+	write_t w;
+	w.baddr = baddr;
+	w.bsize = bsize;
+	w.context_id = context_id;
+	w.bank = bank;
+	w.row = row;
+	c.writes.push_back(w);
+
+	if(c.writes.size() >= queue_size)
+		drain(channel, now);
+}
+
+//write the queued writes of CHANNEL to the banks at NOW, a bank at a time (oldest write first) with the writes to
+//its open row first and then the writes to each other row together
+void dram_ctrl_t::drain(unsigned int channel, tick_t now)
+{
+	std::vector<write_t> pending, rest;
+	pending.swap(channel_state[channel].writes);
+	while(!pending.empty())
+	{
+		unsigned int bank = pending[0].bank;
+		md_addr_t row = pending[0].row;
+		const std::list<slot_t> & slots = bank_slots[bank];
+		if(!closed_page && !slots.empty())
+		{
+			for(unsigned int i=0;i<pending.size();i++)
+			{
+				if((pending[i].bank == bank) && (pending[i].row == slots.back().row))
+				{
+					row = slots.back().row;
+					break;
+				}
+			}
+		}
+
+		rest.clear();
+		for(unsigned int i=0;i<pending.size();i++)
+		{
+			if((pending[i].bank == bank) && (pending[i].row == row))
+			{
+				row_result result;
+				schedule(channel, bank, row, pending[i].bsize, now, &result);
+				writes[pending[i].context_id]++;
+				count(pending[i].context_id, pending[i].bsize, result);
+			}
+			else
+			{
+				rest.push_back(pending[i]);
+			}
+		}
+		pending.swap(rest);
+	}
+}
+
+//resets the stats and the state of the banks after fast forwarding
+void dram_ctrl_t::reset()
+{
+	std::fill(reads.begin(), reads.end(), 0);
+	std::fill(writes.begin(), writes.end(), 0);
+	std::fill(row_hits.begin(), row_hits.end(), 0);
+	std::fill(row_empty.begin(), row_empty.end(), 0);
+	std::fill(row_conflicts.begin(), row_conflicts.end(), 0);
+	std::fill(forwarded.begin(), forwarded.end(), 0);
+	std::fill(bytes.begin(), bytes.end(), 0);
+	std::fill(read_latency.begin(), read_latency.end(), 0);
+	std::fill(queue_wait.begin(), queue_wait.end(), 0);
+
+	channel_state.assign(channels, channel_t());
+	bank_slots.assign(channels * ranks * banks, std::list<slot_t>());
+}
+
+//register the per-context stats
+void dram_ctrl_t::reg_stats(stat_sdb_t *sdb, int num_contexts)
+{
+	if(num_contexts > static_cast<int>(reads.size()))
+		fatal("banked DRAM supports at most %d contexts", static_cast<int>(reads.size()));
+
+	for(int i=0;i<num_contexts;i++)
+	{
+		char buf[16];
+		sprintf(buf, "_%d", i);
+		std::string id = buf;
+
+		stat_reg_counter(sdb, "dram.reads" + id, "reads served by DRAM", &reads[i], 0, NULL);
+		stat_reg_counter(sdb, "dram.writes" + id, "writes written to DRAM", &writes[i], 0, NULL);
+		stat_reg_counter(sdb, "dram.row_hits" + id, "DRAM accesses to the open row", &row_hits[i], 0, NULL);
+		stat_reg_counter(sdb, "dram.row_empty" + id, "DRAM accesses to a bank without an open row", &row_empty[i], 0, NULL);
+		stat_reg_counter(sdb, "dram.row_conflicts" + id, "DRAM accesses that closed another row", &row_conflicts[i], 0, NULL);
+		stat_reg_counter(sdb, "dram.forwarded" + id, "reads served from the write queue", &forwarded[i], 0, NULL);
+		stat_reg_counter(sdb, "dram.bytes" + id, "bytes transferred on the channels (reads, writes and forwarded reads)", &bytes[i], 0, NULL);
+		stat_reg_counter(sdb, "dram.read_latency" + id, "cumulative DRAM read latency", &read_latency[i], 0, NULL);
+		stat_reg_counter(sdb, "dram.queue_wait" + id, "cumulative cycles reads waited for a read queue entry", &queue_wait[i], 0, NULL);
+		stat_reg_formula(sdb, "dram.row_hit_rate" + id, "fraction of DRAM accesses to the open row",
+			"dram.row_hits" + id + " / (dram.row_hits" + id + " + dram.row_empty" + id + " + dram.row_conflicts" + id + ")", "%9.4f");
+		stat_reg_formula(sdb, "dram.bandwidth" + id, "DRAM bandwidth used (bytes per cycle)",
+			"dram.bytes" + id + " / sim_cycle", "%9.4f");
+		stat_reg_formula(sdb, "dram.avg_read_latency" + id, "average DRAM read latency",
+			"dram.read_latency" + id + " / dram.reads" + id, "%9.4f");
+	}
+}
+
+static bool is_power_of_two(int x)
+{
+	return (x > 0) && !(x & (x - 1));
+}
+
+//returns the controller described by CONFIG if it is a banked configuration, NULL otherwise
+dram_ctrl_t * dram_ctrl_parser(const char *config, int max_contexts)
+{
+	if(strncmp(config, "banked:", 7))
+		return NULL;
+
+	int width, channels, ranks, banks, row_size, t_rcd, t_cas, t_rp, t_bus, queue_size;
+	char page;
+	if(sscanf(config, "banked:%d:%d:%d:%d:%d:%c:%d:%d:%d:%d:%d", &width, &channels, &ranks, &banks, &row_size, &page,
+		&t_rcd, &t_cas, &t_rp, &t_bus, &queue_size) != 11)
+	{
+		fatal("bad banked DRAM config `%s': banked:<width>:<channels>:<ranks>:<banks>:<row>:<page>:<tRCD>:<tCAS>:<tRP>:<tBus>:<queue>",
+			config);
+	}
+	if(!is_power_of_two(width) || !is_power_of_two(channels) || !is_power_of_two(ranks) || !is_power_of_two(banks))
+		fatal("DRAM bus width, channels, ranks and banks must be powers of two");
+	if(!is_power_of_two(row_size) || (row_size < width))
+		fatal("DRAM row size `%d' must be a power of two of at least the bus width", row_size);
+	if((page != 'o') && (page != 'c'))
+		fatal("DRAM page policy `%c' must be 'o' (open) or 'c' (closed)", page);
+	if((t_rcd < 0) || (t_cas < 0) || (t_rp < 0) || (t_bus < 1))
+		fatal("DRAM timings must be positive");
+	if(queue_size < 1)
+		fatal("DRAM queues must have at least one entry");
+
+	return new dram_ctrl_t(config, width, channels, ranks, banks, row_size, page == 'c', t_rcd, t_cas, t_rp, t_bus, queue_size,
+		max_contexts);
+}
+
+#endif
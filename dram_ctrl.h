@@ -0,0 +1,203 @@
+// Banked DRAM Controller Prototypes
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ *
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ *
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ *
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ *
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ *
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ *
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ *
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ *
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ *
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#ifndef DRAM_CTRL_H
+#define DRAM_CTRL_H
+
+#include<cstdio>
+#include<string>
+#include<vector>
+#include<list>
+
+#include"host.h"
+#include"misc.h"
+#include"machine.h"
+#include"stats.h"
+
+//Banked DRAM controller, selected with -mem:config banked:... instead of the dram_t models
+//
+//Memory is split into channels, each with its own data bus, and each channel into ranks of banks. A bank has
+//a row buffer, an access to the open row (a row hit) only needs a column access, other accesses first
+//activate their row (and precharge the open one, a row conflict). With the closed page policy every access
+//activates its row and the bank precharges right after it.
+//
+//Addresses are interleaved row:rank:bank:channel:column, so the blocks of one row share a row buffer and
+//consecutive rows go to different channels and banks.
+//
+//Reads are scheduled when they arrive: each is given the earliest time its bank and its channel's data bus can
+//serve it without delaying the accesses already scheduled, so a row hit can be served in a gap ahead of older
+//row misses (FR-FCFS, as far as the latency of a request can be fixed when it arrives). Each channel holds
+//at most <queue> reads in flight, further reads wait for the first one to finish. Writes are posted to a
+//write queue of <queue> entries per channel, a full queue is drained to the banks with the writes grouped by
+//row (open row first), and reads of a block waiting there are served from the queue.
+//
+//All times are in processor cycles.
+class dram_ctrl_t
+{
+	public:
+		dram_ctrl_t(std::string config,		//configuration string, as given to dram_ctrl_parser
+			unsigned int width,		//data bus width of a channel in bytes
+			unsigned int channels,		//number of channels
+			unsigned int ranks,		//ranks per channel
+			unsigned int banks,		//banks per rank
+			unsigned int row_size,		//bytes per row
+			bool closed_page,		//precharge after every access?
+			tick_t t_rcd,			//activate to column access
+			tick_t t_cas,			//column access to data
+			tick_t t_rp,			//precharge
+			tick_t t_bus,			//cycles per data bus transfer of width bytes
+			unsigned int queue_size,	//read and write queue entries per channel
+			int max_contexts);		//largest number of contexts, sizes the stats
+
+		//returns the latency of a read of the BSIZE byte block at BADDR for CONTEXT_ID arriving at NOW
+		tick_t mem_access_latency(md_addr_t baddr, int bsize, tick_t now, int context_id);
+
+		//post a write of the BSIZE byte block at BADDR for CONTEXT_ID at NOW
+		void mem_write(md_addr_t baddr, int bsize, tick_t now, int context_id);
+
+		//resets the stats and the state of the banks after fast forwarding
+		void reset();
+
+		//register the per-context stats (dram.*_<context>)
+		void reg_stats(stat_sdb_t *sdb, int num_contexts);
+
+		//parameters
+		std::string config;
+		unsigned int width, channels, ranks, banks, row_size;
+		bool closed_page;
+		tick_t t_rcd, t_cas, t_rp, t_bus;
+		unsigned int queue_size;
+
+		//per-context statistics
+		std::vector<counter_t> reads;		//reads served
+		std::vector<counter_t> writes;		//writes written to the banks
+		std::vector<counter_t> row_hits;	//accesses to the open row
+		std::vector<counter_t> row_empty;	//accesses to a bank without an open row
+		std::vector<counter_t> row_conflicts;	//accesses that closed another row
+		std::vector<counter_t> forwarded;	//reads served from the write queue
+		std::vector<counter_t> bytes;		//bytes transferred, read or written
+		std::vector<counter_t> read_latency;	//cumulative read latency
+		std::vector<counter_t> queue_wait;	//cumulative cycles reads waited for a read queue entry
+
+	private:
+		//what an access found in its bank
+		enum row_result
+		{
+			ROW_HIT,
+			ROW_EMPTY,
+			ROW_CONFLICT
+		};
+
+		//a bank busy serving an access from start until it takes the next command at end, leaving row open (unless the page
+		//policy is closed)
+		class slot_t
+		{
+			public:
+				tick_t start, end;
+				md_addr_t row;
+				row_result result;
+		};
+
+		//a data bus transfer
+		class transfer_t
+		{
+			public:
+				tick_t start, end;
+		};
+
+		//a write waiting in a write queue
+		class write_t
+		{
+			public:
+				md_addr_t baddr;
+				int bsize;
+				int context_id;
+				unsigned int bank;
+				md_addr_t row;
+		};
+
+		class channel_t
+		{
+			public:
+				std::vector<tick_t> reads;		//end of each read in flight
+				std::vector<write_t> writes;		//write queue
+				std::list<transfer_t> bus;		//data bus transfers, in time order
+		};
+
+		//slots and transfers that ended this long before the latest access are forgotten
+		static const tick_t HISTORY = 4096;
+
+		//the channel, bank (an index into bank_slots) and row of BADDR
+		void decode(md_addr_t baddr, unsigned int *channel, unsigned int *bank, md_addr_t *row);
+
+		//schedule an access of BSIZE bytes to ROW of BANK on CHANNEL, arriving at NOW, returns when its data
+		//transfer ends and places what it found in the bank in *RESULT
+		tick_t schedule(unsigned int channel, unsigned int bank, md_addr_t row, int bsize, tick_t now, row_result *result);
+
+		//returns the earliest time from FROM that the data bus of CHANNEL is free for LEN cycles
+		tick_t bus_free(channel_t & c, tick_t from, tick_t len);
+
+		//write the queued writes of CHANNEL to the banks at NOW
+		void drain(unsigned int channel, tick_t now);
+
+		//count an access of BSIZE bytes for CONTEXT_ID that found RESULT
+		void count(int context_id, int bsize, row_result result);
+
+		std::vector<channel_t> channel_state;
+		std::vector<std::list<slot_t> > bank_slots;	//per bank, in time order
+};
+
+//returns the controller described by CONFIG if it is a banked configuration, NULL otherwise (a dram_t
+//model, see dram_parser), fatal if it is malformed. The format is
+//	banked:<width>:<channels>:<ranks>:<banks>:<row>:<page>:<tRCD>:<tCAS>:<tRP>:<tBus>:<queue>
+//with <page> 'o' (open) or 'c' (closed)
+dram_ctrl_t * dram_ctrl_parser(const char *config, int max_contexts);
+
+#endif
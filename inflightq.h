@@ -2,6 +2,7 @@
  * inflightq.h: Specifies the data structure used for the inflight queues
  *              - event_queue, ready_queue, waiting_queue and issue_exec_queue
  *              This is largely a wrapper for std::list
+ *              and the timing wheel the register file schedules wakeups on
  *
  * Author: Jason Loew <jloew@cs.binghamton.edu>, January 2009
  *
@@ -11,45 +12,103 @@
 #define INFLIGHTQ_H
 
 #include<list>
+#include<map>
+#include<vector>
+#include<algorithm>
 #include<functional>
 
+#include"host.h"
+
+/* Queues that are searched for an element (the waiting_queue) can keep a lookup index.
+   Specialize this for <T, Compare> to provide the identity elements are compared by (see operator==).
+*/
+template<typename T, typename Compare>
+class inflight_queue_lookup
+{
+	public:
+		static const bool indexed = false;
+		static const void * key(const T & element)
+		{
+			return NULL;
+		}
+};
+
 /* Defines a queue of type T which is sorted by the default "<" operator for type T (unless explicitly provided)
- *	//provides a queue of integers which is sorted in ascending order
- *	inflight_queue_t<int>				intq;
- *	//provides a queue of integers which is sorted using ">" (descending order)
- *	inflight_queue_t<int,std::greater<int> >	intq2;
+
+   Elements are kept in a std::list in sorted order, so users may walk and erase with list iterators.
+   Erased nodes are kept on a free list and reused by later inserts instead of going back to the heap.
+   Inserts search back from the tail, new elements (younger instructions, later events) normally belong there.
+
+   Queues with a lookup index (see inflight_queue_lookup) answer contains() and remove() without a walk.
 */
 template<typename T, typename Compare = std::less<T> >
 class inflight_queue_t
 {
 	public:
+		typedef typename std::list<T>::iterator iterator;
+		typedef inflight_queue_lookup<T, Compare> lookup_of;
+
 		inflight_queue_t()
 		{};
 
+		//the lookup index holds iterators into data, so copies are rebuilt element by element
+		inflight_queue_t(const inflight_queue_t & source)
+		{
+			append(source);
+		}
+
+		inflight_queue_t & operator=(const inflight_queue_t & source)
+		{
+			if(this != &source)
+			{
+				clear();
+				append(source);
+			}
+			return *this;
+		}
+
 		//Wrapper functions
 		inline unsigned int size()
 		{
 			return data.size();
 		}
 
-		inline typename std::list<T>::iterator begin()
+		inline iterator begin()
 		{
 			return data.begin();
 		}
 
-		inline typename std::list<T>::iterator end()
+		inline iterator end()
 		{
 			return data.end();
 		}
 
-		inline typename std::list<T>::iterator erase(const typename std::list<T>::iterator & it)
+		inline T & front()
 		{
-			return data.erase(it);
+			return data.front();
+		}
+
+		inline iterator erase(const iterator & it)
+		{
+			iterator next = it;
+			next++;
+			if(lookup_of::indexed)
+			{
+				unlookup(it);
+			}
+			free_nodes.splice(free_nodes.end(), data, it);
+			return next;
+		}
+
+		inline void pop_front()
+		{
+			erase(data.begin());
 		}
 
 		inline void clear()
 		{
-			return data.clear();
+			free_nodes.splice(free_nodes.end(), data);
+			lookup.clear();
 		}
 
 		inline bool empty()
@@ -57,28 +116,239 @@ class inflight_queue_t
 			return data.empty();
 		}
 
+		inline bool contains(const T & target)
+		{
+			if(lookup_of::indexed)
+			{
+				typedef typename std::multimap<const void *, iterator>::iterator lookup_iterator;
+				std::pair<lookup_iterator, lookup_iterator> range = lookup.equal_range(lookup_of::key(target));
+				for(lookup_iterator it = range.first; it != range.second; it++)
+				{
+					if(*(it->second) == target)
+					{
+						return true;
+					}
+				}
+				return false;
+			}
+			for(iterator it = data.begin(); it != data.end(); it++)
+			{
+				if(*it == target)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
 		inline void remove(const T & target)
 		{
-			return data.remove(target);
+			if(lookup_of::indexed)
+			{
+				typedef typename std::multimap<const void *, iterator>::iterator lookup_iterator;
+				std::pair<lookup_iterator, lookup_iterator> range = lookup.equal_range(lookup_of::key(target));
+				std::vector<iterator> found;
+				for(lookup_iterator it = range.first; it != range.second; it++)
+				{
+					if(*(it->second) == target)
+					{
+						found.push_back(it->second);
+					}
+				}
+				for(size_t i=0;i<found.size();i++)
+				{
+					erase(found[i]);
+				}
+				return;
+			}
+			for(iterator it = data.begin(); it != data.end();)
+			{
+				if(*it == target)
+				{
+					it = erase(it);
+				}
+				else
+				{
+					it++;
+				}
+			}
 		}
 
 		void inorderinsert(const T & toinsert)
 		{
-			typename std::list<T>::iterator it = data.begin();
-			while(it!=data.end())
+			iterator it = tail_position(toinsert);
+			if(free_nodes.empty())
+			{
+				it = data.insert(it, toinsert);
+			}
+			else
+			{
+				iterator node = free_nodes.begin();
+				*node = toinsert;
+				data.splice(it, free_nodes, node);
+				it = node;
+			}
+			if(lookup_of::indexed)
+			{
+				lookup.insert(std::make_pair(lookup_of::key(*it), it));
+			}
+		}
+
+	private:
+		void append(const inflight_queue_t & source)
+		{
+			for(typename std::list<T>::const_iterator it = source.data.begin(); it != source.data.end(); it++)
 			{
-				if(comp(toinsert,(*it)))
+				inorderinsert(*it);
+			}
+		}
+
+		//the insert position searching back from the tail, equal elements stay in insertion order
+		iterator tail_position(const T & toinsert)
+		{
+			iterator it = data.end();
+			while(it != data.begin())
+			{
+				iterator prev = it;
+				prev--;
+				if(!comp(toinsert, *prev))
 				{
 					break;
 				}
-				it++;
+				it = prev;
+			}
+			return it;
+		}
+
+		void unlookup(const iterator & it)
+		{
+			typedef typename std::multimap<const void *, iterator>::iterator lookup_iterator;
+			std::pair<lookup_iterator, lookup_iterator> range = lookup.equal_range(lookup_of::key(*it));
+			for(lookup_iterator l = range.first; l != range.second; l++)
+			{
+				if(l->second == it)
+				{
+					lookup.erase(l);
+					return;
+				}
 			}
-			data.insert(it,toinsert);
 		}
 
-	private:
 		std::list<T> data;
+		std::list<T> free_nodes;			//recycled list nodes
+		std::multimap<const void *, iterator> lookup;	//element identity to position, lookup queues only
 		Compare comp;
 };
 
+/* A calendar queue of elements of type T due at a cycle, drained one cycle at a time.
+
+   Each cycle of a window of WHEEL_SIZE cycles starting at the next cycle to drain has a bucket, an insert appends to
+   the bucket of its cycle (O(1)) and drain() takes whole buckets. Elements due beyond the window wait in an overflow
+   heap and move to their bucket as the window reaches them. Buckets keep their storage, so a queue in steady state
+   does not allocate. Elements due at the same cycle are drained in insertion order.
+*/
+template<typename T>
+class timing_wheel_t
+{
+	public:
+		timing_wheel_t()
+		: next(0), count(0), serial(0), wheel(WHEEL_SIZE)
+		{};
+
+		inline unsigned int size() const
+		{
+			return count;
+		}
+
+		inline bool empty() const
+		{
+			return !count;
+		}
+
+		//queues element at cycle when, elements due before the next cycle to drain are drained with it
+		void insert(tick_t when, const T & element)
+		{
+			if(when < next)
+			{
+				when = next;
+			}
+			if(when - next < WHEEL_SIZE)
+			{
+				//earlier inserts for the cycle may still be in the overflow
+				advance();
+				wheel[when & (WHEEL_SIZE - 1)].push_back(element);
+			}
+			else
+			{
+				overflow.push_back(overflow_t(when, serial++, element));
+				std::push_heap(overflow.begin(), overflow.end());
+			}
+			count++;
+		}
+
+		//appends every element due by cycle now to out, in time order
+		void drain(tick_t now, std::vector<T> & out)
+		{
+			while(count && (next <= now))
+			{
+				advance();
+				std::vector<T> & bucket = wheel[next & (WHEEL_SIZE - 1)];
+				out.insert(out.end(), bucket.begin(), bucket.end());
+				count -= bucket.size();
+				bucket.clear();
+				next++;
+			}
+			if(!count && (next <= now))
+			{
+				next = now + 1;
+			}
+		}
+
+		void clear()
+		{
+			for(size_t i=0;i<wheel.size();i++)
+			{
+				wheel[i].clear();
+			}
+			overflow.clear();
+			count = 0;
+		}
+
+	private:
+		static const tick_t WHEEL_SIZE = 1024;		//must be a power of two
+
+		//an element beyond the window, the heap yields the earliest cycle first (the oldest insert among equal cycles)
+		class overflow_t
+		{
+			public:
+				overflow_t(tick_t when, unsigned long long serial, const T & element)
+				: when(when), serial(serial), element(element)
+				{}
+				inline bool operator<(const overflow_t & rhs) const
+				{
+					return (when > rhs.when) || ((when == rhs.when) && (serial > rhs.serial));
+				}
+				tick_t when;
+				unsigned long long serial;
+				T element;
+		};
+
+		//moves the overflow elements the window reached to their buckets
+		void advance()
+		{
+			while(!overflow.empty() && (overflow.front().when - next < WHEEL_SIZE))
+			{
+				wheel[overflow.front().when & (WHEEL_SIZE - 1)].push_back(overflow.front().element);
+				std::pop_heap(overflow.begin(), overflow.end());
+				overflow.pop_back();
+			}
+		}
+
+		tick_t next;					//next cycle to drain, the window is [next, next + WHEEL_SIZE)
+		unsigned int count;				//elements queued
+		unsigned long long serial;			//insert order of overflow elements
+		std::vector<std::vector<T> > wheel;		//one bucket per cycle of the window
+		std::vector<overflow_t> overflow;		//heap of the elements beyond the window
+};
+
 #endif
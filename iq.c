@@ -55,13 +55,18 @@
 #include"iq.h"
 #include<cassert>
 
+#define FREE_MAP_BITS	64
+
 issue_queue_t::issue_queue_t(unsigned int size)
-: used(size)
-{};
+: used(size), num_used(0)
+{
+	clear();
+};
 
 void issue_queue_t::resize(int size)
 {
 	used.resize(size);
+	clear();
 }
 
 unsigned int issue_queue_t::size()
@@ -72,27 +77,49 @@ unsigned int issue_queue_t::size()
 void issue_queue_t::clear()
 {
 	used.assign(used.size(),IQ_ENTRY_FREE);
+	owner.assign(used.size(),-1);
+	free_map.assign((used.size() + FREE_MAP_BITS - 1) / FREE_MAP_BITS, ~0ULL);
+	if(used.size() % FREE_MAP_BITS)
+	{
+		//entries past the end are never free
+		free_map.back() = (1ULL << (used.size() % FREE_MAP_BITS)) - 1;
+	}
+	num_used = 0;
+	thread_used.assign(thread_used.size(),0);
 }
 
 void issue_queue_t::free_iq_entry(const unsigned int entry_num)
 {
 	assert(used[entry_num]==IQ_ENTRY_ALLOC);
 	used[entry_num] = IQ_ENTRY_FREE;
+	free_map[entry_num / FREE_MAP_BITS] |= 1ULL << (entry_num % FREE_MAP_BITS);
+	num_used--;
+	if(owner[entry_num] >= 0)
+	{
+		assert(thread_used[owner[entry_num]] > 0);
+		thread_used[owner[entry_num]]--;
+		owner[entry_num] = -1;
+	}
 }
 
 int issue_queue_t::find_iq_entry()
 {
-	for(int i=0;i<static_cast<int>(used.size());i++)
+	if(num_used == used.size())
 	{
-		if(used[i]==IQ_ENTRY_FREE)
+		return -1;
+	}
+	for(unsigned int i=0;i<free_map.size();i++)
+	{
+		if(free_map[i])
 		{
-			return i;
+			return (i * FREE_MAP_BITS) + __builtin_ctzll(free_map[i]);
 		}
 	}
+	assert(0);
 	return -1;
 }
 
-int issue_queue_t::alloc_iq_entry()
+int issue_queue_t::alloc_iq_entry(int context_id)
 {
 	int i = find_iq_entry();
 	if(i==-1)
@@ -101,6 +128,17 @@ int issue_queue_t::alloc_iq_entry()
 	}
 	assert(used[i]==IQ_ENTRY_FREE);
 	used[i]=IQ_ENTRY_ALLOC;
+	free_map[i / FREE_MAP_BITS] &= ~(1ULL << (i % FREE_MAP_BITS));
+	num_used++;
+	owner[i] = context_id;
+	if(context_id >= 0)
+	{
+		if(context_id >= static_cast<int>(thread_used.size()))
+		{
+			thread_used.resize(context_id + 1, 0);
+		}
+		thread_used[context_id]++;
+	}
 	return i;
 }
 
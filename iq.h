@@ -55,6 +55,7 @@
 #define IQ_ENTRY_FREE 0
 #define IQ_ENTRY_ALLOC 1
 
+//Free entries are tracked in a word-packed bitmap, allocation takes the lowest free entry
 class issue_queue_t
 {
 	public:
@@ -65,7 +66,25 @@ class issue_queue_t
 		void clear();
 		void free_iq_entry(const unsigned int entry_num);
 		int find_iq_entry();
-		int alloc_iq_entry();
+
+		//allocates the lowest free entry for context_id, returns -1 if the IQ is full
+		int alloc_iq_entry(int context_id = -1);
+
+		//number of allocated entries
+		inline unsigned int occupancy() const
+		{
+			return num_used;
+		}
+
+		//number of entries allocated to context_id
+		inline unsigned int occupancy(int context_id) const
+		{
+			if(context_id < 0 || context_id >= static_cast<int>(thread_used.size()))
+			{
+				return 0;
+			}
+			return thread_used[context_id];
+		}
 
 		inline int & operator[](const unsigned int & index)
 		{
@@ -78,6 +97,12 @@ class issue_queue_t
 		}
 
 		std::vector<int> used;
+
+	private:
+		std::vector<unsigned long long> free_map;	//one bit per entry, set when the entry is free
+		std::vector<int> owner;				//context each entry is allocated to (-1 if unknown)
+		unsigned int num_used;				//number of allocated entries
+		std::vector<unsigned int> thread_used;		//number of allocated entries per context
 };
 
 
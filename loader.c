@@ -353,8 +353,8 @@ int loader_t::ld_load_prog(std::string fname,			//program to load
 		argv.insert(argv.begin(),"../sysfiles/alpha-sys-root/sbin/loader");
 
 		//Indicate that this executable is in the loader and can be fast-forwarded to the entry point
-		contexts[regs->context_id].entry_point = MD_SWAPQ(ahdr.entry);
-		contexts[regs->context_id].interrupts |= 0x1;
+		sim_contexts()[regs->context_id].entry_point = MD_SWAPQ(ahdr.entry);
+		sim_contexts()[regs->context_id].interrupts |= 0x1;
 
 		return ld_load_prog("../sysfiles/alpha-sys-root/sbin/loader",argv,envp,regs,mem,zero_bss_segs);
 	}
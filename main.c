@@ -58,6 +58,7 @@
 #include<unistd.h>
 #include<sys/time.h>
 #endif
+#include<pthread.h>
 #ifdef BFD_LOADER
 #include <bfd.h>
 #endif /* BFD_LOADER */
@@ -75,6 +76,7 @@
 #include "regs.h"
 /************** SMT ***************/
 #include "smt.h"
+#include "sim-outorder.h"
 /**********************************/
 #include "bpreds.h"
 
@@ -82,6 +84,9 @@
 #include<string>
 #include<iostream>
 #include<fstream>
+#include<sstream>
+#include<algorithm>
+#include<deque>
 
 //stats signal handler
 void signal_sim_stats(int sigtype)
@@ -102,10 +107,13 @@ void signal_exit_now(int sigtype)
 unsigned int sim_mem_usage = 0;
 #endif
 
+//The state of the command line below (execution times, options and stats databases, redirections, ...) is per
+//thread, each batch job has its own (see batch_main())
+
 //execution start/end times
-time_t sim_start_time;
-time_t sim_end_time;
-int sim_elapsed_time;
+__thread time_t sim_start_time;
+__thread time_t sim_end_time;
+__thread int sim_elapsed_time;
 
 //byte/word swapping required to execute target executable on this host
 int sim_swap_bytes;
@@ -118,39 +126,42 @@ int sim_exit_now = FALSE;
 int sim_dump_stats = FALSE;
 
 //options database
-opt_odb_t *sim_odb;
+__thread opt_odb_t *sim_odb;
 
 //stats database
-stat_sdb_t *sim_sdb;
+__thread stat_sdb_t *sim_sdb;
 
 //redirected program/simulator output file names
-char *sim_simout = NULL;
-char *sim_progout = NULL;
-char *sim_progerr = NULL;
+__thread char *sim_simout = NULL;
+__thread char *sim_progout = NULL;
+__thread char *sim_progerr = NULL;
 
 //Redirected file handles
-md_gpr_t sim_progfd = 0;
-md_gpr_t sim_progerrfd = 0;
+__thread md_gpr_t sim_progfd = 0;
+__thread md_gpr_t sim_progerrfd = 0;
+
+//simulator output of a batch job (its -redir:sim file), NULL when stderr is the simulator output
+static __thread FILE *batch_simout = NULL;
 
 //Used to convert command line arguments into vector format
-std::vector<std::string> * v_argv = NULL;
-std::vector<std::string> * v_envp = NULL;
+__thread std::vector<std::string> * v_argv = NULL;
+__thread std::vector<std::string> * v_envp = NULL;
 
 //track first argument orphan, this is the program to execute
-int exec_index = -1;
+__thread int exec_index = -1;
 
 //dump help information
-int help_me;
+__thread int help_me;
 
 //random number generator seed
-int rand_seed;
+__thread int rand_seed;
 
 //initialize and quit immediately
-int init_quit;
+__thread int init_quit;
 
 #ifndef _MSC_VER
 //simulator scheduling priority
-int nice_priority;
+__thread int nice_priority;
 #endif
 
 //default simulator scheduling priority
@@ -179,10 +190,21 @@ void banner(FILE *fd, int argc, char **argv)
 void usage(FILE *fd, int argc, char **argv)
 {
 	fprintf(fd, "Usage: %s {-options} executable {arguments}\n", argv[0]);
+	fprintf(fd, "       %s -batch <manifest> {-batch:jobs <n>}\n", argv[0]);
 	opt_print_help(sim_odb, fd);
 }
 
-int running = FALSE;
+__thread int running = FALSE;
+
+//formula stats are evaluated with the process-wide error state of the expression evaluator (eval.c),
+//so batch jobs print their stats one at a time
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+//the simulator output stream
+static FILE * sim_outfd()
+{
+	return batch_simout ? batch_simout : stderr;
+}
 
 //print all simulator stats to output stream fd
 void sim_print_stats(FILE *fd)
@@ -208,24 +230,41 @@ void sim_print_stats(FILE *fd)
 #endif
 
 	//print simulation stats
-	fprintf(fd, "\nsim: ** simulation statistics **\n");
-	stat_print_stats(sim_sdb, fd);
-	sim_aux_stats(fd);
-	fprintf(fd, "\n");
+	pthread_mutex_lock(&stats_lock);
+	try
+	{
+		fprintf(fd, "\nsim: ** simulation statistics **\n");
+		stat_print_stats(sim_sdb, fd);
+		sim_aux_stats(fd);
+		fprintf(fd, "\n");
+	}
+	catch(fatal_error_t &)
+	{
+		pthread_mutex_unlock(&stats_lock);
+		throw;
+	}
+	pthread_mutex_unlock(&stats_lock);
 }
 
-//print stats, uninitialize simulator components, and exit w/ exitcode
-void exit_now(int exit_code)
+//print stats and SMT statistics, uninitialize simulator components
+static void sim_end()
 {
-	//print simulation stats and SMT statistics
-	sim_print_stats(stderr);
-	smt_print_stats();
+	sim_print_stats(sim_outfd());
+	smt_print_stats(sim_outfd());
 
 	//un-initialize the simulator
 	sim_uninit();
+}
 
-	//Various cleanup
-	if(sim_simout != NULL)
+//close the redirected output and free the command line
+static void sim_cleanup()
+{
+	if(batch_simout != NULL)
+	{
+		fclose(batch_simout);
+		batch_simout = NULL;
+	}
+	else if(sim_simout != NULL)
 	{
 		fclose(stderr);
 	}
@@ -241,11 +280,42 @@ void exit_now(int exit_code)
 	delete v_envp;
 	delete sim_odb;
 	delete sim_sdb;
+	v_argv = v_envp = NULL;
+	sim_odb = NULL;
+	sim_sdb = NULL;
+}
+
+//print stats, uninitialize simulator components, and exit w/ exitcode
+void exit_now(int exit_code)
+{
+	sim_end();
+	sim_cleanup();
 
 	//all done!
 	exit(exit_code);
 }
 
+//end a simulation that ran: exit, or return 0 to the batch job (batch_run_job() cleans up once it has the stats)
+static int sim_done()
+{
+	if(!current_sim->batch_job)
+	{
+		exit_now(0);
+	}
+	sim_end();
+	return 0;
+}
+
+//end a simulation on an error that has been reported: exit w/ exitcode, a batch job fails as on fatal()
+static void sim_abort(int exit_code)
+{
+	if(current_sim->batch_job)
+	{
+		throw fatal_error_t();
+	}
+	exit(exit_code);
+}
+
 /*
  * Initalizes a thread context. This includes loading the binary into memory,
  * parsing command line options from the argument file, and setting up infile
@@ -261,6 +331,7 @@ void exit_now(int exit_code)
  */
 void init_thread(std::vector<std::string> env, std::string filename, int curcontext)
 {
+	std::vector<context> & contexts = sim_contexts();
 	char buffer[256];
 
 	// open the file containing the command line arguments for this thread
@@ -270,7 +341,7 @@ void init_thread(std::vector<std::string> env, std::string filename, int curcont
 	if(argfile == NULL)
 	{
 		std::cerr << "ERROR: cannot open argument file: " << filename << std::endl;
-		exit(-1);
+		sim_abort(-1);
 	}
 
 	// Anything before the first # is the fastfwd distance.
@@ -321,7 +392,7 @@ void init_thread(std::vector<std::string> env, std::string filename, int curcont
 			if(temp == (md_gpr_t)-1)
 			{
 				std::cerr << " - failed: couldn't open for reading" << std::endl;
-				exit(1);
+				sim_abort(1);
 			}
 			std::cerr << " fd: " << temp << std::endl;
 			gather = FALSE;
@@ -338,7 +409,7 @@ void init_thread(std::vector<std::string> env, std::string filename, int curcont
 			if(temp == (md_gpr_t)-1)
 			{
 				std::cerr << " - failed: couldn't open for reading" << std::endl;
-				exit(1);
+				sim_abort(1);
 			}
 			std::cerr << " fd: " << temp << std::endl;
 			gather = FALSE;
@@ -355,7 +426,7 @@ void init_thread(std::vector<std::string> env, std::string filename, int curcont
 			if(temp == (md_gpr_t)-1)
 			{
 				std::cerr << " - failed: couldn't open for reading" << std::endl;
-				exit(1);
+				sim_abort(1);
 			}
 			std::cerr << " fd: " << temp << std::endl;
 		}
@@ -366,8 +437,14 @@ void init_thread(std::vector<std::string> env, std::string filename, int curcont
 	}
 }
 
-int main(int argc, char **argv, char **envptemp)
+//runs one simulation with the given command line, on the calling thread's simulator (current_sim).
+//A batch job returns its exit code, other runs exit.
+int sim_run(int argc, char **argv, char **envptemp)
 {
+	bool batch_job = current_sim->batch_job;
+	std::vector<context> & contexts = sim_contexts();
+	int & contexts_at_init_time = sim_contexts_at_init_time();
+	unsigned int & cores_at_init_time = sim_cores_at_init_time();
 	//std::vector<std::string> envp;
 	v_envp = new std::vector<std::string>;
 	std::vector<std::string> & envp = *v_envp;
@@ -427,16 +504,20 @@ int main(int argc, char **argv, char **envptemp)
 //	This may be ok, but this is a potential source of the uninitialized register value problem
 //	contexts.resize(contexts_at_init_time);
 
+	//signals and the error handler are the process's, batch jobs leave them to batch_main()
+	if(!batch_job)
+	{
 #ifndef _MSC_VER
-	//catch SIGUSR1 and dump intermediate stats
-	signal(SIGUSR1, signal_sim_stats);
+		//catch SIGUSR1 and dump intermediate stats
+		signal(SIGUSR1, signal_sim_stats);
 
-	//catch SIGUSR2 and dump final stats and exit
-	signal(SIGUSR2, signal_exit_now);
+		//catch SIGUSR2 and dump final stats and exit
+		signal(SIGUSR2, signal_exit_now);
 #endif
 
-	//register an error handler
-	fatal_hook(sim_print_stats);
+		//register an error handler
+		fatal_hook(sim_print_stats);
+	}
 
 	//register global options
 	sim_odb = new opt_odb_t(orphan_fn);
@@ -486,8 +567,16 @@ int main(int argc, char **argv, char **envptemp)
 	exec_index = -1;
 	opt_process_options(sim_odb, *v_argv);
 
-	//redirect I/O?
-	if(sim_simout != NULL)
+	//redirect I/O? (stderr is shared by the batch jobs, each writes its own file instead)
+	if(batch_job && (sim_simout != NULL))
+	{
+		batch_simout = fopen(sim_simout, "w");
+		if(!batch_simout)
+		{
+			fatal("unable to redirect simulator output to file `%s'", sim_simout);
+		}
+	}
+	else if(sim_simout != NULL)
 	{
 		//send simulator non-interactive output (STDERR) to file SIM_SIMOUT
 		fflush(stderr);
@@ -520,19 +609,19 @@ int main(int argc, char **argv, char **envptemp)
 	//need at least two argv values to run
 	if(argc < 2)
 	{
-		banner(stderr, argc, argv);
-		usage(stderr, argc, argv);
-		exit(1);
+		banner(sim_outfd(), argc, argv);
+		usage(sim_outfd(), argc, argv);
+		sim_abort(1);
 	}
 
 	//opening banner
-	banner(stderr, argc, argv);
+	banner(sim_outfd(), argc, argv);
 
 	if(help_me)
 	{
 		//print help message and exit
-		usage(stderr, argc, argv);
-		exit(1);
+		usage(sim_outfd(), argc, argv);
+		sim_abort(1);
 	}
 
 	//seed the random number generator
@@ -552,32 +641,36 @@ int main(int argc, char **argv, char **envptemp)
 	{
 		//executable was not found
 		std::cerr << "error: no executable specified" << std::endl;
-		usage(stderr, argc, argv);
-		exit(1);
+		usage(sim_outfd(), argc, argv);
+		sim_abort(1);
 	}
 	//else, exec_index points to simulated program arguments
 
 	//check simulator-specific options
 	sim_check_options();
 
-#ifndef _MSC_VER
-	//set simulator scheduling priority
-	if(nice(0) < nice_priority)
+	//the scheduling priority and the decoder are the process's, batch_main() sets them up once for the batch jobs
+	if(!batch_job)
 	{
-		if(nice(nice_priority - nice(0)) < 0)
+#ifndef _MSC_VER
+		//set simulator scheduling priority
+		if(nice(0) < nice_priority)
 		{
-			fatal("could not renice simulator process");
+			if(nice(nice_priority - nice(0)) < 0)
+			{
+				fatal("could not renice simulator process");
+			}
 		}
-	}
 #endif
 
 #ifdef BFD_LOADER
-	//initialize the bfd library
-	bfd_init();
+		//initialize the bfd library
+		bfd_init();
 #endif // BFD_LOADER
 
-	//initialize the instruction decoder
-	md_init_decoder();
+		//initialize the instruction decoder
+		md_init_decoder();
+	}
 
 	//initialize all simulation modules
 	sim_init();
@@ -585,7 +678,7 @@ int main(int argc, char **argv, char **envptemp)
 	/******************* SMT ********************/
 	//Support added to load multiple binaries
 	//initalize the number of contexts to zero
-	num_contexts = 0;
+	sim_num_contexts() = 0;
 
 	for(int i=0; (i<contexts_at_init_time && (i + exec_index) < argc);i++)
 	{
@@ -621,35 +714,348 @@ int main(int argc, char **argv, char **envptemp)
 	sim_start_time = time((time_t *)NULL);
 
 	//emit the command line for later reuse
-	std::cerr << "sim: command line: ";
+	fprintf(sim_outfd(), "sim: command line: ");
 	for(int i=0; i < argc; i++)
 	{
-		std::cerr << argv[i] << " ";
+		fprintf(sim_outfd(), "%s ", argv[i]);
 	}
-	std::cerr << std::endl;
+	fprintf(sim_outfd(), "\n");
 
 	//output simulation conditions
-	std::string *s = new std::string(ctime(&sim_start_time));
-	s->erase(s->end()-1);	//Last character is always \n, so we delete it.
-	std::cerr << "\nsim: simulation started @ " << *s << ", options follow:" << std::endl;
-	delete s;
-	opt_print_options(sim_odb, stderr, /* short */TRUE, /* notes */TRUE);
-	sim_aux_config(stderr);
-	std::cerr << std::endl;
+	char started[26];
+	std::string s(ctime_r(&sim_start_time, started));
+	s.erase(s.end()-1);	//Last character is always \n, so we delete it.
+	fprintf(sim_outfd(), "\nsim: simulation started @ %s, options follow:\n", s.c_str());
+	opt_print_options(sim_odb, sim_outfd(), /* short */TRUE, /* notes */TRUE);
+	sim_aux_config(sim_outfd());
+	fprintf(sim_outfd(), "\n");
 
 	//omit option dump time from rate stats
 	sim_start_time = time((time_t *)NULL);
 
 	if(init_quit)
 	{
-		exit_now(0);
+		return sim_done();
 	}
 
 	running = TRUE;
 	sim_main();
 
 	//simulation finished early
-	exit_now(0);
+	return sim_done();
+}
 
-	return 0;
+/*
+ * Batch mode: runs every job of a manifest, up to -batch:jobs at a time (default: one per host CPU).
+ * Each line of the manifest is one job, the options and .arg files of a normal command line, e.g.
+ *
+ *     -config base.cfg -max:inst 100000000 mix0/gcc.arg mix0/mcf.arg
+ *
+ * Blank lines and lines starting with # are skipped. The jobs run in this process on a pool of -batch:jobs threads.
+ * Each job has its own simulator_t (contexts, cores, loader, emulated OS state, random number generator, ...) and
+ * its own options and stats databases, so jobs share no simulated state. The jobs are dealt round robin onto one
+ * queue per thread; a thread runs its own queue from the front and, once it is empty, steals jobs from the back
+ * of the other queues.
+ * A job's simulator output (and stats) goes to <manifest>.<job> unless the line gives its own -redir:sim.
+ * Messages the simulator writes straight to stderr (warnings, fatal errors, context loading, ...) are not
+ * separated per job. A job that fails (fatal()) ends on its own, the others go on.
+ * Within a batch job -sim:threads is 1, -nice is ignored, and -ptrace and -sim:fanout are errors. The host's
+ * working directory, umask and resource limits are the process's, so jobs whose programs change them affect
+ * the others.
+ * One record per job is written to stdout: exit status, wall time, sim_num_insn, sim_cycle, IPC and sim_inst_rate.
+ */
+
+//a job of a batch
+class batch_job_t
+{
+	public:
+		batch_job_t()
+		: exit_code(0), elapsed(0), sim_num_insn(0), sim_cycle(0), sim_inst_rate(0.0)
+		{}
+
+		std::string line;			//manifest line
+		std::vector<std::string> args;		//command line
+
+		//outcome
+		int exit_code;
+		time_t elapsed;
+		counter_t sim_num_insn;
+		tick_t sim_cycle;
+		double sim_inst_rate;
+};
+
+//runs job on a new simulator on the calling thread
+static void batch_run_job(batch_job_t & job, char **envptemp)
+{
+	std::vector<char *> job_argv;
+	for(size_t i=0;i<job.args.size();i++)
+	{
+		job_argv.push_back(const_cast<char *>(job.args[i].c_str()));
+	}
+	job_argv.push_back(NULL);
+
+	time_t started = time((time_t *)NULL);
+	current_sim = new simulator_t;
+	current_sim->batch_job = true;
+	sim_cycle = 0;
+	running = FALSE;
+	sim_progfd = sim_progerrfd = 0;
+	try
+	{
+		job.exit_code = sim_run(job_argv.size() - 1, &job_argv[0], envptemp);
+		job.sim_num_insn = current_sim->sim_num_insn;
+		job.sim_cycle = sim_cycle;
+		job.sim_inst_rate = current_sim->sim_num_insn / static_cast<double>(MAX(sim_elapsed_time, 1));
+	}
+	catch(fatal_error_t &)
+	{
+		//what the fatal hook does for a single run, unless printing the stats was what failed
+		job.exit_code = 1;
+		try
+		{
+			sim_print_stats(sim_outfd());
+		}
+		catch(fatal_error_t &)
+		{
+		}
+	}
+	sim_cleanup();
+	delete current_sim;
+	current_sim = &simulator;
+	job.elapsed = time((time_t *)NULL) - started;
+}
+
+//the threads running the jobs of a batch, see batch_main()
+class batch_pool_t
+{
+	public:
+		batch_pool_t(std::vector<batch_job_t> & jobs, unsigned int threads, char **envptemp);
+		~batch_pool_t();
+
+		//runs every job, returns once they have all finished
+		void run();
+
+		//jobs that did not exit with 0
+		size_t failed;
+
+	private:
+		static void * worker_main(void * arg);
+
+		//takes the next job for thread worker, false if none are left
+		bool take(unsigned int worker, size_t & job);
+
+		//writes the record of a finished job to stdout
+		void report(size_t job);
+
+		std::vector<batch_job_t> & jobs;
+		char **envptemp;
+		unsigned int threads;
+
+		std::vector<std::deque<size_t> > queues;	//jobs (indices) of each thread
+		std::vector<pthread_mutex_t> queue_locks;
+		pthread_mutex_t lock;				//guards next_worker, failed and stdout
+		unsigned int next_worker;			//index the next thread started takes
+};
+
+batch_pool_t::batch_pool_t(std::vector<batch_job_t> & jobs, unsigned int threads, char **envptemp)
+: failed(0), jobs(jobs), envptemp(envptemp), threads(threads), queues(threads), queue_locks(threads), next_worker(0)
+{
+	for(size_t i=0;i<jobs.size();i++)
+	{
+		queues[i % threads].push_back(i);
+	}
+	for(unsigned int i=0;i<threads;i++)
+	{
+		pthread_mutex_init(&queue_locks[i], NULL);
+	}
+	pthread_mutex_init(&lock, NULL);
+}
+
+batch_pool_t::~batch_pool_t()
+{
+	for(unsigned int i=0;i<threads;i++)
+	{
+		pthread_mutex_destroy(&queue_locks[i]);
+	}
+	pthread_mutex_destroy(&lock);
+}
+
+void batch_pool_t::run()
+{
+	std::vector<pthread_t> workers;
+	for(unsigned int i=0;i<threads;i++)
+	{
+		pthread_t worker;
+		if(pthread_create(&worker, NULL, worker_main, this))
+		{
+			fatal("batch: could not create job thread %d", i);
+		}
+		workers.push_back(worker);
+	}
+	for(size_t i=0;i<workers.size();i++)
+	{
+		pthread_join(workers[i], NULL);
+	}
+}
+
+void * batch_pool_t::worker_main(void * arg)
+{
+	batch_pool_t * pool = static_cast<batch_pool_t *>(arg);
+	pthread_mutex_lock(&pool->lock);
+	unsigned int worker = pool->next_worker++;
+	pthread_mutex_unlock(&pool->lock);
+
+	//a fatal error ends the job, not the batch
+	fatal_throw(true);
+	size_t job;
+	while(pool->take(worker, job))
+	{
+		batch_run_job(pool->jobs[job], pool->envptemp);
+		pool->report(job);
+	}
+	return NULL;
+}
+
+bool batch_pool_t::take(unsigned int worker, size_t & job)
+{
+	//own queue, oldest first
+	pthread_mutex_lock(&queue_locks[worker]);
+	if(!queues[worker].empty())
+	{
+		job = queues[worker].front();
+		queues[worker].pop_front();
+		pthread_mutex_unlock(&queue_locks[worker]);
+		return true;
+	}
+	pthread_mutex_unlock(&queue_locks[worker]);
+
+	//steal from the back of the others, no jobs are added once the pool runs so empty queues stay empty
+	for(unsigned int i=1;i<threads;i++)
+	{
+		unsigned int victim = (worker + i) % threads;
+		pthread_mutex_lock(&queue_locks[victim]);
+		if(!queues[victim].empty())
+		{
+			job = queues[victim].back();
+			queues[victim].pop_back();
+			pthread_mutex_unlock(&queue_locks[victim]);
+			return true;
+		}
+		pthread_mutex_unlock(&queue_locks[victim]);
+	}
+	return false;
+}
+
+void batch_pool_t::report(size_t job)
+{
+	const batch_job_t & done = jobs[job];
+	pthread_mutex_lock(&lock);
+	if(done.exit_code)
+	{
+		failed++;
+	}
+	std::cout << "batch: job " << job << " exit " << done.exit_code << " time " << done.elapsed << "s";
+	if(!done.exit_code)
+	{
+		std::cout << " sim_num_insn " << done.sim_num_insn << " sim_cycle " << done.sim_cycle
+			<< " IPC " << (done.sim_cycle ? done.sim_num_insn / static_cast<double>(done.sim_cycle) : 0.0)
+			<< " sim_inst_rate " << static_cast<long long>(done.sim_inst_rate);
+	}
+	std::cout << ": " << done.line << std::endl;
+	pthread_mutex_unlock(&lock);
+}
+
+int batch_main(int argc, char **argv, char **envptemp)
+{
+	std::string manifest;
+	long jobs_at_once = 0;
+	for(int i=1;i<argc;i++)
+	{
+		std::string arg(argv[i]);
+		if((arg == "-batch") && (i+1 < argc))
+		{
+			manifest = argv[++i];
+		}
+		else if((arg == "-batch:jobs") && (i+1 < argc))
+		{
+			jobs_at_once = atol(argv[++i]);
+		}
+		else
+		{
+			std::cerr << "batch: unknown argument " << arg << ", options belong in the manifest" << std::endl;
+			exit(1);
+		}
+	}
+	if(jobs_at_once <= 0)
+	{
+		jobs_at_once = MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+	}
+
+	std::ifstream infile(manifest.c_str());
+	if(!infile)
+	{
+		std::cerr << "batch: cannot open manifest: " << manifest << std::endl;
+		exit(1);
+	}
+	std::vector<batch_job_t> jobs;
+	std::string line;
+	while(std::getline(infile, line))
+	{
+		std::istringstream tokens(line);
+		std::vector<std::string> args;
+		std::string token;
+		while(tokens >> token)
+		{
+			args.push_back(token);
+		}
+		if(args.empty() || (args[0][0] == '#'))
+		{
+			continue;
+		}
+		if(std::find(args.begin(), args.end(), std::string("-redir:sim")) == args.end())
+		{
+			std::ostringstream out;
+			out << manifest << "." << jobs.size();
+			args.insert(args.begin(), out.str());
+			args.insert(args.begin(), "-redir:sim");
+		}
+		args.insert(args.begin(), argv[0]);
+		jobs.push_back(batch_job_t());
+		jobs.back().line = line;
+		jobs.back().args = args;
+	}
+	if(jobs.empty())
+	{
+		std::cout << "batch: no jobs in " << manifest << std::endl;
+		return 0;
+	}
+	unsigned int threads = MIN(static_cast<size_t>(jobs_at_once), jobs.size());
+	std::cout << "batch: " << jobs.size() << " jobs from " << manifest << ", " << threads << " at a time" << std::endl;
+
+	//process-wide setup the jobs would otherwise each do (see sim_run())
+#ifdef BFD_LOADER
+	bfd_init();
+#endif // BFD_LOADER
+	md_init_decoder();
+
+	batch_pool_t pool(jobs, threads, envptemp);
+	pool.run();
+	std::cout << "batch: " << (jobs.size() - pool.failed) << " of " << jobs.size() << " jobs succeeded" << std::endl;
+	return pool.failed ? 1 : 0;
+}
+
+int main(int argc, char **argv, char **envptemp)
+{
+	//each simulation draws random numbers and places its mappings on its own
+	myrand_hook(sim_rand_state);
+	mem_mmap_base_hook(sim_mmap_base);
+
+	for(int i=1;i<argc;i++)
+	{
+		if(std::string(argv[i]) == "-batch")
+		{
+			return batch_main(argc, argv, envptemp);
+		}
+	}
+	return sim_run(argc, argv, envptemp);
 }
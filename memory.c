@@ -59,32 +59,131 @@
 #include "stats.h"
 #include "memory.h"
 #include<sys/mman.h>
+#include<sys/stat.h>
+#include<fcntl.h>
 #include <unistd.h>
+#include<cassert>
+#include<cstring>
+#include<algorithm>
 
 //translate address ADDR in memory space MEM, returns pointer to host page
 byte_t * mem_t::mem_translate(md_addr_t addr)		//virtual address to translate
 {
-	//got here via a first level miss in the page tables
-	ptab_misses++;
-	ptab_accesses++;
+	//got here via a miss in the software TLB
+	tlb_misses++;
+	tlb_accesses++;
 
 	//locate accessed PTE
-	for(mem_pte_t *prev=NULL, *pte=ptab[MEM_PTAB_SET(addr)]; pte != NULL; prev=pte, pte=pte->next)
+	mem_pte_t *pte = mem_lookup(MEM_VPN(addr));
+	if(!pte)
 	{
-		if(pte->tag == MEM_PTAB_TAG(addr))
+		//no translation found, return NULL
+		return NULL;
+	}
+
+	//replace the TLB entry
+	mem_tlb_entry_t & entry = tlb[MEM_TLB_SET(addr)];
+	entry.vpn = pte->vpn;
+	entry.page = pte->page;
+	entry.writable = !pte->cow;
+	return pte->page;
+}
+
+mem_pte_t * mem_t::mem_lookup(md_addr_t vpn) const
+{
+	mem_ptab_node_t *node = ptab;
+	for(unsigned int level=0;node && (level < MEM_PTAB_LEVELS - 2);level++)
+	{
+		node = static_cast<mem_ptab_node_t *>(node->entry[MEM_PTAB_INDEX(vpn, level)]);
+	}
+	if(!node || !node->entry[MEM_PTAB_INDEX(vpn, MEM_PTAB_LEVELS - 2)])
+	{
+		return NULL;
+	}
+	mem_pte_t *pte = &static_cast<mem_ptab_leaf_t *>(node->entry[MEM_PTAB_INDEX(vpn, MEM_PTAB_LEVELS - 2)])->entry[MEM_PTAB_INDEX(vpn, MEM_PTAB_LEVELS - 1)];
+	return pte->page ? pte : NULL;
+}
+
+mem_pte_t * mem_t::mem_insert(md_addr_t vpn, byte_t *page)
+{
+	if(!ptab)
+	{
+		ptab = new mem_ptab_node_t;
+	}
+	mem_ptab_node_t *node = ptab;
+	for(unsigned int level=0;level < MEM_PTAB_LEVELS - 2;level++)
+	{
+		void *& next = node->entry[MEM_PTAB_INDEX(vpn, level)];
+		if(!next)
 		{
-			//move this PTE to head of the bucket list
-			if(prev)
+			next = new mem_ptab_node_t;
+		}
+		node = static_cast<mem_ptab_node_t *>(next);
+	}
+	void *& leaf = node->entry[MEM_PTAB_INDEX(vpn, MEM_PTAB_LEVELS - 2)];
+	if(!leaf)
+	{
+		leaf = new mem_ptab_leaf_t;
+	}
+	mem_pte_t *pte = &static_cast<mem_ptab_leaf_t *>(leaf)->entry[MEM_PTAB_INDEX(vpn, MEM_PTAB_LEVELS - 1)];
+	assert(!pte->page);
+	pte->vpn = vpn;
+	pte->page = page;
+	return pte;
+}
+
+void mem_t::mem_remove(md_addr_t vpn)
+{
+	mem_pte_t *pte = mem_lookup(vpn);
+	if(pte)
+	{
+		pte->clear();
+	}
+	tlb[vpn & (MEM_TLB_SIZE - 1)] = mem_tlb_entry_t();
+}
+
+//collects the page table entries below node (at level) in address order
+static void collect_pages(const mem_ptab_node_t *node, unsigned int level, std::vector<mem_pte_t *> & pages)
+{
+	for(unsigned int i=0;i<MEM_PTAB_FANOUT;i++)
+	{
+		if(!node->entry[i])
+		{
+			continue;
+		}
+		if(level == MEM_PTAB_LEVELS - 2)
+		{
+			mem_ptab_leaf_t *leaf = static_cast<mem_ptab_leaf_t *>(node->entry[i]);
+			for(unsigned int j=0;j<MEM_PTAB_FANOUT;j++)
 			{
-				prev->next = pte->next;
-				pte->next = ptab[MEM_PTAB_SET(addr)];
-				ptab[MEM_PTAB_SET(addr)] = pte;
+				if(leaf->entry[j].page)
+				{
+					pages.push_back(&leaf->entry[j]);
+				}
 			}
-			return pte->page;
+		}
+		else
+		{
+			collect_pages(static_cast<const mem_ptab_node_t *>(node->entry[i]), level + 1, pages);
 		}
 	}
-	//no translation found, return NULL
-	return NULL;
+}
+
+void mem_t::mem_pages(std::vector<mem_pte_t *> & pages) const
+{
+	pages.clear();
+	if(ptab)
+	{
+		collect_pages(ptab, 0, pages);
+	}
+}
+
+void mem_t::mem_tlb_flush() const
+{
+	for(unsigned int i=0;i<MEM_TLB_SIZE;i++)
+	{
+		tlb[i] = mem_tlb_entry_t();
+	}
 }
 
 //allocate a memory page
@@ -93,52 +192,147 @@ void mem_t::mem_newpage(md_addr_t addr)			//virtual address to allocate
 	byte_t *page = new byte_t[MD_PAGE_SIZE];
 	memset(page,0,MD_PAGE_SIZE);
 
-	//generate a new PTE
-	mem_pte_t *pte = new mem_pte_t(ptab[MEM_PTAB_SET(addr)],MEM_PTAB_TAG(addr),page);
-
-	//insert PTE into inverted hash table
-	ptab[MEM_PTAB_SET(addr)] = pte;
+	//insert it into the page table
+	mem_insert(MEM_VPN(addr),page);
 
 	//one more page allocated
 	page_count++;
 }
 
+//translate address ADDR for writing, returns a host page only this memory holds
+byte_t * mem_t::mem_write_translate(md_addr_t addr)	//virtual address to translate
+{
+	//got here via a miss in the software TLB (or a TLB entry of a shared page)
+	tlb_misses++;
+	tlb_accesses++;
+
+	mem_pte_t *pte = mem_lookup(MEM_VPN(addr));
+	if(!pte)
+	{
+		mem_newpage(addr);
+		pte = mem_lookup(MEM_VPN(addr));
+	}
+	else if(pte->cow)
+	{
+		//the page was shared, copy it unless every other holder has since written (or freed) theirs
+		if(!pte->shared->exclusive())
+		{
+			byte_t *page = new byte_t[MD_PAGE_SIZE];
+			memcpy(page,pte->page,MD_PAGE_SIZE);
+			pte->shared->release();
+			pte->shared = NULL;
+			pte->page = page;
+			page_copies++;
+		}
+		pte->cow = false;
+	}
+
+	mem_tlb_entry_t & entry = tlb[MEM_TLB_SET(addr)];
+	entry.vpn = pte->vpn;
+	entry.page = pte->page;
+	entry.writable = true;
+	return pte->page;
+}
+
+void mem_pte_t::share(mem_pte_t *source)
+{
+	if(!source->shared)
+	{
+		source->shared = new mem_page_t(source->page, NULL);
+	}
+	source->shared->acquire();
+	source->cow = true;
+
+	if(shared)
+	{
+		shared->release();
+	}
+	else
+	{
+		delete [] page;
+	}
+	shared = source->shared;
+	page = source->page;
+	cow = true;
+}
+
+unsigned int mem_t::mem_share_identical(mem_t & other)
+{
+	unsigned int count = 0;
+	std::vector<mem_pte_t *> pages;
+	mem_pages(pages);
+	for(size_t i=0;i<pages.size();i++)
+	{
+		mem_pte_t *other_pte = other.mem_lookup(pages[i]->vpn);
+		if(other_pte && (other_pte->page != pages[i]->page) && !memcmp(other_pte->page,pages[i]->page,MD_PAGE_SIZE))
+		{
+			pages[i]->share(other_pte);
+			count++;
+		}
+	}
+
+	//entries of both memories changed
+	mem_tlb_flush();
+	other.mem_tlb_flush();
+	return count;
+}
+
 mem_t::mem_t(char *name)
-: name(name), ptab(MEM_PTAB_SIZE,static_cast<mem_pte_t *>(NULL)), page_count(0), ptab_misses(0), ptab_accesses(0)
+: name(name), ptab(NULL), page_count(0), page_copies(0), tlb_misses(0), tlb_accesses(0)
 {}
 
 mem_t::mem_t(const mem_t & source)
-: name(source.name), ptab(MEM_PTAB_SIZE,static_cast<mem_pte_t *>(NULL)), memory_map(source.memory_map), internal_map(source.internal_map),
-page_count(source.page_count), ptab_misses(source.ptab_misses), ptab_accesses(source.ptab_accesses),
+: name(source.name), ptab(NULL), memory_map(source.memory_map), internal_map(source.internal_map),
+page_count(source.page_count), page_copies(source.page_copies), tlb_misses(source.tlb_misses), tlb_accesses(source.tlb_accesses),
 context_id(source.context_id), ld_text_base(source.ld_text_base), ld_text_size(source.ld_text_size), ld_data_base(source.ld_data_base), ld_brk_point(source.ld_brk_point),
 ld_data_size(source.ld_data_size), ld_stack_base(source.ld_stack_base), ld_stack_size(source.ld_stack_size), ld_stack_min(source.ld_stack_min), ld_prog_fname(source.ld_prog_fname),
 ld_prog_entry(source.ld_prog_entry), ld_environ_base(source.ld_environ_base), ld_target_big_endian(source.ld_target_big_endian)
 {
-	//FIXME: This is in reverse compared to the original, do we care is the question.
-	for(unsigned int i = 0;i<source.ptab.size();i++)
+	//Pages are shared with source until either writes them (source's entries are marked copy-on-write as well)
+	std::vector<mem_pte_t *> pages;
+	source.mem_pages(pages);
+	for(size_t i=0;i<pages.size();i++)
 	{
-		for(mem_pte_t *pte=source.ptab[i];pte;pte=pte->next)
-		{
-			byte_t *page = new byte_t[MD_PAGE_SIZE];
-			memcpy(page,pte->page,MD_PAGE_SIZE);
-			mem_pte_t *newpte = new mem_pte_t(ptab[i], pte->tag, page);
-			ptab[i] = newpte;
-		}
+		mem_insert(pages[i]->vpn, NULL)->share(pages[i]);
 	}
+	source.mem_tlb_flush();
 	page_count = source.page_count;
 }
 
 mem_t::~mem_t()
 {
-	for(unsigned int i=0;i<ptab.size();i++)
+	free_pages();
+}
+
+//frees node (at level) and everything below it, the pages of the leaves are freed with them
+static void free_node(mem_ptab_node_t *node, unsigned int level)
+{
+	for(unsigned int i=0;i<MEM_PTAB_FANOUT;i++)
 	{
-		while(ptab[i])
+		if(node->entry[i])
 		{
-			mem_pte_t *temp = ptab[i]->next;
-			delete ptab[i];
-			ptab[i] = temp;
+			if(level == MEM_PTAB_LEVELS - 2)
+			{
+				delete static_cast<mem_ptab_leaf_t *>(node->entry[i]);
+			}
+			else
+			{
+				free_node(static_cast<mem_ptab_node_t *>(node->entry[i]), level + 1);
+			}
 		}
 	}
+	delete node;
+}
+
+void mem_t::free_pages()
+{
+	if(ptab)
+	{
+		free_node(ptab, 0);
+		ptab = NULL;
+	}
+	mem_tlb_flush();
+	page_count = 0;
 }
 
 std::ostream & operator << (std::ostream & out, const mem_t * source)
@@ -146,50 +340,53 @@ std::ostream & operator << (std::ostream & out, const mem_t * source)
 	return operator<<(out,*source);
 }
 
-std::ostream & operator << (std::ostream & out, const mem_t & source)
+void mem_t::write_layout(std::ostream & out) const
 {
-	out << "/* writing `" << (int)source.page_count << "' memory pages... */" << std::endl;
-	out << "(" << source.page_count << ", 0x" << std::hex << source.ld_brk_point << ", 0x" << std::hex << source.ld_stack_min << ")" << std::endl;
+	out << "/* writing `" << (int)page_count << "' memory pages... */" << std::endl;
+	out << "(" << page_count << ", 0x" << std::hex << ld_brk_point << ", 0x" << std::hex << ld_stack_min << ")" << std::endl;
 
 	out << std::endl;
 	out << "/* text segment specifiers (base & size) */" << std::endl;
-	out << "(0x" << std::hex << source.ld_text_base << ", " << std::dec << source.ld_text_size << ")" << std::endl;
+	out << "(0x" << std::hex << ld_text_base << ", " << std::dec << ld_text_size << ")" << std::endl;
 
 	out << std::endl;
 	out << "/* data segment specifiers (base & size) */" << std::endl;
-	out << "(0x" << std::hex << source.ld_data_base << ", " << std::dec << source.ld_data_size << ")" << std::endl;
+	out << "(0x" << std::hex << ld_data_base << ", " << std::dec << ld_data_size << ")" << std::endl;
 
 	out << std::endl;
 	out << "/* stack segment specifiers (base & size) */" << std::endl;
-	out << "(0x" << std::hex << source.ld_stack_base << ", " << std::dec << source.ld_stack_size << ")" << std::endl;
+	out << "(0x" << std::hex << ld_stack_base << ", " << std::dec << ld_stack_size << ")" << std::endl;
+}
+
+std::ostream & operator << (std::ostream & out, const mem_t & source)
+{
+	source.write_layout(out);
 
 	out << std::endl;
-	for(unsigned int i = 0;i<source.ptab.size();i++)
+	std::vector<mem_pte_t *> pages;
+	source.mem_pages(pages);
+	for(size_t i = 0;i<pages.size();i++)
 	{
-		for(mem_pte_t *pte=source.ptab[i];pte;pte=pte->next)
-		{
-			out << "(0x";
-			unsigned long long mem_pte_addr((pte->tag << (MD_LOG_PAGE_SIZE + MEM_LOG_PTAB_SIZE)) | (i << MD_LOG_PAGE_SIZE));
-			out << std::hex << mem_pte_addr << ", ";
-			out << "{" << std::dec << MD_PAGE_SIZE << "}<\n";
+		mem_pte_t *pte = pages[i];
+		out << "(0x" << std::hex << MEM_PTE_ADDR(pte) << ", ";
+		out << "{" << std::dec << MD_PAGE_SIZE << "}<\n";
 
-			bool newline(false);
-			for(unsigned int j=0;j<MD_PAGE_SIZE;j++)
-			{
-				if((j!=0) && ((j%32)==0))
-				{
-					out << "\n";
-					newline = true;
-				}
-				unsigned int toprint = (unsigned int)pte->page[j];
-				out << std::hex << (toprint/16) << std::hex << (toprint%16);
-			}
-			if(!newline)
+		bool newline(false);
+		for(unsigned int j=0;j<MD_PAGE_SIZE;j++)
+		{
+			if((j!=0) && ((j%32)==0))
 			{
 				out << "\n";
+				newline = true;
 			}
-			out << ">)\n" << std::dec << std::endl;
+			unsigned int toprint = (unsigned int)pte->page[j];
+			out << std::hex << (toprint/16) << std::hex << (toprint%16);
 		}
+		if(!newline)
+		{
+			out << "\n";
+		}
+		out << ">)\n" << std::dec << std::endl;
 	}
 	return out;
 }
@@ -199,7 +396,7 @@ std::istream & operator >> (std::istream & in, mem_t * target)
 	return operator>>(in,*target);
 }
 
-std::istream & operator >> (std::istream & in, mem_t & target)
+void mem_t::read_layout(std::istream & in)
 {
 	std::string mem_header("' memory pages... */");
 	std::string text_header("/* text segment specifiers (base & size) */");
@@ -208,7 +405,7 @@ std::istream & operator >> (std::istream & in, mem_t & target)
 
 	std::string buf;
 	char c_buf;
-	in >> buf >> buf >> c_buf >> target.page_count;
+	in >> buf >> buf >> c_buf >> page_count;
 	getline(in,buf);
 	if(buf!=mem_header)
 	{
@@ -216,7 +413,7 @@ std::istream & operator >> (std::istream & in, mem_t & target)
 		std::cerr << "Wanted to read: " << mem_header << std::endl;
 		exit(-1);
 	}
-	in >> c_buf >> target.page_count >> c_buf >> std::hex >> target.ld_brk_point >> c_buf >> std::hex >> target.ld_stack_min;
+	in >> c_buf >> page_count >> c_buf >> std::hex >> ld_brk_point >> c_buf >> std::hex >> ld_stack_min;
 	getline(in,buf);
 	getline(in,buf);
 	getline(in,buf);
@@ -226,7 +423,7 @@ std::istream & operator >> (std::istream & in, mem_t & target)
 		std::cerr << "Wanted to read: " << text_header << std::endl;
 		exit(-1);
 	}
-	in >> c_buf >> std::hex >> target.ld_text_base >> c_buf >> std::dec >> target.ld_text_size;
+	in >> c_buf >> std::hex >> ld_text_base >> c_buf >> std::dec >> ld_text_size;
 	getline(in,buf);
 	getline(in,buf);
 	getline(in,buf);
@@ -236,7 +433,7 @@ std::istream & operator >> (std::istream & in, mem_t & target)
 		std::cerr << "Wanted to read: " << data_header << std::endl;
 		exit(-1);
 	}
-	in >> c_buf >> std::hex >> target.ld_data_base >> c_buf >> std::dec >> target.ld_data_size;
+	in >> c_buf >> std::hex >> ld_data_base >> c_buf >> std::dec >> ld_data_size;
 	getline(in,buf);
 	getline(in,buf);
 	getline(in,buf);
@@ -246,11 +443,41 @@ std::istream & operator >> (std::istream & in, mem_t & target)
 		std::cerr << "Wanted to read: " << stack_header << std::endl;
 		exit(-1);
 	}
-	in >> c_buf >> std::hex >> target.ld_stack_base >> c_buf >> std::dec >> target.ld_stack_size;
+	in >> c_buf >> std::hex >> ld_stack_base >> c_buf >> std::dec >> ld_stack_size;
 	getline(in,buf);
+}
+
+//value of a hex digit of the text image
+static inline unsigned int hex_digit(char c)
+{
+	if(c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+	if(c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+	if(c >= 'A' && c <= 'F')
+	{
+		return c - 'A' + 10;
+	}
+	std::cerr << "Bad hex digit in memory page: " << c << std::endl;
+	exit(-1);
+}
+
+std::istream & operator >> (std::istream & in, mem_t & target)
+{
+	//the image replaces whatever is in target
+	target.free_pages();
+	target.read_layout(in);
+
+	std::string buf;
+	char c_buf;
 	getline(in,buf);
 
 	int page_count(target.page_count);
+	target.page_count = 0;
 	for(int i=0; i < page_count; i++)
 	{
 		in >> c_buf;
@@ -265,16 +492,14 @@ std::istream & operator >> (std::istream & in, mem_t & target)
 		}
 		getline(in,buf);
 
+		//pages are written whole, so fill the host page directly
+		byte_t *page = target.mem_write_translate(page_addr);
 		for(int j=0; j < MD_PAGE_SIZE; j++)
-                {
-			char t[3];
-			t[2] = NULL;
-			in >> t[0] >> t[1];
-			unsigned int val = strtol(t,NULL,16);
-                        //unchecked access...
-                        MEM_WRITE_BYTE(&target, page_addr, val);
-                        page_addr++;
-                }
+		{
+			char hi, lo;
+			in >> hi >> lo;
+			page[j] = (hex_digit(hi) << 4) | hex_digit(lo);
+		}
 		in >> c_buf;
 		if(c_buf!='>')
 		{
@@ -283,93 +508,289 @@ std::istream & operator >> (std::istream & in, mem_t & target)
 		}
 		getline(in,buf);
 		getline(in,buf);
-        }
+	}
 	target.page_count = page_count;
 	return in;
 }
 
-md_fault_type mem_t::mem_access(mem_cmd cmd,		//Read (from sim mem) or Write
-	md_addr_t addr,					//target address to access
-	void *vp,					//host memory address to access
-	int nbytes)					//number of bytes to access
+#define MEM_IMAGE_MAGIC		"m-sim pages"
+#define MEM_IMAGE_VERSION	1
+#define MEM_IMAGE_ORDER		ULL(0x0102030405060708)	//byte order check, images are in host byte order
+
+//image header, padded to MD_PAGE_SIZE in the file
+struct mem_image_header_t
 {
-	//check alignments: size || max size
-	if((nbytes & (nbytes-1)) != 0 || (nbytes > MD_PAGE_SIZE))
-		return md_fault_access;
+	char magic[16];
+	qword_t version;
+	qword_t page_size;
+	qword_t order;
+};
+
+//pads out to the next multiple of MD_PAGE_SIZE
+static void pad_page(std::ostream & out)
+{
+	static const char zeros[MD_PAGE_SIZE] = {0};
+	unsigned long long offset = out.tellp();
+	if(offset & (MD_PAGE_SIZE - 1))
+	{
+		out.write(zeros, MD_PAGE_SIZE - (offset & (MD_PAGE_SIZE - 1)));
+	}
+}
 
-	//check natural alignment
-	if((addr & (nbytes-1)) != 0)
+void mem_image_t::write_header(std::ostream & out)
+{
+	mem_image_header_t header;
+	memset(&header, 0, sizeof(header));
+	strcpy(header.magic, MEM_IMAGE_MAGIC);
+	header.version = MEM_IMAGE_VERSION;
+	header.page_size = MD_PAGE_SIZE;
+	header.order = MEM_IMAGE_ORDER;
+	out.write((const char *)&header, sizeof(header));
+	pad_page(out);
+}
+
+mem_image_t::mem_image_t(const std::string & fname)
+: fname(fname), base(NULL), size(0), refs(1)
+{
+	int fd = open(fname.c_str(), O_RDONLY);
+	if(fd == -1)
 	{
-		return md_fault_alignment;
+		fatal("could not open memory image `%s'", fname.c_str());
+	}
+	struct stat sbuf;
+	if(fstat(fd, &sbuf) == -1)
+	{
+		fatal("could not stat memory image `%s'", fname.c_str());
+	}
+	size = sbuf.st_size;
+	if(size < MD_PAGE_SIZE)
+	{
+		fatal("`%s' is not a memory image", fname.c_str());
 	}
 
-	if(!memory_map.empty())
+	//private and writable: pages are used in place and written by the simulated program
+	void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED)
 	{
-		for(size_t i=0;i<memory_map.size();i++)
-		{
-			if(memory_map[i].is_within(addr))
-			{
-				if(!memory_map[i].bounds_check(addr,nbytes))
-				{
-					return md_fault_segfault;
-				}
-				byte_t *p = (byte_t *)vp;
-				byte_t *dest = (byte_t *)memory_map[i].translate(addr);
-				if(cmd == Read)
-				{
-					if(!(memory_map[i].protections & PROT_READ))
-					{
-						return md_fault_access;
-					}
-					while(nbytes-- > 0)
-					{
-						*((byte_t *)p) = *dest;
-						p += sizeof(byte_t);
-						dest += sizeof(byte_t);
-					}
-				}
-				else
-				{
-					if(!(memory_map[i].protections & PROT_WRITE))
-					{
-						return md_fault_access;
-					}
-					while(nbytes-- > 0)
-					{
-						*dest = *((byte_t *)p);
-						p += sizeof(byte_t);
-						dest += sizeof(byte_t);
-					}
-				}
-				return md_fault_none;
-			}
-		}
+		fatal("could not map memory image `%s'", fname.c_str());
 	}
+	base = (byte_t *)mapping;
 
-	//perform the copy
-	byte_t *p = (byte_t *)vp;
+	mem_image_header_t header;
+	memcpy(&header, base, sizeof(header));
+	if(strncmp(header.magic, MEM_IMAGE_MAGIC, sizeof(header.magic)) || (header.order != MEM_IMAGE_ORDER))
+	{
+		fatal("`%s' is not a memory image (or was written on a host of different byte order)", fname.c_str());
+	}
+	if(header.version != MEM_IMAGE_VERSION)
+	{
+		fatal("memory image `%s' is version %d, expected version %d", fname.c_str(), (int)header.version, MEM_IMAGE_VERSION);
+	}
+	if(header.page_size != MD_PAGE_SIZE)
+	{
+		fatal("memory image `%s' has %d byte pages, expected %d", fname.c_str(), (int)header.page_size, MD_PAGE_SIZE);
+	}
+}
+
+mem_image_t::~mem_image_t()
+{
+	munmap(base, size);
+}
+
+void mem_image_t::acquire()
+{
+	__sync_fetch_and_add(&refs, 1);
+}
+
+void mem_image_t::release()
+{
+	assert(refs);
+	if(!__sync_sub_and_fetch(&refs, 1))
+	{
+		delete this;
+	}
+}
+
+unsigned long long mem_t::write_pages(std::ostream & out) const
+{
+	unsigned long long offset = out.tellp();
+	if(offset & (MD_PAGE_SIZE - 1))
+	{
+		fatal("memory image is not page aligned");
+	}
+
+	std::vector<mem_pte_t *> pages;
+	mem_pages(pages);
+
+	qword_t count = pages.size();
+	out.write((const char *)&count, sizeof(count));
+	for(size_t i=0;i<pages.size();i++)
+	{
+		qword_t addr = MEM_PTE_ADDR(pages[i]);
+		out.write((const char *)&addr, sizeof(addr));
+	}
+	pad_page(out);
+
+	for(size_t i=0;i<pages.size();i++)
+	{
+		out.write((const char *)pages[i]->page, MD_PAGE_SIZE);
+	}
+	return offset;
+}
+
+void mem_t::map_pages(mem_image_t * image, unsigned long long offset)
+{
+	free_pages();
+
+	qword_t count;
+	if((offset & (MD_PAGE_SIZE - 1)) || (offset + sizeof(count) > image->size))
+	{
+		fatal("memory image `%s' has no pages at offset 0x%llx", image->fname.c_str(), offset);
+	}
+	memcpy(&count, image->base + offset, sizeof(count));
+
+	unsigned long long index = offset + sizeof(count);
+	unsigned long long data = (index + count * sizeof(qword_t) + MD_PAGE_SIZE - 1) & ~(unsigned long long)(MD_PAGE_SIZE - 1);
+	if(data + count * MD_PAGE_SIZE > image->size)
+	{
+		fatal("memory image `%s' is truncated at offset 0x%llx", image->fname.c_str(), offset);
+	}
+
+	for(qword_t i=0;i<count;i++)
+	{
+		qword_t addr;
+		memcpy(&addr, image->base + index + i * sizeof(qword_t), sizeof(addr));
+
+		//the mapping is private, so the page is written in place until it is shared
+		mem_pte_t *pte = mem_insert(MEM_VPN(addr), image->base + data + i * MD_PAGE_SIZE);
+		pte->shared = new mem_page_t(pte->page, image);
+		image->acquire();
+	}
+	page_count = count;
+}
+
+std::ostream & operator << (std::ostream & out, const mmap_t & source)
+{
+	out << "(0x" << std::hex << source.base_address << ", " << std::dec << source.size << ", " << source.protections << ", " << source.flags << ")";
+	return out;
+}
+
+std::istream & operator >> (std::istream & in, mmap_t & target)
+{
+	char c_buf;
+	in >> c_buf >> std::hex >> target.base_address >> c_buf >> std::dec >> target.size >> c_buf >> target.protections >> c_buf >> target.flags >> c_buf;
+	if(c_buf != ')')
+	{
+		fatal("bad memory mapping in checkpoint");
+	}
+	//mappings are not translated, see mem_t::mem_map()
+	target.mapping = (void *)target.base_address;
+	return in;
+}
+
+//orders memory mappings (and addresses) by base address
+static bool map_base_less(md_addr_t addr, const mmap_t & map)
+{
+	return addr < map.base_address;
+}
+
+mmap_t * mem_t::mem_find_map(md_addr_t addr)
+{
+	//the last mapping that starts at or below addr
+	std::vector<mmap_t>::iterator it = std::upper_bound(memory_map.begin(), memory_map.end(), addr, map_base_less);
+	if(it == memory_map.begin())
+	{
+		return NULL;
+	}
+	it--;
+	return it->is_within(addr) ? &(*it) : NULL;
+}
+
+//memcpy() with the access sizes spelled out, so that word copies compile to a single move
+static inline void copy_bytes(void *dest, const void *src, size_t nbytes)
+{
+	switch(nbytes)
+	{
+	case 1:	memcpy(dest, src, 1); break;
+	case 2:	memcpy(dest, src, 2); break;
+	case 4:	memcpy(dest, src, 4); break;
+	case 8:	memcpy(dest, src, 8); break;
+	default: memcpy(dest, src, nbytes); break;
+	}
+}
+
+//copy NBYTES between the host memory of mapping MAP and P, returns any faults
+static md_fault_type map_copy(mmap_t & map, mem_cmd cmd, md_addr_t addr, byte_t *p, md_addr_t nbytes)
+{
+	byte_t *dest = (byte_t *)map.translate(addr);
 	if(cmd == Read)
 	{
-		while(nbytes-- > 0)
+		if(!(map.protections & PROT_READ))
 		{
-			*((byte_t *)p) = MEM_READ_BYTE(this, addr);
-			p += sizeof(byte_t);
-			addr += sizeof(byte_t);
+			return md_fault_access;
 		}
+		copy_bytes(p, dest, nbytes);
 	}
 	else
 	{
-		while(nbytes-- > 0)
+		if(!(map.protections & PROT_WRITE))
 		{
-			MEM_WRITE_BYTE(this, addr, *((byte_t *)p));
-			p += sizeof(byte_t);
-			addr += sizeof(byte_t);
+			return md_fault_access;
 		}
+		copy_bytes(dest, p, nbytes);
 	}
-	//no fault...
 	return md_fault_none;
 }
 
+void mem_t::mem_page_copy(mem_cmd cmd, md_addr_t addr, byte_t *p, md_addr_t nbytes)
+{
+	while(nbytes)
+	{
+		//up to the end of the page
+		md_addr_t count = MIN(nbytes, MD_PAGE_SIZE - MEM_OFFSET(addr));
+		if(cmd == Read)
+		{
+			byte_t *page = MEM_PAGE(this, addr);
+			if(page)
+			{
+				copy_bytes(p, page + MEM_OFFSET(addr), count);
+			}
+			else
+			{
+				//page not yet allocated, return zero value
+				memset(p, 0, count);
+			}
+		}
+		else
+		{
+			copy_bytes(MEM_WRITE_PAGE(this, addr) + MEM_OFFSET(addr), p, count);
+		}
+		addr += count;
+		p += count;
+		nbytes -= count;
+	}
+}
+
+md_fault_type mem_t::mem_access(mem_cmd cmd,		//Read (from sim mem) or Write
+	md_addr_t addr,					//target address to access
+	void *vp,					//host memory address to access
+	int nbytes)					//number of bytes to access
+{
+	//check alignments: size || max size
+	if((nbytes & (nbytes-1)) != 0 || (nbytes > MD_PAGE_SIZE))
+		return md_fault_access;
+
+	//check natural alignment
+	if((addr & (nbytes-1)) != 0)
+	{
+		return md_fault_alignment;
+	}
+
+	//naturally aligned accesses never cross a page
+	return mem_access_direct(cmd, addr, vp, nbytes);
+}
+
 md_fault_type mem_t::mem_access_direct(mem_cmd cmd,	//Read (from sim mem) or Write
 	md_addr_t addr,					//target address to access
 	void *vp,					//host memory address to access
@@ -381,67 +802,19 @@ md_fault_type mem_t::mem_access_direct(mem_cmd cmd,	//Read (from sim mem) or Wri
 
 	if(!memory_map.empty())
 	{
-		for(size_t i=0;i<memory_map.size();i++)
+		mmap_t *map = mem_find_map(addr);
+		if(map)
 		{
-			if(memory_map[i].is_within(addr))
+			if(!map->bounds_check(addr,nbytes))
 			{
-				if(!memory_map[i].bounds_check(addr,nbytes))
-				{
-					return md_fault_segfault;
-				}
-				byte_t *p = (byte_t *)vp;
-				byte_t *dest = (byte_t *)memory_map[i].translate(addr);
-				if(cmd == Read)
-				{
-					if(!(memory_map[i].protections & PROT_READ))
-					{
-						return md_fault_access;
-					}
-					while(nbytes-- > 0)
-					{
-						*((byte_t *)p) = *dest;
-						p += sizeof(byte_t);
-						dest += sizeof(byte_t);
-					}
-				}
-				else
-				{
-					if(!(memory_map[i].protections & PROT_WRITE))
-					{
-						return md_fault_access;
-					}
-					while(nbytes-- > 0)
-					{
-						*dest = *((byte_t *)p);
-						p += sizeof(byte_t);
-						dest += sizeof(byte_t);
-					}
-				}
-				return md_fault_none;
+				return md_fault_segfault;
 			}
+			return map_copy(*map, cmd, addr, (byte_t *)vp, nbytes);
 		}
 	}
 
-	//perform the copy
-	byte_t *p = (byte_t *)vp;
-	if(cmd == Read)
-	{
-		while(nbytes-- > 0)
-		{
-			*((byte_t *)p) = MEM_READ_BYTE(this, addr);
-			p += sizeof(byte_t);
-			addr += sizeof(byte_t);
-		}
-	}
-	else
-	{
-		while(nbytes-- > 0)
-		{
-			MEM_WRITE_BYTE(this, addr, *((byte_t *)p));
-			p += sizeof(byte_t);
-			addr += sizeof(byte_t);
-		}
-	}
+	//perform the copy, one translation per page
+	mem_page_copy(cmd, addr, (byte_t *)vp, nbytes);
 
 	//no fault...
 	return md_fault_none;
@@ -464,17 +837,34 @@ void mem_t::print_stats(FILE * stream)
 	fprintf(stream,"%s->ld_target_endian \"%s\" # program endian-ness\n",                    name.c_str(), ld_target_big_endian ? "Big" : "Little");
 
 
-	fprintf(stream,"%s.page_count     %lld # total number of pages allocated\n",     name.c_str(), page_count);
-	fprintf(stream,"%s.page_mem      %lldK # total size of memory pages allocated\n",name.c_str(), ((page_count*MD_PAGE_SIZE)/1024));
-	fprintf(stream,"%s.ptab_misses    %lld # total first level page table misses\n", name.c_str(), ptab_misses);
-	fprintf(stream,"%s.ptab_accesses  %lld # total page table accesses\n",           name.c_str(), ptab_accesses);
-	if(ptab_accesses)
+	//pages still shared copy-on-write are held by every holder, so they are only counted in page_shared
+	counter_t page_owned = 0, page_shared = 0;
+	std::vector<mem_pte_t *> pages;
+	mem_pages(pages);
+	for(size_t i=0;i<pages.size();i++)
 	{
-		fprintf(stream,"%s.ptab_miss_rate %f # first level page table miss rate\n",      name.c_str(), (double)ptab_misses/(double)ptab_accesses);
+		if(pages[i]->shared && !pages[i]->shared->exclusive())
+		{
+			page_shared++;
+		}
+		else
+		{
+			page_owned++;
+		}
+	}
+	fprintf(stream,"%s.page_count     %lld # total number of pages allocated (held by this memory alone)\n", name.c_str(), page_owned);
+	fprintf(stream,"%s.page_mem      %lldK # total size of memory pages allocated (held by this memory alone)\n",name.c_str(), ((page_owned*MD_PAGE_SIZE)/1024));
+	fprintf(stream,"%s.page_shared    %lld # pages shared with other memories (copy-on-write)\n", name.c_str(), page_shared);
+	fprintf(stream,"%s.page_copies    %lld # total shared pages copied on write\n", name.c_str(), page_copies);
+	fprintf(stream,"%s.tlb_misses     %lld # total software TLB misses\n",           name.c_str(), tlb_misses);
+	fprintf(stream,"%s.tlb_accesses   %lld # total address translations\n",          name.c_str(), tlb_accesses);
+	if(tlb_accesses)
+	{
+		fprintf(stream,"%s.tlb_miss_rate  %f # software TLB miss rate\n",               name.c_str(), (double)tlb_misses/(double)tlb_accesses);
 	}
 	else
 	{
-		fprintf(stream,"%s.ptab_miss_rate %s # first level page table miss rate\n",      name.c_str(), "<error: divide by zero>");
+		fprintf(stream,"%s.tlb_miss_rate  %s # software TLB miss rate\n",               name.c_str(), "<error: divide by zero>");
 	}
 }
 
@@ -524,17 +914,10 @@ md_fault_type mem_t::mem_strcpy(mem_cmd cmd,	//Read (from sim mem) or Write
 		}
 		break;
 	case Write:
-		//copy until string terminator ('\0') is encountered
-		{
-			size_t i = 0;
-			do
-			{
-				c = s[i++];
-				fault = mem_access(Write, addr++, &c, 1);
-				if(fault != md_fault_none)
-					return fault;
-			} while(c);
-		}
+		//copy up to and including the string terminator ('\0')
+		fault = mem_bcopy(Write, addr, (void *)s.c_str(), strlen(s.c_str()) + 1);
+		if(fault != md_fault_none)
+			return fault;
 		break;
 	default:
 		return md_fault_internal;
@@ -551,14 +934,31 @@ md_fault_type mem_t::mem_bcopy(mem_cmd cmd,	//Read (from sim mem) or Write
 	int nbytes)
 {
 	byte_t *p = (byte_t *)vp;
-	md_fault_type fault;
 
-	//copy NBYTES bytes to/from simulator memory
-	while(nbytes-- > 0)
+	//copy NBYTES bytes to/from simulator memory, in pieces that lie within one mapping or between mappings
+	while(nbytes > 0)
 	{
-		fault = mem_access(cmd, addr++, p++, 1);
-		if(fault != md_fault_none)
-			return fault;
+		md_addr_t count = nbytes;
+		mmap_t *map = memory_map.empty() ? NULL : mem_find_map(addr);
+		if(map)
+		{
+			count = MIN(count, map->base_address + map->size - addr);
+			md_fault_type fault = map_copy(*map, cmd, addr, p, count);
+			if(fault != md_fault_none)
+				return fault;
+		}
+		else
+		{
+			std::vector<mmap_t>::iterator next = std::upper_bound(memory_map.begin(), memory_map.end(), addr, map_base_less);
+			if(next != memory_map.end())
+			{
+				count = MIN(count, next->base_address - addr);
+			}
+			mem_page_copy(cmd, addr, p, count);
+		}
+		addr += count;
+		p += count;
+		nbytes -= count;
 	}
 
 	//no faults...
@@ -566,42 +966,35 @@ md_fault_type mem_t::mem_bcopy(mem_cmd cmd,	//Read (from sim mem) or Write
 }
 
 //copy NBYTES to/from simulated memory space, NBYTES must be a multiple of 4 bytes,
-//this function is faster than mem_bcopy(), returns any faults encountered
+//returns any faults encountered
 md_fault_type mem_t::mem_bcopy4(mem_cmd cmd,	//Read (from sim mem) or Write
 	md_addr_t addr,				//target address to access
 	void *vp,				//host memory address to access
 	int nbytes)
 {
-	byte_t *p = (byte_t *)vp;
-	int words = nbytes >> 2;		//note: nbytes % 2 == 0 is assumed
-	md_fault_type fault;
-
-	while(words-- > 0)
-	{
-		fault = mem_access(cmd, addr, p, sizeof(word_t));
-		if(fault != md_fault_none)
-			return fault;
-		addr += sizeof(word_t);
-		p += sizeof(word_t);
-	}
+	//note: nbytes % 4 == 0 is assumed
+	if((addr & (sizeof(word_t)-1)) != 0)
+		return md_fault_alignment;
 
-	//no faults...
-	return md_fault_none;
+	return mem_bcopy(cmd, addr, vp, nbytes & ~(int)(sizeof(word_t)-1));
 }
 
 //zero out NBYTES of simulated memory, returns any faults encountered
 md_fault_type mem_t::mem_bzero(md_addr_t addr,	//target address to access
 	int nbytes)
 {
-	byte_t c = 0;
+	static byte_t zeros[MD_PAGE_SIZE];
 	md_fault_type fault;
 
-	//zero out NBYTES of simulator memory
-	while(nbytes-- > 0)
+	//zero out NBYTES of simulator memory, a page at a time
+	while(nbytes > 0)
 	{
-		fault = mem_access(Write, addr++, &c, 1);
+		int count = MIN(nbytes, MD_PAGE_SIZE);
+		fault = mem_bcopy(Write, addr, zeros, count);
 		if(fault != md_fault_none)
 			return fault;
+		addr += count;
+		nbytes -= count;
 	}
 
 	//no faults...
@@ -629,45 +1022,32 @@ void mem_t::exec_flush()
 	}
 
 	//Kill actual pages
-	for(unsigned int i = 0;i<ptab.size();i++)
+	std::vector<mem_pte_t *> pages;
+	mem_pages(pages);
+	for(size_t i = 0;i<pages.size();i++)
 	{
-		mem_pte_t *pte = ptab[i];
-		mem_pte_t *prev = NULL;
-		while(pte)
+		md_addr_t addr = MEM_PTE_ADDR(pages[i]);
+		if(bounds_verify(memory_map,addr,1) && bounds_verify(internal_map,addr,1))
 		{
-			md_addr_t addr = MEM_PTE_ADDR(pte,i);
-			if(!bounds_verify(memory_map,addr,1) || !bounds_verify(internal_map,addr,1))
-			{
-				prev = pte;
-				pte = pte->next;
-			}
-			else
-			{
-				if(prev==NULL)
-				{
-					pte = pte->next;
-					delete ptab[i];
-					ptab[i] = pte;
-				}
-				else
-				{
-					prev->next = pte->next;
-					delete pte;
-					pte = prev->next;
-				}
-				page_count--;
-			}
+			mem_remove(pages[i]->vpn);
+			page_count--;
 		}
 	}
 }
 
+//next free mapping address, returns the one of the calling thread's simulation, NULL for the process-wide one
+static md_addr_t & (*mmap_base_hook)() = NULL;
+
+//take the next free mapping address from the one fn returns
+void mem_mmap_base_hook(md_addr_t & (*fn)())
+{
+	mmap_base_hook = fn;
+}
+
 md_addr_t mem_t::acquire_address(md_addr_t addr, md_addr_t len)
 {
-#ifdef __LP64__
-	static md_addr_t base_addr = 0x050000000000;
-#else
-	static md_addr_t base_addr = 0x50000000;
-#endif
+	static md_addr_t process_base_addr = MEM_MMAP_BASE;
+	md_addr_t & base_addr = mmap_base_hook ? mmap_base_hook() : process_base_addr;
 	if(addr==0)
 	{
 		addr = base_addr;
@@ -802,7 +1182,7 @@ md_addr_t mem_t::mem_map(md_addr_t simulated_addr, md_gpr_t fd, md_addr_t offset
 		{
 			return -1;
 		}
-		memory_map.push_back(temp);
+		memory_map.insert(std::upper_bound(memory_map.begin(),memory_map.end(),temp),temp);
 	}
 	else
 	{
@@ -814,7 +1194,7 @@ md_addr_t mem_t::mem_map(md_addr_t simulated_addr, md_gpr_t fd, md_addr_t offset
 		{
 			return -1;
 		}
-		memory_map.push_back(temp);
+		memory_map.insert(std::upper_bound(memory_map.begin(),memory_map.end(),temp),temp);
 	}
 	return temp.base_address;
 }
@@ -1009,3 +1389,84 @@ void mem_init1(void)
 }
 
 #endif
+
+#ifdef BENCH
+//Host throughput of the translations ff_context() makes: every instruction is fetched (runs of 16 sequential
+//PCs over 2MB of text), every third one loads and every thirtieth stores, three quarters of the data accesses
+//hit a 64KB stack and the rest are spread over <data pages> pages of data:
+//	memory-bench [<data pages> [<repeats>]]
+#include<iostream>
+#include<vector>
+#include<sys/time.h>
+
+static double bench_seconds()
+{
+	timeval now;
+	gettimeofday(&now, NULL);
+	return now.tv_sec + now.tv_usec * 1e-6;
+}
+
+int main(int argc, char **argv)
+{
+	long long data_pages = (argc > 1) ? atoll(argv[1]) : 1024;
+	int repeats = (argc > 2) ? atoi(argv[2]) : 60;
+	if((data_pages < 1) || (repeats < 1))
+		fatal("usage: memory-bench [<data pages> [<repeats>]]");
+
+	const size_t insts = 1 << 20;
+	const md_addr_t text_size = 2 * 1024 * 1024, stack_size = 64 * 1024;
+	const md_addr_t text = 0x120000000ULL, data = 0x140000000ULL, stack = 0x11ff00000ULL;
+	mem_t mem((char *)"bench");
+	for(md_addr_t addr=text;addr<text+text_size;addr+=sizeof(md_inst_t))
+		MEM_WRITE_WORD(&mem, addr, (word_t)addr);
+	for(long long page=0;page<data_pages;page++)
+		MEM_WRITE_WORD(&mem, data + page * MD_PAGE_SIZE, 1);
+	for(md_addr_t addr=stack-stack_size;addr<stack;addr+=8)
+		MEM_WRITE_WORD(&mem, addr, 1);
+
+	//the PCs and effective addresses, from a xorshift generator so every run sees the same stream
+	unsigned long long x = 88172645463325252ULL;
+	std::vector<md_addr_t> pcs(insts), addrs(insts / 3 + 1);
+	md_addr_t pc = text;
+	for(size_t i=0;i<insts;i++)
+	{
+		pcs[i] = pc;
+		pc += sizeof(md_inst_t);
+		if((i & 15) == 15)
+		{
+			x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+			pc = text + ((x >> 20) % (text_size / sizeof(md_inst_t))) * sizeof(md_inst_t);
+		}
+	}
+	for(size_t i=0;i<addrs.size();i++)
+	{
+		x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+		addrs[i] = (x & 3) ? (stack - 8 - ((x >> 8) % (stack_size / 8)) * 8)
+			: (data + ((x >> 8) % (data_pages * MD_PAGE_SIZE / 8)) * 8);
+	}
+
+	word_t sum = 0;
+	double start = bench_seconds();
+	for(int r=0;r<repeats;r++)
+	{
+		for(size_t i=0,j=0;i+2<insts;i+=3,j++)
+		{
+			md_inst_t inst;
+			MD_FETCH_INST(inst, &mem, pcs[i]);
+			sum += inst;
+			MD_FETCH_INST(inst, &mem, pcs[i+1]);
+			sum += inst;
+			MD_FETCH_INST(inst, &mem, pcs[i+2]);
+			sum += inst;
+			sum += MEM_READ_WORD(&mem, addrs[j]);
+			if(j % 10 == 0)
+				MEM_WRITE_WORD(&mem, addrs[j], (word_t)i);
+		}
+	}
+	double seconds = bench_seconds() - start;
+
+	std::cout << data_pages << " data pages: " << std::setprecision(4) << (insts / 3 * 3) * (double)repeats / seconds / 1e6
+		<< " M insts/s, " << mem.tlb_misses << " TLB misses in " << mem.tlb_accesses << " translations (checksum " << sum << ")" << std::endl;
+	return 0;
+}
+#endif
@@ -62,9 +62,22 @@
 #include"options.h"
 #include"stats.h"
 
-//number of entries in page translation hash table (must be power-of-two)
-#define MEM_PTAB_SIZE		(32*1024)
-#define MEM_LOG_PTAB_SIZE	15
+//virtual page number of address ADDR
+#define MEM_VPN(ADDR)		(((md_addr_t)(ADDR)) >> MD_LOG_PAGE_SIZE)
+
+//radix page table, MEM_PTAB_LEVELS levels of nodes with (1 << MEM_LOG_PTAB_FANOUT) entries each that are indexed
+//by the virtual page number from the top bits down, the last level holds the page table entries
+#define MEM_LOG_PTAB_FANOUT	9
+#define MEM_PTAB_FANOUT		(1 << MEM_LOG_PTAB_FANOUT)
+#define MEM_PTAB_LEVELS		((sizeof(md_addr_t) * 8 - MD_LOG_PAGE_SIZE + MEM_LOG_PTAB_FANOUT - 1) / MEM_LOG_PTAB_FANOUT)
+
+//index of virtual page number VPN in a page table node at LEVEL (0 is the root)
+#define MEM_PTAB_INDEX(VPN, LEVEL)	(((VPN) >> (MEM_LOG_PTAB_FANOUT * (MEM_PTAB_LEVELS - 1 - (LEVEL)))) & (MEM_PTAB_FANOUT - 1))
+
+//number of entries in the software TLB, a direct-mapped cache of translations in front of the page table
+//(must be power-of-two)
+#define MEM_TLB_SIZE		1024
+#define MEM_TLB_SET(ADDR)	(MEM_VPN(ADDR) & (MEM_TLB_SIZE - 1))
 
 //memory access command
 enum mem_cmd
@@ -73,26 +86,146 @@ enum mem_cmd
 	Write			//write memory from host (simulator) to target
 };
 
+//binary memory image, the pages of any number of memories written by mem_t::write_pages() to one file
+//The file is mapped once (MAP_PRIVATE) and its pages are installed into the page tables in place, the host reads
+//a page from the file when it is first touched and writes stay private to the simulator.
+//The image is unmapped when the last page installed from it is freed.
+class mem_image_t
+{
+	public:
+		//maps fname, fatal if it is not a memory image
+		mem_image_t(const std::string & fname);
+
+		//writes the image header, the pages of each memory follow
+		static void write_header(std::ostream & out);
+
+		//a shared page (or the reader) holds a reference to the image
+		void acquire();
+		void release();
+
+		std::string fname;		//image file name
+		byte_t *base;			//mapping of the whole file
+		size_t size;			//file size in bytes
+
+	private:
+		~mem_image_t();
+		unsigned int refs;		//references held
+};
+
+//a host page shared by page table entries (of one or more memories), freed with its last reference
+//Entries sharing a page copy it before they write it (see mem_t::mem_write_translate), pages of a memory image
+//(see mem_image_t) are always held this way. References are atomic, the memories of contexts on different cores
+//may share a page (see core_pool.h).
+class mem_page_t
+{
+	public:
+		mem_page_t(byte_t *page, mem_image_t *image)
+		: page(page), image(image), refs(1)
+		{}
+
+		void acquire()
+		{
+			__sync_fetch_and_add(&refs, 1);
+		}
+		void release()
+		{
+			if(!__sync_sub_and_fetch(&refs, 1))
+			{
+				if(image)
+				{
+					image->release();
+				}
+				else
+				{
+					delete [] page;
+				}
+				delete this;
+			}
+		}
+
+		//true if only the caller holds the page
+		bool exclusive()
+		{
+			return __atomic_load_n(&refs, __ATOMIC_ACQUIRE) == 1;
+		}
+
+		byte_t *page;			//host page
+		mem_image_t *image;		//image holding the page, NULL if the page was allocated
+
+	private:
+		unsigned int refs;		//references held
+};
+
 //page table entry
 class mem_pte_t
 {
 	public:
 		mem_pte_t()
-		: next(NULL), tag(static_cast<md_addr_t>(0)), page(NULL)
+		: vpn(static_cast<md_addr_t>(0)), page(NULL), shared(NULL), cow(false)
 		{}
 		~mem_pte_t()
 		{
-			delete [] page;
+			clear();
+		}
+
+		//free the page (the entry is unallocated)
+		void clear()
+		{
+			if(shared)
+			{
+				shared->release();
+			}
+			else
+			{
+				delete [] page;
+			}
 			page = NULL;
-			next = NULL;
+			shared = NULL;
+			cow = false;
+		}
+
+		//share the page of source, copy-on-write for both entries
+		void share(mem_pte_t *source);
+
+		md_addr_t vpn;			//virtual page number
+		byte_t *page;			//page pointer, NULL if the page is not allocated
+		mem_page_t *shared;		//shared host page, NULL if this entry owns page
+		bool cow;			//the page may be shared, copy it before writing
+};
+
+//page table node, entries are the nodes of the next level
+class mem_ptab_node_t
+{
+	public:
+		mem_ptab_node_t()
+		{
+			for(unsigned int i=0;i<MEM_PTAB_FANOUT;i++)
+			{
+				entry[i] = NULL;
+			}
 		}
-		mem_pte_t(mem_pte_t *next, md_addr_t tag, byte_t *page)
-		: next(next), tag(tag), page(page)
+
+		void *entry[MEM_PTAB_FANOUT];
+};
+
+//last level of the page table, holds the page table entries themselves (a lookup does not chase another pointer)
+class mem_ptab_leaf_t
+{
+	public:
+		mem_pte_t entry[MEM_PTAB_FANOUT];
+};
+
+//software TLB entry
+class mem_tlb_entry_t
+{
+	public:
+		mem_tlb_entry_t()
+		: vpn(~static_cast<md_addr_t>(0)), page(NULL), writable(false)
 		{}
 
-		mem_pte_t *next;		//next translation in this bucket
-		md_addr_t tag;			//virtual page number tag
+		md_addr_t vpn;			//virtual page number, all ones if invalid
 		byte_t *page;			//page pointer
+		bool writable;			//the page is not shared, writes may use page
 };
 
 class mmap_t
@@ -107,6 +240,12 @@ class mmap_t
 		bool is_within(md_addr_t addr);
 		bool bounds_check(md_addr_t addr, md_addr_t len);
 		void * translate(md_addr_t addr);
+
+		//mappings are ordered by base address
+		bool operator < (const mmap_t & other) const
+		{
+			return base_address < other.base_address;
+		}
 };
 
 //memory object
@@ -119,14 +258,16 @@ class mem_t
 
 		//memory state
 		std::string name;			//name of this memory space
-		std::vector<mem_pte_t *> ptab;		//inverted page table
-		std::vector<mmap_t> memory_map;		//list of active memory mappings
+		mem_ptab_node_t *ptab;			//radix page table root, NULL if no page is allocated
+		mutable mem_tlb_entry_t tlb[MEM_TLB_SIZE];	//software TLB
+		std::vector<mmap_t> memory_map;		//list of active memory mappings, sorted by base address
 		std::vector<mmap_t> internal_map;	//Non-translated (internal) memory mappings
 
 		//memory statistics
-		counter_t page_count;			//total number of pages allocated
-		counter_t ptab_misses;			//total first level page table misses
-		counter_t ptab_accesses;		//total page table accesses
+		counter_t page_count;			//total number of pages mapped, including pages shared copy-on-write
+		counter_t page_copies;			//total shared pages copied on write
+		counter_t tlb_misses;			//total software TLB misses
+		counter_t tlb_accesses;			//total translations
 
 		int context_id; 			//the context id for this memory space
 
@@ -171,12 +312,21 @@ class mem_t
 			int nbytes);			//number of bytes to access
 
 		//copy NBYTES to/from simulated memory space, NBYTES must be a multiple of 4
-		//bytes, this function is faster than mem_bcopy(), returns any faults encountered
+		//bytes and ADDR word aligned, returns any faults encountered
 		md_fault_type mem_bcopy4(mem_cmd cmd,	//Read (from sim mem) or Write
 			md_addr_t addr,			//target address to access
 			void *vp,			//host memory address to access
 			int nbytes);			//number of bytes to access
 
+		//the memory mapping holding ADDR, NULL if ADDR is not mapped (binary search of memory_map)
+		mmap_t * mem_find_map(md_addr_t addr);
+
+		//copy NBYTES to/from the pages of simulated memory (not the memory mappings), one translation per page
+		void mem_page_copy(mem_cmd cmd,		//Read (from sim mem) or Write
+			md_addr_t addr,			//target address to access
+			byte_t *p,			//host memory address to access
+			md_addr_t nbytes);		//number of bytes to access
+
 		//zero out NBYTES of simulated memory, returns any faults encountered
 		md_fault_type mem_bzero(md_addr_t addr,	//target address to access
 			int nbytes);			//number of bytes to clear
@@ -192,9 +342,32 @@ class mem_t
 		//translate address ADDR in memory space MEM, returns pointer to host page
 		byte_t * mem_translate(md_addr_t addr);	//virtual address to translate
 
+		//page table entry for virtual page number VPN, NULL if the page is not allocated
+		mem_pte_t * mem_lookup(md_addr_t vpn) const;
+
+		//enter PAGE for virtual page number VPN into the page table, returns its entry, VPN must not be allocated
+		mem_pte_t * mem_insert(md_addr_t vpn, byte_t *page);
+
+		//free the page of virtual page number VPN
+		void mem_remove(md_addr_t vpn);
+
+		//every page table entry, in address order
+		void mem_pages(std::vector<mem_pte_t *> & pages) const;
+
+		//invalidate the software TLB, required when a page is freed or an entry's page or cow changes
+		void mem_tlb_flush() const;
+
+		//translate address ADDR for writing, returns pointer to a host page only this memory holds,
+		//the page is allocated if it is not yet and copied if it is shared
+		byte_t * mem_write_translate(md_addr_t addr);	//virtual address to translate
+
 		//allocate a memory page
 		void mem_newpage(md_addr_t addr);	//virtual address to allocate
 
+		//share the pages that hold the same contents at the same address in other (copy-on-write),
+		//returns the number of pages shared
+		unsigned int mem_share_identical(mem_t & other);
+
 #define OSF_MAP_ANON		0x0010		//Don't use a file
 #define OSF_MAP_FIXED		0x0100		//Interpret addr exactly
 #define OSF_MAP_SHARED		0x0001		//Changes made to the mapping alter the original mapping.
@@ -214,6 +387,21 @@ class mem_t
 
 		//Flush memory mappings when exec is called (OSF_MAP_INHERIT)
 		void exec_flush();
+
+		//frees every page
+		void free_pages();
+
+		//checkpoint the page count and segment specifiers, the text image (operator<<) starts with these
+		void write_layout(std::ostream & out) const;
+		void read_layout(std::istream & in);
+
+		//appends the pages to the binary image out, which is positioned at a multiple of MD_PAGE_SIZE:
+		//the page count and the page addresses, then the raw pages starting at the next multiple of MD_PAGE_SIZE.
+		//Returns the image offset the pages were written at (for map_pages)
+		unsigned long long write_pages(std::ostream & out) const;
+
+		//replaces the pages with the pages written at offset of image, the pages are not read here (see mem_image_t)
+		void map_pages(mem_image_t * image, unsigned long long offset);
 };
 
 std::ostream & operator << (std::ostream & out, const mem_t & source);
@@ -221,33 +409,51 @@ std::ostream & operator << (std::ostream & out, const mem_t * source);
 std::istream & operator >> (std::istream & in, mem_t & target);
 std::istream & operator >> (std::istream & in, mem_t * target);
 
-//virtual to host page translation macros
+//checkpoint a memory mapping (the mapped pages are part of the mem_t image)
+std::ostream & operator << (std::ostream & out, const mmap_t & source);
+std::istream & operator >> (std::istream & in, mmap_t & target);
+
+//first address mem_t::acquire_address() tries for a mapping without a desired address
+#ifdef __LP64__
+#define MEM_MMAP_BASE		0x050000000000
+#else
+#define MEM_MMAP_BASE		0x50000000
+#endif
 
-//compute page table set
-#define MEM_PTAB_SET(ADDR)	(((ADDR) >> MD_LOG_PAGE_SIZE) & (MEM_PTAB_SIZE - 1))
+//acquire_address() takes the next free mapping address from the one fn returns (that of the calling thread's
+//simulation) rather than the process-wide one
+void mem_mmap_base_hook(md_addr_t & (*fn)());
 
-//compute page table tag
-#define MEM_PTAB_TAG(ADDR)	((ADDR) >> (MD_LOG_PAGE_SIZE + MEM_LOG_PTAB_SIZE))
+//virtual to host page translation macros
 
-//convert a pte entry at idx to a block address
-#define MEM_PTE_ADDR(PTE, IDX)						\
-	(((PTE)->tag << (MD_LOG_PAGE_SIZE + MEM_LOG_PTAB_SIZE))		\
-		| ((IDX) << MD_LOG_PAGE_SIZE))
+//convert a pte entry to a page address
+#define MEM_PTE_ADDR(PTE)	((PTE)->vpn << MD_LOG_PAGE_SIZE)
 
 //locate host page for virtual address ADDR, returns NULL if unallocated
 #define MEM_PAGE(MEM, ADDR)								\
-	(/* first attempt to hit in first entry, otherwise call xlation fn */		\
-		((MEM)->ptab[MEM_PTAB_SET(ADDR)]					\
-			&& (MEM)->ptab[MEM_PTAB_SET(ADDR)]->tag == MEM_PTAB_TAG(ADDR))	\
+	(/* first attempt to hit in the software TLB, otherwise call xlation fn */	\
+		((MEM)->tlb[MEM_TLB_SET(ADDR)].vpn == MEM_VPN(ADDR))			\
 			? (/* hit - return the page address on host */			\
-			(MEM)->ptab_accesses++,						\
-			(MEM)->ptab[MEM_PTAB_SET(ADDR)]->page)				\
-			: (/* first level miss - call the translation helper function */\
+			(MEM)->tlb_accesses++,						\
+			(MEM)->tlb[MEM_TLB_SET(ADDR)].page)				\
+			: (/* TLB miss - call the translation helper function */	\
 			(MEM)->mem_translate((ADDR))))
 
 //compute address of access within a host page
 #define MEM_OFFSET(ADDR)	((ADDR) & (MD_PAGE_SIZE - 1))
 
+//locate host page for writing virtual address ADDR, allocates the page when it is first written and copies it
+//if it is shared
+#define MEM_WRITE_PAGE(MEM, ADDR)							\
+	(/* first attempt to hit in the software TLB, otherwise call xlation fn */	\
+		((MEM)->tlb[MEM_TLB_SET(ADDR)].vpn == MEM_VPN(ADDR)			\
+			&& (MEM)->tlb[MEM_TLB_SET(ADDR)].writable)			\
+			? (/* hit - return the page address on host */			\
+			(MEM)->tlb_accesses++,						\
+			(MEM)->tlb[MEM_TLB_SET(ADDR)].page)				\
+			: (/* miss or shared page - call the write translation function */\
+			(MEM)->mem_write_translate((ADDR))))
+
 //memory tickle function, allocates pages when they are first written
 #define MEM_TICKLE(MEM, ADDR)						\
 	(!MEM_PAGE(MEM, ADDR)						\
@@ -255,19 +461,17 @@ std::istream & operator >> (std::istream & in, mem_t * target);
 	(MEM)->mem_newpage(ADDR))					\
 	: (/* nada... */ (void)0))
 
-//memory page iterator
-#define MEM_FORALL(MEM, ITER, PTE)					\
-	for ((ITER)=0; (ITER) < MEM_PTAB_SIZE; (ITER)++)		\
-		for ((PTE)=(MEM)->ptab[i]; (PTE) != NULL; (PTE)=(PTE)->next)
-
 //memory accessors macros, fast but difficult to debug...
 
-//safe version, works only with scalar types
-//FIXME: write a more efficient GNU C expression for this...
-#define MEM_READ(MEM, ADDR, TYPE)						\
-	(MEM_PAGE(MEM, (md_addr_t)(ADDR))					\
-	? *((TYPE *)(MEM_PAGE(MEM, (md_addr_t)(ADDR)) + MEM_OFFSET(ADDR)))	\
-	: /* page not yet allocated, return zero value */ 0)
+//safe version, works only with scalar types (translates ADDR once)
+template<typename TYPE>
+inline TYPE mem_read(mem_t *mem, md_addr_t addr)
+{
+	byte_t *page = MEM_PAGE(mem, addr);
+	return page ? *((TYPE *)(page + MEM_OFFSET(addr)))
+		: /* page not yet allocated, return zero value */ 0;
+}
+#define MEM_READ(MEM, ADDR, TYPE)	mem_read<TYPE>((MEM), (md_addr_t)(ADDR))
 
 //unsafe version, works with any type
 #define __UNCHK_MEM_READ(MEM, ADDR, TYPE)				\
@@ -276,12 +480,11 @@ std::istream & operator >> (std::istream & in, mem_t * target);
 //safe version, works only with scalar types
 //FIXME: write a more efficient GNU C expression for this...
 #define MEM_WRITE(MEM, ADDR, TYPE, VAL)						\
-	(MEM_TICKLE(MEM, (md_addr_t)(ADDR)),					\
-	*((TYPE *)(MEM_PAGE(MEM, (md_addr_t)(ADDR)) + MEM_OFFSET(ADDR))) = (VAL))
+	(*((TYPE *)(MEM_WRITE_PAGE(MEM, (md_addr_t)(ADDR)) + MEM_OFFSET(ADDR))) = (VAL))
       
 //unsafe version, works with any type
 #define __UNCHK_MEM_WRITE(MEM, ADDR, TYPE, VAL)				\
-	(*((TYPE *)(MEM_PAGE(MEM, (md_addr_t)(ADDR)) + MEM_OFFSET(ADDR))) = (VAL))
+	(*((TYPE *)(MEM_WRITE_PAGE(MEM, (md_addr_t)(ADDR)) + MEM_OFFSET(ADDR))) = (VAL))
 
 
 //fast memory accessor macros, typed versions
@@ -65,7 +65,7 @@
 #include "machine.h"
 
 //verbose output flag
-int verbose = FALSE;
+__thread int verbose = FALSE;
 
 #ifdef DEBUG
 //active debug flag
@@ -82,6 +82,15 @@ void fatal_hook(void (*fn)(FILE *stream))
 	hook_fn = fn;
 }
 
+//fatal() throws fatal_error_t on this thread
+static __thread bool fatal_throws = false;
+
+//make fatal() on the calling thread throw fatal_error_t or exit the process
+void fatal_throw(bool enable)
+{
+	fatal_throws = enable;
+}
+
 //declare a fatal run-time error, calls fatal hook function
 #ifdef __GNUC__
 void _fatal(const char *file, const char *func, int line, const char *fmt, ...)
@@ -99,6 +108,9 @@ void fatal(const char *fmt, ...)
 		fprintf(stderr, " [%s:%s, line %d]", func, file, line);
 #endif /* __GNUC__ */
 	fprintf(stderr, "\n");
+	va_end(v);
+	if(fatal_throws)
+		throw fatal_error_t();
 	if(hook_fn)
 		(*hook_fn)(stderr);
 	exit(1);
@@ -185,12 +197,36 @@ void debug(const char *fmt, ...)
 }
 #endif /* DEBUG */
 
+//returns the generator of the calling thread's simulation, NULL for the process-wide one
+static rand_state_t *(*rand_hook)() = NULL;
+
+rand_state_t::rand_state_t()
+{
+#ifdef __GLIBC__
+	memset(&data, 0, sizeof(data));
+	initstate_r(1, state, sizeof(state), &data);		//1 is random()'s seed until srandom() is called
+#endif
+}
+
+//use the generator fn returns in mysrand() and myrand()
+void myrand_hook(rand_state_t *(*fn)())
+{
+	rand_hook = fn;
+}
+
 //seed the random number generator
 void mysrand(unsigned int seed)			//random number generator seed
 {
 #if defined(hpux) || defined(__hpux) || defined(__svr4__) || defined(_MSC_VER)
 	srand(seed);
 #else
+#ifdef __GLIBC__
+	if(rand_hook)
+	{
+		srandom_r(seed, &rand_hook()->data);
+		return;
+	}
+#endif
 	srandom(seed);
 #endif
 }
@@ -205,6 +241,14 @@ int myrand()					//returns random number
 #if defined(hpux) || defined(__hpux) || defined(__svr4__) || defined(_MSC_VER)
 	return rand();
 #else
+#ifdef __GLIBC__
+	if(rand_hook)
+	{
+		int32_t result;
+		random_r(&rand_hook()->data, &result);
+		return result;
+	}
+#endif
 	return random();
 #endif
 }
@@ -85,8 +85,8 @@
 #define ROUND_UP(N,ALIGN)	(((N) + ((ALIGN)-1)) & ~((ALIGN)-1))
 #define ROUND_DOWN(N,ALIGN)	((N) & ~((ALIGN)-1))
 
-//verbose output flag
-extern int verbose;
+//verbose output flag (per thread, each batch job has its own, see main.c)
+extern __thread int verbose;
 
 #ifdef DEBUG
 //active debug flag
@@ -96,6 +96,12 @@ extern int debugging;
 //register a fatal hook function to be called when an error is detected
 void fatal_hook(void (*hook_fn)(FILE *stream));
 
+//thrown by fatal() on a thread that asked for it with fatal_throw(), instead of calling the hook and exiting
+class fatal_error_t {};
+
+//make fatal() on the calling thread throw fatal_error_t (a batch job ends, the other jobs go on) or exit the process
+void fatal_throw(bool enable);
+
 #ifdef __GNUC__
 //declare a fatal run-time error, calls fatal hook function
 #define fatal(fmt, args...)	_fatal(__FILE__, __FUNCTION__, __LINE__, fmt, ## args)
@@ -168,6 +174,27 @@ void mysrand(unsigned int seed);
 //get a random number (int)
 int myrand(void);
 
+//state of a random number generator, each simulation draws from its own (see myrand_hook())
+class rand_state_t
+{
+	public:
+		rand_state_t();
+
+#ifdef __GLIBC__
+		struct random_data data;
+		char state[128];			//the size srandom() uses, so a seed gives the same sequence
+#endif
+
+	private:
+		//data points into state
+		rand_state_t(const rand_state_t &);
+		rand_state_t & operator=(const rand_state_t &);
+};
+
+//mysrand() and myrand() use the generator fn returns (that of the calling thread's simulation) rather than the
+//process-wide one; hosts without random_r() always use the process-wide one
+void myrand_hook(rand_state_t *(*fn)());
+
 //case insensitive string compare (NOTE: many machines are missing this trivial function, so I funcdup() it here...)
 //Returns result of compare (see strcmp())
 int mystricmp(const char *s1, const char *s2);
@@ -4,6 +4,7 @@
 #include<map>
 #include<cassert>
 #include<cerrno>
+#include<iostream>
 
 pid_handler_t::pid_handler_t()
 : next_pid(0x3500)
@@ -14,6 +15,7 @@ unsigned long long pid_handler_t::get_new_pid()
 	process_t temp;
 	temp.pid = next_pid++;
 	temp.alive = true;
+	temp.retval = 0;
 	temp.parent = 0;
 
 	p_list.push_back(temp);
@@ -160,3 +162,40 @@ size_t pid_handler_t::get_entry(unsigned long long pid)
 	return (size_t)-1;
 }
 
+std::ostream & operator<<(std::ostream & out, const pid_handler_t & source)
+{
+	out << "(" << std::dec << source.next_pid << " " << source.p_list.size();
+	for(size_t i=0;i<source.p_list.size();i++)
+	{
+		const pid_handler_t::process_t & p = source.p_list[i];
+		out << " " << p.pid << " " << p.alive << " " << p.retval << " " << p.parent << " " << p.children.size();
+		for(size_t j=0;j<p.children.size();j++)
+		{
+			out << " " << p.children[j];
+		}
+	}
+	out << ")";
+	return out;
+}
+
+std::istream & operator>>(std::istream & in, pid_handler_t & target)
+{
+	char c_buf;
+	size_t count;
+	in >> c_buf >> std::dec >> target.next_pid >> count;
+	target.p_list.resize(count);
+	for(size_t i=0;i<count;i++)
+	{
+		pid_handler_t::process_t & p = target.p_list[i];
+		size_t children;
+		in >> p.pid >> p.alive >> p.retval >> p.parent >> children;
+		p.children.resize(children);
+		for(size_t j=0;j<children;j++)
+		{
+			in >> p.children[j];
+		}
+	}
+	in >> c_buf;
+	assert(c_buf==')');
+	return in;
+}
@@ -39,6 +39,12 @@ class pid_handler_t
 
 		unsigned long long next_pid;
 
+		friend std::ostream & operator<<(std::ostream & out, const pid_handler_t & source);
+		friend std::istream & operator>>(std::istream & in, pid_handler_t & target);
 };
 
+//checkpoint the process list (pids, parents, children and return values)
+std::ostream & operator<<(std::ostream & out, const pid_handler_t & source);
+std::istream & operator>>(std::istream & in, pid_handler_t & target);
+
 #endif
@@ -0,0 +1,246 @@
+// Hardware Prefetchers
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ *
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ *
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ *
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ *
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ *
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ *
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ *
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ *
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ *
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#ifndef PREFETCH_C
+#define PREFETCH_C
+
+#include<cstdio>
+#include<cstring>
+#include<cassert>
+
+#include"prefetch.h"
+
+prefetcher_t::prefetcher_t(std::string config, unsigned int bsize)
+: config(config), bsize(bsize)
+{}
+
+prefetcher_t::~prefetcher_t()
+{}
+
+nextline_prefetcher_t::nextline_prefetcher_t(std::string config, unsigned int bsize, unsigned int degree)
+: prefetcher_t(config, bsize), degree(degree)
+{}
+
+void nextline_prefetcher_t::access(md_addr_t pc, md_addr_t addr, int context_id, prefetch_event event,
+	std::vector<md_addr_t> & prefetches)
+{
+	//tagged: a hit on a prefetched block keeps the sequence going
+	if(event == PF_HIT)
+		return;
+
+	md_addr_t next = baddr(addr);
+	for(unsigned int i=0;i<degree;i++)
+	{
+		next += bsize;
+		prefetches.push_back(next);
+	}
+}
+
+stride_prefetcher_t::stride_prefetcher_t(std::string config, unsigned int bsize, unsigned int entries, unsigned int degree)
+: prefetcher_t(config, bsize), degree(degree), table(entries)
+{}
+
+void stride_prefetcher_t::access(md_addr_t pc, md_addr_t addr, int context_id, prefetch_event event,
+	std::vector<md_addr_t> & prefetches)
+{
+	//without a PC, accesses to the same 4KB page train together
+	md_addr_t key = pc ? pc : (addr >> 12);
+	entry_t & e = table[((key >> 2) ^ (key >> 12) ^ ((md_addr_t)context_id * 0x9e3779b1)) & (table.size() - 1)];
+
+	if((e.key != key) || (e.context_id != context_id))
+	{
+		//a new PC (or page) takes the entry over
+		e = entry_t();
+		e.key = key;
+		e.context_id = context_id;
+		e.last_addr = addr;
+		return;
+	}
+
+	long long stride = (long long)(addr - e.last_addr);
+	if(!stride)
+	{
+		//the same address again, nothing to learn
+		return;
+	}
+	e.last_addr = addr;
+
+	if(stride == e.stride)
+	{
+		e.confidence = MIN(e.confidence + 1, STRIDE_MAX_CONFIDENCE);
+	}
+	else if(e.confidence)
+	{
+		e.confidence--;
+	}
+	else
+	{
+		e.stride = stride;
+	}
+
+	if(e.confidence < STRIDE_CONFIDENT)
+		return;
+
+	//strides smaller than a block land in the same block several times
+	md_addr_t last = baddr(addr);
+	for(unsigned int i=1;i<=degree;i++)
+	{
+		md_addr_t next = baddr(addr + e.stride * i);
+		if(next != last)
+		{
+			prefetches.push_back(next);
+			last = next;
+		}
+	}
+}
+
+stream_prefetcher_t::stream_prefetcher_t(std::string config, unsigned int bsize, unsigned int streams, unsigned int depth)
+: prefetcher_t(config, bsize), depth(depth), streams(streams), uses(0)
+{}
+
+void stream_prefetcher_t::issue(stream_t *s, std::vector<md_addr_t> & prefetches)
+{
+	while((long long)(s->next - s->last) / s->direction <= (long long)depth)
+	{
+		prefetches.push_back(s->next);
+		s->next += s->direction;
+	}
+}
+
+void stream_prefetcher_t::access(md_addr_t pc, md_addr_t addr, int context_id, prefetch_event event,
+	std::vector<md_addr_t> & prefetches)
+{
+	//hits on blocks that were not prefetched say nothing about the streams
+	if(event == PF_HIT)
+		return;
+
+	uses++;
+	md_addr_t block = baddr(addr);
+	for(unsigned int i=0;i<streams.size();i++)
+	{
+		stream_t *s = &streams[i];
+		if(!s->valid || (s->context_id != context_id))
+			continue;
+
+		if(s->confirmed)
+		{
+			//a demand read inside the prefetched part of the stream moves it forward
+			long long ahead = (long long)(block - s->last) / s->direction;
+			if((ahead < 1) || (ahead > (long long)depth))
+				continue;
+		}
+		else
+		{
+			//the second miss of a stream, next to the first, sets its direction
+			if((block != s->last + bsize) && (block != s->last - bsize))
+				continue;
+			s->confirmed = true;
+			s->direction = (long long)(block - s->last);
+			s->next = block + s->direction;
+		}
+		s->last = block;
+		s->lru = uses;
+		issue(s, prefetches);
+		return;
+	}
+
+	//only misses start streams
+	if(event != PF_MISS)
+		return;
+
+	stream_t *victim = &streams[0];
+	for(unsigned int i=1;i<streams.size() && victim->valid;i++)
+	{
+		if(!streams[i].valid || (streams[i].lru < victim->lru))
+			victim = &streams[i];
+	}
+	*victim = stream_t();
+	victim->valid = true;
+	victim->context_id = context_id;
+	victim->last = block;
+	victim->lru = uses;
+}
+
+//returns the prefetcher described by CONFIG for a cache with BSIZE byte blocks, NULL for "none"
+prefetcher_t * prefetch_parser(const char *config, unsigned int bsize)
+{
+	if(!mystricmp(config, "none"))
+		return NULL;
+
+	char kind[128];
+	int first, second;
+	int args = sscanf(config, "%127[^:]:%d:%d", kind, &first, &second);
+
+	if((args == 2) && !mystricmp(kind, "nextline"))
+	{
+		if(first < 1)
+			fatal("next-line prefetch degree `%d' must be greater than zero", first);
+		return new nextline_prefetcher_t(config, bsize, first);
+	}
+	if((args == 3) && !mystricmp(kind, "stride"))
+	{
+		if((first < 1) || ((first & (first-1)) != 0))
+			fatal("stride prefetcher entries `%d' must be a power of two", first);
+		if(second < 1)
+			fatal("stride prefetch degree `%d' must be greater than zero", second);
+		return new stride_prefetcher_t(config, bsize, first, second);
+	}
+	if((args == 3) && !mystricmp(kind, "stream"))
+	{
+		if(first < 1)
+			fatal("stream prefetcher streams `%d' must be greater than zero", first);
+		if(second < 1)
+			fatal("stream prefetch depth `%d' must be greater than zero", second);
+		return new stream_prefetcher_t(config, bsize, first, second);
+	}
+	fatal("bad prefetcher `%s': {none|nextline:<degree>|stride:<entries>:<degree>|stream:<streams>:<depth>}", config);
+}
+
+#endif
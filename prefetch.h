@@ -0,0 +1,184 @@
+// Hardware Prefetcher Prototypes
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ *
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ *
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ *
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ *
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ *
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ *
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ *
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ *
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ *
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include<string>
+#include<vector>
+
+#include"host.h"
+#include"misc.h"
+#include"machine.h"
+
+//Hardware prefetchers, attached to a cache_t (see cache_t::set_prefetcher)
+//The cache reports each demand read to its prefetcher, which answers with the blocks to prefetch. The cache
+//issues those that are not already cached or in flight, as long as it has a free MSHR, over the same bus as
+//its misses.
+
+//what a demand read found in the cache
+enum prefetch_event
+{
+	PF_MISS,			//the block was not in the cache
+	PF_HIT,				//the block was in the cache
+	PF_PREFETCH_HIT			//first demand hit on a block brought in by a prefetch
+};
+
+class prefetcher_t
+{
+	public:
+		prefetcher_t(std::string config, unsigned int bsize);
+		virtual ~prefetcher_t();
+
+		//observe a demand read of ADDR by the instruction at PC (0 if unknown) for CONTEXT_ID, appends the
+		//block addresses to prefetch to PREFETCHES
+		virtual void access(md_addr_t pc, md_addr_t addr, int context_id, prefetch_event event,
+			std::vector<md_addr_t> & prefetches) = 0;
+
+		std::string config;		//configuration string, as given to prefetch_parser
+		unsigned int bsize;		//block size of the cache
+
+	protected:
+		//block address of ADDR
+		md_addr_t baddr(md_addr_t addr) const
+		{
+			return addr & ~(md_addr_t)(bsize - 1);
+		}
+};
+
+//Next-line (tagged) prefetcher: a miss, or the first hit on a prefetched block, prefetches the next DEGREE blocks
+class nextline_prefetcher_t : public prefetcher_t
+{
+	public:
+		nextline_prefetcher_t(std::string config, unsigned int bsize, unsigned int degree);
+
+		void access(md_addr_t pc, md_addr_t addr, int context_id, prefetch_event event,
+			std::vector<md_addr_t> & prefetches);
+
+		unsigned int degree;		//blocks to prefetch ahead
+};
+
+//Stride prefetcher: a reference prediction table indexed by the PC of the load, once the same stride is seen
+//twice in a row, each access prefetches DEGREE strides ahead. Accesses without a PC (the lower levels) train
+//the entry of their page instead.
+class stride_prefetcher_t : public prefetcher_t
+{
+	public:
+		stride_prefetcher_t(std::string config, unsigned int bsize, unsigned int entries, unsigned int degree);
+
+		void access(md_addr_t pc, md_addr_t addr, int context_id, prefetch_event event,
+			std::vector<md_addr_t> & prefetches);
+
+		unsigned int degree;		//strides to prefetch ahead
+
+	private:
+		static const int STRIDE_CONFIDENT = 2;	//confidence needed to prefetch
+		static const int STRIDE_MAX_CONFIDENCE = 3;
+
+		class entry_t
+		{
+			public:
+				entry_t()
+				: key(0), context_id(-1), last_addr(0), stride(0), confidence(0)
+				{}
+				md_addr_t key;		//PC (or page) trained by this entry
+				int context_id;		//owner of the entry
+				md_addr_t last_addr;	//last address accessed
+				long long stride;	//last stride seen
+				int confidence;		//times the stride repeated, saturating
+		};
+
+		std::vector<entry_t> table;	//direct mapped on the key
+};
+
+//Stream prefetcher: a set of stream buffers, two misses to adjacent blocks start a stream in their
+//direction that keeps DEPTH blocks prefetched ahead of the demand reads that follow it. Streams are
+//replaced LRU.
+class stream_prefetcher_t : public prefetcher_t
+{
+	public:
+		stream_prefetcher_t(std::string config, unsigned int bsize, unsigned int streams, unsigned int depth);
+
+		void access(md_addr_t pc, md_addr_t addr, int context_id, prefetch_event event,
+			std::vector<md_addr_t> & prefetches);
+
+		unsigned int depth;		//blocks kept prefetched ahead of a stream
+
+	private:
+		class stream_t
+		{
+			public:
+				stream_t()
+				: valid(false), confirmed(false), context_id(-1), last(0), next(0), direction(0), lru(0)
+				{}
+				bool valid;
+				bool confirmed;		//the direction is known, the stream is prefetching
+				int context_id;		//owner of the stream
+				md_addr_t last;		//last block demanded from the stream
+				md_addr_t next;		//next block to prefetch
+				long long direction;	//+bsize or -bsize
+				counter_t lru;		//time of the last use, for replacement
+		};
+
+		//prefetch from S->next up to DEPTH blocks past its last demanded block
+		void issue(stream_t *s, std::vector<md_addr_t> & prefetches);
+
+		std::vector<stream_t> streams;
+		counter_t uses;			//stream uses, orders the LRU stamps
+};
+
+//returns the prefetcher described by CONFIG for a cache with BSIZE byte blocks, NULL for "none", fatal if CONFIG
+//is malformed, the formats are:
+//	nextline:<degree>
+//	stride:<entries>:<degree>
+//	stream:<streams>:<depth>
+prefetcher_t * prefetch_parser(const char *config, unsigned int bsize);
+
+#endif
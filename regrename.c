@@ -59,18 +59,200 @@ reg_set::reg_set()
 : src1(REG_NONE), src2(REG_NONE), dest(), load(0), store(0)
 {};
 
+#define FREE_MAP_BITS	64
+
 physical_reg_file::physical_reg_file()
+: free_regs(0)
 {};
 
+physical_reg_file::physical_reg_file(const physical_reg_file & source)
+: data(source.data), free_regs(0), in_flight_count(source.in_flight_count)
+{
+	for(int kind=0;kind<WAKE_KINDS;kind++)
+	{
+		wakeups[kind] = source.wakeups[kind];
+	}
+	bind();
+}
+
+physical_reg_file & physical_reg_file::operator=(const physical_reg_file & source)
+{
+	if(this != &source)
+	{
+		//unbind first, the element-wise copy must not be counted or scheduled again
+		for(size_t i=0;i<data.size();i++)
+		{
+			data[i].state.owner = NULL;
+			data[i].spec_ready.owner = NULL;
+		}
+		data = source.data;
+		in_flight_count = source.in_flight_count;
+		for(int kind=0;kind<WAKE_KINDS;kind++)
+		{
+			wakeups[kind] = source.wakeups[kind];
+		}
+		bind();
+	}
+	return *this;
+}
+
 void physical_reg_file::resize(int size)
 {
 	data.resize(size);
+	bind();
+}
+
+void physical_reg_file::bind()
+{
+	free_map.assign((data.size() + FREE_MAP_BITS - 1) / FREE_MAP_BITS, 0);
+	free_regs = 0;
+	for(size_t i=0;i<data.size();i++)
+	{
+		data[i].state.owner = this;
+		data[i].state.index = i;
+		data[i].spec_ready.owner = this;
+		data[i].spec_ready.index = i;
+		if(data[i].state == REG_FREE)
+		{
+			free_map[i / FREE_MAP_BITS] |= 1ULL << (i % FREE_MAP_BITS);
+			free_regs++;
+		}
+	}
+}
+
+int physical_reg_file::in_flight(int context_id) const
+{
+	if(context_id < 0 || context_id >= static_cast<int>(in_flight_count.size()))
+	{
+		return 0;
+	}
+	return in_flight_count[context_id];
+}
+
+void physical_reg_file::state_change(unsigned int index, reg_state old_state, reg_state new_state)
+{
+	//a newly allocated register starts without consumers
+	if((new_state == REG_ALLOC) && (old_state != REG_ALLOC))
+	{
+		for(int kind=0;kind<WAKE_KINDS;kind++)
+		{
+			data[index].consumers[kind].clear();
+		}
+	}
+
+	//maintain the free map, registers are freed at commit (old mapping) and on squash
+	if((old_state == REG_FREE) != (new_state == REG_FREE))
+	{
+		unsigned long long bit = 1ULL << (index % FREE_MAP_BITS);
+		if(new_state == REG_FREE)
+		{
+			assert(!(free_map[index / FREE_MAP_BITS] & bit));
+			free_map[index / FREE_MAP_BITS] |= bit;
+			free_regs++;
+		}
+		else
+		{
+			assert(free_map[index / FREE_MAP_BITS] & bit);
+			free_map[index / FREE_MAP_BITS] &= ~bit;
+			free_regs--;
+		}
+	}
+
+	bool was_in_flight = (old_state == REG_ALLOC) || (old_state == REG_WB);
+	bool is_in_flight = (new_state == REG_ALLOC) || (new_state == REG_WB);
+	int context_id = data[index].context_id;
+	if((was_in_flight == is_in_flight) || (context_id < 0))
+	{
+		return;
+	}
+	if(context_id >= static_cast<int>(in_flight_count.size()))
+	{
+		in_flight_count.resize(context_id + 1, 0);
+	}
+	if(is_in_flight)
+	{
+		in_flight_count[context_id]++;
+	}
+	else
+	{
+		in_flight_count[context_id]--;
+		assert(in_flight_count[context_id] >= 0);
+	}
 }
 
 physreg_t::physreg_t()
-: state(REG_FREE), ready(0), spec_ready(0), alloc_cycle(0)
+: context_id(-1), state(), ready(0), spec_ready(), alloc_cycle(0)
+{};
+
+void physical_reg_file::spec_ready_change(unsigned int index, tick_t when)
+{
+	//__LONG_LONG_MAX__ means not yet known, consumers wait for the next assignment
+	if(when == __LONG_LONG_MAX__)
+	{
+		return;
+	}
+	for(int kind=0;kind<WAKE_KINDS;kind++)
+	{
+		std::vector<RS_link> & consumers = data[index].consumers[kind];
+		for(size_t i=0;i<consumers.size();i++)
+		{
+			schedule(consumers[i].rs, consumers[i].x.seq, when, static_cast<wakeup_kind>(kind));
+		}
+	}
+}
+
+bool physical_reg_file::watch(unsigned int index, ROB_entry *rs, wakeup_kind kind)
+{
+	physreg_t & target = data[index];
+	std::vector<RS_link> & consumers = target.consumers[kind];
+	for(size_t i=0;i<consumers.size();i++)
+	{
+		if((consumers[i].rs == rs) && (consumers[i].x.seq == rs->seq))
+		{
+			return false;
+		}
+	}
+	RS_link consumer(rs);
+	consumer.x.seq = rs->seq;
+	consumers.push_back(consumer);
+	if(target.spec_ready != __LONG_LONG_MAX__)
+	{
+		schedule(rs, rs->seq, target.spec_ready, kind);
+	}
+	return true;
+}
+
+void physical_reg_file::schedule(ROB_entry *rs, INST_SEQ_TYPE seq, tick_t when, wakeup_kind kind)
+{
+	wakeups[kind].insert(when, wakeup_event_t(rs, seq, when));
+}
+
+void physical_reg_file::due_wakeups(tick_t now, std::vector<ROB_entry *> & out, wakeup_kind kind)
+{
+	due.clear();
+	wakeups[kind].drain(now, due);
+	for(size_t i=0;i<due.size();i++)
+	{
+		if(due[i].rs->seq == due[i].seq)
+		{
+			out.push_back(due[i].rs);
+		}
+	}
+}
+
+wakeup_event_t::wakeup_event_t()
+: when(0), rs(NULL), seq(0)
+{};
+
+wakeup_event_t::wakeup_event_t(ROB_entry *rs, INST_SEQ_TYPE seq, tick_t when)
+: when(when), rs(rs), seq(seq)
 {};
 
+bool wakeup_event_t::operator==(const wakeup_event_t & rhs) const
+{
+	return (rs == rhs.rs) && (seq == rhs.seq) && (when == rhs.when);
+}
+
 physreg_t & physical_reg_file::operator[](unsigned int index)
 {
 	return *(&data[index]);
@@ -83,13 +265,18 @@ const physreg_t & physical_reg_file::operator[](unsigned int index) const
 
 int physical_reg_file::find_free_physreg()
 {
-	for(int i = 0; i<static_cast<int>(data.size()); i++)
+	if(!free_regs)
 	{
-		if(data[i].state == REG_FREE)
+		return -1;
+	}
+	for(size_t i = 0; i<free_map.size(); i++)
+	{
+		if(free_map[i])
 		{
-			return i;
+			return (i * FREE_MAP_BITS) + __builtin_ctzll(free_map[i]);
 		}
 	}
+	assert(0);
 	return -1;
 }
 
@@ -131,6 +318,77 @@ physreg_t & reg_file_t::reg_file_access(int index,reg_type type)
 	}
 }
 
+int reg_file_t::free_count(reg_type type) const
+{
+	if(type==REG_INT)
+	{
+		return intregs.free_count();
+	}
+	else
+	{
+		return fpregs.free_count();
+	}
+}
+
+int reg_file_t::in_flight(int context_id,reg_type type) const
+{
+	if(type==REG_INT)
+	{
+		return intregs.in_flight(context_id);
+	}
+	else
+	{
+		return fpregs.in_flight(context_id);
+	}
+}
+
+bool reg_file_t::watch(ROB_entry *rs, tick_t now)
+{
+	return watch(rs, rs, WAKE_ISSUE, now);
+}
+
+void reg_file_t::watch_load(ROB_entry *load, ROB_entry *blocker, tick_t now)
+{
+	watch(blocker, load, WAKE_LSQ, now);
+}
+
+bool reg_file_t::watch(ROB_entry *rs, ROB_entry *waiter, wakeup_kind kind, tick_t now)
+{
+	bool pending = false, added = false;
+	//address computations only wait on operand 1 (see all_operands_spec_ready)
+	for(int op_num = (rs->ea_comp ? 1 : 0); op_num < 2; op_num++)
+	{
+		reg_type type = src_type(rs->op, op_num);
+		if((rs->src_physreg[op_num] < 0) || (type == REG_NONE))
+		{
+			continue;
+		}
+		physical_reg_file & regs = (type == REG_INT) ? intregs : fpregs;
+		if(regs[rs->src_physreg[op_num]].spec_ready > now)
+		{
+			added |= regs.watch(rs->src_physreg[op_num], waiter, kind);
+			pending = true;
+		}
+	}
+	if(!pending)
+	{
+		intregs.schedule(waiter, waiter->seq, now, kind);
+	}
+	return added;
+}
+
+void reg_file_t::due_wakeups(tick_t now, std::vector<ROB_entry *> & out)
+{
+	intregs.due_wakeups(now, out, WAKE_ISSUE);
+	fpregs.due_wakeups(now, out, WAKE_ISSUE);
+}
+
+void reg_file_t::due_load_wakeups(tick_t now, std::vector<ROB_entry *> & out)
+{
+	intregs.due_wakeups(now, out, WAKE_LSQ);
+	fpregs.due_wakeups(now, out, WAKE_LSQ);
+}
+
 // Allocates a physical register to the specified ROB entry
 int reg_file_t::alloc_physreg(ROB_entry* rob_entry,tick_t sim_cycle,std::vector<int> & rename_table)
 {
@@ -155,6 +413,7 @@ int reg_file_t::alloc_physreg(ROB_entry* rob_entry,tick_t sim_cycle,std::vector<
 		target = &fpregs.data[rob_entry->physreg];
 	}
 	assert(target->state==REG_FREE);
+	target->context_id = rob_entry->context_id;
 	target->state = REG_ALLOC;
 	target->alloc_cycle = sim_cycle;
 	target->spec_ready = __LONG_LONG_MAX__;;
@@ -167,8 +426,8 @@ int reg_file_t::alloc_physreg(ROB_entry* rob_entry,tick_t sim_cycle,std::vector<
 	return rob_entry->physreg;
 }
 
-//Returns the set of register types used by a specific operation
-void reg_file_t::get_reg_set(reg_set* my_regs, md_opcode op)
+//Decodes the set of register types used by a specific operation, only used to build reg_set_table
+static void decode_reg_set(reg_set* my_regs, md_opcode op)
 {
 	my_regs->src1 = REG_NONE;
 	my_regs->src2 = REG_NONE;
@@ -543,4 +802,82 @@ void reg_file_t::get_reg_set(reg_set* my_regs, md_opcode op)
 		break;
 	}
 }
+
+//register sets of every opcode, decoded once at startup so get_reg_set is a table lookup
+reg_set reg_set_table[OP_MAX];
+
+class reg_set_table_init
+{
+	public:
+		reg_set_table_init()
+		{
+			for(int op=0;op<OP_MAX;op++)
+			{
+				decode_reg_set(&reg_set_table[op], (md_opcode)op);
+			}
+		}
+};
+
+static reg_set_table_init reg_set_table_initializer;
+
+#ifdef BENCH
+//Host cost of the operand type checks done for every instruction in the window every cycle, decoding the
+//register set of the opcode each time (as get_reg_set did) against reading it from reg_set_table:
+//	regrename-bench [<window> [<cycles>]]
+#include<cstdio>
+#include<cstdlib>
+#include<vector>
+#include<sys/time.h>
+
+static double bench_seconds()
+{
+	timeval now;
+	gettimeofday(&now, NULL);
+	return now.tv_sec + now.tv_usec * 1e-6;
+}
+
+int main(int argc, char **argv)
+{
+	int window = (argc > 1) ? atoi(argv[1]) : 128;
+	int cycles = (argc > 2) ? atoi(argv[2]) : 200000;
+	if((window < 1) || (cycles < 1))
+		fatal("usage: regrename-bench [<window> [<cycles>]]");
+
+	//a window of random opcodes, each cycle the window moves on by one entry
+	std::vector<md_opcode> ops(window);
+	srand(1);
+	for(int i=0;i<window;i++)
+	{
+		ops[i] = (md_opcode)(1 + rand() % (OP_MAX - 1));
+	}
+
+	long long sum = 0;
+	double start = bench_seconds();
+	for(int c=0;c<cycles;c++)
+	{
+		for(int i=0;i<window;i++)
+		{
+			reg_set my_regs;
+			decode_reg_set(&my_regs, ops[(c + i) % window]);
+			sum += my_regs.src1 + my_regs.src2;
+		}
+	}
+	double decoded = bench_seconds() - start;
+
+	start = bench_seconds();
+	for(int c=0;c<cycles;c++)
+	{
+		for(int i=0;i<window;i++)
+		{
+			md_opcode op = ops[(c + i) % window];
+			sum += reg_file_t::src_type(op, 0) + reg_file_t::src_type(op, 1);
+		}
+	}
+	double table = bench_seconds() - start;
+
+	printf("window %d, %d cycles: decode %.1f ns/cycle, reg_set_table %.1f ns/cycle (checksum %lld)\n",
+		window, cycles, decoded * 1e9 / cycles, table * 1e9 / cycles, sum);
+	return 0;
+}
+#endif
 #endif
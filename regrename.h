@@ -79,32 +79,178 @@ class reg_set
 		int store;		//is a store?
 };
 
+//register sets of every opcode, indexed by md_opcode (see reg_file_t::get_reg_set)
+extern reg_set reg_set_table[OP_MAX];
+
+class physical_reg_file;
+
+//The state of a physical register
+//Assignments are reported to the owning physical_reg_file, which keeps its per-thread
+//counts of in-flight registers consistent however the state is changed (rename, writeback,
+//commit or a squash in core_t::rollbackTo)
+class physreg_state_t
+{
+	public:
+		physreg_state_t()
+		: value(REG_FREE), owner(NULL), index(0)
+		{}
+
+		inline physreg_state_t & operator=(reg_state new_state);
+
+		//copies the state only, the target stays bound to its own register file
+		inline physreg_state_t & operator=(const physreg_state_t & rhs)
+		{
+			return operator=(rhs.value);
+		}
+
+		inline operator reg_state() const
+		{
+			return value;
+		}
+
+	private:
+		reg_state value;		//the current state
+		physical_reg_file *owner;	//register file this register belongs to
+		unsigned int index;		//index of this register in owner
+
+		friend class physical_reg_file;
+};
+
+//The speculative ready time of a physical register
+//Assignments are reported to the owning physical_reg_file, which schedules the waiting consumers
+//of the register for wakeup at the new time (issue, load-latency prediction, replay or writeback)
+class physreg_spec_ready_t
+{
+	public:
+		physreg_spec_ready_t()
+		: value(0), owner(NULL), index(0)
+		{}
+
+		inline physreg_spec_ready_t & operator=(tick_t when);
+
+		//copies the time only, the target stays bound to its own register file
+		inline physreg_spec_ready_t & operator=(const physreg_spec_ready_t & rhs)
+		{
+			return operator=(rhs.value);
+		}
+
+		inline operator tick_t() const
+		{
+			return value;
+		}
+
+	private:
+		tick_t value;			//the current time
+		physical_reg_file *owner;	//register file this register belongs to
+		unsigned int index;		//index of this register in owner
+
+		friend class physical_reg_file;
+};
+
+//A request to re-check the operands of a waiting instruction at cycle when
+class wakeup_event_t
+{
+	public:
+		wakeup_event_t();
+		wakeup_event_t(ROB_entry *rs, INST_SEQ_TYPE seq, tick_t when);
+		bool operator==(const wakeup_event_t & rhs) const;
+
+		tick_t when;
+		ROB_entry *rs;
+		INST_SEQ_TYPE seq;	//instance tag, the event is stale once rs->seq no longer matches
+};
+
+//Who the consumers of a register are woken for: wakeup() checks the instructions on the waiting_queue,
+//lsq_refresh() the loads blocked in the LSQ (on their own operands or on the data of an older store)
+enum wakeup_kind {WAKE_ISSUE = 0, WAKE_LSQ, WAKE_KINDS};
+
 //A physical register - only contains state for now
 
 class physreg_t
 {
 	public:
 		physreg_t();
-		reg_state state;	//the state the register is currently in
+		int context_id;		//the context this register was last allocated to (-1 if never renamed)
+		physreg_state_t state;	//the state the register is currently in
 		tick_t ready;		//earliest cycle in which the data will be available for read off bypass network
-		tick_t spec_ready;	//earliest cycle instructions dependant on this register should issue (speculative on loads
+		physreg_spec_ready_t spec_ready;	//earliest cycle instructions dependant on this register should issue (speculative on loads
 		tick_t alloc_cycle;
+		std::vector<RS_link> consumers[WAKE_KINDS];	//instructions that waited on this register since it was allocated (x.seq is the instance tag)
 };
 
 class physical_reg_file
 {
 	public:
 		physical_reg_file();
+		physical_reg_file(const physical_reg_file & source);
+		physical_reg_file & operator=(const physical_reg_file & source);
 		void resize(int size);
 
 		physreg_t & operator[](unsigned int index);
 		const physreg_t & operator[](unsigned int index) const;
 
+		//returns the lowest numbered free register, -1 if none are free
 		int find_free_physreg();
 
+		//number of registers in REG_FREE
+		inline int free_count() const
+		{
+			return free_regs;
+		}
+
+		//number of registers context_id holds in REG_ALLOC or REG_WB (renamed, not yet committed)
+		int in_flight(int context_id) const;
+
+		//called on every state assignment of register index
+		void state_change(unsigned int index, reg_state old_state, reg_state new_state);
+
+		//called on every spec_ready assignment of register index, schedules its consumers for wakeup at when
+		void spec_ready_change(unsigned int index, tick_t when);
+
+		//records rs as a kind consumer of register index, rs is scheduled for wakeup whenever the register's spec_ready is set,
+		//returns false if it already was one
+		bool watch(unsigned int index, ROB_entry *rs, wakeup_kind kind);
+
+		//schedules rs for a kind wakeup at cycle when
+		void schedule(ROB_entry *rs, INST_SEQ_TYPE seq, tick_t when, wakeup_kind kind);
+
+		//appends the instructions scheduled for a kind wakeup by cycle now to out (stale events are dropped)
+		void due_wakeups(tick_t now, std::vector<ROB_entry *> & out, wakeup_kind kind);
+
 		std::vector<physreg_t> data;
+
+	private:
+		//points every register's state back at this register file and rebuilds the free map
+		void bind();
+
+		std::vector<unsigned long long> free_map;	//one bit per register, set when the register is free
+		int free_regs;					//number of bits set in free_map
+		std::vector<int> in_flight_count;		//per-context registers in REG_ALLOC or REG_WB
+		timing_wheel_t<wakeup_event_t> wakeups[WAKE_KINDS];	//pending wakeups of consumers
+		std::vector<wakeup_event_t> due;			//the wakeups due_wakeups() drained
 };
 
+inline physreg_state_t & physreg_state_t::operator=(reg_state new_state)
+{
+	reg_state old_state = value;
+	value = new_state;
+	if(owner)
+	{
+		owner->state_change(index, old_state, new_state);
+	}
+	return *this;
+}
+
+inline physreg_spec_ready_t & physreg_spec_ready_t::operator=(tick_t when)
+{
+	value = when;
+	if(owner)
+	{
+		owner->spec_ready_change(index, when);
+	}
+	return *this;
+}
+
 class reg_file_t
 {
 	public:
@@ -117,14 +263,49 @@ class reg_file_t
 
 		physreg_t & reg_file_access(int index,reg_type type);
 
+		//number of free type registers
+		int free_count(reg_type type) const;
+
+		//number of type registers context_id holds in REG_ALLOC or REG_WB (renamed, not yet committed)
+		int in_flight(int context_id,reg_type type) const;
+
+		//registers a waiting instruction for event-driven wakeup: rs becomes a consumer of every source
+		//register that is not speculatively ready at now, if none are pending it is checked at now.
+		//Returns true if rs was not yet a consumer of one of the pending registers
+		bool watch(ROB_entry *rs, tick_t now);
+
+		//registers a blocked load for event-driven lsq_refresh(): load is checked again when a source register of
+		//blocker (the load itself, or the older store whose data it waits for) that is not speculatively ready at now
+		//gets a speculative ready time, if none are pending it is checked at now
+		void watch_load(ROB_entry *load, ROB_entry *blocker, tick_t now);
+
+		//appends the instructions due for a wakeup check by cycle now to out
+		void due_wakeups(tick_t now, std::vector<ROB_entry *> & out);
+
+		//appends the loads due for an lsq_refresh() check by cycle now to out
+		void due_load_wakeups(tick_t now, std::vector<ROB_entry *> & out);
+
 		// Allocates a physical register to the specified ROB entry
 		int alloc_physreg(ROB_entry* rob_entry,tick_t sim_cycle,std::vector<int> & rename_table);
 
 		//Returns the set of register types used by a specific operation
 		//This doesn't need to be in reg_file_t, but is for isolation purposes
-		void get_reg_set(reg_set* my_regs, md_opcode op);
+		inline void get_reg_set(reg_set* my_regs, md_opcode op)
+		{
+			*my_regs = reg_set_table[op];
+		}
+
+		//Returns the register type of source op_num (0 or 1) of a specific operation
+		static inline reg_type src_type(md_opcode op, int op_num)
+		{
+			return op_num ? reg_set_table[op].src2 : reg_set_table[op].src1;
+		}
 
 		physical_reg_file intregs,fpregs;
+
+	private:
+		//makes waiter a kind consumer of the source registers of rs not speculatively ready at now (see watch())
+		bool watch(ROB_entry *rs, ROB_entry *waiter, wakeup_kind kind, tick_t now);
 };
 
 
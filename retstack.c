@@ -1,5 +1,7 @@
 #include"retstack.h"
 
+#include<iostream>
+
 retstack_t::retstack_t(size_t retstack_size)
 : size(retstack_size), tos(size-1), pops(0), pushes(0)
 {
@@ -65,3 +67,35 @@ void retstack_t::reset()
 {
 	pushes = pops = 0;
 }
+
+std::ostream & operator<<(std::ostream & out, const retstack_t & source)
+{
+	out << "(" << std::dec << source.size << " " << source.tos << std::hex;
+	for(size_t i=0;i<source.stack.size();i++)
+	{
+		out << " " << source.stack[i].addr << " " << source.stack[i].target;
+	}
+	out << std::dec << ")";
+	return out;
+}
+
+std::istream & operator>>(std::istream & in, retstack_t & target)
+{
+	char c_buf;
+	size_t size;
+	in >> c_buf >> std::dec >> size >> target.tos >> std::hex;
+	if(size != target.size)
+	{
+		fatal("checkpoint return address stack has %d entries, this one has %d", (int)size, (int)target.size);
+	}
+	for(size_t i=0;i<target.stack.size();i++)
+	{
+		in >> target.stack[i].addr >> target.stack[i].target;
+	}
+	in >> std::dec >> c_buf;
+	if(c_buf != ')')
+	{
+		fatal("bad return address stack in checkpoint");
+	}
+	return in;
+}
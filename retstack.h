@@ -7,6 +7,7 @@
 #include"stats.h"
 #include"btb.h"
 #include<vector>
+#include<iosfwd>
 
 class retstack_t
 {
@@ -41,4 +42,8 @@ class retstack_t
 		void clear();
 };
 
+//checkpoint the stack contents (the stats are not saved), reading checks the size matches
+std::ostream & operator<<(std::ostream & out, const retstack_t & source);
+std::istream & operator>>(std::istream & in, retstack_t & target);
+
 #endif
@@ -57,12 +57,17 @@
 #include<list>
 #include<functional>
 
+ROB_state::ROB_state()
+: val_ra(0), val_rb(0), val_rc(0), val_ra_result(0), regs_R(0), regs_index(0), previous_mem(0), data_size(0), is_store(0)
+{}
+
 ROB_entry::ROB_entry()
-: IR(0), op(MD_NOP_OP), PC(0), next_PC(0), pred_PC(0), in_LSQ(0), LSQ_index(0), ea_comp(0), recover_inst(0),
-stack_recover_idx(0), spec_mode(0), addr(0), seq(0), ptrace_seq(0), val_ra(0), val_rb(0), val_rc(0), val_ra_result(0),
-slip(0), exec_lat(0), dispatched(0), queued(0), issued(0), completed(0), replayed(0), context_id(-1), iq_entry_num(-1), in_IQ(0),
-disp_cycle(-1), rename_cycle(-1), physreg(-1), old_physreg(-1), dest_format(REG_NONE), archreg(0),
-L1_miss(0), L2_miss(0), L3_miss(0), regs_R(0), regs_index(0), previous_mem(0), data_size(0), is_store(0)
+: op(MD_NOP_OP), in_LSQ(0), LSQ_index(0), ea_comp(0), addr(0), seq(0), exec_lat(0),
+dispatched(0), queued(0), issued(0), completed(0), replayed(0), context_id(-1), iq_entry_num(-1), in_IQ(0),
+physreg(-1), dest_format(REG_NONE), recover_inst(0), spec_mode(0),
+IR(0), PC(0), next_PC(0), pred_PC(0), stack_recover_idx(0), ptrace_seq(0),
+slip(0), disp_cycle(-1), rename_cycle(-1), old_physreg(-1), archreg(0),
+L1_miss(0), L2_miss(0), L3_miss(0)
 {
 	src_physreg[0] = src_physreg[1] = -1;
 	src_archreg[0] = src_archreg[1] = 0;
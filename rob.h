@@ -55,6 +55,7 @@
 #include "regs.h"
 #include "bpreds.h"
 #include<list>
+#include"inflightq.h"
 
 //inst sequence type, used to order instructions in the ready list, if
 //	this rolls over the ready list order temporarily will get messed up,
@@ -64,35 +65,54 @@ typedef unsigned long long INST_SEQ_TYPE;
 //total output dependencies possible, only 1 of the 2 used by Alpha
 #define MAX_ODEPS               2
 
+//The cold state of a re-order buffer (ROB) entry: the values a rollback restores and the Wattch operand values,
+//written at rename and read only when rolling back and for activity factor accounting. In the default layout an
+//ROB_entry carries it (ROB_entry derives from it), with -DROB_SPLIT it is kept in arrays of its own next to the
+//context's ROB and LSQ, context::state_of() finds the state of an entry in either layout
+class ROB_state {
+public:
+	ROB_state();
+
+	//Wattch: values of source operands and result operand used for AF generation
+	quad_t val_ra, val_rb, val_rc, val_ra_result;
+
+	//For walk-through rollback, this should ultimately replace spec_mode
+	//These should represent the old values, and must be retained before instruction execution
+	qword_t regs_R;					//Integer register data
+	md_fpr_t regs_F;				//Floating point register data
+	md_ctrl_t regs_C;				//Control flags
+	int regs_index;					//index for the register (if >32, then -32 and use fp)
+	//These are for precise state rollback
+	qword_t previous_mem;				//Data before store occurred
+	size_t data_size;
+	bool is_store;					//Is this a store? (Did it write to memory?)
+};
+
 //A re-order buffer (ROB) entry, this record is contained in the program order.
 //	NOTE: the ROB and LSQ share the same structure, this is useful because
 //	loads and stores are split into two operations: an effective address
 //	add and a load/store, the add is inserted into the ROB and the load/store
 //	inserted into the LSQ, allowing the add to wake up the load/store when
 //	effective address computation has finished
+#ifdef ROB_SPLIT
 class ROB_entry {
+#else
+class ROB_entry : public ROB_state {
+#endif
 public:
 	ROB_entry();
 
-	//instruction info
-	md_inst_t IR;					//instruction bits
+	//Fields are grouped by use: the scheduling state read by the per-cycle scans (lsq_refresh(), wakeup/selection,
+	//dispatch and commit) comes first so it shares the first cache lines of an entry, the state only touched on
+	//rename, writeback and commit follows it (rollback and power state is in ROB_state)
+
+	//scheduling state (hot)
 	enum md_opcode op;				//decoded instruction opcode
-	md_addr_t PC, next_PC, pred_PC;			//inst PC, next PC, predicted PC
 	int in_LSQ;
 	int LSQ_index;					//non-zero if op is in LSQ
 	int ea_comp;					//non-zero if op is an addr comp
-	int recover_inst;				//start of mis-speculation?
-	int stack_recover_idx;				//non-speculative TOS for RSB pred
-	bpred_update_t dir_update;			//bpred direction update info
-	int spec_mode;					//non-zero if issued in spec_mode
 	md_addr_t addr;					//effective address for ld/st's
 	INST_SEQ_TYPE seq;				//instruction sequence, used to sort the ready list and tag inst
-	unsigned long long ptrace_seq;			//pipetrace sequence number
-
-	//Wattch: values of source operands and result operand used for AF generation
-	quad_t val_ra, val_rb, val_rc, val_ra_result;
-
-	int slip;
 	int exec_lat;					//execution latency
 
 	//instruction status
@@ -105,31 +125,33 @@ public:
 	int context_id;					//the id of the context this entry belongs to
 	int iq_entry_num;				//the IQ entry number allocated to this entry (or -1 if no entry is allocated)
 	int in_IQ;					//flag - is the instruction currently in the IQ?
-	long long disp_cycle;				//the cycle this instruction was dispatched
-	long long rename_cycle;				//the cycle this instruction was renameded
 
 	int physreg;					//the physical register assigned for the instructions destination (-1 if NA)
-	int old_physreg;				//the physical register assigned for the instructions destination (-1 if NA)
 	int src_physreg[2];				//physical register sources for the inst. (-1 if NA)
-
 	enum reg_type dest_format;			//the type of destination register used (none, int, or fp)
 
+	int recover_inst;				//start of mis-speculation?
+	int spec_mode;					//non-zero if issued in spec_mode
+
+	//instruction info (cold)
+	md_inst_t IR;					//instruction bits
+	md_addr_t PC, next_PC, pred_PC;			//inst PC, next PC, predicted PC
+	int stack_recover_idx;				//non-speculative TOS for RSB pred
+	bpred_update_t dir_update;			//bpred direction update info
+	unsigned long long ptrace_seq;			//pipetrace sequence number
+
+	int slip;
+
+	long long disp_cycle;				//the cycle this instruction was dispatched
+	long long rename_cycle;				//the cycle this instruction was renameded
+
+	int old_physreg;				//the physical register assigned for the instructions destination (-1 if NA)
+
 	int archreg;					//the architectural register destination (0 if NA)
 	int src_archreg[2];				//the architectural source registers (0 if NA)
 
 	//useful instruction state bits
 	int L1_miss,L2_miss,L3_miss;			//Did this instruction miss into one of the D-caches?
-
-	//For walk-through rollback, this should ultimately replace spec_mode
-	//These should represent the old values, and must be retained before instruction execution
-	qword_t regs_R;					//Integer register data
-	md_fpr_t regs_F;				//Floating point register data
-	md_ctrl_t regs_C;				//Control flags
-	int regs_index;					//index for the register (if >32, then -32 and use fp)
-	//These are for precise state rollback
-	qword_t previous_mem;				//Data before store occurred
-	size_t data_size;
-	bool is_store;					//Is this a store? (Did it write to memory?)
 };
 
 //RS_LINK defintions and declarations
@@ -172,4 +194,16 @@ class seq_sort : public std::binary_function<RS_link,RS_link,bool>
 	        }
 };
 
+//the waiting_queue (std::less<RS_link>) is searched by ROB entry when wakeup() moves an instruction out of it
+template<>
+class inflight_queue_lookup<RS_link, std::less<RS_link> >
+{
+	public:
+		static const bool indexed = true;
+		static const void * key(const RS_link & element)
+		{
+			return element.rs;
+		}
+};
+
 #endif
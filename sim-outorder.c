@@ -88,83 +88,55 @@
 
 #include "sim-outorder.h"
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <fstream>
+
+simulator_t::simulator_t()
+: max_insts(0), max_cycles(-1), fastfwd_count(0), sim_ff_insn(0), sim_ff_time(0.0), sim_invalid_addrs(0), inst_seq(0), sim_num_insn(0), loader(sim_num_insn), mmap_base(MEM_MMAP_BASE), batch_job(false),
+num_contexts(0), contexts_at_init_time(0), num_cores(0), cores_at_init_time(0), max_contexts_per_core(0), cache_il3(NULL), cache_dl3(NULL),
+cache_dl3_opt(NULL), cache_il3_opt(NULL), cache_dl3_lat(0), cache_il3_lat(0),
+cache_dl1_mshrs(0), cache_dl2_mshrs(0), cache_il1_mshrs(0), cache_il2_mshrs(0), cache_dl3_mshrs(0), cache_il3_mshrs(0),
+cache_dl1pf_opt(NULL), cache_dl2pf_opt(NULL), cache_dl2part_opt(NULL), cache_dl3part_opt(NULL),
+cache_dl2occ_nelt(1), cache_dl3occ_nelt(1), main_mem(NULL), main_mem_config(NULL), dram_ctrl(NULL), eio_name(NULL),
+chkpt_write_name(NULL), chkpt_warm(FALSE), chkpt_text(FALSE), chkpt_read_name(NULL), fanout_name(NULL),
+ptrace_nelt(0), pcstat_nelt(0), print_power_stats(FALSE), load_core(-1), cap_policy(MAX_CONTEXTS),
+shared_mem_cycles(0), shared_mem_reads(0), shared_mem_seed(0), shared_replayed(0), shared_estimate_mismatch(0), shared_estimate_error(0),
+options(NULL), quantum_start(0), quantum_cycles(0)
+{}
 
-int num_contexts = 0;
-int contexts_at_init_time = 0;
-std::vector<context> contexts;
-std::vector<context> ejected_contexts;
-
-unsigned int num_cores = 0;
-unsigned int cores_at_init_time = 0;
-int max_contexts_per_core = 0;
-std::vector<core_t> cores;
-
-int reg_counter[MAX_CONTEXTS] = {0};
-int reg_counter_size = 0;
-
-// per-thread limit for in-flight (renamed) physical registers
-const int RENAME_REG_LIMIT = 10;
+//the simulation the CLI runs, and the one each thread is running
+simulator_t simulator;
+__thread simulator_t * current_sim = &simulator;
 /*
  * This file implements a very detailed out-of-order issue superscalar
  * processor with a two-level memory system and speculative execution support.
  * This simulator is a performance simulator, tracking the latency of all
  * pipeline operations.
  */
-//haque edit: made non-static so other translation units can call this
-void reg_counter_decref_if_positive(int tid)
+//returns the rename registers context_id holds on its core, as seen by the cap policy
+cap_usage_t cap_usage(int context_id)
 {
-	if (tid >= 0 && tid < num_contexts && reg_counter[tid] > 0)
-		reg_counter[tid]--;
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
+	reg_file_t & reg_file = cores[contexts[context_id].core_id].reg_file;
+	int int_regs = reg_file.in_flight(context_id, REG_INT);
+	int fp_regs = reg_file.in_flight(context_id, REG_FP);
+	return cap_usage_t(int_regs + fp_regs, int_regs, fp_regs);
 }
 /**************** Simulation State *******************/
 // These variables do not need to be in a core or context object
 
-	//maximum number of insts to execute (this could be done per core/context but isn't)
-	long long max_insts;
-
-	//Maximum number of cycles to run, this can be done in tandem with max_insts
-	long long max_cycles;
-
-	//cycle counter
-	tick_t sim_cycle = 0;
-
-	//total non-speculative bogus addresses seen (debug var)
-	counter_t sim_invalid_addrs;
-
-	//L3 cache (data and inst), this is shared among all cores
-	cache_t * cache_il3=NULL, *cache_dl3=NULL;
-
-	//L3 cache config, i.e., {<config>|none} */
-	char *cache_dl3_opt;
-	//L3 cache config, i.e., {<config>|dl1|dl2|dl3|none} */
-	char *cache_il3_opt;
-
-	//L3 cache hit latency in cycles
-	int cache_dl3_lat, cache_il3_lat;
-
-	//instruction sequence counter, used to assign unique id's to insts
-	unsigned long long inst_seq = 0;
+	//cycle counter, each host thread has its own copy: the cores keep their own clock during a quantum
+	//(see core_pool.h), the main thread's copy is the simulation time
+	__thread tick_t sim_cycle = 0;
 
 	//options for Wattch
 	int data_width = 64;
 
 	long long INF = __LONG_LONG_MAX__;
 
-	//Print static power model results?
-	int print_power_stats = FALSE;
-
-	//Number of executed instructions
-	counter_t sim_num_insn = 0;
-
-	//Loader object, we give it access to sim_num_insn (not sure if we actually need to do this)
-	loader_t loader(sim_num_insn);
-
-	//process id object
-	pid_handler_t pid_handler;
-
-	//Main Memory pointer and configuration string
-	dram_t * main_mem;
-	char * main_mem_config;
 /****************************************************/
 
 /**************** Core/Context Data *******************/
@@ -172,20 +144,9 @@ void reg_counter_decref_if_positive(int tid)
 
 /******************************************************/
 
-//Filename to use when creating an eio file
-char * eio_name = NULL;
-
-//number of insts skipped before timing starts
-long long fastfwd_count;
-
-//pipeline trace range and output filename
-int ptrace_nelt = 0;
-char *ptrace_opts[2];
-
-//text-based stat profiles
-#define MAX_PCSTAT_VARS 8
-int pcstat_nelt = 0;
-char *pcstat_vars[MAX_PCSTAT_VARS];
+//contexts that may be forked while the cores run in parallel, the contexts vector is reserved up front
+//since the other cores hold references into it
+#define PARALLEL_FORK_LIMIT 256
 
 //convert 64-bit inst text addresses to 32-bit inst equivalents
 #define IACOMPRESS(A)		(A)
@@ -241,13 +202,6 @@ res_desc fu_config[] =
 	},
 };
 
-//simulator state variables
-
-//text-based stat profiles
-stat_stat_t *pcstat_stats[MAX_PCSTAT_VARS];
-counter_t pcstat_lastvals[MAX_PCSTAT_VARS];
-stat_stat_t *pcstat_sdists[MAX_PCSTAT_VARS];
-
 //wedge all stat values into a counter_t
 #define STATVAL(STAT)							\
 	((STAT)->sc == sc_int						\
@@ -260,6 +214,109 @@ stat_stat_t *pcstat_sdists[MAX_PCSTAT_VARS];
 
 //cache miss handlers
 
+//latency of a read of main memory, by the banked controller when one is configured
+static unsigned long long main_mem_latency(md_addr_t baddr, unsigned int bsize, tick_t now, int context_id)
+{
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
+	if(current_sim->dram_ctrl)
+		return current_sim->dram_ctrl->mem_access_latency(baddr, bsize, now, context_id);
+	return cores[contexts[context_id].core_id].main_mem->mem_access_latency(baddr, bsize, now, context_id);
+}
+
+//post a write to main memory, only the banked controller queues writes
+static void main_mem_write(md_addr_t baddr, unsigned int bsize, tick_t now, int context_id)
+{
+	if(current_sim->dram_ctrl)
+		current_sim->dram_ctrl->mem_write(baddr, bsize, now, context_id);
+}
+
+unsigned long long simulator_t::shared_access(cache_t *level, mem_cmd cmd, md_addr_t baddr, unsigned int bsize, tick_t now, int context_id)
+{
+	//fast forwarding and the replays run outside of the cores' quantum
+	if((core_pool.quantum == 1) || !core_pool_t::active())
+	{
+		core_pool.ordered_enter();
+		if(level)
+			return level->cache_access(cmd, baddr, context_id, NULL, bsize, now, NULL, NULL);
+		if(cmd == Read)
+			return main_mem_latency(baddr, bsize, now, context_id);
+		main_mem_write(baddr, bsize, now, context_id);
+		return 0;
+	}
+
+	//nothing changes the shared levels until the quantum ends, they can be probed without a lock
+	shared_request_t request;
+	request.now = now;
+	request.level = level;
+	request.cmd = cmd;
+	request.baddr = baddr;
+	request.bsize = bsize;
+	request.context_id = context_id;
+	request.estimated_hit = level && level->cache_probe(baddr);
+	request.estimate = 0;
+	if(cmd == Read)
+	{
+		unsigned long long mem_lat = shared_mem_reads ? (shared_mem_cycles / shared_mem_reads) : shared_mem_seed;
+		request.estimate = level ? (level->hit_latency + (request.estimated_hit ? 0 : mem_lat)) : mem_lat;
+	}
+	shared_requests[contexts[context_id].core_id].push_back(request);
+	return request.estimate;
+}
+
+void simulator_t::replay_shared()
+{
+	std::vector<shared_request_t> requests;
+	for(unsigned int i=0;i<shared_requests.size();i++)
+	{
+		requests.insert(requests.end(), shared_requests[i].begin(), shared_requests[i].end());
+		shared_requests[i].clear();
+	}
+	//the lists are in time order, a stable sort keeps core order among equal times
+	std::stable_sort(requests.begin(), requests.end());
+
+	//the levels (and the prefetchers and partitioning behind them) may read the time from sim_cycle
+	tick_t quantum_end = sim_cycle;
+	for(unsigned int i=0;i<requests.size();i++)
+	{
+		const shared_request_t & r = requests[i];
+		sim_cycle = r.now;
+		shared_replayed++;
+		if(r.cmd != Read)
+		{
+			if(r.level)
+				r.level->cache_access(r.cmd, r.baddr, r.context_id, NULL, r.bsize, r.now, NULL, NULL);
+			else
+				main_mem_write(r.baddr, r.bsize, r.now, r.context_id);
+			continue;
+		}
+
+		unsigned long long lat;
+		bool hit = false;
+		if(r.level)
+		{
+			hit = r.level->cache_probe(r.baddr);
+			lat = r.level->cache_access(r.cmd, r.baddr, r.context_id, NULL, r.bsize, r.now, NULL, NULL);
+			if(hit != r.estimated_hit)
+				shared_estimate_mismatch++;
+		}
+		else
+		{
+			lat = main_mem_latency(r.baddr, r.bsize, r.now, r.context_id);
+		}
+
+		//reads that went to main memory calibrate the estimate of its latency
+		if(!hit)
+		{
+			unsigned long long above = r.level ? r.level->hit_latency : 0;
+			shared_mem_cycles += (lat > above) ? (lat - above) : 0;
+			shared_mem_reads++;
+		}
+		shared_estimate_error += (lat > r.estimate) ? (lat - r.estimate) : (r.estimate - lat);
+	}
+	sim_cycle = quantum_end;
+}
+
 //Where are the next level access counters here? Shouldn't they be same level? Except for L3 of course...
 //l1 data cache l1 block miss handler function
 unsigned long long			//latency of block access
@@ -270,6 +327,8 @@ dl1_access_fn(mem_cmd cmd,		//access cmd, Read or Write
 	tick_t now,			//time of access
 	int context_id)			//context_id for the access
 {
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
 	if(cores[contexts[context_id].core_id].cache_dl2)
 	{
 		//access next level of data cache hierarchy
@@ -288,11 +347,15 @@ dl1_access_fn(mem_cmd cmd,		//access cmd, Read or Write
 	}
 	else
 	{
-		//access main memory
+		//access main memory, main memory is shared among the cores
 		if(cmd == Read)
-			return cores[contexts[context_id].core_id].main_mem->mem_access_latency(baddr, bsize, now, context_id);
+		{
+			return current_sim->shared_access(NULL, cmd, baddr, bsize, now, context_id);
+		}
 		else
 		{
+			current_sim->shared_access(NULL, cmd, baddr, bsize, now, context_id);
+
 			//FIXME: unlimited write buffers
 			return 0;
 		}
@@ -308,10 +371,12 @@ dl2_access_fn(mem_cmd cmd,		//access cmd, Read or Write
 	tick_t now,			//time of access
 	int context_id)			//context_id for the access
 {
-	if(cache_dl3)
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
+	if(current_sim->cache_dl3)
 	{
-		//access next level of data cache hierarchy
-		unsigned long long lat = cache_dl3->cache_access(cmd, baddr, context_id, NULL, bsize, now, NULL, NULL);
+		//access next level of data cache hierarchy, the L3 is shared among the cores
+		unsigned long long lat = current_sim->shared_access(current_sim->cache_dl3, cmd, baddr, bsize, now, context_id);
 
 		//Wattch -- Dcache2 access
 		cores[contexts[context_id].core_id].power.dcache3_access++;
@@ -326,11 +391,15 @@ dl2_access_fn(mem_cmd cmd,		//access cmd, Read or Write
 	}
 	else
 	{
-		//access main memory
+		//access main memory, main memory is shared among the cores
 		if(cmd == Read)
-			return cores[contexts[context_id].core_id].main_mem->mem_access_latency(baddr, bsize, now, context_id);
+		{
+			return current_sim->shared_access(NULL, cmd, baddr, bsize, now, context_id);
+		}
 		else
 		{
+			current_sim->shared_access(NULL, cmd, baddr, bsize, now, context_id);
+
 			//FIXME: unlimited write buffers
 			return 0;
 		}
@@ -350,9 +419,11 @@ dl3_access_fn(mem_cmd cmd,		//access cmd, Read or Write
 
 	//this is a miss to the lowest level, so access main memory
 	if(cmd == Read)
-		return cores[contexts[context_id].core_id].main_mem->mem_access_latency(baddr, bsize, now, context_id);
+		return main_mem_latency(baddr, bsize, now, context_id);
 	else
 	{
+		main_mem_write(baddr, bsize, now, context_id);
+
 		//FIXME: unlimited write buffers
 		return 0;
 	}
@@ -367,6 +438,8 @@ il1_access_fn(mem_cmd cmd,		//access cmd, Read or Write
 	tick_t now,			//time of access
 	int context_id)			//context_id of the access
 {
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
 	if(cores[contexts[context_id].core_id].cache_il2)
 	{
 		//access next level of inst cache hierarchy
@@ -382,9 +455,11 @@ il1_access_fn(mem_cmd cmd,		//access cmd, Read or Write
 	}
 	else
 	{
-		//access main memory
+		//access main memory, main memory is shared among the cores
 		if(cmd == Read)
-			return cores[contexts[context_id].core_id].main_mem->mem_access_latency(baddr, bsize, now, context_id);
+		{
+			return current_sim->shared_access(NULL, cmd, baddr, bsize, now, context_id);
+		}
 		else
 			panic("writes to instruction memory not supported");
 	}
@@ -399,10 +474,12 @@ il2_access_fn(mem_cmd cmd,		//access cmd, Read or Write
 	tick_t now,			//time of access
 	int context_id)			//context_id of the access
 {
-	if(cache_il3)
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
+	if(current_sim->cache_il3)
 	{
-		//access next level of inst cache hierarchy
-		unsigned long long lat = cache_il3->cache_access(cmd, baddr, context_id, NULL, bsize, now, NULL, NULL);
+		//access next level of inst cache hierarchy, the L3 is shared among the cores
+		unsigned long long lat = current_sim->shared_access(current_sim->cache_il3, cmd, baddr, bsize, now, context_id);
 
 		//Wattch -- Dcache2 access
 		cores[contexts[context_id].core_id].power.dcache3_access++;
@@ -414,9 +491,11 @@ il2_access_fn(mem_cmd cmd,		//access cmd, Read or Write
 	}
 	else
 	{
-		//access main memory
+		//access main memory, main memory is shared among the cores
 		if(cmd == Read)
-			return cores[contexts[context_id].core_id].main_mem->mem_access_latency(baddr, bsize, now, context_id);
+		{
+			return current_sim->shared_access(NULL, cmd, baddr, bsize, now, context_id);
+		}
 		else
 			panic("writes to instruction memory not supported");
 	}
@@ -435,7 +514,7 @@ il3_access_fn(mem_cmd cmd,		//access cmd, Read or Write
 
 	//this is a miss to the lowest level, so access main memory
 	if(cmd == Read)
-		return cores[contexts[context_id].core_id].main_mem->mem_access_latency(baddr, bsize, now, context_id);
+		return main_mem_latency(baddr, bsize, now, context_id);
 	else
 		panic("writes to instruction memory not supported");
 }
@@ -451,6 +530,8 @@ itlb_access_fn(mem_cmd cmd,		//access cmd, Read or Write
 	tick_t now,			//time of access
 	int context_id)
 {
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
 	md_addr_t *phy_page_ptr = (md_addr_t *)blk->user_data;
 
 	//no real memory access, however, should have user data space attached
@@ -472,6 +553,8 @@ dtlb_access_fn(mem_cmd cmd,		//access cmd, Read or Write
 	tick_t now,			//time of access
 	int context_id)
 {
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
 	md_addr_t *phy_page_ptr = (md_addr_t *)blk->user_data;
 
 	//no real memory access, however, should have user data space attached
@@ -485,8 +568,10 @@ dtlb_access_fn(mem_cmd cmd,		//access cmd, Read or Write
 }
 
 //register simulator-specific options
-void sim_reg_options(opt_odb_t *odb)
+void simulator_t::reg_options(opt_odb_t *odb)
 {
+	options = odb;
+
 	opt_reg_header(odb, 
 		"sim-outorder: This simulator implements a very detailed out-of-order issue superscalar processor with a two-level memory system and speculative\n"
 		"execution support.  This simulator is a performance simulator, tracking the latency of all pipeline operations.\n");
@@ -501,6 +586,9 @@ void sim_reg_options(opt_odb_t *odb)
 		&max_cycles, /* default */-1,
 		/* print */TRUE, /* format */NULL);
 
+	//host threads and quantum
+	core_pool.reg_options(odb);
+
 	//trace options
 	opt_reg_long_long(odb, "-fastfwd", "", "number of insts skipped before timing starts (1 to use value in .arg file)",
 		&fastfwd_count, /* default */1000000,
@@ -882,6 +970,18 @@ void sim_reg_options(opt_odb_t *odb)
 		"\n"
 		"    Examples:   -mem:config chunk:4:300:2\n"
 		"                -mem:config basic:4:6:12:90:90:90:8:2048\n"
+		"\n"
+		"    The banked controller (channels, ranks and banks with row buffers, FR-FCFS\n"
+		"    scheduling and read/write queues, see dram_ctrl.h) is configured with\n"
+		"\n"
+		"    banked:<width>:<channels>:<ranks>:<banks>:<row>:<page>:<tRCD>:<tCAS>:<tRP>:<tBus>:<queue>\n"
+		"\n"
+		"    <row>    - Size of a row (row buffer) in bytes\n"
+		"    <page>   - Row buffer policy, o (open page) or c (closed page)\n"
+		"    <tRCD>.. - Activate, column access, precharge and bus cycle times in cycles\n"
+		"    <queue>  - Entries of the read and of the write queue of each channel\n"
+		"\n"
+		"    Example:    -mem:config banked:8:2:1:8:8192:o:42:42:42:1:32\n"
 		);
 
 	opt_reg_string(odb, "-mem:config","",
@@ -912,14 +1012,135 @@ void sim_reg_options(opt_odb_t *odb)
 		&cache_il3_lat, /* default */30,
 		/* print */TRUE, /* format */NULL);
 
+	//Miss status holding registers, these limit the outstanding misses of each cache
+	opt_reg_int(odb, "-cache:dl1mshr","",
+		"l1 data cache MSHRs, outstanding misses of each core's dl1 (0 for unlimited)",
+		&cache_dl1_mshrs, /* default */0,
+		/* print */TRUE, /* format */NULL);
+
+	opt_reg_int(odb, "-cache:dl2mshr","",
+		"l2 data cache MSHRs, outstanding misses of each core's dl2 (0 for unlimited)",
+		&cache_dl2_mshrs, /* default */0,
+		/* print */TRUE, /* format */NULL);
+
+	opt_reg_int(odb, "-cache:il1mshr","",
+		"l1 instruction cache MSHRs, outstanding misses of each core's il1 (0 for unlimited)",
+		&cache_il1_mshrs, /* default */0,
+		/* print */TRUE, /* format */NULL);
+
+	opt_reg_int(odb, "-cache:il2mshr","",
+		"l2 instruction cache MSHRs, outstanding misses of each core's il2 (0 for unlimited)",
+		&cache_il2_mshrs, /* default */0,
+		/* print */TRUE, /* format */NULL);
+
+	opt_reg_int(odb, "-cache:dl3mshr","",
+		"l3 data cache MSHRs (0 for unlimited)",
+		&cache_dl3_mshrs, /* default */0,
+		/* print */TRUE, /* format */NULL);
+
+	opt_reg_int(odb, "-cache:il3mshr","",
+		"l3 instruction cache MSHRs (0 for unlimited)",
+		&cache_il3_mshrs, /* default */0,
+		/* print */TRUE, /* format */NULL);
+
+	//Prefetchers
+	opt_reg_note(odb,
+		"  The data cache prefetcher parameter <pf> has one of the following formats:\n"
+		"\n"
+		"    nextline:<degree>           - the next <degree> blocks after a miss (or the first use of a prefetched block)\n"
+		"    stride:<entries>:<degree>   - <degree> strides ahead of each load once its stride repeats,\n"
+		"                                  <entries> (a power of two) loads are tracked by PC\n"
+		"    stream:<streams>:<depth>    - <depth> blocks ahead of up to <streams> sequential miss streams\n"
+		"\n"
+		"    Examples:   -cache:dl1pf stride:256:4\n"
+		"                -cache:dl2pf stream:16:8\n"
+		);
+
+	opt_reg_string(odb, "-cache:dl1pf","",
+		"l1 data cache prefetcher of each core, i.e., {<pf>|none}",
+		&cache_dl1pf_opt, "none",
+		/* print */TRUE, NULL);
+
+	opt_reg_string(odb, "-cache:dl2pf","",
+		"l2 data cache prefetcher of each core, i.e., {<pf>|none}",
+		&cache_dl2pf_opt, "none",
+		/* print */TRUE, NULL);
+
+	//Shared cache partitioning
+	opt_reg_note(odb,
+		"  The l2 data cache of each core (shared by its threads) and the l3 data cache (shared by every thread)\n"
+		"  can replace blocks with their owners in mind. The partitioning parameter <part> is one of:\n"
+		"\n"
+		"    none                        - a miss replaces the block the replacement policy picks\n"
+		"    static:<ways>[,<ways>...]   - thread i is given <ways> ways of every set (the last value repeats)\n"
+		"    ucp:<interval>              - utility-based partitioning, every <interval> cycles the ways are given\n"
+		"                                  to the threads whose shadow tags saw the most hits in them\n"
+		"\n"
+		"  A thread that holds its ways of a set replaces its own blocks there. The occupancy caps limit the\n"
+		"  blocks of the whole cache each thread may hold, in percent (100 for no cap, the last value repeats),\n"
+		"  a thread at its cap replaces its own blocks where it has any.\n"
+		"\n"
+		"    Examples:   -cache:dl3part ucp:1000000\n"
+		"                -cache:dl2part static:6,2 -cache:dl2occ 100 25\n"
+		);
+
+	opt_reg_string(odb, "-cache:dl2part","",
+		"l2 data cache partitioning among the threads of each core, i.e., {<part>|none}",
+		&cache_dl2part_opt, "none",
+		/* print */TRUE, NULL);
+
+	opt_reg_string(odb, "-cache:dl3part","",
+		"l3 data cache partitioning among all threads, i.e., {<part>|none}",
+		&cache_dl3part_opt, "none",
+		/* print */TRUE, NULL);
+
+	int occ_def[1] = {100};
+	opt_reg_int_list(odb, "-cache:dl2occ","",
+		"per-thread occupancy cap of the l2 data cache, in percent of its blocks",
+		cache_dl2occ, MAX_CONTEXTS, &cache_dl2occ_nelt, occ_def,
+		/* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+	opt_reg_int_list(odb, "-cache:dl3occ","",
+		"per-thread occupancy cap of the l3 data cache, in percent of its blocks",
+		cache_dl3occ, MAX_CONTEXTS, &cache_dl3occ_nelt, occ_def,
+		/* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
 	opt_reg_string(odb, "-makeeio","",
 		"After fast-forwarding, make an eio file called: (\"none\"==no eio file)",
 		&eio_name, "none",
 		/* print */TRUE, NULL);
+
+	opt_reg_string(odb, "-chkpt:write","",
+		"After fast-forwarding, write a checkpoint of every context to this file (\"none\"==no checkpoint)",
+		&chkpt_write_name, "none",
+		/* print */TRUE, NULL);
+
+	opt_reg_flag(odb, "-chkpt:warm","",
+		"include the cache tags and the branch and load-latency predictors in the -chkpt:write checkpoint",
+		&chkpt_warm, /* default */FALSE,
+		/* print */TRUE, /* format */NULL);
+
+	opt_reg_flag(odb, "-chkpt:text","",
+		"write the memory images into the -chkpt:write checkpoint as text instead of a binary page file (<file>.pages), slow to read, for debugging",
+		&chkpt_text, /* default */FALSE,
+		/* print */TRUE, /* format */NULL);
+
+	opt_reg_string(odb, "-chkpt:read","",
+		"Restore every context from this checkpoint before fast-forwarding, -fastfwd counts from the checkpoint (\"none\"==start from the programs)",
+		&chkpt_read_name, "none",
+		/* print */TRUE, NULL);
+
+	opt_reg_string(odb, "-sim:fanout","",
+		"After fast-forwarding, fork one timing simulation per line of this file, each line lists the options it changes (\"none\"==no fan-out)",
+		&fanout_name, "none",
+		/* print */TRUE, NULL);
+
+	//rename register cap options
+	cap_policy.reg_options(odb);
 }
 
 //check simulator-specific option values
-void sim_check_options()
+void simulator_t::check_options()
 {
 	if(num_cores<1)
 		fatal("Less than 1 core specified! Nothing to do!");
@@ -935,6 +1156,24 @@ void sim_check_options()
 	if(cores_at_init_time != num_cores)
 		fatal("Num_cores detected from command line doesn't match num_cores from option flag");
 
+	cap_policy.check_options();
+
+	core_pool.check_options();
+
+	//a batch job runs on one thread of the batch's pool beside the other jobs (see main.c)
+	if(batch_job)
+	{
+		if(core_pool.threads > 1)
+		{
+			warn("-sim:threads ignored in batch jobs, each job runs on one of the batch's threads");
+			core_pool.threads = 1;
+		}
+		if(ptrace_nelt > 0)
+			fatal("-ptrace can't be used in batch jobs, the pipeline trace and its symbols are shared by the process");
+		if(fanout_name && std::string(fanout_name)!="none")
+			fatal("-sim:fanout can't be used in batch jobs, the jobs can't fork");
+	}
+
 	if(fastfwd_count < 0 || fastfwd_count == 9223372036854775807LL)
 	{
 		fprintf(stderr,"bad fast forward count: %lld\n", fastfwd_count);
@@ -959,138 +1198,7 @@ void sim_check_options()
 
 	for(unsigned int i=0;i<num_cores;i++)
 	{
-		if(cores[i].fetch_speed < 1)
-		{
-			printf("Core %d front-end speed must be greater than 0\n",i);
-			assert(cores[i].fetch_speed>0);
-		}
-
-		if(cores[i].decode_width < 1 || (cores[i].decode_width & (cores[i].decode_width-1)) != 0)
-		{
-			printf("Core %d decode width must be positive non-zero and a power of two",i);
-			assert(0);
-		}
-
-		if(cores[i].issue_width < 1 || (cores[i].issue_width & (cores[i].issue_width-1)) != 0)
-		{
-			printf("Core %d issue width must be positive non-zero and a power of two",i);
-			assert(0);
-		}
-
-		if(cores[i].commit_width < 1)
-		{
-			printf("Core %d commit width must be positive non-zero",i);
-			assert(0);
-		}
-
-		if(cores[i].ROB_size < 2)
-		{
-			printf("Core %d ROB size must be a positive number > 1",i);
-			assert(0);
-		}
-
-		if(cores[i].LSQ_size < 2)
-		{
-			printf("Core %d LSQ size must be a positive number > 1",i);
-			assert(0);
-		}
-
-		if(cores[i].iq_size < 2)
-		{
-			printf("Core %d IQ size must be a positive number > 1",i);
-			assert(0);
-		}
-
-		//Each thread requires 32 integer and 32 floating point registers for the architectural state
-		if(cores[i].rf_size < static_cast<unsigned int>(32 * (max_contexts_per_core + 1)))
-		{
-			printf("Core %d needs at least 32 non-architectural registers per thread. ",i);
-			printf("Only has %d registers\n",cores[i].rf_size-(32*max_contexts_per_core));
-			printf("Allowing %d threads per core, may need to lower this (-max_contexts_per_core)\n",max_contexts_per_core);
-			assert(0);
-		}
-
-		if((cores[i].res_ialu < 1)||(cores[i].res_ialu > MAX_INSTS_PER_CLASS))
-		{
-			printf("Core %d: number of integer ALUs not in range (0<%d<=%d)\n",i,cores[i].res_ialu,MAX_INSTS_PER_CLASS);
-			assert(0);
-		}
-
-		if((cores[i].res_imult < 1)||(cores[i].res_imult > MAX_INSTS_PER_CLASS))
-		{
-			printf("Core %d: number of integer multiplier/dividers not in range (0<%d<=%d)\n",i,cores[i].res_imult,MAX_INSTS_PER_CLASS);
-			assert(0);
-		}
-
-		if((cores[i].res_memport < 1)||(cores[i].res_memport > MAX_INSTS_PER_CLASS))
-		{
-			printf("Core %d: number of memory system ports not in range (0<%d<=%d)\n",i,cores[i].res_memport,MAX_INSTS_PER_CLASS);
-			assert(0);
-		}
-
-		if((cores[i].res_fpalu < 1)||(cores[i].res_fpalu > MAX_INSTS_PER_CLASS))
-		{
-			printf("Core %d: number of floating point ALUs not in range (0<%d<=%d)\n",i,cores[i].res_fpalu,MAX_INSTS_PER_CLASS);
-			assert(0);
-		}
-
-		if((cores[i].res_fpmult < 1)||(cores[i].res_fpmult > MAX_INSTS_PER_CLASS))
-		{
-			printf("Core %d: number of floating point multiplier/dividers not in range (0<%d<=%d)\n",i,cores[i].res_fpmult,MAX_INSTS_PER_CLASS);
-			assert(0);
-		}
-
-		if(cores[i].cache_dl1_lat < 1)
-		{
-			printf("Core %d L1 data cache latency must be greater than zero",i);
-			assert(0);
-		}
-
-		if(cores[i].cache_dl2_lat < 1)
-		{
-			printf("Core %d L2 data cache latency must be greater than zero",i);
-			assert(0);
-		}
-
-		if(cores[i].cache_il1_lat < 1)
-		{
-			printf("Core %d L1 instruction cache latency must be greater than zero",i);
-			assert(0);
-		}
-
-		if(cores[i].cache_il2_lat < 1)
-		{
-			printf("Core %d L2 instruction cache latency must be greater than zero",i);
-			assert(0);
-		}
-
-		if(cores[i].tlb_miss_lat < 1)
-		{
-			printf("Core %d TLB miss latency must be greater than zero",i);
-			assert(0);
-		}
-
-		if(!strcmp(cores[i].fetch_policy, "icount")){
-			cores[i].fetcher = icount_fetch;
-		}else if(!strcmp(cores[i].fetch_policy, "round_robin")){
-			cores[i].fetcher = RR_fetch;
-		}else if(!strcmp(cores[i].fetch_policy, "dcra")){
-			cores[i].fetcher = dcra_fetch;
-		}else{
-			std::cerr << "Invalid fetch policy!" << std::endl;
-			assert(0);
-		}
-
-		//Set up recovery model value
-		cores[i].recovery_model_v = core_t::RECOVERY_MODEL_UNDEFINED;
-		if(cores[i].recovery_model == std::string("squash"))
-		{
-			cores[i].recovery_model_v = core_t::RECOVERY_MODEL_SQUASH;
-		}
-		else if(cores[i].recovery_model == std::string("perfect"))
-		{
-			cores[i].recovery_model_v = core_t::RECOVERY_MODEL_PERFECT;
-		}
+		check_core_options(i);
 
 		cores[i].id = i;
 		cores[i].reg_file.resize(cores[i].rf_size);
@@ -1261,6 +1369,10 @@ void sim_check_options()
 	if(cache_il3_lat < 1)
 		fatal("l3 instruction cache latency must be greater than zero");
 
+	if((cache_dl1_mshrs < 0) || (cache_dl2_mshrs < 0) || (cache_il1_mshrs < 0) || (cache_il2_mshrs < 0)
+		|| (cache_dl3_mshrs < 0) || (cache_il3_mshrs < 0))
+		fatal("cache MSHRs must be zero (unlimited) or greater");
+
 	//Note: cache_dl3 and cache_il3 belong to no core
 	std::string prepend = "Core_0_";
 	int nsets, bsize, assoc;
@@ -1274,7 +1386,8 @@ void sim_check_options()
 		if(sscanf(cache_dl3_opt, "%[^:]:%d:%d:%d:%c", name, &nsets, &bsize, &assoc, &c) != 5)
 			fatal("bad l3 D-cache parms: " "<name>:<nsets>:<bsize>:<assoc>:<repl>");
 		cache_dl3 = new cache_t(prepend + name, nsets, bsize, /* balloc */FALSE, /* usize */0, assoc, cache_char2policy(c),
-			dl3_access_fn, /* hit lat */cache_dl3_lat);
+			dl3_access_fn, /* hit lat */cache_dl3_lat, /* MSHRs */cache_dl3_mshrs);
+		cache_dl3->set_partition(MAX_CONTEXTS, cache_dl3part_opt, cache_dl3occ, cache_dl3occ_nelt);
 	}
 	//is the level 3 D-cache defined?
 	if(!mystricmp(cache_il3_opt, "none"))
@@ -1290,7 +1403,7 @@ void sim_check_options()
 		if(sscanf(cache_il3_opt, "%[^:]:%d:%d:%d:%c", name, &nsets, &bsize, &assoc, &c) != 5)
 			fatal("bad l3 I-cache parms: <name>:<nsets>:<bsize>:<assoc>:<repl>");
 		cache_il3 = new cache_t(prepend + name, nsets, bsize, /* balloc */FALSE, /* usize */0, assoc, cache_char2policy(c),
-			il3_access_fn, /* hit lat */cache_il3_lat);
+			il3_access_fn, /* hit lat */cache_il3_lat, /* MSHRs */cache_il3_mshrs);
 	}
 
 	for(unsigned int i=0;i<num_cores;i++)
@@ -1318,7 +1431,8 @@ void sim_check_options()
 				fatal("bad l1 D-cache parms: <name>:<nsets>:<bsize>:<assoc>:<repl>");
 
 			cores[i].cache_dl1 = new cache_t(prepend + name, nsets, bsize, /* balloc */FALSE, /* usize */0, assoc, cache_char2policy(c),
-				dl1_access_fn, /* hit lat */cores[i].cache_dl1_lat);
+				dl1_access_fn, /* hit lat */cores[i].cache_dl1_lat, /* MSHRs */cache_dl1_mshrs);
+			cores[i].cache_dl1->set_prefetcher(prefetch_parser(cache_dl1pf_opt, bsize));
 
 			//is the level 2 D-cache defined?
 			if(!mystricmp(cores[i].cache_dl2_opt, "none"))
@@ -1328,7 +1442,9 @@ void sim_check_options()
 				if(sscanf(cores[i].cache_dl2_opt, "%[^:]:%d:%d:%d:%c", name, &nsets, &bsize, &assoc, &c) != 5)
 					fatal("bad l2 D-cache parms: " "<name>:<nsets>:<bsize>:<assoc>:<repl>");
 				cores[i].cache_dl2 = new cache_t(prepend + name, nsets, bsize, /* balloc */FALSE, /* usize */0, assoc, cache_char2policy(c),
-					dl2_access_fn, /* hit lat */cores[i].cache_dl2_lat);
+					dl2_access_fn, /* hit lat */cores[i].cache_dl2_lat, /* MSHRs */cache_dl2_mshrs);
+				cores[i].cache_dl2->set_prefetcher(prefetch_parser(cache_dl2pf_opt, bsize));
+				cores[i].cache_dl2->set_partition(MAX_CONTEXTS, cache_dl2part_opt, cache_dl2occ, cache_dl2occ_nelt);
 			}
 		}
 
@@ -1369,7 +1485,7 @@ void sim_check_options()
 			if(sscanf(cores[i].cache_il1_opt, "%[^:]:%d:%d:%d:%c", name, &nsets, &bsize, &assoc, &c) != 5)
 				fatal("bad l1 I-cache parms: <name>:<nsets>:<bsize>:<assoc>:<repl>");
 			cores[i].cache_il1 = new cache_t(prepend + name, nsets, bsize, /* balloc */FALSE, /* usize */0, assoc, cache_char2policy(c),
-				il1_access_fn, /* hit lat */cores[i].cache_il1_lat);
+				il1_access_fn, /* hit lat */cores[i].cache_il1_lat, /* MSHRs */cache_il1_mshrs);
 			//is the level 2 D-cache defined?
 			if(!mystricmp(cores[i].cache_il2_opt, "none"))
 				cores[i].cache_il2 = cache_il3;
@@ -1384,7 +1500,7 @@ void sim_check_options()
 				if(sscanf(cores[i].cache_il2_opt, "%[^:]:%d:%d:%d:%c", name, &nsets, &bsize, &assoc, &c) != 5)
 					fatal("bad l2 I-cache parms: <name>:<nsets>:<bsize>:<assoc>:<repl>");
 				cores[i].cache_il2 = new cache_t(prepend + name, nsets, bsize, /* balloc */FALSE, /* usize */0, assoc, cache_char2policy(c),
-					il2_access_fn, /* hit lat */cores[i].cache_il2_lat);
+					il2_access_fn, /* hit lat */cores[i].cache_il2_lat, /* MSHRs */cache_il2_mshrs);
 			}
 		}
 
@@ -1396,7 +1512,7 @@ void sim_check_options()
 			if(sscanf(cores[i].itlb_opt, "%[^:]:%d:%d:%d:%c", name, &nsets, &bsize, &assoc, &c) != 5)
 				fatal("bad TLB parms: <name>:<nsets>:<page_size>:<assoc>:<repl>");
 			cores[i].itlb = new cache_t(prepend + name, nsets, bsize, /* balloc */FALSE, /* usize */sizeof(md_addr_t), assoc,
-				cache_char2policy(c), itlb_access_fn, /* hit latency */1);
+				cache_char2policy(c), itlb_access_fn, /* hit latency */1, /* MSHRs */0);
 		}
 
 		//use a D-TLB?
@@ -1407,11 +1523,13 @@ void sim_check_options()
 			if(sscanf(cores[i].dtlb_opt, "%[^:]:%d:%d:%d:%c", name, &nsets, &bsize, &assoc, &c) != 5)
 				fatal("bad TLB parms: <name>:<nsets>:<page_size>:<assoc>:<repl>");
 			cores[i].dtlb = new cache_t(prepend + name, nsets, bsize, /* balloc */FALSE, /* usize */sizeof(md_addr_t), assoc,
-				cache_char2policy(c), dtlb_access_fn, /* hit latency */1);
+				cache_char2policy(c), dtlb_access_fn, /* hit latency */1, /* MSHRs */0);
 		}
 	}
 
-	assert(main_mem = dram_parser(main_mem_config));
+	dram_ctrl = dram_ctrl_parser(main_mem_config, MAX_CONTEXTS);
+	if(!dram_ctrl)
+		assert(main_mem = dram_parser(main_mem_config));
 	for(unsigned int i=0;i<num_cores;i++)
 	{
 		cores[i].main_mem = main_mem;
@@ -1462,6 +1580,143 @@ void sim_check_options()
 	}
 }
 
+//check the pipeline option values of core i, and select its fetch policy and recovery model
+void simulator_t::check_core_options(unsigned int i)
+{
+	if(cores[i].fetch_speed < 1)
+	{
+		printf("Core %d front-end speed must be greater than 0\n",i);
+		assert(cores[i].fetch_speed>0);
+	}
+
+	if(cores[i].decode_width < 1 || (cores[i].decode_width & (cores[i].decode_width-1)) != 0)
+	{
+		printf("Core %d decode width must be positive non-zero and a power of two",i);
+		assert(0);
+	}
+
+	if(cores[i].issue_width < 1 || (cores[i].issue_width & (cores[i].issue_width-1)) != 0)
+	{
+		printf("Core %d issue width must be positive non-zero and a power of two",i);
+		assert(0);
+	}
+
+	if(cores[i].commit_width < 1)
+	{
+		printf("Core %d commit width must be positive non-zero",i);
+		assert(0);
+	}
+
+	if(cores[i].ROB_size < 2)
+	{
+		printf("Core %d ROB size must be a positive number > 1",i);
+		assert(0);
+	}
+
+	if(cores[i].LSQ_size < 2)
+	{
+		printf("Core %d LSQ size must be a positive number > 1",i);
+		assert(0);
+	}
+
+	if(cores[i].iq_size < 2)
+	{
+		printf("Core %d IQ size must be a positive number > 1",i);
+		assert(0);
+	}
+
+	//Each thread requires 32 integer and 32 floating point registers for the architectural state
+	if(cores[i].rf_size < static_cast<unsigned int>(32 * (max_contexts_per_core + 1)))
+	{
+		printf("Core %d needs at least 32 non-architectural registers per thread. ",i);
+		printf("Only has %d registers\n",cores[i].rf_size-(32*max_contexts_per_core));
+		printf("Allowing %d threads per core, may need to lower this (-max_contexts_per_core)\n",max_contexts_per_core);
+		assert(0);
+	}
+
+	if((cores[i].res_ialu < 1)||(cores[i].res_ialu > MAX_INSTS_PER_CLASS))
+	{
+		printf("Core %d: number of integer ALUs not in range (0<%d<=%d)\n",i,cores[i].res_ialu,MAX_INSTS_PER_CLASS);
+		assert(0);
+	}
+
+	if((cores[i].res_imult < 1)||(cores[i].res_imult > MAX_INSTS_PER_CLASS))
+	{
+		printf("Core %d: number of integer multiplier/dividers not in range (0<%d<=%d)\n",i,cores[i].res_imult,MAX_INSTS_PER_CLASS);
+		assert(0);
+	}
+
+	if((cores[i].res_memport < 1)||(cores[i].res_memport > MAX_INSTS_PER_CLASS))
+	{
+		printf("Core %d: number of memory system ports not in range (0<%d<=%d)\n",i,cores[i].res_memport,MAX_INSTS_PER_CLASS);
+		assert(0);
+	}
+
+	if((cores[i].res_fpalu < 1)||(cores[i].res_fpalu > MAX_INSTS_PER_CLASS))
+	{
+		printf("Core %d: number of floating point ALUs not in range (0<%d<=%d)\n",i,cores[i].res_fpalu,MAX_INSTS_PER_CLASS);
+		assert(0);
+	}
+
+	if((cores[i].res_fpmult < 1)||(cores[i].res_fpmult > MAX_INSTS_PER_CLASS))
+	{
+		printf("Core %d: number of floating point multiplier/dividers not in range (0<%d<=%d)\n",i,cores[i].res_fpmult,MAX_INSTS_PER_CLASS);
+		assert(0);
+	}
+
+	if(cores[i].cache_dl1_lat < 1)
+	{
+		printf("Core %d L1 data cache latency must be greater than zero",i);
+		assert(0);
+	}
+
+	if(cores[i].cache_dl2_lat < 1)
+	{
+		printf("Core %d L2 data cache latency must be greater than zero",i);
+		assert(0);
+	}
+
+	if(cores[i].cache_il1_lat < 1)
+	{
+		printf("Core %d L1 instruction cache latency must be greater than zero",i);
+		assert(0);
+	}
+
+	if(cores[i].cache_il2_lat < 1)
+	{
+		printf("Core %d L2 instruction cache latency must be greater than zero",i);
+		assert(0);
+	}
+
+	if(cores[i].tlb_miss_lat < 1)
+	{
+		printf("Core %d TLB miss latency must be greater than zero",i);
+		assert(0);
+	}
+
+	if(!strcmp(cores[i].fetch_policy, "icount")){
+		cores[i].fetcher = icount_fetch;
+	}else if(!strcmp(cores[i].fetch_policy, "round_robin")){
+		cores[i].fetcher = RR_fetch;
+	}else if(!strcmp(cores[i].fetch_policy, "dcra")){
+		cores[i].fetcher = dcra_fetch;
+	}else{
+		std::cerr << "Invalid fetch policy!" << std::endl;
+		assert(0);
+	}
+
+	//Set up recovery model value
+	cores[i].recovery_model_v = core_t::RECOVERY_MODEL_UNDEFINED;
+	if(cores[i].recovery_model == std::string("squash"))
+	{
+		cores[i].recovery_model_v = core_t::RECOVERY_MODEL_SQUASH;
+	}
+	else if(cores[i].recovery_model == std::string("perfect"))
+	{
+		cores[i].recovery_model_v = core_t::RECOVERY_MODEL_PERFECT;
+	}
+}
+
 //print simulator-specific configuration information
 void sim_aux_config(FILE *stream)
 {
@@ -1469,7 +1724,7 @@ void sim_aux_config(FILE *stream)
 }
 
 //register simulator-specific statistics
-void sim_reg_stats(stat_sdb_t *sdb)
+void simulator_t::reg_stats(stat_sdb_t *sdb)
 {
 	stat_reg_counter(sdb, "sim_num_insn",
 		"total number of instructions executed",
@@ -1487,6 +1742,17 @@ void sim_reg_stats(stat_sdb_t *sdb)
 		"simulation speed (in insts/sec)",
 		std::string("sim_num_insn / sim_elapsed_time").c_str(), NULL);
 
+	//fast-forward (functional simulation) speed
+	stat_reg_counter(sdb, "sim_ff_insn",
+		"total number of instructions fast-forwarded",
+		&sim_ff_insn, sim_ff_insn, NULL);
+	stat_reg_double(sdb, "sim_ff_time",
+		"total fast-forward time in seconds",
+		&sim_ff_time, sim_ff_time, NULL);
+	stat_reg_formula(sdb, "sim_ff_rate",
+		"fast-forward speed (in insts/sec)",
+		std::string("sim_ff_insn / sim_ff_time").c_str(), NULL);
+
 	//debug variable(s)
 	stat_reg_counter(sdb, "sim_invalid_addrs",
 		"total non-speculative bogus addresses seen (debug var)",
@@ -1552,6 +1818,30 @@ void sim_reg_stats(stat_sdb_t *sdb)
 			/* print fn */NULL);
 	}
 
+	//register rename cap policy stats
+	cap_policy.reg_stats(sdb, num_contexts);
+	core_pool.reg_stats(sdb);
+	if(core_pool.quantum > 1)
+	{
+		stat_reg_counter(sdb, "sim_quantum_shared", "accesses to the shared L3/main memory, replayed at the end of each quantum",
+			&shared_replayed, 0, NULL);
+		//estimate error only: the cores keep the estimated latencies, so this is not the error against a -sim:quantum 1 run
+		stat_reg_counter(sdb, "sim_quantum_estimate_mismatch", "shared L3 reads estimated as hits that missed in the replay, or the other way round",
+			&shared_estimate_mismatch, 0, NULL);
+		stat_reg_counter(sdb, "sim_quantum_estimate_error", "total cycles the latencies given to the cores differ from the replayed ones",
+			&shared_estimate_error, 0, NULL);
+		stat_reg_formula(sdb, "sim_quantum_avg_estimate_error", "average cycles a shared access latency estimate was off",
+			"sim_quantum_estimate_error / sim_quantum_shared", "%9.4f");
+		stat_reg_counter(sdb, "sim_quantum_mem_reads", "replayed reads that went to main memory", &shared_mem_reads, 0, NULL);
+		stat_reg_counter(sdb, "sim_quantum_mem_cycles", "total main memory latency of the replayed reads", &shared_mem_cycles, 0, NULL);
+		stat_reg_formula(sdb, "sim_quantum_avg_mem_latency", "average main memory latency of the replayed reads (the miss estimate)",
+			"sim_quantum_mem_cycles / sim_quantum_mem_reads", "%9.4f");
+	}
+
+	//register banked DRAM controller stats
+	if(dram_ctrl)
+		dram_ctrl->reg_stats(sdb, num_contexts);
+
 	//register power stats
 	if(print_power_stats)
 	{
@@ -1567,7 +1857,7 @@ void sim_init()
 {}
 
 //load program into simulated state
-void sim_load_prog(std::string fname,			//program to load
+void simulator_t::load_prog(std::string fname,		//program to load
 	std::vector<std::string> argv,			//program arguments
 	std::vector<std::string> envp)			//program environment
 {
@@ -1575,11 +1865,10 @@ void sim_load_prog(std::string fname,			//program to load
 	regs_t* regs = &contexts[num_contexts].regs;
 
 	//Distributes programs into cores via round_robin
-	static int core_num = -1;
-	core_num++;
+	load_core++;
 
 	//Contexts are put into cores in a round_robin fashion and initialized
-	int targetcore = core_num%num_cores;
+	int targetcore = load_core%num_cores;
 	contexts[num_contexts].init_context(num_contexts);
 	if(!cores[targetcore].addcontext(contexts[num_contexts]))
 	{
@@ -1590,8 +1879,13 @@ void sim_load_prog(std::string fname,			//program to load
 	//load program text and data, set up environment, memory, and regs
 	if(loader.ld_load_prog(fname, argv, envp, regs, contexts[num_contexts].mem, TRUE))
 	{
-		std::cerr << "Can't load context " << fname << " at start time" << std::endl;
-		exit(1);
+		fatal("can't load context %s at start time", fname.c_str());
+	}
+
+	//contexts running the same program share its text and initial data until they write it
+	for(int i=0;i<num_contexts;i++)
+	{
+		contexts[num_contexts].mem->mem_share_identical(*contexts[i].mem);
 	}
 
 	//Initialize the process id
@@ -1628,7 +1922,7 @@ void sim_load_prog(std::string fname,			//program to load
 }
 
 //dump simulator-specific auxiliary simulator statistics to an output stream
-void sim_aux_stats(FILE *stream)
+void simulator_t::aux_stats(FILE *stream)
 {
 	for(size_t i=0;i<contexts.size();i++)
 	{
@@ -1675,12 +1969,15 @@ void sim_aux_stats(FILE *stream)
 }
 
 //uninitialize the simulator
-void sim_uninit()
+void simulator_t::uninit()
 {
+	core_pool.stop();
+
 	if(ptrace_nelt > 0)
 		ptrace_close();
 
 	delete main_mem;
+	delete dram_ctrl;
 
 	for(size_t i=0;i<contexts.size();i++)
 	{
@@ -1758,6 +2055,7 @@ void rob_dumpent(ROB_entry *rs,		//ptr to ROB entry
 //dump the contents of the ROB
 void rob_dump(FILE *stream, int context_id)
 {
+	std::vector<context> & contexts = current_sim->contexts;
 	if(!stream)
 		stream = stderr;
 
@@ -1779,6 +2077,7 @@ void rob_dump(FILE *stream, int context_id)
 //dump the contents of the LSQ
 void lsq_dump(FILE *stream, int context_id)
 {
+	std::vector<context> & contexts = current_sim->contexts;
 	if(!stream)
 		stream = stderr;
 
@@ -1803,6 +2102,8 @@ void lsq_dump(FILE *stream, int context_id)
 //dump the contents of the event queue to output specified by stream
 void eventq_dump(FILE *stream, int context_id)
 {
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
 	if(!stream)
 		stream = stderr;
 	fprintf(stream, "** event queue state **\n");
@@ -1819,6 +2120,8 @@ void eventq_dump(FILE *stream, int context_id)
 
 void issue_exec_q_queue_event(ROB_entry *rs, tick_t when)
 {
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
 	if(rs->completed)
 		panic("instruction completed");
 	assert(all_operands_spec_ready(rs));
@@ -1839,6 +2142,8 @@ void issue_exec_q_queue_event(ROB_entry *rs, tick_t when)
 //dump the contents of the ready queue to the output specified by stream
 void readyq_dump(FILE *stream, int context_id)
 {
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
 	if(!stream)
 		stream = stderr;
 	fprintf(stream, "** ready queue state **\n");
@@ -1865,6 +2170,8 @@ then
   likely on the program's critical path */
 void readyq_enqueue(ROB_entry *rs)		//RS to enqueue
 {
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
 	//We queue the node here, therefore, it shouldn't be queued already
 	if(rs->queued)
 		panic("node is already queued");
@@ -1877,12 +2184,38 @@ void readyq_enqueue(ROB_entry *rs)		//RS to enqueue
 
 }
 
+//wait_q_enqueue_watched() - puts an instruction on the waiting_queue and registers it with the register file
+//so wakeup() checks it again when one of its source registers gets a speculative ready time
+void simulator_t::wait_q_enqueue_watched(unsigned int core_num, ROB_entry *rs)
+{
+	cores[core_num].wait_q_enqueue(rs, sim_cycle);
+	cores[core_num].reg_file.watch(rs, sim_cycle);
+	waiting_watched[core_num]++;
+}
+
+//watch_waiting() - registers every instruction on the waiting_queue with the register file, for instructions
+//queued through core_t::wait_q_enqueue() directly (and to recount after a rollback)
+unsigned int simulator_t::watch_waiting(unsigned int core_num)
+{
+	unsigned int added = 0;
+	inflight_queue_t<RS_link> & waiting_queue = cores[core_num].waiting_queue;
+	for(inflight_queue_t<RS_link>::iterator it = waiting_queue.begin(); it != waiting_queue.end(); it++)
+	{
+		if(it->rs->seq == it->x.seq)
+		{
+			added += cores[core_num].reg_file.watch(it->rs, sim_cycle);
+		}
+	}
+	waiting_watched[core_num] = waiting_queue.size();
+	return added;
+}
+
 //COMMIT() - instruction retirement pipeline stage
 
 //this function commits the results of the oldest completed entries from the
 //ROB and LSQ to the architected reg file, stores in the LSQ will commit
 //their store data to the data cache at this point as well
-void commit(unsigned int core_num)
+void simulator_t::commit(unsigned int core_num)
 {
 	std::vector<int> contexts_left(cores[core_num].context_ids);
 	//Check for commit timeout
@@ -2035,6 +2368,7 @@ void commit(unsigned int core_num)
 			ptrace_endinst(contexts[context_id].LSQ[contexts[context_id].LSQ_head].ptrace_seq);
 
 			//commit head of LSQ (ROB will be committed later in this iteration
+			contexts[context_id].store_table.remove(contexts[context_id].LSQ_head);
 			contexts[context_id].LSQ_head = (contexts[context_id].LSQ_head + 1) % contexts[context_id].LSQ.size();
 			contexts[context_id].LSQ_num--;
 		}
@@ -2044,7 +2378,7 @@ void commit(unsigned int core_num)
 		{
 			cores[core_num].power.regfile_access++;
 #ifdef DYNAMIC_AF
-			cores[core_num].power.regfile_total_pop_count_cycle += pop_count(rs->val_rc);
+			cores[core_num].power.regfile_total_pop_count_cycle += pop_count(contexts[rs->context_id].state_of(rs).val_rc);
 			cores[core_num].power.regfile_num_pop_count_cycle++;
 #endif
 		}
@@ -2070,7 +2404,7 @@ void commit(unsigned int core_num)
 		//print retirement trace if in verbose mode
 		if(verbose)
 		{
-			static counter_t sim_ret_insn = 0;
+			static __thread counter_t sim_ret_insn = 0;
 			sim_ret_insn++;
 			myfprintf(stderr, "(%d) %10n @ 0x%08p: ", context_id, sim_ret_insn, contexts[context_id].ROB[contexts[context_id].ROB_head].PC);
 			md_print_insn(contexts[context_id].ROB[contexts[context_id].ROB_head].IR, contexts[context_id].ROB[contexts[context_id].ROB_head].PC, stderr);
@@ -2091,23 +2425,9 @@ void commit(unsigned int core_num)
 			//free the old physreg mapping
 			assert(cores[core_num].reg_file.reg_file_access(contexts[context_id].ROB[contexts[context_id].ROB_head].old_physreg,contexts[context_id].ROB[contexts[context_id].ROB_head].dest_format).state == REG_ARCH);
 			cores[core_num].reg_file.reg_file_access(contexts[context_id].ROB[contexts[context_id].ROB_head].old_physreg,contexts[context_id].ROB[contexts[context_id].ROB_head].dest_format).state = REG_FREE;
-			/*haque edit*/
-			reg_counter_decref_if_positive(context_id);
 			//commit the physreg mapping to arch state
 			assert(cores[core_num].reg_file.reg_file_access(contexts[context_id].ROB[contexts[context_id].ROB_head].physreg,contexts[context_id].ROB[contexts[context_id].ROB_head].dest_format).state == REG_WB);
 			cores[core_num].reg_file.reg_file_access(contexts[context_id].ROB[contexts[context_id].ROB_head].physreg,contexts[context_id].ROB[contexts[context_id].ROB_head].dest_format).state = REG_ARCH;
-			/******** DCRA ******/
-			if(rs->dest_format == REG_INT)
-			{
-				contexts[context_id].DCRA_int_rf--;
-				assert(contexts[context_id].DCRA_int_rf >= 0);
-			}
-			else
-			{
-				contexts[context_id].DCRA_fp_rf--;
-				assert(contexts[context_id].DCRA_fp_rf >= 0);
-			}
-			/********************/
 		}
 		//commit head entry of ROB
 		contexts[context_id].ROB_head = (contexts[context_id].ROB_head + 1) % contexts[context_id].ROB.size();
@@ -2124,7 +2444,7 @@ void commit(unsigned int core_num)
 //dependency chains of completing instructions are also walked to determine if any dependent
 //instruction now has all of its register operands, if so the (nearly) ready instruction is
 //inserted into the ready instruction queue
-void writeback(unsigned int core_num)
+void simulator_t::writeback(unsigned int core_num)
 {
 	ROB_entry *rs;
 	//service all completed events
@@ -2149,9 +2469,9 @@ void writeback(unsigned int core_num)
 			cores[core_num].power.window_wakeup_access++;
 			cores[core_num].power.resultbus_access++;
 #ifdef DYNAMIC_AF	
-			cores[core_num].power.window_total_pop_count_cycle += pop_count(rs->val_rc);
+			cores[core_num].power.window_total_pop_count_cycle += pop_count(contexts[rs->context_id].state_of(rs).val_rc);
 			cores[core_num].power.window_num_pop_count_cycle++;
-			cores[core_num].power.resultbus_total_pop_count_cycle += pop_count(rs->val_rc);
+			cores[core_num].power.resultbus_total_pop_count_cycle += pop_count(contexts[rs->context_id].state_of(rs).val_rc);
 			cores[core_num].power.resultbus_num_pop_count_cycle++;
 #endif
 		}
@@ -2181,7 +2501,14 @@ void writeback(unsigned int core_num)
 			//recover processor state and reinitialize fetch to correct path
 			assert(rs->next_PC == contexts[rs->context_id].recover_PC);
 
-			cores[core_num].rollbackTo(contexts[rs->context_id],sim_num_insn,rs,1);
+			//the rollback restores the memory squashed stores wrote and takes the squashed instructions off sim_num_insn,
+			//both are shared among the cores: with a quantum of 1 it runs after the cores before it (like register_rename()),
+			//with a longer quantum it counts on a copy and the difference is applied atomically
+			core_pool.ordered_enter();
+			counter_t num_insn = __sync_fetch_and_add(&sim_num_insn, 0), rolled_from = num_insn;
+			cores[core_num].rollbackTo(contexts[rs->context_id],num_insn,rs,1);
+			waiting_watched[core_num] = WAITING_RESYNC;
+			__sync_fetch_and_add(&sim_num_insn, num_insn - rolled_from);
 			//continue writeback of the branch/control instruction
 		}
 
@@ -2205,65 +2532,175 @@ void writeback(unsigned int core_num)
 	}
 }
 
+//number of bytes a load or store in the LSQ accesses, stores record it at rename (data_size)
+unsigned int lsq_access_size(ROB_entry *rs)
+{
+	std::vector<context> & contexts = current_sim->contexts;
+	const ROB_state & state = contexts[rs->context_id].state_of(rs);
+	if(state.data_size)
+	{
+		return state.data_size;
+	}
+	switch(rs->op)
+	{
+	case LDBU:
+		return 1;
+	case LDWU:
+		return 2;
+	case LDF:
+	case LDS:
+	case LDL:
+	case LDL_L:
+		return 4;
+	default:
+		return 8;
+	}
+}
+
+//checks if a load in the LSQ can be put on the ready queue: it must be dispatched, waiting, have its register operands
+//and have no STD unknown conflict (every older store that writes a byte of the load no younger store writes must have
+//its data), no STA unknown conflict is assumed (the caller only passes loads before the oldest unresolved store)
+//returns TRUE if the load is done waiting (enqueued, or already queued, issued or completed), a dispatched load that
+//has to wait is registered with the register file to be checked again when what blocks it gets ready
+int simulator_t::lsq_try_load(int context_id, unsigned int index)
+{
+	ROB_entry *rs = &contexts[context_id].LSQ[index];
+	if(rs->queued || rs->issued || rs->completed)
+	{
+		return TRUE;
+	}
+	if(!rs->dispatched)
+	{
+		return FALSE;
+	}
+	reg_file_t & reg_file = cores[contexts[context_id].core_id].reg_file;
+	if(!all_operands_spec_ready(rs))
+	{
+		reg_file.watch_load(rs, rs, sim_cycle);
+		return FALSE;
+	}
+	//a later STD known hides an earlier STD unknown, but only for the bytes it writes
+	int stores[STORE_COVER_MAX];
+	bool covered;
+	unsigned int count = contexts[context_id].store_table.older_stores(contexts[context_id].lsq_seqs(), contexts[context_id].LSQ_head, index,
+		rs->addr, lsq_access_size(rs), stores, &covered);
+	for(unsigned int i=0;i<count;i++)
+	{
+		if(!all_operands_spec_ready(&contexts[context_id].LSQ[stores[i]]))
+		{
+			reg_file.watch_load(rs, &contexts[context_id].LSQ[stores[i]], sim_cycle);
+			return FALSE;
+		}
+	}
+	//no STA or STD unknown conflicts, put load on ready queue
+	readyq_enqueue(rs);
+	return TRUE;
+}
+
 //LSQ_REFRESH() - memory access dependence checker/scheduler
 //this function locates ready instructions whose memory dependencies have been satisfied, this is
 //accomplished by walking the LSQ for loads, looking for blocking memory dependency condition
 //(e.g., earlier store with an	unknown address)
-void lsq_refresh(unsigned int core_num)
+//The walk is incremental: entries visited in earlier cycles are not walked again, and the walk continues from the oldest
+//unresolved store or undispatched entry. Visited loads that could not issue are not polled, lsq_try_load() registers
+//them with the register file and they are checked again once the register they wait for (their own operand, or the
+//data of an older store) gets a speculative ready time.
+//Commits are accounted for by LSQ_head, squashes by the seq of the last visited entry, replays set lsq_rescan.
+void simulator_t::lsq_refresh(unsigned int core_num)
 {
+	for(unsigned int thread=0;thread<cores[core_num].context_ids.size();thread++)
+	{
+		context & ctx = contexts[cores[core_num].context_ids[thread]];
+		unsigned int lsq_size = ctx.LSQ.size();
+		if(!lsq_size)
+		{
+			continue;
+		}
+
+		//committed entries left the visited part
+		unsigned int committed = (ctx.LSQ_head + lsq_size - ctx.lsq_scan_head) % lsq_size;
+		ctx.lsq_scanned = (committed < ctx.lsq_scanned) ? (ctx.lsq_scanned - committed) : 0;
+		ctx.lsq_scan_head = ctx.LSQ_head;
+
+		//a squash removed visited entries (and they may have been renamed again)
+		if(ctx.lsq_scanned && ((ctx.lsq_scanned > ctx.LSQ_num)
+			|| (ctx.lsq_seq_of((ctx.LSQ_head + ctx.lsq_scanned - 1) % lsq_size) != ctx.lsq_scan_seq)))
+		{
+			ctx.lsq_rescan = true;
+		}
+		if(ctx.lsq_rescan)
+		{
+			//the walk visits the loads again (and registers the ones still waiting), checks of loads past it are skipped
+			ctx.lsq_scanned = 0;
+			ctx.lsq_rescan = false;
+		}
+	}
+
+	//check the visited loads whose blocking register got ready (wakeup() reuses the buffer later in the cycle)
+	std::vector<ROB_entry *> & woken = woken_insts[core_num];
+	woken.clear();
+	cores[core_num].reg_file.due_load_wakeups(sim_cycle, woken);
+	for(size_t i=0;i<woken.size();i++)
+	{
+		context & ctx = contexts[woken[i]->context_id];
+		unsigned int lsq_size = ctx.LSQ.size();
+		if((ctx.core_id != static_cast<int>(core_num)) || (woken[i] < &ctx.LSQ[0]) || (woken[i] >= &ctx.LSQ[0] + lsq_size))
+		{
+			continue;
+		}
+		//loads past the visited part are left to the walk
+		unsigned int index = woken[i] - &ctx.LSQ[0];
+		if(((index + lsq_size - ctx.LSQ_head) % lsq_size) < ctx.lsq_scanned)
+		{
+			lsq_try_load(woken[i]->context_id, index);
+		}
+	}
+
 	for(unsigned int thread=0;thread<cores[core_num].context_ids.size();thread++)
 	{
 		int context_id = cores[core_num].context_ids[thread];
-		std::set<md_addr_t> std_unknowns;
+		context & ctx = contexts[context_id];
+		unsigned int lsq_size = ctx.LSQ.size();
+		if(!lsq_size)
+		{
+			continue;
+		}
 
-		//scan entire queue for ready loads: scan from oldest instruction (head) until we reach
-		//the tail or an unresolved store, after which no other instruction will become ready
-		for(unsigned int i=0, index=contexts[context_id].LSQ_head; i < contexts[context_id].LSQ_num; i++, index=(index + 1) % contexts[context_id].LSQ.size())
+		//continue the walk for ready loads: from the last visited entry until we reach the tail, an undispatched entry
+		//(dispatch is in order, so no later load is dispatched) or an unresolved store, after which no other
+		//instruction will become ready
+		for(unsigned int index=(ctx.LSQ_head + ctx.lsq_scanned) % lsq_size; ctx.lsq_scanned < ctx.LSQ_num; index=(index + 1) % lsq_size)
 		{
+			if(!ctx.lsq_dispatched(index))
+			{
+				break;
+			}
+
 			//terminate search for ready loads after first unresolved store, as no later load could be resolved in its presence
-			if((MD_OP_FLAGS(contexts[context_id].LSQ[index].op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE))
+			if(ctx.lsq_is_store(index))
 			{
-				if(!STORE_ADDR_READY(&contexts[context_id].LSQ[index]))
+				if(!STORE_ADDR_READY(&ctx.LSQ[index]))
 				{
 					//FIXME: a later STD + STD known could hide the STA unknown
 					//sta unknown, blocks all later loads, stop search
 					break;
 				}
-				else if(!all_operands_spec_ready(&contexts[context_id].LSQ[index]))
-				{
-					//sta known, but std unknown, may block a later store, record this address
-					std_unknowns.insert(contexts[context_id].LSQ[index].addr);
-				}
-				else	//STORE_ADDR_READY() && OPERANDS_READY()
-				{
-					//a later STD known hides an earlier STD unknown
-					//We erase the known STA/STD from std_unknowns, nothing happens if not found
-					std_unknowns.erase(contexts[context_id].LSQ[index].addr);
-				}
+				//sta known, a std unknown only blocks later loads that overlap it (see lsq_try_load)
 			}
 
-			if(((MD_OP_FLAGS(contexts[context_id].LSQ[index].op) & (F_MEM|F_LOAD)) == (F_MEM|F_LOAD))
-				&& contexts[context_id].LSQ[index].dispatched
-				&& /* queued? */!contexts[context_id].LSQ[index].queued
-				&& /* waiting? */!contexts[context_id].LSQ[index].issued
-				&& /* completed? */!contexts[context_id].LSQ[index].completed
-				&& /* regs ready? */all_operands_spec_ready(&contexts[context_id].LSQ[index]))
+			//a load that can't issue yet is registered for a later check by lsq_try_load()
+			if(ctx.lsq_is_load(index))
 			{
-				//no STA unknown conflict (because we got to this check), check for a STD unknown conflict
-				if(std_unknowns.find(contexts[context_id].LSQ[index].addr)==std_unknowns.end())
-				{
-					//no STA or STD unknown conflicts, put load on ready queue
-					readyq_enqueue(&contexts[context_id].LSQ[index]);
-				}
-				//else, found a relevant STD unknown? Do nothing.
-
+				lsq_try_load(context_id, index);
 			}
+			ctx.lsq_scanned++;
+			ctx.lsq_scan_seq = ctx.lsq_seq_of(index);
 		}
 	}
 }
 
 //takes instructions out of the issue_exec_q and begins their execution schedules a writeback event
-void execute(unsigned int core_num)
+void simulator_t::execute(unsigned int core_num)
 {
 	ROB_entry *rs;
 	//service all completed events
@@ -2276,6 +2713,9 @@ void execute(unsigned int core_num)
 			//to a load, handle memory misprediction here
 			if(cores[core_num].recovery_model_v==core_t::RECOVERY_MODEL_SQUASH)
 			{
+				//replayed loads and stores whose address depends on a replayed instruction must be found by lsq_refresh() again
+				contexts[context_id].lsq_rescan = true;
+
 				//This is the memory mispredicted instruction. Adjust its source register ready times
 				reg_set my_regs;
 				cores[core_num].reg_file.get_reg_set(&my_regs, rs->op);
@@ -2308,7 +2748,7 @@ void execute(unsigned int core_num)
 					if((MD_OP_FLAGS(rs->op) & F_LOAD) != F_LOAD)
 					{
 						//QUEUE IT TO WAKE UP AT THE RIGHT TIME!!
-						cores[core_num].wait_q_enqueue(rs, sim_cycle);
+						wait_q_enqueue_watched(core_num, rs);
 					}
 
 					rs = NULL;
@@ -2349,7 +2789,7 @@ void execute(unsigned int core_num)
 					assert(!rs->completed);
 					if((MD_OP_FLAGS(rs->op) & F_LOAD) != F_LOAD)
 					{
-						cores[core_num].wait_q_enqueue(rs, sim_cycle);
+						wait_q_enqueue_watched(core_num, rs);
 					}
 					it2 = cores[core_num].ready_queue.erase(it2);
 				}
@@ -2372,26 +2812,16 @@ void execute(unsigned int core_num)
 			rs->in_IQ = false;
 			contexts[rs->context_id].icount--;
 			assert(contexts[rs->context_id].icount <= (contexts[rs->context_id].IFQ.size() + contexts[context_id].ROB.size()));
-			/************ DCRA ************/
-			contexts[rs->context_id].DCRA_int_iq--;
-			assert(contexts[rs->context_id].DCRA_int_iq >= 0);
-			/******************************/
 		}
 	}
 }
 
 //checks if an instructions operand is marked as ready
 int operand_ready(ROB_entry *rs, int op_num){
-	reg_set my_regs;
-	enum reg_type src_type = REG_NONE;
-
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
 	//see if it is a floating point or integer register
-	cores[contexts[rs->context_id].core_id].reg_file.get_reg_set(&my_regs, rs->op);
-	if(op_num == 0){
-		src_type = my_regs.src1;
-	}else{
-		src_type = my_regs.src2;
-	}
+	enum reg_type src_type = reg_file_t::src_type(rs->op, op_num);
 
 	if((rs->src_physreg[op_num] >= 0) && (src_type!=REG_NONE))
 	{
@@ -2402,16 +2832,9 @@ int operand_ready(ROB_entry *rs, int op_num){
 
 //checks if an instructions operand is marked as ready (speculative based on load-latency prediction)
 int operand_spec_ready(ROB_entry *rs, int op_num){
-	reg_set my_regs;
-	enum reg_type src_type = REG_NONE;
-
-	cores[contexts[rs->context_id].core_id].reg_file.get_reg_set(&my_regs, rs->op);
-
-	if(op_num == 0){
-		src_type = my_regs.src1;
-	}else{
-		src_type = my_regs.src2;
-	}
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
+	enum reg_type src_type = reg_file_t::src_type(rs->op, op_num);
 
 	if((rs->src_physreg[op_num] >= 0) && (src_type!=REG_NONE))
 	{
@@ -2444,23 +2867,43 @@ int all_operands_spec_ready(ROB_entry *rs){
 }
 
 //wakeup() - moves instructions from the waiting_queue to the ready_queue when their source operands become ready
-void wakeup(unsigned int core_num)
+//only the instructions the register file scheduled for this cycle (consumers of registers whose spec_ready was set)
+//are checked, not the whole waiting_queue
+void simulator_t::wakeup(unsigned int core_num)
 {
-	//(*it).rs refers to the instructions within the ROB/LSQ that we are trying to wakeup
-	for(std::list<RS_link>::iterator it = cores[core_num].waiting_queue.begin();it!=cores[core_num].waiting_queue.end();)
+	//an instruction queued without wait_q_enqueue_watched() would never be scheduled, when the waiting_queue
+	//does not hold what was registered (or a rollback dropped entries) register it all again
+	if(cores[core_num].waiting_queue.size() != waiting_watched[core_num])
 	{
-		if(all_operands_spec_ready((*it).rs))
-		{
-			//instruction ready, so move it to the ready_queue
-			assert((!(*it).rs->queued)&&(!(*it).rs->completed));
-			readyq_enqueue((*it).rs);
-			it = cores[core_num].waiting_queue.erase(it);
-		}
-		else
+		watch_waiting(core_num);
+	}
+#ifdef DEBUG
+	else
+	{
+		//the count can still match if as many entries were queued elsewhere as were dropped
+		unsigned int unwatched = watch_waiting(core_num);
+		assert(unwatched == 0);
+	}
+#endif
+
+	std::vector<ROB_entry *> & woken = woken_insts[core_num];
+	woken.clear();
+	cores[core_num].reg_file.due_wakeups(sim_cycle, woken);
+
+	//woken[i] refers to the instructions within the ROB/LSQ that we are trying to wakeup
+	for(size_t i=0;i<woken.size();i++)
+	{
+		RS_link link(woken[i]);
+		if(!cores[core_num].waiting_queue.contains(link) || !all_operands_spec_ready(woken[i]))
 		{
-			(*it).x.when = sim_cycle;
-			it++;
+			//already woken, squashed, or still waiting on another operand (it is a consumer of that register too)
+			continue;
 		}
+		//instruction ready, so move it to the ready_queue
+		assert((!woken[i]->queued)&&(!woken[i]->completed));
+		readyq_enqueue(woken[i]);
+		cores[core_num].waiting_queue.remove(link);
+		waiting_watched[core_num]--;
 	}
 }
 
@@ -2471,7 +2914,7 @@ void wakeup(unsigned int core_num)
 //2) a function unit is available in this cycle to commence execution of the operation;
 //if all goes well, the function unit is allocated, a writeback event is scheduled,
 //and the instruction begins execution
-void selection(unsigned int core_num)
+void simulator_t::selection(unsigned int core_num)
 {
 	//visit all ready instructions (i.e., insts whose register input
 	//	dependencies have been satisfied, stop issue when no more instructions
@@ -2543,7 +2986,7 @@ void selection(unsigned int core_num)
 			cores[core_num].power.lsq_store_data_access++;
 			cores[core_num].power.lsq_preg_access++;
 #ifdef DYNAMIC_AF
-			cores[core_num].power.lsq_total_pop_count_cycle += pop_count(rs->val_ra);
+			cores[core_num].power.lsq_total_pop_count_cycle += pop_count(contexts[rs->context_id].state_of(rs).val_ra);
 			cores[core_num].power.lsq_num_pop_count_cycle++;
 #endif
 			//one more inst issued
@@ -2580,24 +3023,18 @@ void selection(unsigned int core_num)
 						cores[core_num].power.lsq_access++;
 						cores[core_num].power.lsq_wakeup_access++;
 
-						//for loads, determine cache access latency: first scan LSQ to see if a store forward is
-						//possible, if not, access the data cache
-						load_lat = 0;
-						for(unsigned int i = (rs - &contexts[rs->context_id].LSQ[0]);i!=contexts[rs->context_id].LSQ_head;)
-						{
-							//go to next earlier LSQ entry
-							i = (i + (contexts[rs->context_id].LSQ.size()-1)) % contexts[rs->context_id].LSQ.size();
-
-							//FIXME: not dealing with partials!
-							//Aside from the destination address (which is known) we need to know how many bytes are stored
-							//and how many bytes are being read
-							if((MD_OP_FLAGS(contexts[rs->context_id].LSQ[i].op) & F_STORE) && (contexts[rs->context_id].LSQ[i].addr == rs->addr))
-							{
-								//hit in the LSQ
-								load_lat = 1;
-								break;
-							}
-				  		}
+						//for loads, determine cache access latency: walk the older stores the load overlaps (the same walk
+						//lsq_try_load() checked their data with), the value is forwarded if they write every byte the load
+						//reads, otherwise the load goes to the data cache
+						load_lat = 0;
+						int stores[STORE_COVER_MAX];
+						bool covered;
+						if(contexts[rs->context_id].store_table.older_stores(contexts[rs->context_id].lsq_seqs(), contexts[rs->context_id].LSQ_head,
+							rs - &contexts[rs->context_id].LSQ[0], rs->addr, lsq_access_size(rs), stores, &covered) && covered)
+						{
+							//hit in the LSQ
+							load_lat = 1;
+						}
 
 						//was the value store forwared from the LSQ?
 						if(!load_lat)
@@ -2606,7 +3043,7 @@ void selection(unsigned int core_num)
 
 							if(!rs->spec_mode && !valid_addr)
 							{
-								sim_invalid_addrs++;
+								__sync_fetch_and_add(&sim_invalid_addrs, 1);
 							}
 
 							//no! go to the data cache if addr is valid
@@ -2616,7 +3053,7 @@ void selection(unsigned int core_num)
 								cores[core_num].power.dcache_access++;
 
 								//access the cache if non-faulting
-								load_lat = cores[core_num].cache_dl1->cache_access(Read,(rs->addr & ~3), rs->context_id, NULL, 4, sim_cycle, NULL, NULL);
+								load_lat = cores[core_num].cache_dl1->cache_access(Read,(rs->addr & ~3), rs->context_id, NULL, 4, sim_cycle, NULL, NULL, rs->PC);
 
 								if(load_lat > cores[core_num].cache_dl1_lat)
 								{
@@ -2764,7 +3201,7 @@ void selection(unsigned int core_num)
 					cores[core_num].power.window_preg_access++;
 					cores[core_num].power.window_preg_access++;
 #ifdef DYNAMIC_AF	
-					cores[core_num].power.window_total_pop_count_cycle += pop_count(rs->val_ra) + pop_count(rs->val_rb);
+					cores[core_num].power.window_total_pop_count_cycle += pop_count(contexts[rs->context_id].state_of(rs).val_ra) + pop_count(contexts[rs->context_id].state_of(rs).val_rb);
 					cores[core_num].power.window_num_pop_count_cycle+=2;
 #endif
 					//one more inst issued
@@ -2805,7 +3242,7 @@ void selection(unsigned int core_num)
 				cores[core_num].power.window_preg_access++;
 				cores[core_num].power.window_preg_access++;
 #ifdef DYNAMIC_AF
-				cores[core_num].power.window_total_pop_count_cycle += pop_count(rs->val_ra) + pop_count(rs->val_rb);
+				cores[core_num].power.window_total_pop_count_cycle += pop_count(contexts[rs->context_id].state_of(rs).val_ra) + pop_count(contexts[rs->context_id].state_of(rs).val_rb);
 				cores[core_num].power.window_num_pop_count_cycle+=2;
 #endif
 				//one more inst issued
@@ -2909,8 +3346,9 @@ const char * simoo_mem_obj(mem_t *mem,		//memory space to access
 #define WRITE_QWORD(SRC, DST, FAULT)	__WRITE_SPECMEM(MD_SWAPQ(SRC), (DST), temp_qword, (FAULT))
 
 //system call handler macro - only execute system calls in non-speculative mode
-#define SYSCALL(INST)			((spec_mode ? panic("speculative syscall at %lld",sim_cycle) : (void) 0),	sys_syscall(regs, mem, INST))
-#define PALCALL(INST)			((spec_mode ? panic("speculative palcall at %lld",sim_cycle) : (void) 0),	sys_palcall(regs, mem, INST))
+//system calls may fork, exit or wait on contexts of other cores, so no other core may be running
+#define SYSCALL(INST)			((spec_mode ? panic("speculative syscall at %lld",sim_cycle) : (void) 0),	core_pool.exclusive_enter(), sys_syscall(regs, mem, INST))
+#define PALCALL(INST)			((spec_mode ? panic("speculative palcall at %lld",sim_cycle) : (void) 0),	core_pool.exclusive_enter(), sys_palcall(regs, mem, INST))
 
 //default register state accessor, used by DLite
 //Returns an error string (or NULL for no error)
@@ -3023,6 +3461,7 @@ const char * simoo_reg_obj(regs_t *regs,	//registers to access
 //counts the number of instructions in the rename->dispatch pipeline for a particular thread
 unsigned int not_dispatched_count(int context_id)
 {
+	std::vector<context> & contexts = current_sim->contexts;
 	unsigned int count = 0, num_searched = 0;
 
 	//walk ROB, and count non-dispatched functions
@@ -3043,10 +3482,14 @@ unsigned int not_dispatched_count(int context_id)
 //rename instructions from the IFETCH -> RENAME queue: instructions are
 //	first decoded, then they allocated ROB (and LSQ for load/stores) resources
 //	and then their registers are renamed
-void register_rename(unsigned int core_num)
+void simulator_t::register_rename(unsigned int core_num)
 {
 	int made_check(FALSE);				//used to ensure DLite entry
 
+	//functional execution, syscalls and the pid handler are shared among the cores, with a quantum of 1
+	//the core runs after the cores before it from here on (see core_pool_t::ordered_enter)
+	core_pool.ordered_enter();
+
 	//Threads left to rename from
 	std::vector<int> contexts_left(cores[core_num].context_ids);
 
@@ -3178,16 +3621,14 @@ void register_rename(unsigned int core_num)
 		//make sure we have a free physical register for the destination haque edit
 		if(my_regs.dest != REG_NONE)
 		{
+			//enforce the per-thread limit on outstanding renamed (allocated) phys regs
+			if(!cap_policy.allow(disp_context_id, my_regs.dest, cap_usage(disp_context_id)))
 			{
-				// enforce per-thread limit on outstanding renamed (allocated) phys regs
-				if (disp_context_id >= 0 && disp_context_id < num_contexts && reg_counter[disp_context_id] >= RENAME_REG_LIMIT) {
-					// stall rename for this thread until some registers are freed (freed at commit)
-					contexts_left.erase(contexts_left.begin()+current_context);
-					continue;
-				}
-			
+				//stall rename for this thread until some registers are freed (freed at commit)
+				contexts_left.erase(contexts_left.begin()+current_context);
+				continue;
 			}
-			if(cores[core_num].reg_file.find_free_physreg(my_regs.dest) < 0)
+			if(!cores[core_num].reg_file.free_count(my_regs.dest))
 			{
 				//stall because there are no physical registers free
 				contexts_left.erase(contexts_left.begin()+current_context);
@@ -3214,7 +3655,7 @@ void register_rename(unsigned int core_num)
 		regs->regs_F[MD_REG_ZERO].d = 0.0;
 
 		//one more instruction executed
-		sim_num_insn++;
+		__sync_fetch_and_add(&sim_num_insn, 1);
 		cores[core_num].sim_num_insn_core++;
 
 		//default effective address (0). Maintain a flag to determine if this is a store.
@@ -3441,6 +3882,7 @@ void register_rename(unsigned int core_num)
 			rs->PC = regs->regs_PC;
 			rs->next_PC = regs->regs_NPC; rs->pred_PC = contexts[disp_context_id].pred_PC;
 			rs->in_LSQ = FALSE;
+			ROB_state & rs_state = contexts[disp_context_id].state_of(rs);
 			rs->LSQ_index = -1;
 			rs->ea_comp = FALSE;
 			rs->recover_inst = FALSE;
@@ -3449,7 +3891,7 @@ void register_rename(unsigned int core_num)
 			rs->spec_mode = contexts[disp_context_id].spec_mode;
 			rs->addr = 0;
 			rs->replayed = FALSE;
-			rs->seq = ++inst_seq;
+			rs->seq = __sync_add_and_fetch(&inst_seq, 1);
 			rs->in_IQ = rs->dispatched = rs->queued = rs->issued = rs->completed = FALSE;
 			rs->ptrace_seq = pseq;
 			rs->context_id = disp_context_id;
@@ -3462,8 +3904,8 @@ void register_rename(unsigned int core_num)
 			//store the physical source registers
 			rs->src_physreg[0] = contexts[disp_context_id].rename_table[in1];
 			rs->src_physreg[1] = contexts[disp_context_id].rename_table[in2];
-			rs->regs_C = regs_C;
-			rs->regs_index = -1;
+			rs_state.regs_C = regs_C;
+			rs_state.regs_index = -1;
 			rs->L1_miss = rs->L2_miss = rs->L3_miss = 0;
 			rs->iq_entry_num = -1;
 			contexts[disp_context_id].last_op = RS_link(rs);
@@ -3484,38 +3926,32 @@ void register_rename(unsigned int core_num)
 				{
 					if(my_regs.dest==REG_INT)
 					{
-						/******* DCRA *********/
-						contexts[disp_context_id].DCRA_int_rf++;
-						assert(contexts[disp_context_id].DCRA_int_rf <= cores[core_num].reg_file.size());
-						/**********************/
-						rs->regs_index = DGPR(out1);
-						if(rs->regs_index==Rlist[0])
+						rs_state.regs_index = DGPR(out1);
+						if(rs_state.regs_index==Rlist[0])
 						{
-							rs->regs_R = regs_R[0];
-						} else if(rs->regs_index==Rlist[1])
+							rs_state.regs_R = regs_R[0];
+						} else if(rs_state.regs_index==Rlist[1])
 						{
-							rs->regs_R = regs_R[1];
+							rs_state.regs_R = regs_R[1];
 						}
 						else
 						{
-							assert(rs->regs_index==Rlist[2]);
-							rs->regs_R = regs_R[2];
+							assert(rs_state.regs_index==Rlist[2]);
+							rs_state.regs_R = regs_R[2];
 						}
 					}
 					else
 					{
 						/******* DCRA *********/
 						contexts[disp_context_id].DCRA_activity_fp = 256;
-						contexts[disp_context_id].DCRA_fp_rf++;
-						assert(contexts[disp_context_id].DCRA_fp_rf <= cores[core_num].reg_file.size());
 						/**********************/
-						rs->regs_index = DFPR(out1);
-						if(rs->regs_index==Rlist[0])
+						rs_state.regs_index = DFPR(out1);
+						if(rs_state.regs_index==Rlist[0])
 						{
-							rs->regs_F = regs_F[0];
-						} else if(rs->regs_index==Rlist[1])
+							rs_state.regs_F = regs_F[0];
+						} else if(rs_state.regs_index==Rlist[1])
 						{
-							rs->regs_F = regs_F[1];
+							rs_state.regs_F = regs_F[1];
 						}
 						else
 						{
@@ -3524,24 +3960,17 @@ void register_rename(unsigned int core_num)
 							if(out1==DFPCR)
 							{
 								//FPCR is already preserved by regs_C. We want to nop the rollback here
-								rs->regs_index = Rlist[2];
+								rs_state.regs_index = Rlist[2];
 								//This register didn't change anyway. Now it matches and we don't have to alter the rollback code
 							}
-							assert(rs->regs_index==Rlist[2]);
-							rs->regs_F = regs_F[2];
+							assert(rs_state.regs_index==Rlist[2]);
+							rs_state.regs_F = regs_F[2];
 						}
 						//This lets us keep track of FP via regs_index.
-						rs->regs_index+=32;
+						rs_state.regs_index+=32;
 					}
 					rs->physreg = cores[core_num].reg_file.alloc_physreg(rs,sim_cycle,contexts[disp_context_id].rename_table);
 					assert(rs->physreg >= 0);
-					/*haque edit*/
-					if (rs->physreg >= 0) {
-						int tid = disp_context_id;
-						if (tid >= 0 && tid < num_contexts) {
-							reg_counter[tid]++;
-						}
-					}
 				}
 				rs->dest_format = my_regs.dest;
 			}
@@ -3554,10 +3983,10 @@ void register_rename(unsigned int core_num)
 			}
 
 			//Wattch: Maintain values through core for AFs
-			rs->val_ra = val_ra;
-			rs->val_rb = val_rb;
-			rs->val_rc = val_rc;
-			rs->val_ra_result = val_ra_result;
+			rs_state.val_ra = val_ra;
+			rs_state.val_rb = val_rb;
+			rs_state.val_rc = val_rc;
+			rs_state.val_ra_result = val_ra_result;
 
 			//split ld/st's into two operations: eff addr comp + mem access
 			if(MD_OP_FLAGS(op) & F_MEM)
@@ -3574,6 +4003,7 @@ void register_rename(unsigned int core_num)
 				lsq->next_PC = regs->regs_NPC; lsq->pred_PC = contexts[disp_context_id].pred_PC;
 				rs->LSQ_index = contexts[disp_context_id].LSQ_tail;
 				lsq->in_LSQ = TRUE;
+				ROB_state & lsq_state = contexts[disp_context_id].state_of(lsq);
 				lsq->in_IQ = FALSE;
 				lsq->ea_comp = FALSE;
 				lsq->dispatched = FALSE;
@@ -3583,7 +4013,7 @@ void register_rename(unsigned int core_num)
 				lsq->stack_recover_idx = 0;
 				lsq->spec_mode = contexts[disp_context_id].spec_mode;
 				lsq->addr = addr;
-				lsq->seq = ++inst_seq;
+				lsq->seq = __sync_add_and_fetch(&inst_seq, 1);
 				lsq->replayed = FALSE;
 				lsq->queued = lsq->issued = lsq->completed = FALSE;
 				lsq->ptrace_seq = pseq;
@@ -3599,14 +4029,29 @@ void register_rename(unsigned int core_num)
 				lsq->old_physreg = -1;
 				lsq->dest_format = rs->dest_format;
 				//Wattch: Maintain values through core for AFs
-				lsq->val_ra = val_ra;
-				lsq->val_rb = val_rb;
-				lsq->val_rc = val_rc;
-				lsq->val_ra_result = val_ra_result;
-				lsq->previous_mem = previous_mem;
-				lsq->data_size = data_size;
-				lsq->is_store = ((MD_OP_FLAGS(op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE));
+				lsq_state.val_ra = val_ra;
+				lsq_state.val_rb = val_rb;
+				lsq_state.val_rc = val_rc;
+				lsq_state.val_ra_result = val_ra_result;
+				lsq_state.previous_mem = previous_mem;
+				lsq_state.data_size = data_size;
+				lsq_state.is_store = ((MD_OP_FLAGS(op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE));
+
+				//index stores by address for forwarding, drop any record left in this slot by a squashed store
+				if(contexts[disp_context_id].store_table.lsq_size() != contexts[disp_context_id].LSQ.size())
+				{
+					contexts[disp_context_id].store_table.resize(contexts[disp_context_id].LSQ.size());
+				}
+				if(MD_OP_FLAGS(op) & F_STORE)
+				{
+					contexts[disp_context_id].store_table.insert(rs->LSQ_index, lsq->seq, lsq->addr, lsq_access_size(lsq));
+				}
+				else
+				{
+					contexts[disp_context_id].store_table.remove(rs->LSQ_index);
+				}
 				lsq->iq_entry_num = -1;
+				contexts[disp_context_id].lsq_hot_update(rs->LSQ_index);
 
 				//pipetrace this uop
 				ptrace_newuop(lsq->ptrace_seq, "internal ld/st", lsq->PC, 0);
@@ -3726,7 +4171,7 @@ void register_rename(unsigned int core_num)
 }
 
 //dispatches instruction into the IQ
-void dispatch(unsigned int core_num)
+void simulator_t::dispatch(unsigned int core_num)
 {
 	//round robin dispatch
 	std::vector<int> contexts_left(cores[core_num].context_ids);
@@ -3785,7 +4230,8 @@ void dispatch(unsigned int core_num)
 		//rs now refers to a valid instruction for dispatch
 
 		//if IQ is full, block this thread
-		int my_iq_num = cores[core_num].iq.alloc_iq_entry();
+		//the IQ tracks per-thread occupancy of the entry (used by DCRA)
+		int my_iq_num = cores[core_num].iq.alloc_iq_entry(disp_context_id);
 		if(my_iq_num < 0)
 		{
 			contexts_left.erase(contexts_left.begin()+current_context);
@@ -3794,11 +4240,6 @@ void dispatch(unsigned int core_num)
 
 		//IQ entry obtained, instruction will be dispatched now
 
-		/************* DCRA ************/
-		contexts[disp_context_id].DCRA_int_iq++;
-		assert(contexts[disp_context_id].DCRA_int_iq <= cores[core_num].iq.size());
-		/*******************************/
-
 		//update the ROB entry, dispatch time, IQ status
 		rs->disp_cycle = sim_cycle;
 		rs->dispatched = TRUE;
@@ -3819,8 +4260,8 @@ void dispatch(unsigned int core_num)
 			cores[core_num].power.window_preg_access++;
 			cores[core_num].power.window_preg_access++;
 #ifdef DYNAMIC_AF
-			cores[core_num].power.regfile_total_pop_count_cycle += pop_count(rs->val_ra);
-			cores[core_num].power.regfile_total_pop_count_cycle += pop_count(rs->val_rb);
+			cores[core_num].power.regfile_total_pop_count_cycle += pop_count(contexts[rs->context_id].state_of(rs).val_ra);
+			cores[core_num].power.regfile_total_pop_count_cycle += pop_count(contexts[rs->context_id].state_of(rs).val_rb);
 			cores[core_num].power.regfile_num_pop_count_cycle+=2;
 #endif
 	
@@ -3835,9 +4276,9 @@ void dispatch(unsigned int core_num)
 			cores[core_num].power.window_preg_access++;
 #ifdef DYNAMIC_AF
 			if(operand_ready(rs,0))
-				cores[core_num].power.regfile_total_pop_count_cycle += pop_count(rs->val_ra);
+				cores[core_num].power.regfile_total_pop_count_cycle += pop_count(contexts[rs->context_id].state_of(rs).val_ra);
 			else
-				cores[core_num].power.regfile_total_pop_count_cycle += pop_count(rs->val_rb);
+				cores[core_num].power.regfile_total_pop_count_cycle += pop_count(contexts[rs->context_id].state_of(rs).val_rb);
 			cores[core_num].power.regfile_num_pop_count_cycle++;
 #endif
 		}
@@ -3849,6 +4290,7 @@ void dispatch(unsigned int core_num)
 			ROB_entry *lsq = &contexts[disp_context_id].LSQ[rs->LSQ_index];
 			lsq->disp_cycle = sim_cycle;
 			lsq->dispatched = TRUE;
+			contexts[disp_context_id].lsq_hot_update(rs->LSQ_index);
 
 			//issue stores only, loads are issued by lsq_refresh()
 			if(MD_OP_FLAGS(lsq->op) & F_STORE)
@@ -3866,7 +4308,7 @@ void dispatch(unsigned int core_num)
 				else
 				{
 					assert(!lsq->queued);
-					cores[core_num].wait_q_enqueue(lsq, sim_cycle);
+					wait_q_enqueue_watched(core_num, lsq);
 				}
 			}
 		}
@@ -3874,7 +4316,7 @@ void dispatch(unsigned int core_num)
 		//If instruction was not ready (not put into readyq_enqueue) then it is put into waiting queue here
 		if(!rs->queued)
 		{
-			cores[core_num].wait_q_enqueue(rs, sim_cycle);
+			wait_q_enqueue_watched(core_num, rs);
 		}
 		num_dispatched++;
 	}
@@ -3885,7 +4327,7 @@ void dispatch(unsigned int core_num)
 //access will support without overflowing the instruction fetch queue (IFQ)
 //contexts_left comes from the core's fetching logic and refers to the order
 //of eligible contexts for fetching
-void fetch(std::vector<int> contexts_left)
+void simulator_t::fetch(std::vector<int> contexts_left)
 {
 	std::vector<int>::iterator it = contexts_left.begin();
 	while(it != contexts_left.end())
@@ -4129,10 +4571,13 @@ void fetch(std::vector<int> contexts_left)
 //used for ICOUNT and DCRA fetch
 int my_comparator(const int & a1, const int & a2)
 {
+	std::vector<context> & contexts = current_sim->contexts;
 	return (contexts[a1].icount < contexts[a2].icount);
 }
 
 std::vector<int> icount_fetch(unsigned int core_num){
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
 	std::vector<int> sorted_contexts(cores[core_num].context_ids);
 
 	for(unsigned int i=0;i<sorted_contexts.size();i++){
@@ -4146,6 +4591,7 @@ std::vector<int> icount_fetch(unsigned int core_num){
 }
 
 std::vector<int> RR_fetch(unsigned int core_num){
+	std::vector<core_t> & cores = current_sim->cores;
 	std::vector<int> sorted_contexts(cores[core_num].context_ids);
 
 	for(unsigned int i=0;i<cores[core_num].context_ids.size();i++){
@@ -4157,6 +4603,8 @@ std::vector<int> RR_fetch(unsigned int core_num){
 
 std::vector<int> dcra_fetch(unsigned int core_num)
 {
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
 	std::vector<int> sorted_contexts(cores[core_num].context_ids);
 	int num_fa = 0, num_sa = 0;
 	std::vector<int> fast(sorted_contexts.size(),0);
@@ -4184,14 +4632,15 @@ std::vector<int> dcra_fetch(unsigned int core_num)
 		if(!fast[i])
 		{
 			int context_id = sorted_contexts[i];
-			if(contexts[context_id].DCRA_int_iq >= cores[core_num].iq.size() / num_contexts * (1 + (1/num_contexts) * num_fa))
+			if(cores[core_num].iq.occupancy(context_id) >= cores[core_num].iq.size() / num_contexts * (1 + (1/num_contexts) * num_fa))
 			{
 				sorted_contexts.erase(sorted_contexts.begin()+i);
 				fast.erase(fast.begin()+i);
 				i--;
 				continue;
 			}
-			if(contexts[context_id].DCRA_int_rf >= cores[core_num].reg_file.size() / num_contexts * (1 + (1/num_contexts) * num_fa))
+			//register occupancy is tracked by the register file (see reg_file_t::in_flight)
+			if(cores[core_num].reg_file.in_flight(context_id,REG_INT) >= cores[core_num].reg_file.size() / num_contexts * (1 + (1/num_contexts) * num_fa))
 			{
 				sorted_contexts.erase(sorted_contexts.begin()+i);
 				fast.erase(fast.begin()+i);
@@ -4200,7 +4649,7 @@ std::vector<int> dcra_fetch(unsigned int core_num)
 			}
 			if(num_fa + num_sa)
 			{
-				if(contexts[context_id].DCRA_fp_rf >= cores[core_num].reg_file.size() / (num_fa + num_sa) * (1 + (1/(num_fa + num_sa)) * num_fa))
+				if(cores[core_num].reg_file.in_flight(context_id,REG_FP) >= cores[core_num].reg_file.size() / (num_fa + num_sa) * (1 + (1/(num_fa + num_sa)) * num_fa))
 				{
 					sorted_contexts.erase(sorted_contexts.begin()+i);
 					fast.erase(fast.begin()+i);
@@ -4225,6 +4674,8 @@ const char * simoo_mstate_obj(FILE *stream,		//output stream
 	regs_t *regs,					//registers to access
 	mem_t *mem)					//memory space to access
 {
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
 	if(!cmd || !strcmp(cmd, "help"))
 		fprintf(stream,
 			"mstate commands:\n"
@@ -4288,6 +4739,7 @@ const char * simoo_mstate_obj(FILE *stream,		//output stream
 //What information should we put here?
 void segfault_handler(int sig_type)
 {
+	std::vector<context> & contexts = current_sim->contexts;
 	std::cout << "Segmentation fault occurred at cycle: " << sim_cycle << std::endl;
 	for(size_t i=0;i<contexts.size();i++)
 	{
@@ -4300,7 +4752,7 @@ void segfault_handler(int sig_type)
 
 //Fast forward handler
 //int ff_context(unsigned int context_id, long long insts, int mode)
-int ff_context(unsigned int current_context, long long insts_count, ff_mode_t mode)
+int simulator_t::ff_context(unsigned int current_context, long long insts_count, ff_mode_t mode)
 {
 //	md_inst_t inst(0);		//actual instruction bits
 //	enum md_opcode op(MD_NOP_OP);	//decoded opcode enum
@@ -4398,7 +4850,7 @@ int ff_context(unsigned int current_context, long long insts_count, ff_mode_t mo
 			int stack_recover_idx(0);
 			bpred_update_t dir_update;		//bpred direction update info
 
-			int latency = cores[core_num].cache_dl1->cache_access(Read, (addr&~3), current_context, NULL, 4, sim_cycle, NULL, NULL);
+			int latency = cores[core_num].cache_dl1->cache_access(Read, (addr&~3), current_context, NULL, 4, sim_cycle, NULL, NULL, regs->regs_PC);
 
 			if((cores[core_num].recovery_model_v==core_t::RECOVERY_MODEL_SQUASH) && (!(mode & NO_WARMUP)))
 			{
@@ -4461,6 +4913,7 @@ int ff_context(unsigned int current_context, long long insts_count, ff_mode_t mo
 	//go to the next instruction
 	contexts[current_context].regs.regs_PC = contexts[current_context].regs.regs_NPC;
 	contexts[current_context].regs.regs_NPC += sizeof(md_inst_t);
+	sim_ff_insn++;
 
 	//one more instruction has been executed (1 has already been counted)
 	//This portion is unclear at the prototype and should be clarified or fixed.
@@ -4471,7 +4924,7 @@ int ff_context(unsigned int current_context, long long insts_count, ff_mode_t mo
 	return 0;
 }
 
-bool continue_fastfwd(std::vector<unsigned int> & contexts_left)
+bool simulator_t::continue_fastfwd(std::vector<unsigned int> & contexts_left)
 {
 	bool retval = false;
 	for(size_t i=0;i<contexts_left.size();i++)
@@ -4487,8 +4940,119 @@ bool continue_fastfwd(std::vector<unsigned int> & contexts_left)
 	return retval;
 }
 
+//one cycle of core core_num at sim_cycle: the pipe stages are traversed in reverse order
+//to eliminate this/next state synchronization and relaxation problems
+//Runs on a core_pool thread, see core_pool.h for what the cores may share
+void simulator_t::core_cycle(unsigned int core_num)
+{
+	//added for Wattch to clear hardware access counters
+	cores[core_num].power.clear_access_stats();
+
+	if(cores[core_num].context_ids.empty())
+	{
+		//a lower numbered core may fork a context onto this one during the cycle
+		core_pool.ordered_enter();
+		if(cores[core_num].context_ids.empty())
+		{	//The core has no contexts, nothing to do
+			core_empty[core_num] = 1;
+			cores[core_num].power.update_power_stats();
+			return;
+		}
+	}
+	core_empty[core_num] = 0;
+
+
+	//commit entries from ROB/LSQ to architected register file
+	//commit COMMIT_WIDTH intsructions from each context each cycle
+	commit(core_num);
+
+	//Reduce busy time of in-use functional units by 1 cycle
+	cores[core_num].update_fu();
+
+	//==> may have ready queue entries carried over from previous cycles
+	//service result completions, also readies dependent operations
+	//==> inserts operations into ready queue --> register deps resolved
+	writeback(core_num);
+
+	//try to locate memory operations that are ready to execute
+	//==> inserts operations into ready queue --> mem deps resolved
+	//refresh each core, which refreshes each thread
+	lsq_refresh(core_num);
+
+	//issue operations ready to execute from a previous cycle
+	//<== drains ready queue <-- ready operations commence execution
+	//scheduling occurs in two phases: instruction wakeup and instruction selection
+	//wakeup instructions once their source opearnds are ready (speculative on loads)
+	wakeup(core_num);
+
+	//select among the ready instructions for functional units and issue them to begin RF access
+	selection(core_num);
+
+	//actually begin the execution of instructions on the functional units
+	execute(core_num);
+
+	//dispatch instructions to the IQ
+	dispatch(core_num);
+
+	//decode and rename new operations
+	//==> insert ops w/ no deps or all regs ready --> reg deps resolved
+	register_rename(core_num);
+
+	fetch(cores[core_num].fetcher(core_num));
+
+	//decrement the fetch-issue delay counters (used for min. branch mispred. penalty)
+	for(size_t i=0;i<cores[core_num].context_ids.size();i++)
+	{
+		int context_id = cores[core_num].context_ids[i];
+		if(contexts[context_id].fetch_issue_delay)
+		{
+			contexts[context_id].fetch_issue_delay--;
+		}
+	}
+
+	//Added for Wattch to update per-cycle power statistics
+	cores[core_num].power.update_power_stats();
+
+	//sample rename register occupancy for the cap policy stats
+	for(size_t i=0;i<cores[core_num].context_ids.size();i++)
+	{
+		cap_policy.sample(cores[core_num].context_ids[i], cap_usage(cores[core_num].context_ids[i]));
+	}
+
+	//adaptive caps are redistributed among the threads of each core
+	if(cap_policy.interval_done(sim_cycle + 1))
+	{
+		std::vector<long long> committed(num_contexts);
+		for(size_t i=0;i<cores[core_num].context_ids.size();i++)
+		{
+			int context_id = cores[core_num].context_ids[i];
+			committed[context_id] = contexts[context_id].sim_num_insn;
+		}
+		cap_policy.adapt(cores[core_num].context_ids, committed);
+	}
+}
+
+//runs core core_num through the current quantum on its own clock
+void simulator_t::core_quantum(unsigned int core_num)
+{
+	for(tick_t cycle = 0; cycle < quantum_cycles; cycle++)
+	{
+		sim_cycle = quantum_start + cycle;
+		core_pool.safe_point();
+		core_cycle(core_num);
+		core_pool.end_cycle();
+	}
+}
+
+//core_pool entry point, core_num runs the current quantum of simulation sim on this thread
+void simulator_t::run_core_quantum(void * sim, unsigned int core_num)
+{
+	current_sim = static_cast<simulator_t *>(sim);
+	current_sim->core_quantum(core_num);
+}
+
 //start simulation, program loaded, processor precise state initialized
-void sim_main()
+void simulator_t::run()
 {
 //FIXME: Don't do this here, do this at cache creation time:
 #ifdef BUS_CONTENTION
@@ -4509,15 +5073,18 @@ void sim_main()
 		assert(cores[i].context_ids.size() <= static_cast<unsigned int>(max_contexts_per_core));
 	}
 
-	//load the first context...
-	int current_context = num_contexts - 1;
-
 	//check for DLite debugger entry condition
 	if(dlite_check_break(contexts[0].dlite_evaluator, contexts[0].regs.regs_PC, /* no access */0, /* addr */0, 0, 0))
 	{
 		contexts[0].dlite_evaluator->dlite_main(contexts[0].regs.regs_PC, contexts[0].regs.regs_PC + sizeof(md_inst_t), sim_cycle);
 	}
 
+	//restore the contexts (and warm state) written by -chkpt:write
+	if(chkpt_read_name && std::string(chkpt_read_name)!="none")
+	{
+		chkpt_read(chkpt_read_name, cache_il3, cache_dl3);
+	}
+
 	//if fastfwd_count is 1, then use the fastfwd numbers in the .arg files
 	//otherwise use the specified fastfwd_count from each thread
 	if(fastfwd_count != 1)
@@ -4542,6 +5109,8 @@ void sim_main()
 		contexts_left[i] = i;
 	}
 	fprintf(stderr, "sim: ** fast forwarding insts **\n");
+	timeval ff_start;
+	gettimeofday(&ff_start, NULL);
 	while(continue_fastfwd(contexts_left))
 	{
 		for(size_t j=0;j<contexts_left.size();j++)
@@ -4601,6 +5170,20 @@ void sim_main()
 			start_contexts++;
 		}
 	}
+	timeval ff_end;
+	gettimeofday(&ff_end, NULL);
+	sim_ff_time = (ff_end.tv_sec - ff_start.tv_sec) + (ff_end.tv_usec - ff_start.tv_usec) / 1e6;
+	if(sim_ff_insn)
+	{
+		fprintf(stderr, "sim: fast-forwarded %lld insts in %.2f s (%.2f M insts/s)\n", (long long)sim_ff_insn, sim_ff_time,
+			sim_ff_time > 0 ? sim_ff_insn / sim_ff_time / 1e6 : 0.0);
+	}
+
+	if(chkpt_write_name && std::string(chkpt_write_name)!="none")
+	{
+		chkpt_write(chkpt_write_name, chkpt_warm, chkpt_text, cache_il3, cache_dl3);
+		std::cerr << "Checkpoint of " << num_contexts << " contexts created at location: " << chkpt_write_name << std::endl;
+	}
 
 	//set up timing simulation entry state
 	for(int i=0;i<num_contexts;i++)
@@ -4630,8 +5213,11 @@ void sim_main()
 		if(cores[i].dtlb){
 			cores[i].dtlb->reset_cache_stats();
 		}
-		cores[i].main_mem->reset();
+		if(cores[i].main_mem)
+			cores[i].main_mem->reset();
 	}
+	if(dram_ctrl)
+		dram_ctrl->reset();
 	if(cache_dl3)
 		cache_dl3->reset_cache_stats();
 	if(cache_il3)
@@ -4655,35 +5241,67 @@ void sim_main()
 		std::cerr << "Checkpoint created from " << contexts[0].filename << " at location: " << eio_name << std::endl;
 	}
 
+	//fork the timing configurations of -sim:fanout, they share the fast-forwarded and warmed state
+	if(fanout_name && std::string(fanout_name)!="none")
+	{
+		fanout();
+	}
+
+	timing();
+
+	//this configuration is done, report the ones forked from it
+	fanout_wait();
+}
+
+//timing simulation of the fast-forwarded contexts, until a limit is reached or every core is empty
+void simulator_t::timing()
+{
 	std::cerr << "sim: ** starting performance simulation **" << std::endl;
-	current_context = 0;
+	int current_context = 0;
 
 	if(num_contexts==0)
 	{	//This is probably not needed, however, it was checked for in the main loop every cycle and doesn't need to be
 		return;
 	}
 	
-	#ifdef MD_NUM_IREGS
-		int _arch_regs_for_snapshot = MD_NUM_IREGS;
-	#else
-		int _arch_regs_for_snapshot = 32;
-	#endif
-
-	static std::vector<std::vector<int> > initial_rename;
-	initial_rename.resize(num_contexts);
-	for (int t = 0; t < num_contexts; ++t) {
-	    initial_rename[t].resize(_arch_regs_for_snapshot);
-	    for (int r = 0; r < _arch_regs_for_snapshot; ++r) {
-		initial_rename[t][r] = contexts[t].rename_table[r];
-	    }
-	}
-	//haque edit
-	for (int t = 0; t < num_contexts; ++t) {
-		reg_counter[t] = 0;
-	}
-
-	//main simulator loop, NOTE: the pipe stages are traverse in reverse order
-	//to eliminate this/next state synchronization and relaxation problems
+	//resolve the rename caps now that every context is placed on a core
+	{
+		std::vector<int> rename_regs(num_contexts);
+		for(int t=0;t<num_contexts;t++)
+		{
+			//the int and fp files both have rf_size registers, the caps count registers of either class
+			rename_regs[t] = 2 * (cores[contexts[t].core_id].rf_size - (32 * max_contexts_per_core));
+		}
+		cap_policy.init(rename_regs);
+	}
+
+	//run the cores on host threads, pipetraces and retirement traces are written in order so they stay serial
+	core_empty.assign(cores.size(), 0);
+	waiting_watched.assign(cores.size(), 0);
+	woken_insts.assign(cores.size(), std::vector<ROB_entry *>());
+	if(((ptrace_nelt > 0) || verbose) && ((core_pool.threads > 1) || (core_pool.quantum > 1)))
+	{
+		warn("-sim:threads and -sim:quantum ignored with -ptrace or -v, running the cores one cycle at a time");
+		core_pool.threads = core_pool.quantum = 1;
+	}
+	if(core_pool.quantum > 1)
+	{
+		//the shared accesses are queued per core, main memory reads are estimated by one read of the idle memory until
+		//the replays measured some (the memory is reset afterwards, as it just was after fast forwarding)
+		shared_requests.assign(cores.size(), std::vector<shared_request_t>());
+		shared_mem_seed = main_mem_latency(0, cache_dl3 ? cache_dl3->bsize : 64, sim_cycle, 0);
+		if(dram_ctrl)
+			dram_ctrl->reset();
+		else if(cores[contexts[0].core_id].main_mem)
+			cores[contexts[0].core_id].main_mem->reset();
+	}
+	if((core_pool.threads > 1) && (cores.size() > 1))
+	{
+		contexts.reserve(contexts.size() + PARALLEL_FORK_LIMIT);
+		core_pool.start(std::min(static_cast<size_t>(core_pool.threads), cores.size()));
+	}
+
+	//main simulator loop, each core runs a quantum (one cycle by default) at a time
 	for(;;)
 	{
 		for(int i=0;i<num_contexts;i++)
@@ -4696,11 +5314,6 @@ void sim_main()
 			if(((contexts[i].LSQ_head + contexts[i].LSQ_num) % contexts[i].LSQ.size()) != contexts[i].LSQ_tail)
 				panic("LSQ_head/LSQ_tail wedged");
 		}
-		//added for Wattch to clear hardware access counters
-		for(unsigned int i=0;i<cores.size();i++)
-		{
-			cores[i].power.clear_access_stats();
-		}
 
 		//check if pipetracing is still active - DO NOT replicate this, only once!
 		ptrace_check_active(contexts[current_context].regs.regs_PC, sim_num_insn, sim_cycle);
@@ -4708,146 +5321,375 @@ void sim_main()
 		//indicate new cycle in pipetrace
 		ptrace_newcycle(sim_cycle);
 
-		size_t empty_cores = 0;
-		//Note, cores go one at a time, this should probably be changed
-		for(size_t i=0;i<cores.size();i++)
+		//the quantum does not run past max_cycles
+		quantum_start = sim_cycle;
+		quantum_cycles = core_pool.quantum;
+		if((max_cycles > 0) && (static_cast<long long>(sim_cycle + quantum_cycles) > max_cycles))
 		{
-			if(cores[i].context_ids.empty())
-			{	//The core has no contexts, nothing to do
-				empty_cores++;
-				continue;
-			}
+			quantum_cycles = max_cycles - sim_cycle;
+		}
 
-			//commit entries from ROB/LSQ to architected register file
-			//commit COMMIT_WIDTH intsructions from each context each cycle
-			commit(i);
+		//cores with no contexts are counted as empty by core_cycle
+		core_pool.run(cores.size(), run_core_quantum, this);
+		if(core_pool.quantum > 1)
+		{
+			replay_shared();
+		}
+		size_t empty_cores = std::count(core_empty.begin(), core_empty.end(), 1);
 
-			//Reduce busy time of in-use functional units by 1 cycle
-			cores[i].update_fu();
+		//go to the next quantum (the main thread may have run a core on its own clock)
+		sim_cycle = quantum_start + quantum_cycles;
 
-			//==> may have ready queue entries carried over from previous cycles
-			//service result completions, also readies dependent operations
-			//==> inserts operations into ready queue --> register deps resolved
-			writeback(i);
+		//finished early? execute until the first thread reaches max_insts
+		for(int i=0;i<num_contexts;i++)
+		{
+			if(contexts[i].sim_num_insn >= max_insts)
+			{
+				return;
+			}
+		}
 
-			//try to locate memory operations that are ready to execute
-			//==> inserts operations into ready queue --> mem deps resolved
-			//refresh each core, which refreshes each thread
-			lsq_refresh(i);
+		//If we reached the desired number of cycles
+		if(sim_cycle==max_cycles)
+		{
+			return;
+		}
 
-			//issue operations ready to execute from a previous cycle
-			//<== drains ready queue <-- ready operations commence execution
-			//scheduling occurs in two phases: instruction wakeup and instruction selection
-			//wakeup instructions once their source opearnds are ready (speculative on loads)
-			wakeup(i);
+		if(empty_cores == cores.size())
+		{
+			return;
+		}
+	}
+}
 
-			//select among the ready instructions for functional units and issue them to begin RF access
-			selection(i);
+//Options a -sim:fanout line may change. These are read by the pipeline as it runs (or size core structures
+//that are empty at the fork), everything else is built or warmed before the fork and must match the parent.
+//Per-core options may be given with their core suffix, e.g. -rf:size_1.
+static const char * fanout_options[] =
+{
+	"-max:inst", "-max:cycles", "-sim:threads", "-sim:quantum",
+	"-fetch:speed", "-fetch:policy", "-issue:width", "-issue:inorder", "-issue:wrongpath", "-commit:width",
+	"-iq:issue_exec_delay", "-rename_dispatch_delay", "-recovery:model", "-iq:size", "-rf:size",
+	"-write_buf:size", "-bpred:penalty",
+	"-cap:policy", "-cap:regs", "-cap:int", "-cap:fp", "-cap:percent", "-cap:adapt",
+	NULL
+};
 
-			//actually begin the execution of instructions on the functional units
-			execute(i);
+//returns true if option (with or without a core suffix) is in fanout_options
+static bool fanout_allowed(std::string option)
+{
+	size_t suffix = option.rfind('_');
+	if((suffix != std::string::npos) && (suffix + 1 < option.size())
+		&& (option.find_first_not_of("0123456789", suffix + 1) == std::string::npos))
+	{
+		option.erase(suffix);
+	}
+	for(size_t i=0;fanout_options[i];i++)
+	{
+		if(option == fanout_options[i])
+		{
+			return true;
+		}
+	}
+	return false;
+}
 
-			//dispatch instructions to the IQ
-			dispatch(i);
+//Forks one child per configuration line of -sim:fanout, each child continues as that configuration.
+//A line holds the options that differ from this run, plus an optional -redir:sim for the child's output
+//(default: <fanout file>.<line number>), e.g.
+//
+//    -rf:size 160 -cap:policy static -cap:regs 40
+//
+//Blank lines and lines starting with # are skipped. The parent continues as the configuration it was started with.
+void simulator_t::fanout()
+{
+	if(ptrace_nelt > 0)
+	{
+		fatal("-sim:fanout can't be used with -ptrace, the configurations would share the pipetrace");
+	}
 
-			//decode and rename new operations
-			//==> insert ops w/ no deps or all regs ready --> reg deps resolved
-			register_rename(i);
+	std::ifstream infile(fanout_name);
+	if(!infile.is_open())
+	{
+		fatal("could not open fan-out file `%s'", fanout_name);
+	}
 
-			fetch(cores[i].fetcher(i));
+	//read and check every line before forking, so a bad line stops the run instead of one child
+	std::vector<std::vector<std::string> > configs;
+	std::vector<std::string> outputs;
+	std::string line;
+	for(int line_num = 1;getline(infile, line);line_num++)
+	{
+		std::istringstream words(line);
+		std::vector<std::string> args;
+		std::string word;
+		while(words >> word)
+		{
+			args.push_back(word);
+		}
+		if(args.empty() || (args[0][0] == '#'))
+		{
+			continue;
 		}
 
-		//decrement the fetch-issue delay counters (used for min. branch mispred. penalty)
-		for(int i=0;i<num_contexts;i++)
+		std::stringstream output;
+		output << fanout_name << "." << line_num;
+		for(size_t i=0;i<args.size();i++)
 		{
-			if(contexts[i].fetch_issue_delay)
+			if((args[i][0] != '-') || isdigit(args[i][1]))
+			{
+				continue;
+			}
+			if(args[i] == "-redir:sim")
 			{
-				contexts[i].fetch_issue_delay--;
+				if(i + 1 == args.size())
+				{
+					fatal("%s:%d: option `-redir:sim' requires an argument", fanout_name, line_num);
+				}
+				output.str(args[i+1]);
+				args.erase(args.begin() + i, args.begin() + i + 2);
+				i--;
+			}
+			else if(!fanout_allowed(args[i]))
+			{
+				fatal("%s:%d: `%s' can't differ between fan-out configurations, it is fixed before the fork", fanout_name, line_num, args[i].c_str());
 			}
 		}
+		configs.push_back(args);
+		outputs.push_back(output.str());
+	}
 
-		//Added for Wattch to update per-cycle power statistics
-		for(unsigned int i=0;i<cores.size();i++)
+	//the children inherit unflushed output
+	std::cerr.flush();
+	fflush(stderr);
+	fflush(stdout);
+
+	for(size_t c=0;c<configs.size();c++)
+	{
+		pid_t pid = fork();
+		if(pid < 0)
 		{
-			cores[i].power.update_power_stats();
+			fatal("could not fork fan-out configuration %d", static_cast<int>(c + 1));
 		}
-
-		//go to next cycle haque edit
-		sim_cycle++;
-		
-		if (sim_cycle == 1) {
-		    int arch_regs = _arch_regs_for_snapshot;
-		    fprintf(stderr, "=== Cycle 0 ===\n", (unsigned long long)sim_cycle);
-		    for (int t = 0; t < num_contexts; ++t) 
-		    fprintf(stderr, "Thread %d used %d registers\n", t, reg_counter[t]);
-			fprintf(stderr, "==========================\n");
+		if(pid == 0)
+		{
+			fanout_pids.clear();
+			fanout_outputs.clear();
+			fanout_child(configs[c], outputs[c]);
+			return;
 		}
+		fanout_pids.push_back(pid);
+		fanout_outputs.push_back(outputs[c]);
+		std::cerr << "sim: fan-out configuration " << c + 1 << " (pid " << pid << ") writes to " << outputs[c] << std::endl;
+	}
+}
 
-		if (sim_cycle <= 100) {
-		    int arch_regs = _arch_regs_for_snapshot;
-		    fprintf(stderr, "=== Cycle %llu ===\n", (unsigned long long)sim_cycle);
-		    for (int t = 0; t < num_contexts; ++t) 
-		    fprintf(stderr, "Thread %d used %d registers\n", t, reg_counter[t]);
-			fprintf(stderr, "==========================\n");
-		}
-		
+//Runs in the child forked for a -sim:fanout line: applies the options of the line and registers the stats again
+void simulator_t::fanout_child(std::vector<std::string> args, const std::string & output)
+{
+	if(!freopen(output.c_str(), "w", stderr))
+	{
+		fatal("unable to redirect simulator output to file `%s'", output.c_str());
+	}
 
-		//finished early? execute until the first thread reaches max_insts
-		for(int i=0;i<num_contexts;i++)
+	//opt_process_options() skips the program name
+	args.insert(args.begin(), "-sim:fanout");
+	opt_process_options(options, args);
+
+	//the checks check_options() made on what the line may change
+	cap_policy.check_options();
+	core_pool.check_options();
+	for(size_t i=0;i<cores.size();i++)
+	{
+		check_core_options(i);
+
+		//the issue queue is empty until timing starts, the register file holds only the architected registers
+		cores[i].iq.resize(cores[i].iq_size);
+		for(unsigned int j=cores[i].rf_size;j<cores[i].reg_file.size();j++)
 		{
-			if(contexts[i].sim_num_insn >= max_insts)
+			if((cores[i].reg_file.reg_file_access(j, REG_INT).state != REG_FREE) || (cores[i].reg_file.reg_file_access(j, REG_FP).state != REG_FREE))
 			{
-				return;
+				fatal("core %d: -rf:size %d drops architected register %d", static_cast<int>(i), cores[i].rf_size, j);
 			}
 		}
+		cores[i].reg_file.resize(cores[i].rf_size);
 
-		//If we reached the desired number of cycles
-		if(sim_cycle==max_cycles)
-		{
-			return;
-		}
+		//static power estimates of the resized core
+		cores[i].power.issue_width = cores[i].issue_width;
+		cores[i].power.commit_width = cores[i].commit_width;
+		cores[i].power.rf_size = cores[i].rf_size;
+		cores[i].power.iq_size = cores[i].iq_size;
+	}
 
-		if(empty_cores == cores.size())
+	//the cap policy and quantum stats depend on the options
+	delete sim_sdb;
+	sim_sdb = new stat_sdb_t;
+	reg_stats(sim_sdb);
+
+	std::cerr << "sim: fan-out configuration of " << fanout_name << ":";
+	for(size_t i=1;i<args.size();i++)
+	{
+		std::cerr << " " << args[i];
+	}
+	std::cerr << "\n\nsim: options follow:" << std::endl;
+	opt_print_options(options, stderr, /* short */TRUE, /* notes */TRUE);
+	std::cerr << std::endl;
+
+	for(size_t i=0;i<cores.size();i++)
+	{
+		cores[i].power.calculate_power(print_power_stats ? stderr : NULL);
+	}
+}
+
+//waits for the configurations forked by fanout()
+void simulator_t::fanout_wait()
+{
+	for(size_t c=0;c<fanout_pids.size();c++)
+	{
+		int status = 0;
+		if(waitpid(fanout_pids[c], &status, 0) < 0)
 		{
-			return;
+			warn("could not wait for fan-out configuration %d", static_cast<int>(c + 1));
+			continue;
 		}
+		int exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+		std::cerr << "sim: fan-out configuration " << c + 1 << " (" << fanout_outputs[c] << ") exited with status " << exit_code << std::endl;
 	}
+	fanout_pids.clear();
+}
+
+//The simulator interface (see sim.h) runs the calling thread's simulation (current_sim)
+void sim_reg_options(opt_odb_t *odb)
+{
+	current_sim->reg_options(odb);
+}
+
+void sim_check_options()
+{
+	current_sim->check_options();
+}
+
+void sim_reg_stats(stat_sdb_t *sdb)
+{
+	current_sim->reg_stats(sdb);
+}
+
+void sim_aux_stats(FILE *stream)
+{
+	current_sim->aux_stats(stream);
+}
+
+void sim_uninit()
+{
+	current_sim->uninit();
+}
+
+void sim_load_prog(std::string fname, std::vector<std::string> argv, std::vector<std::string> envp)
+{
+	current_sim->load_prog(fname, argv, envp);
+}
+
+void sim_main()
+{
+	current_sim->run();
+}
+
+loader_t & sim_loader()
+{
+	return current_sim->loader;
+}
+
+pid_handler_t & sim_pid_handler()
+{
+	return current_sim->pid_handler;
+}
+
+syscall_state_t & sim_syscall_state()
+{
+	return current_sim->syscall_state;
+}
+
+rand_state_t * sim_rand_state()
+{
+	return &current_sim->rand_state;
+}
+
+md_addr_t & sim_mmap_base()
+{
+	return current_sim->mmap_base;
+}
+
+int & sim_num_contexts()
+{
+	return current_sim->num_contexts;
+}
+
+int & sim_contexts_at_init_time()
+{
+	return current_sim->contexts_at_init_time;
+}
+
+unsigned int & sim_cores_at_init_time()
+{
+	return current_sim->cores_at_init_time;
+}
+
+std::vector<context> & sim_contexts()
+{
+	return current_sim->contexts;
+}
+
+std::vector<context> & sim_ejected_contexts()
+{
+	return current_sim->ejected_contexts;
+}
+
+std::vector<core_t> & sim_cores()
+{
+	return current_sim->cores;
 }
 
 // Prints statistics at the end of simulation.
 // This is the easiest place to add your own output.
-void smt_print_stats()
+void smt_print_stats(FILE *stream)
 {
+	std::vector<context> & contexts = current_sim->contexts;
+	std::vector<core_t> & cores = current_sim->cores;
+	int & num_contexts = current_sim->num_contexts;
+	std::ostringstream out;
 	for(int i=0;i<num_contexts;i++)
 	{
-		std::cerr << "Fast Forwarded: " << i << " (" << contexts[i].filename << "): " << contexts[i].fastfwd_cnt-contexts[i].fastfwd_left << std::endl;
+		out << "Fast Forwarded: " << i << " (" << contexts[i].filename << "): " << contexts[i].fastfwd_cnt-contexts[i].fastfwd_left << std::endl;
 	}
 
 	//print my STATS
-	std::cerr << "\n******* SMT STATS *******" << std::endl;
-	std::cerr << "THROUGHPUT IPC: " << sim_num_insn/static_cast<double>(sim_cycle) << "\n\n";
+	out << "\n******* SMT STATS *******" << std::endl;
+	out << "THROUGHPUT IPC: " << current_sim->sim_num_insn/static_cast<double>(sim_cycle) << "\n\n";
 
 	for(int i=0;i<num_contexts;i++)
 	{
-		std::cerr << "IPC " << i << " (" << contexts[i].filename << "): " << contexts[i].sim_num_insn/static_cast<double>(sim_cycle) << std::endl;
+		out << "IPC " << i << " (" << contexts[i].filename << "): " << contexts[i].sim_num_insn/static_cast<double>(sim_cycle) << std::endl;
 	}
 
 	//FIXME: IPCs are horribly off for threads that were forked. This is because they run for a portion of the time but use sim_cycle as a divisor.
 	//FIXME: Should we account for wait cycles in this?
 
-	std::cerr << "\n******* CMP STATS *******" << std::endl;
+	out << "\n******* CMP STATS *******" << std::endl;
+	fputs(out.str().c_str(), stream);
  	for(unsigned int i=0;i<cores.size();i++)
 	{
-		fprintf(stderr,"\nCore %d IPC: %1.4f\n\n",i,cores[i].sim_num_insn_core / (double)sim_cycle);
+		fprintf(stream,"\nCore %d IPC: %1.4f\n\n",i,cores[i].sim_num_insn_core / (double)sim_cycle);
 		for(unsigned int j=0;j<cores[i].context_ids.size();j++)
 		{
-			fprintf(stderr,"\tIPC %d (%s):\t%1.4f\n",j,contexts[cores[i].context_ids[j]].filename.c_str(),contexts[cores[i].context_ids[j]].sim_num_insn/static_cast<double>(sim_cycle));
+			fprintf(stream,"\tIPC %d (%s):\t%1.4f\n",j,contexts[cores[i].context_ids[j]].filename.c_str(),contexts[cores[i].context_ids[j]].sim_num_insn/static_cast<double>(sim_cycle));
 		}
 	}
 
 	for(size_t i=0;i<contexts.size();i++)
 	{
-		contexts[i].file_table.prettyprint(std::cerr);
-		std::cerr << std::endl;
+		std::ostringstream table;
+		contexts[i].file_table.prettyprint(table);
+		table << std::endl;
+		fputs(table.str().c_str(), stream);
 	}
 }
@@ -38,46 +38,27 @@
 #include"regrename.h"
 #include"fetchtorename.h"
 #include"inflightq.h"
+#include"checkpoint.h"
 #include"dram.h"
+#include"dram_ctrl.h"
 #include"eio.h"
+#include"cap_policy.h"
+#include"core_pool.h"
 
 //added for Wattch
 #include "power.h"
 
 #define COMMIT_TIMEOUT 100000
+
+//simulator_t::waiting_watched value that makes wakeup() register the whole waiting_queue again
+#define WAITING_RESYNC (~0U)
 #ifndef MAX_CONTEXTS
 #define MAX_CONTEXTS 4
 #endif
 
-extern int reg_counter[MAX_CONTEXTS];
-//haque edit: prototype for external use - decrement the per-context register allocation counter if positive
-void reg_counter_decref_if_positive(int tid);
-
-/**************** SMT Options *******************/
-//the number of contexts present in the simulator
-extern int num_contexts;
-//Number of contexts detected from the command line
-extern int contexts_at_init_time;
-
-//the actual contexts - (see smt.h for details)
-extern std::vector<context> contexts;
-
-//ejected contexts - retained such that we can see statistics later
-extern std::vector<context> ejected_contexts;
-/***********************************************/
-
-/**************** CMP Options ******************/
-//the number of cores present in the simulator
-extern unsigned int num_cores;
-//Number of cores detected from the command line
-extern unsigned int cores_at_init_time;
-//Max number of contexts allowed on a core (needed to reserve architectural registers
-extern int max_contexts_per_core;
+//rename registers a context holds on its core (per register class), see reg_file_t::in_flight
+cap_usage_t cap_usage(int context_id);
 
-//The actual cores - (see cmp.h for details)
-//✅ Must be extern, not a definition here
-extern std::vector<core_t> cores;
-/********************************************/
 
 //Fetchers, ICOUNT, Round Robin and DCRA
 std::vector<int> icount_fetch(unsigned int core_num);
@@ -91,6 +72,9 @@ int all_operands_ready(ROB_entry *rs);
 int all_operands_spec_ready(ROB_entry *rs);
 int one_operand_ready(ROB_entry *rs);
 
+/* number of bytes a load or store in the LSQ accesses */
+unsigned int lsq_access_size(ROB_entry *rs);
+
 /*
  * input dependencies for stores in the LSQ:
  *   idep #0 - operand input (value that is store'd)
@@ -125,13 +109,266 @@ const char * simoo_mstate_obj(FILE *stream,     //output stream
     regs_t *regs,              //registers to access
     mem_t *mem);              //memory space to access
 
+//text-based stat profiles (-pcstat)
+#define MAX_PCSTAT_VARS 8
+
 enum ff_mode_t
 {
     NORMAL = 0,
     NO_WARMUP = 1
 };
 
-//Fast forward handler
-int ff_context(unsigned int current_context, long long insts_count, ff_mode_t mode);
+//One timing simulation: its limits, the levels shared among the cores and the pipeline stages.
+//sim_reg_options() ... sim_main() (see sim.h) forward to the instance the calling thread runs (current_sim).
+//Cache miss handlers and other callbacks reach the running instance through current_sim.
+//syscall.c reaches the loader, the pid handler and the emulated OS state through sim_loader(), sim_pid_handler()
+//and sim_syscall_state() (see sim.h).
+//The core model (cmp.c), syscall.c and the other modules reach its contexts and cores through sim_contexts(),
+//sim_cores(), ... (see sim.h), so instances on different host threads do not share any of them.
+class simulator_t
+{
+	public:
+		simulator_t();
+
+		//sim_reg_options(), sim_check_options(), sim_reg_stats(), sim_aux_stats(), sim_uninit() and sim_main()
+		void reg_options(opt_odb_t *odb);
+		void check_options();
+		void reg_stats(stat_sdb_t *sdb);
+		void aux_stats(FILE *stream);
+		void uninit();
+		void run();
+
+		//sim_load_prog(): loads a program into the next context, the contexts are placed on the cores round robin
+		void load_prog(std::string fname, std::vector<std::string> argv, std::vector<std::string> envp);
+
+		//pipeline stages of core core_num, in the reverse order they run in each cycle
+		void fetch(std::vector<int> contexts_left);
+		void register_rename(unsigned int core_num);
+		void dispatch(unsigned int core_num);
+		void execute(unsigned int core_num);
+		void selection(unsigned int core_num);
+		void wakeup(unsigned int core_num);
+		void lsq_refresh(unsigned int core_num);
+		void writeback(unsigned int core_num);
+		void commit(unsigned int core_num);
+
+		//Fast forward handler
+		int ff_context(unsigned int current_context, long long insts_count, ff_mode_t mode);
+		bool continue_fastfwd(std::vector<unsigned int> & contexts_left);
+
+		//maximum number of insts to execute (this could be done per core/context but isn't)
+		long long max_insts;
+
+		//Maximum number of cycles to run, this can be done in tandem with max_insts
+		long long max_cycles;
+
+		//number of insts skipped before timing starts
+		long long fastfwd_count;
+
+		//instructions fast-forwarded (by ff_context) and the host time spent fast-forwarding, in seconds
+		counter_t sim_ff_insn;
+		double sim_ff_time;
+
+		//total non-speculative bogus addresses seen (debug var)
+		counter_t sim_invalid_addrs;
+
+		//instruction sequence counter, used to assign unique id's to insts
+		unsigned long long inst_seq;
+
+		//Number of executed instructions
+		counter_t sim_num_insn;
+
+		//program loader (it restores sim_num_insn from EIO checkpoints) and process ids of the contexts
+		loader_t loader;
+		pid_handler_t pid_handler;
+
+		//emulated OS state, random number generator and next free mapping address of the simulated programs
+		//(see sim_syscall_state(), myrand_hook() and mem_mmap_base_hook())
+		syscall_state_t syscall_state;
+		rand_state_t rand_state;
+		md_addr_t mmap_base;
+
+		//this simulation is a job of a -batch run (see main.c), other simulations run in the process beside it
+		bool batch_job;
+
+		/**************** SMT Options *******************/
+		//the number of contexts present in the simulator
+		int num_contexts;
+		//Number of contexts detected from the command line
+		int contexts_at_init_time;
+
+		//the actual contexts - (see smt.h for details)
+		std::vector<context> contexts;
+
+		//ejected contexts - retained such that we can see statistics later
+		std::vector<context> ejected_contexts;
+		/***********************************************/
+
+		/**************** CMP Options ******************/
+		//the number of cores present in the simulator
+		unsigned int num_cores;
+		//Number of cores detected from the command line
+		unsigned int cores_at_init_time;
+		//Max number of contexts allowed on a core (needed to reserve architectural registers
+		int max_contexts_per_core;
+
+		//The actual cores - (see cmp.h for details)
+		std::vector<core_t> cores;
+		/********************************************/
+
+		//L3 cache (data and inst), this is shared among all cores
+		cache_t *cache_il3, *cache_dl3;
+
+		//L3 cache config, i.e., {<config>|none} */
+		char *cache_dl3_opt;
+		//L3 cache config, i.e., {<config>|dl1|dl2|dl3|none} */
+		char *cache_il3_opt;
+
+		//L3 cache hit latency in cycles
+		int cache_dl3_lat, cache_il3_lat;
+
+		//MSHRs of each cache level (every core's l1 and l2 caches take the same number), 0 for unlimited
+		int cache_dl1_mshrs, cache_dl2_mshrs, cache_il1_mshrs, cache_il2_mshrs, cache_dl3_mshrs, cache_il3_mshrs;
+
+		//prefetcher of every core's l1 and l2 data caches, i.e., {<config>|none}, see prefetch_parser
+		char *cache_dl1pf_opt, *cache_dl2pf_opt;
+
+		//thread-aware replacement of every core's l2 data cache and of the shared l3 data cache,
+		//i.e., {none|static:<ways>[,<ways>...]|ucp:<interval>}, see cache_t::set_partition
+		char *cache_dl2part_opt, *cache_dl3part_opt;
+
+		//per-thread occupancy caps of those caches, in percent of their blocks (the last value repeats)
+		int cache_dl2occ[MAX_CONTEXTS], cache_dl2occ_nelt;
+		int cache_dl3occ[MAX_CONTEXTS], cache_dl3occ_nelt;
+
+		//Main Memory pointer and configuration string
+		dram_t * main_mem;
+		char * main_mem_config;
+
+		//Banked DRAM controller, used instead of main_mem when main_mem_config is a banked configuration
+		dram_ctrl_t * dram_ctrl;
+
+		//Filename to use when creating an eio file
+		char * eio_name;
+
+		//Checkpoint of every context to write after fast-forwarding (with the warm state if chkpt_warm)
+		//and to restore before fast-forwarding, see checkpoint.h
+		char * chkpt_write_name;
+		int chkpt_warm;
+		int chkpt_text;
+		char * chkpt_read_name;
+
+		//File of timing configurations to fork after fast-forwarding (see simulator_t::fanout)
+		char * fanout_name;
+
+		//pipeline trace range and output filename
+		int ptrace_nelt;
+		char *ptrace_opts[2];
+
+		//text-based stat profiles
+		int pcstat_nelt;
+		char *pcstat_vars[MAX_PCSTAT_VARS];
+		stat_stat_t *pcstat_stats[MAX_PCSTAT_VARS];
+		counter_t pcstat_lastvals[MAX_PCSTAT_VARS];
+		stat_stat_t *pcstat_sdists[MAX_PCSTAT_VARS];
+
+		//Print static power model results?
+		int print_power_stats;
+
+		//core the last program loaded from the command line was placed on, they are placed round robin
+		int load_core;
+
+		//per-thread limit for in-flight (renamed) physical registers, selected with -cap:policy
+		cap_policy_t cap_policy;
+
+		//runs the cores of each cycle, see core_pool.h
+		core_pool_t core_pool;
+
+		//an access to the levels shared among the cores at time now: the L3 cache level, or main memory if level is NULL,
+		//returns the latency of a read. With a quantum of 1 the access is made in core order (see core_pool_t::ordered_enter).
+		//With a longer quantum the shared levels do not change during the quantum: the access is queued, its latency is
+		//estimated from the level's contents at the start of the quantum and the main memory latency the replays measured,
+		//and replay_shared() makes the queued accesses in time order at the end of the quantum.
+		unsigned long long shared_access(cache_t *level, mem_cmd cmd, md_addr_t baddr, unsigned int bsize, tick_t now, int context_id);
+
+	private:
+		//one cycle of core core_num, and the current quantum of it
+		void core_cycle(unsigned int core_num);
+		void core_quantum(unsigned int core_num);
+		static void run_core_quantum(void * sim, unsigned int core_num);
+
+		int lsq_try_load(int context_id, unsigned int index);
+
+		//puts rs on the waiting_queue of core core_num and registers it with the register file for wakeup()
+		void wait_q_enqueue_watched(unsigned int core_num, ROB_entry *rs);
+
+		//registers every waiting_queue entry of core core_num with the register file (wakeup() only checks the
+		//instructions the register file schedules), returns how many were not registered yet
+		unsigned int watch_waiting(unsigned int core_num);
+
+		//makes the shared accesses queued during the quantum, in time order (core order among equal times)
+		void replay_shared();
+
+		//a shared access queued during a quantum
+		class shared_request_t
+		{
+			public:
+				tick_t now;
+				cache_t *level;
+				mem_cmd cmd;
+				md_addr_t baddr;
+				unsigned int bsize;
+				int context_id;
+				bool estimated_hit;			//level held the block at the start of the quantum
+				unsigned long long estimate;		//latency the core was given
+
+				inline bool operator<(const shared_request_t & rhs) const
+				{
+					return now < rhs.now;
+				}
+		};
+		std::vector<std::vector<shared_request_t> > shared_requests;	//queued accesses of each core
+
+		//main memory read latency estimate: the mean of what the replays measured, shared_mem_seed until a read was replayed
+		counter_t shared_mem_cycles, shared_mem_reads;
+		unsigned long long shared_mem_seed;
+
+		//replay statistics, these measure the latency estimates against the replay, not the run against a -sim:quantum 1 run
+		counter_t shared_replayed;			//accesses replayed
+		counter_t shared_estimate_mismatch;		//L3 reads estimated as hits that missed in the replay, or the other way round
+		counter_t shared_estimate_error;		//sum of how far the estimated read latencies were off
+
+		void check_core_options(unsigned int i);
+
+		//timing simulation, and the configurations forked before it (-sim:fanout)
+		void timing();
+		void fanout();
+		void fanout_child(std::vector<std::string> args, const std::string & output);
+		void fanout_wait();
+
+		//the option database, the fan-out children process their options into it
+		opt_odb_t *options;
+
+		//fan-out children of this configuration and the files they write to
+		std::vector<pid_t> fanout_pids;
+		std::vector<std::string> fanout_outputs;
+
+		//cores that had no contexts in their last cycle (written by core_cycle)
+		std::vector<char> core_empty;
+
+		//wakeup() state of each core: the number of waiting_queue entries registered with the register file
+		//(WAITING_RESYNC once a rollback dropped some) and the buffer due wakeups are collected in (by lsq_refresh() too)
+		std::vector<unsigned int> waiting_watched;
+		std::vector<std::vector<ROB_entry *> > woken_insts;
+
+		//the quantum the cores are running: [quantum_start, quantum_start + quantum_cycles)
+		tick_t quantum_start, quantum_cycles;
+};
+
+//the simulation the CLI runs
+extern simulator_t simulator;
+
+//the simulation the calling thread runs
+extern __thread simulator_t * current_sim;
 
 #endif
@@ -62,17 +62,12 @@
 #include "smt.h"
 #include "cmp.h"
 #include "pid.h"
+#include "syscall.h"
 
-extern int num_contexts;
-extern int contexts_at_init_time;
-extern unsigned int cores_at_init_time;
-extern std::vector<context> contexts;
-extern std::vector<context> ejected_contexts;
-extern std::vector<core_t> cores;
+//cycle counter, thread-local: each host thread running a core sees that core's clock (see core_pool.h)
+extern __thread tick_t sim_cycle;
 //set to non-zero when simulator should dump statistics
 extern int sim_dump_stats;
-extern loader_t loader;
-extern pid_handler_t pid_handler;
 
 //exit when this becomes non-zero
 extern int sim_exit_now;
@@ -81,16 +76,16 @@ extern int sim_exit_now;
 extern int sim_swap_bytes;
 extern int sim_swap_words;
 
-//execution start/end times
+//execution start/end times, options and stats databases, per thread (see main.c)
 //extern time_t sim_start_time;
 //extern time_t sim_end_time;
-extern int sim_elapsed_time;
+extern __thread int sim_elapsed_time;
 
 //options database
-extern opt_odb_t *sim_odb;
+extern __thread opt_odb_t *sim_odb;
 
 //stats database
-extern stat_sdb_t *sim_sdb;
+extern __thread stat_sdb_t *sim_sdb;
 
 //main simulator interfaces, called in the following order
 
@@ -130,6 +125,24 @@ void sim_uninit();
 //print all simulator stats
 void sim_print_stats(FILE *fd);
 
-void smt_print_stats();
+void smt_print_stats(FILE *stream);
+
+//the program loader, the process ids and the emulated OS state of the simulation the calling thread runs
+loader_t & sim_loader();
+pid_handler_t & sim_pid_handler();
+syscall_state_t & sim_syscall_state();
+
+//the random number generator and the next free mapping address of that simulation (see myrand_hook() and
+//mem_mmap_base_hook())
+rand_state_t * sim_rand_state();
+md_addr_t & sim_mmap_base();
+
+//the contexts and cores of the simulation the calling thread runs (members of simulator_t, see sim-outorder.h)
+int & sim_num_contexts();
+int & sim_contexts_at_init_time();
+unsigned int & sim_cores_at_init_time();
+std::vector<context> & sim_contexts();
+std::vector<context> & sim_ejected_contexts();
+std::vector<core_t> & sim_cores();
 
 #endif /* SIM_H */
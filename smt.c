@@ -20,12 +20,12 @@ fetch_num(0), fetch_tail(0), fetch_head(0),
 fetch_issue_delay(0), ptrace_seq(0), icount(0), sim_num_insn(0), rename_table(MD_TOTAL_REGS),
 ROB_head(0),
 ROB_tail(0), ROB_num(0), LSQ_head(0), LSQ_tail(0),
-LSQ_num(0),
+LSQ_num(0), lsq_scanned(0), lsq_scan_head(0), lsq_scan_seq(0), lsq_rescan(true),
 last_op((ROB_entry *)NULL),
 spec_mode(FALSE),
 pid(0), gpid(0), gid(0),
 last_commit_cycle(0),
-DCRA_int_iq(0), DCRA_int_rf(0), DCRA_fp_rf(0), DCRA_activity_fp(256), DCRA_L1_misses(0),
+DCRA_activity_fp(256), DCRA_L1_misses(0),
 dlite_evaluator(NULL), 
 sleep(0), interrupts(0), entry_point(0), waiting_for(0), nfds(0), next_check(0)
 {
@@ -69,6 +69,17 @@ context::context(const context & source)
 	LSQ_head = source.LSQ_head;
 	LSQ_tail = source.LSQ_tail;
 	LSQ_num = source.LSQ_num;
+	store_table = source.store_table;
+#ifdef ROB_SPLIT
+	lsq_seq = source.lsq_seq;
+	lsq_kind = source.lsq_kind;
+	ROB_cold = source.ROB_cold;
+	LSQ_cold = source.LSQ_cold;
+#endif
+	lsq_scanned = 0;
+	lsq_scan_head = source.LSQ_head;
+	lsq_scan_seq = 0;
+	lsq_rescan = true;
 
 	fetch_issue_delay = source.fetch_issue_delay;
 	fastfwd_cnt = source.fastfwd_cnt;
@@ -91,9 +102,6 @@ context::context(const context & source)
 
 	last_commit_cycle = source.last_commit_cycle;
 
-	DCRA_int_iq = source.DCRA_int_iq;
-	DCRA_int_rf = source.DCRA_int_rf;
-	DCRA_fp_rf = source.DCRA_fp_rf;
 	DCRA_activity_fp = source.DCRA_activity_fp;
 	DCRA_L1_misses = source.DCRA_L1_misses;
 
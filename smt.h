@@ -20,12 +20,18 @@
 #include "bpreds.h"
 #include "fetchtorename.h"
 #include "regrename.h"
+#include "store_table.h"
 #include "file_table.h"
 #include "dlite.h"
 
 #include<vector>
 #include<fstream>
 
+//bits of context::lsq_kind (-DROB_SPLIT)
+#define LSQ_KIND_LOAD		0x01
+#define LSQ_KIND_STORE		0x02
+#define LSQ_KIND_DISPATCHED	0x04
+
 class context
 {
 public:
@@ -98,6 +104,116 @@ public:
 	std::vector<ROB_entry> LSQ;		//load/store queue
 	unsigned int LSQ_head, LSQ_tail;	//LSQ head and tail pointers
 	unsigned int LSQ_num;			//num entries currently in LSQ
+	store_table_t store_table;		//address index of the stores in the LSQ (forwarding and STD unknown checks)
+
+	//incremental lsq_refresh() state: the entries from LSQ_head already visited end at the oldest unresolved
+	//store or undispatched entry, only the entries past them are walked, the loads left waiting among them are
+	//checked when the register file wakes them (see reg_file_t::watch_load)
+	unsigned int lsq_scanned;		//entries from LSQ_head already visited
+	unsigned int lsq_scan_head;		//LSQ_head when lsq_scanned was last updated
+	INST_SEQ_TYPE lsq_scan_seq;		//seq of the last visited entry (detects squashes)
+	bool lsq_rescan;			//visit the whole LSQ again on the next refresh (set on replay)
+
+#ifdef ROB_SPLIT
+	//hot/cold split of the ROB and LSQ (build with -DROB_SPLIT): the slot state read by the lsq_refresh() walk and
+	//the forwarding checks is mirrored into arrays of its own, so the scans stride over a few bytes per slot instead of
+	//whole ROB_entry records, and the rollback and power state of the entries (ROB_state) is kept apart from them;
+	//the LSQ entries stay authoritative for the mirror, lsq_hot_update() copies a slot after rename and dispatch
+	std::vector<INST_SEQ_TYPE> lsq_seq;	//seq of each LSQ slot
+	std::vector<unsigned char> lsq_kind;	//LSQ_KIND_* bits of each LSQ slot
+	std::vector<ROB_state> ROB_cold;	//cold state of each ROB slot
+	std::vector<ROB_state> LSQ_cold;	//cold state of each LSQ slot
+
+	inline void lsq_hot_copy(unsigned int index)
+	{
+		const ROB_entry & rs = LSQ[index];
+		lsq_seq[index] = rs.seq;
+		lsq_kind[index] = (((MD_OP_FLAGS(rs.op) & (F_MEM|F_LOAD)) == (F_MEM|F_LOAD)) ? LSQ_KIND_LOAD : 0)
+			| (((MD_OP_FLAGS(rs.op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE)) ? LSQ_KIND_STORE : 0)
+			| (rs.dispatched ? LSQ_KIND_DISPATCHED : 0);
+	}
+#endif
+
+	//the cold state (rollback and Wattch values) of one of this context's ROB or LSQ entries
+	inline ROB_state & state_of(ROB_entry *rs)
+	{
+#ifdef ROB_SPLIT
+		std::vector<ROB_entry> & entries = rs->in_LSQ ? LSQ : ROB;
+		std::vector<ROB_state> & cold = rs->in_LSQ ? LSQ_cold : ROB_cold;
+		if(cold.size() != entries.size())
+		{
+			cold.assign(entries.size(), ROB_state());
+		}
+		return cold[rs - &entries[0]];
+#else
+		return *rs;
+#endif
+	}
+
+	//copies LSQ slot index into the split arrays after rename and dispatch (nothing to do without -DROB_SPLIT)
+	inline void lsq_hot_update(unsigned int index)
+	{
+#ifdef ROB_SPLIT
+		if(lsq_seq.size() != LSQ.size())
+		{
+			lsq_seq.assign(LSQ.size(), 0);
+			lsq_kind.assign(LSQ.size(), 0);
+			for(unsigned int i=0;i<LSQ.size();i++)
+			{
+				lsq_hot_copy(i);
+			}
+		}
+		else
+		{
+			lsq_hot_copy(index);
+		}
+#endif
+	}
+
+	//the per-slot state as the scans read it: from the split arrays with -DROB_SPLIT, otherwise from the LSQ entries
+#ifdef ROB_SPLIT
+	inline const std::vector<INST_SEQ_TYPE> & lsq_seqs() const
+	{
+		return lsq_seq;
+	}
+	inline INST_SEQ_TYPE lsq_seq_of(unsigned int index) const
+	{
+		return lsq_seq[index];
+	}
+	inline bool lsq_is_load(unsigned int index) const
+	{
+		return lsq_kind[index] & LSQ_KIND_LOAD;
+	}
+	inline bool lsq_is_store(unsigned int index) const
+	{
+		return lsq_kind[index] & LSQ_KIND_STORE;
+	}
+	inline bool lsq_dispatched(unsigned int index) const
+	{
+		return lsq_kind[index] & LSQ_KIND_DISPATCHED;
+	}
+#else
+	inline const std::vector<ROB_entry> & lsq_seqs() const
+	{
+		return LSQ;
+	}
+	inline INST_SEQ_TYPE lsq_seq_of(unsigned int index) const
+	{
+		return LSQ[index].seq;
+	}
+	inline bool lsq_is_load(unsigned int index) const
+	{
+		return (MD_OP_FLAGS(LSQ[index].op) & (F_MEM|F_LOAD)) == (F_MEM|F_LOAD);
+	}
+	inline bool lsq_is_store(unsigned int index) const
+	{
+		return (MD_OP_FLAGS(LSQ[index].op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE);
+	}
+	inline bool lsq_dispatched(unsigned int index) const
+	{
+		return LSQ[index].dispatched;
+	}
+#endif
 
 	RS_link last_op;			//last_op for inorder issue
   
@@ -117,7 +233,8 @@ public:
 	int pendingLoadMisses(int cacheLevel);
 
 	//DCRA Counters
-	unsigned int DCRA_int_iq, DCRA_int_rf, DCRA_fp_rf, DCRA_activity_fp;
+	//IQ and register file occupancy are queried from the core (issue_queue_t::occupancy, reg_file_t::in_flight)
+	unsigned int DCRA_activity_fp;
 	counter_t DCRA_L1_misses;
 
 	dlite_t *dlite_evaluator;		//dlite expression evaluator
@@ -0,0 +1,283 @@
+// Store Table (address index of the stores in a context's LSQ)
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ *
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ *
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ *
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ *
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ *
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ *
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ *
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ *
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ *
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#ifndef STORE_TABLE_C
+#define STORE_TABLE_C
+
+#include"store_table.h"
+#include<cassert>
+
+#define STORE_BLOCK_SHIFT	3
+
+store_table_t::record_t::record_t()
+: used(false), block(0), lsq_index(0), seq(0), addr(0), size(0)
+{}
+
+store_table_t::slot_t::slot_t()
+: blocks(0)
+{
+	block[0] = block[1] = 0;
+}
+
+store_table_t::store_table_t()
+: mask(0)
+{}
+
+void store_table_t::resize(unsigned int lsq_size)
+{
+	unsigned int size = 1;
+	while(size < 8 * lsq_size)
+	{
+		size <<= 1;
+	}
+	table.assign(size, record_t());
+	mask = size - 1;
+	slots.assign(lsq_size, slot_t());
+}
+
+void store_table_t::clear()
+{
+	table.assign(table.size(), record_t());
+	slots.assign(slots.size(), slot_t());
+}
+
+unsigned int store_table_t::home(md_addr_t block) const
+{
+	return (unsigned int)((block * 0x9E3779B97F4A7C15ULL) >> 40) & mask;
+}
+
+void store_table_t::add(md_addr_t block, const record_t & record)
+{
+	unsigned int i = home(block);
+	while(table[i].used)
+	{
+		i = (i + 1) & mask;
+	}
+	table[i] = record;
+	table[i].used = true;
+	table[i].block = block;
+}
+
+//removes the record and shifts later records of the probe sequence back, so no tombstones are needed
+void store_table_t::erase(md_addr_t block, unsigned int lsq_index)
+{
+	unsigned int i = home(block);
+	while(table[i].used && !((table[i].block == block) && (table[i].lsq_index == lsq_index)))
+	{
+		i = (i + 1) & mask;
+	}
+	if(!table[i].used)
+	{
+		return;
+	}
+	unsigned int hole = i;
+	for(unsigned int j = (hole + 1) & mask; table[j].used; j = (j + 1) & mask)
+	{
+		//a record may fill the hole if its home is not cyclically in (hole, j]
+		unsigned int h = home(table[j].block);
+		if(((j - h) & mask) >= ((j - hole) & mask))
+		{
+			table[hole] = table[j];
+			hole = j;
+		}
+	}
+	table[hole] = record_t();
+}
+
+void store_table_t::insert(unsigned int lsq_index, INST_SEQ_TYPE seq, md_addr_t addr, unsigned int size)
+{
+	assert(lsq_index < slots.size());
+	remove(lsq_index);
+
+	record_t record;
+	record.lsq_index = lsq_index;
+	record.seq = seq;
+	record.addr = addr;
+	record.size = size ? size : 1;
+
+	slot_t & slot = slots[lsq_index];
+	md_addr_t first = addr >> STORE_BLOCK_SHIFT, last = (addr + record.size - 1) >> STORE_BLOCK_SHIFT;
+	slot.block[slot.blocks++] = first;
+	add(first, record);
+	if(last != first)
+	{
+		slot.block[slot.blocks++] = last;
+		add(last, record);
+	}
+}
+
+void store_table_t::remove(unsigned int lsq_index)
+{
+	if(lsq_index >= slots.size())
+	{
+		return;
+	}
+	slot_t & slot = slots[lsq_index];
+	for(unsigned int i=0;i<slot.blocks;i++)
+	{
+		erase(slot.block[i], lsq_index);
+	}
+	slot.blocks = 0;
+}
+
+//the seq of an LSQ slot, read from the LSQ entry
+class lsq_entry_seq
+{
+	public:
+		lsq_entry_seq(const std::vector<ROB_entry> & LSQ)
+		: LSQ(LSQ)
+		{}
+		inline INST_SEQ_TYPE operator()(unsigned int lsq_index) const
+		{
+			return LSQ[lsq_index].seq;
+		}
+	private:
+		const std::vector<ROB_entry> & LSQ;
+};
+
+unsigned int store_table_t::older_stores(const std::vector<ROB_entry> & LSQ, unsigned int LSQ_head, unsigned int load_index,
+	md_addr_t addr, unsigned int size, int *stores, bool *covered) const
+{
+	return find_older(lsq_entry_seq(LSQ), LSQ.size(), LSQ_head, load_index, addr, size, stores, covered);
+}
+
+#ifdef ROB_SPLIT
+//the seq of an LSQ slot, read from the split lsq_seq array
+class lsq_split_seq
+{
+	public:
+		lsq_split_seq(const std::vector<INST_SEQ_TYPE> & lsq_seq)
+		: lsq_seq(lsq_seq)
+		{}
+		inline INST_SEQ_TYPE operator()(unsigned int lsq_index) const
+		{
+			return lsq_seq[lsq_index];
+		}
+	private:
+		const std::vector<INST_SEQ_TYPE> & lsq_seq;
+};
+
+unsigned int store_table_t::older_stores(const std::vector<INST_SEQ_TYPE> & lsq_seq, unsigned int LSQ_head, unsigned int load_index,
+	md_addr_t addr, unsigned int size, int *stores, bool *covered) const
+{
+	return find_older(lsq_split_seq(lsq_seq), lsq_seq.size(), LSQ_head, load_index, addr, size, stores, covered);
+}
+#endif
+
+template<class seq_of_t>
+const store_table_t::record_t * store_table_t::youngest_before(const seq_of_t & seq_of, unsigned int lsq_size, unsigned int LSQ_head,
+	unsigned int before_pos, md_addr_t addr, unsigned int size) const
+{
+	const record_t *found = NULL;
+	unsigned int found_pos = 0;
+
+	md_addr_t first = addr >> STORE_BLOCK_SHIFT, last = (addr + size - 1) >> STORE_BLOCK_SHIFT;
+	for(md_addr_t block = first; block <= last; block++)
+	{
+		for(unsigned int i = home(block); table[i].used; i = (i + 1) & mask)
+		{
+			const record_t & r = table[i];
+			if(r.block != block)
+			{
+				continue;
+			}
+			//stale (squashed or reused slot) or not older than the position
+			unsigned int pos = (r.lsq_index + lsq_size - LSQ_head) % lsq_size;
+			if((seq_of(r.lsq_index) != r.seq) || (pos >= before_pos))
+			{
+				continue;
+			}
+			if((r.addr < addr + size) && (addr < r.addr + r.size) && (!found || (pos > found_pos)))
+			{
+				found = &r;
+				found_pos = pos;
+			}
+		}
+	}
+	return found;
+}
+
+template<class seq_of_t>
+unsigned int store_table_t::find_older(const seq_of_t & seq_of, unsigned int lsq_size, unsigned int LSQ_head, unsigned int load_index,
+	md_addr_t addr, unsigned int size, int *stores, bool *covered) const
+{
+	*covered = false;
+	if(table.empty())
+	{
+		return 0;
+	}
+	size = size ? size : 1;
+	assert(size <= STORE_COVER_MAX);
+
+	//bit i of written stands for byte addr + i
+	unsigned int all = (1 << size) - 1, written = 0, count = 0;
+	unsigned int before_pos = (load_index + lsq_size - LSQ_head) % lsq_size;
+	while(written != all)
+	{
+		const record_t *r = youngest_before(seq_of, lsq_size, LSQ_head, before_pos, addr, size);
+		if(!r)
+		{
+			return count;
+		}
+		md_addr_t lo = MAX(r->addr, addr) - addr, hi = MIN(r->addr + r->size, addr + size) - addr;
+		unsigned int bytes = ((1 << hi) - 1) & ~((1 << lo) - 1);
+		if(bytes & ~written)
+		{
+			stores[count++] = r->lsq_index;
+			written |= bytes;
+		}
+		before_pos = (r->lsq_index + lsq_size - LSQ_head) % lsq_size;
+	}
+	*covered = true;
+	return count;
+}
+
+#endif
@@ -0,0 +1,141 @@
+// Store Table Prototypes (address index of the stores in a context's LSQ)
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ *
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ *
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ *
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ *
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ *
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ *
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ *
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ *
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ *
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#ifndef STORE_TABLE_H
+#define STORE_TABLE_H
+
+#include<vector>
+#include"rob.h"
+
+//most stores older_stores() lists, each one writes at least one byte of an access of at most 8 bytes
+#define STORE_COVER_MAX		8
+
+//Indexes the stores in a context's LSQ by address, for store-to-load forwarding and STD unknown checks
+//Stores are recorded under every 8 byte block they touch in an open-addressing (linear probing) hash table,
+//at most two records per LSQ slot, the table is kept at most a quarter full
+//Records are inserted at rename and removed at commit or when their LSQ slot is renamed again;
+//records of squashed stores are left behind, a record is only used while its LSQ slot still holds
+//the same instruction (seq matches) and the slot lies between LSQ_head and the load
+class store_table_t
+{
+	public:
+		store_table_t();
+
+		//sizes the table for an LSQ of lsq_size entries, drops all records
+		void resize(unsigned int lsq_size);
+		void clear();
+
+		//number of LSQ entries the table is sized for
+		inline unsigned int lsq_size() const
+		{
+			return slots.size();
+		}
+
+		//records the store in LSQ slot lsq_index (dropping whatever the slot held before)
+		void insert(unsigned int lsq_index, INST_SEQ_TYPE seq, md_addr_t addr, unsigned int size);
+
+		//drops the records of LSQ slot lsq_index
+		void remove(unsigned int lsq_index);
+
+		//walks the stores older than LSQ slot load_index that overlap [addr, addr + size) (at most 8 bytes) from the
+		//youngest on, until every byte of it is written by one of them. A store is listed only if it writes a byte no
+		//younger one did: places up to STORE_COVER_MAX LSQ indexes in stores (youngest first), returns how many,
+		//and in *covered whether they write every byte of the access
+		unsigned int older_stores(const std::vector<ROB_entry> & LSQ, unsigned int LSQ_head, unsigned int load_index,
+			md_addr_t addr, unsigned int size, int *stores, bool *covered) const;
+#ifdef ROB_SPLIT
+		//the same, checking whether a record's slot still holds its store against the context's lsq_seq array
+		unsigned int older_stores(const std::vector<INST_SEQ_TYPE> & lsq_seq, unsigned int LSQ_head, unsigned int load_index,
+			md_addr_t addr, unsigned int size, int *stores, bool *covered) const;
+#endif
+
+	private:
+		class record_t
+		{
+			public:
+				record_t();
+				bool used;
+				md_addr_t block;		//8 byte block this record is filed under
+				unsigned int lsq_index;
+				INST_SEQ_TYPE seq;
+				md_addr_t addr;
+				unsigned int size;
+		};
+
+		//the blocks a slot's store was filed under
+		class slot_t
+		{
+			public:
+				slot_t();
+				unsigned int blocks;		//0 (no store recorded), 1 or 2
+				md_addr_t block[2];
+		};
+
+		//older_stores() for either LSQ layout, seq_of(i) is the seq held by LSQ slot i
+		template<class seq_of_t>
+		unsigned int find_older(const seq_of_t & seq_of, unsigned int lsq_size, unsigned int LSQ_head, unsigned int load_index,
+			md_addr_t addr, unsigned int size, int *stores, bool *covered) const;
+
+		//returns the record of the youngest store in LSQ positions (from LSQ_head) below before_pos that overlaps
+		//[addr, addr + size), NULL if there is none
+		template<class seq_of_t>
+		const record_t * youngest_before(const seq_of_t & seq_of, unsigned int lsq_size, unsigned int LSQ_head,
+			unsigned int before_pos, md_addr_t addr, unsigned int size) const;
+
+		unsigned int home(md_addr_t block) const;
+		void erase(md_addr_t block, unsigned int lsq_index);
+		void add(md_addr_t block, const record_t & record);
+
+		std::vector<record_t> table;
+		unsigned int mask;			//table.size() - 1
+		std::vector<slot_t> slots;		//one per LSQ entry
+};
+
+#endif
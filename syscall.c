@@ -59,6 +59,7 @@
 
 #include "smt.h"
 #include "eio.h"
+#include "core_pool.h"
 
 #ifdef SYS_DEBUG
 #include<iostream>
@@ -1134,8 +1135,6 @@ class osf_sgttyb
 		}
 };
 
-#define OSF_NSIG		32
-
 #define OSF_SIG_BLOCK		1
 #define OSF_SIG_UNBLOCK		2
 #define OSF_SIG_SETMASK		3
@@ -1414,9 +1413,14 @@ class osf_flag_table_object
 };
 #define OSF_NFLAGS	(sizeof(osf_flag_table)/sizeof(osf_flag_table[0]))
 
-unsigned long sigmask = 0;
-
-qword_t sigaction_array[OSF_NSIG] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+syscall_state_t::syscall_state_t()
+: signal_mask(0), select_ignores(0), usleep_jitter(200), audcntl(0x002)		//audcntl is AUDIT_OFF
+{
+	for(int i=0;i<OSF_NSIG;i++)
+	{
+		sigaction_array[i] = 0;
+	}
+}
 
 //setsockopt option names
 #define OSF_SO_DEBUG		0x0001
@@ -1773,6 +1777,7 @@ void sys_palcall(regs_t *regs,		//registers to access
 	mem_t *mem,			//memory space to access
 	md_inst_t inst)			//palcall inst
 {
+	std::vector<context> & contexts = sim_contexts();
 #define arg(X)	regs->regs_R[MD_REG_##X]
 	qword_t palcode = inst;
 
@@ -1824,6 +1829,11 @@ void sys_syscall(regs_t *regs,		//registers to access
 	mem_t *mem,			//memory space to access
 	md_inst_t inst)			//system call inst
 {
+	std::vector<context> & contexts = sim_contexts();
+	std::vector<context> & ejected_contexts = sim_ejected_contexts();
+	std::vector<core_t> & cores = sim_cores();
+	int & num_contexts = sim_num_contexts();
+	syscall_state_t & os = sim_syscall_state();
 //This macro allows us to use shorthand for accessing the registers.
 //The main registers we access here are A0, A1, A2, A3, A4, A5 (the 6 argument registers) and V0 (return register)
 //In general, V0 is the return register and A3 is used to store errno (when applicable), this is reserved in some syscalls
@@ -1890,7 +1900,7 @@ void sys_syscall(regs_t *regs,		//registers to access
 	case OSF_SYS_exit:
 		fprintf(stderr,"(%lld) Received syscode OSF_SYS_exit with status: %lld, exiting\n",contexts[context_id].pid,arg(A0));
 
-		pid_handler.kill_pid(contexts[context_id].pid, arg(A0));
+		sim_pid_handler().kill_pid(contexts[context_id].pid, arg(A0));
 
 		//This might cause the instruction count to be off by 1.
 		cores[contexts[context_id].core_id].flushcontext(contexts[context_id],contexts[context_id].sim_num_insn);
@@ -1903,7 +1913,7 @@ void sys_syscall(regs_t *regs,		//registers to access
 	case OSF_SYS_exit_group:
 		fprintf(stderr,"(%lld) Received syscode OSF_SYS_exit_group with status: %lld, exiting\n",contexts[context_id].pid,arg(A0));
 
-		pid_handler.kill_pid(contexts[context_id].pid, arg(A0));
+		sim_pid_handler().kill_pid(contexts[context_id].pid, arg(A0));
 
 		//This might cause the instruction count to be off by 1.
 		cores[contexts[context_id].core_id].flushcontext(contexts[context_id],contexts[context_id].sim_num_insn);
@@ -2818,7 +2828,7 @@ void sys_syscall(regs_t *regs,		//registers to access
 						int core_num = contexts[i].core_id;
 						cores[core_num].flushcontext(contexts[i],contexts[i].sim_num_insn);
 						cores[core_num].ejectcontext(contexts[i]);
-						pid_handler.kill_pid(arg(A0),arg(A1));
+						sim_pid_handler().kill_pid(arg(A0),arg(A1));
 						fprintf(stderr,"(%lld) Killed by signal %lld\n",killwho,arg(A1));
 						contexts[i].pid = 0;
 						break;
@@ -2856,7 +2866,7 @@ void sys_syscall(regs_t *regs,		//registers to access
 						int core_num = contexts[i].core_id;
 						cores[core_num].flushcontext(contexts[i],contexts[i].sim_num_insn);
 						cores[core_num].ejectcontext(contexts[i]);
-						pid_handler.kill_pid(arg(A0),arg(A1));
+						sim_pid_handler().kill_pid(arg(A0),arg(A1));
 						fprintf(stderr,"(%lld) Killed by signal %lld\n",killwho,arg(A1));
 						contexts[i].pid = 0;
 						break;
@@ -3537,19 +3547,19 @@ void sys_syscall(regs_t *regs,		//registers to access
 			//details, which you only get right if you really let the kernel
 			//handle it. (e.g. you can't really ever block sigkill etc.)
 
-			arg(V0) = sigmask;
+			arg(V0) = os.signal_mask;
 			arg(A3) = 0;
 
 			switch(arg(A0))
 			{
 			case OSF_SIG_BLOCK:
-				sigmask |= (unsigned long)arg(A1);
+				os.signal_mask |= (unsigned long)arg(A1);
 				break;
 			case OSF_SIG_UNBLOCK:
-				sigmask &= (unsigned int)(~arg(A1));
+				os.signal_mask &= (unsigned int)(~arg(A1));
 				break;
 			case OSF_SIG_SETMASK:
-				sigmask = (unsigned int)arg(A1);
+				os.signal_mask = (unsigned int)arg(A1);
 				break;
 			default:
 				arg(V0) = EINVAL;
@@ -3567,12 +3577,12 @@ void sys_syscall(regs_t *regs,		//registers to access
 
 			if(arg(A1) != 0)
 			{
-				sigaction_array[signum] = arg(A1);
+				os.sigaction_array[signum] = arg(A1);
 			}
 
 			if(arg(A2))
 			{
-				arg(A2) = sigaction_array[signum];
+				arg(A2) = os.sigaction_array[signum];
 			}
 
 			arg(V0) = 0;
@@ -3670,7 +3680,7 @@ void sys_syscall(regs_t *regs,		//registers to access
 			sys_output("OSF_SYS_sigreturn: from(%llx) - does not return. ",arg(A0));
 			mem->mem_bcopy(Read, /* sc */arg(A0), &sc, sizeof(osf_sigcontext));
 
-			sigmask = MD_SWAPQ(sc.sc_mask); /* was: prog_sigmask */
+			os.signal_mask = MD_SWAPQ(sc.sc_mask); /* was: prog_sigmask */
 			regs->regs_NPC = MD_SWAPQ(sc.sc_pc);
 
 			//FIXME: should check for the branch delay bit
@@ -4496,9 +4506,8 @@ void sys_syscall(regs_t *regs,		//registers to access
 
 #endif
 #if 1
-			static int ignores = 0;
-			ignores++;
-			if(ignores<200000)
+			os.select_ignores++;
+			if(os.select_ignores<200000)
 			{
 				arg(V0) = 0;
 				contexts[context_id].regs.regs_PC = regs->regs_PC-8;
@@ -4506,7 +4515,7 @@ void sys_syscall(regs_t *regs,		//registers to access
 				check_error = false;
 				break;
 			}
-			ignores = 0;
+			os.select_ignores = 0;
 #endif
 			if(contexts[context_id].fastfwd_left == -1)
 			{
@@ -4638,12 +4647,11 @@ void sys_syscall(regs_t *regs,		//registers to access
 
 	case OSF_SYS_usleep_thread:
 		{
-			static int var = 200;
-			var = (var + 1)%1000;
+			os.usleep_jitter = (os.usleep_jitter + 1)%1000;
 			unsigned int useconds = 0;
 			mem->mem_bcopy(Read, arg(A0), &useconds, sizeof(unsigned int));
 			sys_output("OSF_SYS_usleep_thread (%d) ", useconds);
-			contexts[context_id].sleep = useconds*1000 + var;
+			contexts[context_id].sleep = useconds*1000 + os.usleep_jitter;
 
 			arg(V0) = 0;
 			check_error = true;
@@ -4874,7 +4882,7 @@ void sys_syscall(regs_t *regs,		//registers to access
 			//exec_flush must occur first, otherwise it will purse pages that may have been loaded dynamically
 			//However, this causes exec to have no possible return path on failure (if the target can be loaded into memory at all).
 			mem->exec_flush();
-			int load_ret = loader.ld_load_prog(filename, argv, envp, &contexts[context_id].regs, contexts[context_id].mem, 1);
+			int load_ret = sim_loader().ld_load_prog(filename, argv, envp, &contexts[context_id].regs, contexts[context_id].mem, 1);
 			if(load_ret)
 			{
 				arg(A3) = load_ret;
@@ -4916,7 +4924,7 @@ void sys_syscall(regs_t *regs,		//registers to access
 			arg(V0) = arg(A0);
 
 			//get_retval sets arg(V0) and arg(A3) with the return value (A3) and the source child's pid (V0) on success. Otherwise, no change.
-			if(!pid_handler.get_retval(contexts[context_id].pid,arg(V0),arg(A3)))
+			if(!sim_pid_handler().get_retval(contexts[context_id].pid,arg(V0),arg(A3)))
 			{
 				//FIXME: Can we just cancel this instruction somehow?
 				arg(V0) = 0;
@@ -5008,6 +5016,11 @@ void sys_syscall(regs_t *regs,		//registers to access
 			}
 			else
 			{
+				//the other cores hold references into contexts while they run in parallel, it must not be reallocated
+				if(core_pool_t::active() && core_pool_t::active()->parallel() && (contexts.size() == contexts.capacity()))
+				{
+					fatal("fork: too many contexts for a parallel run, use -sim:threads 1");
+				}
 				contexts.push_back(*new_context);
 
 				//Remember, pointers may be broken at this point.
@@ -5029,7 +5042,7 @@ void sys_syscall(regs_t *regs,		//registers to access
 				}
 
 				//arg(A4) determines which is the child
-				unsigned long long child_pid = pid_handler.get_new_pid();
+				unsigned long long child_pid = sim_pid_handler().get_new_pid();
 				contexts.back().regs.regs_R[MD_REG_A3] = arg(A3) = 0;
 				contexts.back().regs.regs_R[MD_REG_A4] = 1;
 				contexts.back().regs.regs_R[MD_REG_V0] = arg(V0) = contexts.back().pid = child_pid;
@@ -5037,7 +5050,7 @@ void sys_syscall(regs_t *regs,		//registers to access
 				contexts.back().gid = contexts[context_id].gid;
 				arg(A4) = 0;
 				contexts.back().file_table.copy_from(contexts[context_id].file_table);
-				pid_handler.add_child(contexts[context_id].pid,child_pid);
+				sim_pid_handler().add_child(contexts[context_id].pid,child_pid);
 				contexts.back().fastfwd_cnt = contexts[context_id].fastfwd_left;
 				contexts.back().fastfwd_left = contexts[context_id].fastfwd_left;
 
@@ -5064,7 +5077,6 @@ void sys_syscall(regs_t *regs,		//registers to access
 
 	case OSF_SYS_audcntl:
 		{
-			static md_gpr_t audcntl = 0x002;	//Default value is AUDIT_OFF
 			sys_output("OSF_SYS_audcntl: request(%lld) argp(0x%llx) len(%lld) flag(%lld) audit_id(%lld) pid(%lld) (FIXME)\t",arg(A0),arg(A1),arg(A2),arg(A3),arg(A4),arg(A5));
 			//sys/audit.h
 			arg(V0) = 0;
@@ -5097,11 +5109,11 @@ void sys_syscall(regs_t *regs,		//registers to access
 				}
 				break;
 			case 6:		//GET_PROC_ACNTL
-				arg(V0) = audcntl;
+				arg(V0) = os.audcntl;
 				break;
 			case 7:		//SET_PROC_ACNTL
-				arg(V0) = audcntl;
-				audcntl = arg(A4);
+				arg(V0) = os.audcntl;
+				os.audcntl = arg(A4);
 				break;
 
 			default:
@@ -81,6 +81,24 @@
  *
  */
 
+#define OSF_NSIG		32
+
+//emulated OS state of one simulation, the calling thread's simulation holds it (see sim_syscall_state() in sim.h)
+class syscall_state_t
+{
+	public:
+		syscall_state_t();
+
+		//signal mask and sigaction() handlers of the target
+		unsigned long signal_mask;
+		qword_t sigaction_array[OSF_NSIG];
+
+		//select() calls ignored since one was made, the jitter added to usleep_thread() and the audcntl() value
+		int select_ignores;
+		int usleep_jitter;
+		md_gpr_t audcntl;
+};
+
 //syscall proxy handler, architect registers and memory are assumed to be
 //precise when this function is called, register and memory are updated with
 //the results of the system call
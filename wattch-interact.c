@@ -18,7 +18,6 @@ int data_width;
 int res_ialu;
 int res_fpalu;
 int res_memport;
-int verbose;
 int rename_access, window_access, bpred_access, lsq_access, regfile_access;
 int icache_access, dcache_access, dcache2_access, alu_access, resultbus_access;
 int window_preg_access, window_selection_access;